@@ -57,6 +57,12 @@ struct sampler_info
 {
    void *samplers[PIPE_MAX_SAMPLERS];
    unsigned nr_samplers;
+
+   /** CSO found by the last lookup for each slot, NULL for unbound slots */
+   struct cso_sampler *cso_samplers[PIPE_MAX_SAMPLERS];
+
+   /** Did any slot change since the samplers were last sent to the driver? */
+   boolean dirty;
 };
 
 
@@ -80,6 +86,7 @@ struct cso_context {
    unsigned nr_fragment_views_saved;
 
    void *fragment_samplers_saved[PIPE_MAX_SAMPLERS];
+   struct cso_sampler *fragment_cso_samplers_saved[PIPE_MAX_SAMPLERS];
    unsigned nr_fragment_samplers_saved;
 
    struct sampler_info samplers[PIPE_SHADER_TYPES];
@@ -157,6 +164,20 @@ static boolean delete_depth_stencil_state(struct cso_context *ctx, void *state)
 static boolean delete_sampler_state(struct cso_context *ctx, void *state)
 {
    struct cso_sampler *cso = (struct cso_sampler *)state;
+   unsigned sh, i;
+
+   /* Keep samplers which are bound or saved, cso_single_sampler() refers
+    * to them without a hash lookup.
+    */
+   for (i = 0; i < PIPE_MAX_SAMPLERS; i++) {
+      for (sh = 0; sh < PIPE_SHADER_TYPES; sh++) {
+         if (ctx->samplers[sh].cso_samplers[i] == cso)
+            return FALSE;
+      }
+      if (ctx->fragment_cso_samplers_saved[i] == cso)
+         return FALSE;
+   }
+
    if (cso->delete_state)
       cso->delete_state(cso->context, cso->data);
    FREE(state);
@@ -1164,8 +1185,19 @@ enum pipe_error
 cso_single_sampler(struct cso_context *ctx, unsigned shader_stage,
                    unsigned idx, const struct pipe_sampler_state *templ)
 {
+   struct sampler_info *info = &ctx->samplers[shader_stage];
+   struct cso_sampler *cso = NULL;
    void *handle = NULL;
 
+   if (templ) {
+      /* Most of the time the slot is set to the state it already has */
+      cso = info->cso_samplers[idx];
+      if (cso && memcmp(&cso->state, templ, sizeof(*templ)) == 0) {
+         assert(info->samplers[idx] == cso->data);
+         return PIPE_OK;
+      }
+   }
+
    if (templ) {
       unsigned key_size = sizeof(struct pipe_sampler_state);
       unsigned hash_key = cso_construct_key((void*)templ, key_size);
@@ -1175,7 +1207,7 @@ cso_single_sampler(struct cso_context *ctx, unsigned shader_stage,
                                  (void *) templ, key_size);
 
       if (cso_hash_iter_is_null(iter)) {
-         struct cso_sampler *cso = MALLOC(sizeof(struct cso_sampler));
+         cso = MALLOC(sizeof(struct cso_sampler));
          if (!cso)
             return PIPE_ERROR_OUT_OF_MEMORY;
 
@@ -1194,17 +1226,22 @@ cso_single_sampler(struct cso_context *ctx, unsigned shader_stage,
          handle = cso->data;
       }
       else {
-         handle = ((struct cso_sampler *)cso_hash_iter_data(iter))->data;
+         cso = (struct cso_sampler *)cso_hash_iter_data(iter);
+         handle = cso->data;
       }
    }
 
-   ctx->samplers[shader_stage].samplers[idx] = handle;
+   if (info->samplers[idx] != handle) {
+      info->samplers[idx] = handle;
+      info->dirty = TRUE;
+   }
+   info->cso_samplers[idx] = cso;
    return PIPE_OK;
 }
 
 
 /**
- * Send staged sampler state to the driver.
+ * Send staged sampler state to the driver, if it changed.
  */
 void
 cso_single_sampler_done(struct cso_context *ctx,
@@ -1214,6 +1251,13 @@ cso_single_sampler_done(struct cso_context *ctx,
    const unsigned old_nr_samplers = info->nr_samplers;
    unsigned i;
 
+   /* Drivers expect the whole range of samplers to be set at once (many
+    * of them only support start == 0), so either all slots up to the
+    * highest bound one are sent or nothing is.
+    */
+   if (!info->dirty)
+      return;
+
    /* find highest non-null sampler */
    for (i = PIPE_MAX_SAMPLERS; i > 0; i--) {
       if (info->samplers[i - 1] != NULL)
@@ -1221,6 +1265,7 @@ cso_single_sampler_done(struct cso_context *ctx,
    }
 
    info->nr_samplers = i;
+   info->dirty = FALSE;
    ctx->pipe->bind_sampler_states(ctx->pipe, shader_stage, 0,
                                   MAX2(old_nr_samplers, info->nr_samplers),
                                   info->samplers);
@@ -1267,6 +1312,8 @@ cso_save_fragment_samplers(struct cso_context *ctx)
    ctx->nr_fragment_samplers_saved = info->nr_samplers;
    memcpy(ctx->fragment_samplers_saved, info->samplers,
           sizeof(info->samplers));
+   memcpy(ctx->fragment_cso_samplers_saved, info->cso_samplers,
+          sizeof(info->cso_samplers));
 }
 
 
@@ -1278,6 +1325,11 @@ cso_restore_fragment_samplers(struct cso_context *ctx)
    info->nr_samplers = ctx->nr_fragment_samplers_saved;
    memcpy(info->samplers, ctx->fragment_samplers_saved,
           sizeof(info->samplers));
+   memcpy(info->cso_samplers, ctx->fragment_cso_samplers_saved,
+          sizeof(info->cso_samplers));
+   memset(ctx->fragment_cso_samplers_saved, 0,
+          sizeof(ctx->fragment_cso_samplers_saved));
+   info->dirty = TRUE;
    cso_single_sampler_done(ctx, PIPE_SHADER_FRAGMENT);
 }
 
@@ -35,363 +35,231 @@
 
 #include "cso_hash.h"
 
-#ifndef MAX
-#define MAX(a, b) ((a > b) ? (a) : (b))
-#endif
-
-static const int MinNumBits = 4;
-
-static const unsigned char prime_deltas[] = {
-   0,  0,  1,  3,  1,  5,  3,  3,  1,  9,  7,  5,  3,  9, 25,  3,
-   1, 21,  3, 21,  7, 15,  9,  5,  3, 29, 15,  0,  0,  0,  0,  0
-};
-
-static int primeForNumBits(int numBits)
-{
-   return (1 << numBits) + prime_deltas[numBits];
-}
 
 /*
-    Returns the smallest integer n such that
-    primeForNumBits(n) >= hint.
-*/
-static int countBits(int hint)
-{
-   int numBits = 0;
-   int bits = hint;
+ * Open addressing with linear probing.  Keys are stored inline next to the
+ * data pointer, so a lookup touches a single cache line in the common case
+ * instead of chasing a per-entry node allocation.
+ *
+ * Removed entries leave a tombstone behind, which keeps both probe
+ * sequences and ongoing iterations valid.  Tombstones are dropped the next
+ * time the table is rebuilt.
+ */
 
-   while (bits > 1) {
-      bits >>= 1;
-      numBits++;
-   }
+#define CSO_HASH_MIN_BITS 4
 
-   if (numBits >= (int)sizeof(prime_deltas)) {
-      numBits = sizeof(prime_deltas) - 1;
-   } else if (primeForNumBits(numBits) < hint) {
-      ++numBits;
-   }
-   return numBits;
-}
+enum cso_slot_state {
+   CSO_SLOT_EMPTY = 0,
+   CSO_SLOT_LIVE,
+   CSO_SLOT_DELETED
+};
 
 struct cso_node {
-   struct cso_node *next;
    unsigned key;
+   unsigned state;
    void *value;
 };
 
-struct cso_hash_data {
-   struct cso_node *fakeNext;
-   struct cso_node **buckets;
-   int size;
-   int nodeSize;
-   short userNumBits;
-   short numBits;
-   int numBuckets;
-};
-
 struct cso_hash {
-   union {
-      struct cso_hash_data *d;
-      struct cso_node      *e;
-   } data;
+   struct cso_node *slots;
+   int num_slots;   /**< power of two, or 0 before the first insertion */
+   int num_bits;    /**< log2(num_slots) */
+   int size;        /**< live entries */
+   int used;        /**< live entries plus tombstones */
 };
 
-static void *cso_data_allocate_node(struct cso_hash_data *hash)
-{
-   return MALLOC(hash->nodeSize);
-}
 
-static void cso_free_node(struct cso_node *node)
+static inline int
+cso_hash_slot(const struct cso_hash *hash, unsigned key)
 {
-   FREE(node);
+   /* Keys are often poorly distributed (e.g. level and layer numbers, or
+    * the XOR of the words of a state object), so mix them before use.
+    */
+   /* Fibonacci hashing: the top bits of the product depend on all the
+    * bits of the key.
+    */
+   return (key * 0x9e3779b1u) >> (32 - hash->num_bits);
 }
 
-static struct cso_node *
-cso_hash_create_node(struct cso_hash *hash,
-                      unsigned akey, void *avalue,
-                      struct cso_node **anextNode)
+static inline struct cso_hash_iter
+cso_hash_make_iter(struct cso_hash *hash, int index, boolean probing)
 {
-   struct cso_node *node = cso_data_allocate_node(hash->data.d);
-
-   if (!node)
-      return NULL;
-
-   node->key = akey;
-   node->value = avalue;
-
-   node->next = (struct cso_node*)(*anextNode);
-   *anextNode = node;
-   ++hash->data.d->size;
-   return node;
+   struct cso_hash_iter iter = {hash, index, probing};
+   return iter;
 }
 
-static void cso_data_rehash(struct cso_hash_data *hash, int hint)
+static int
+cso_hash_next_live(const struct cso_hash *hash, int index)
 {
-   if (hint < 0) {
-      hint = countBits(-hint);
-      if (hint < MinNumBits)
-         hint = MinNumBits;
-      hash->userNumBits = (short)hint;
-      while (primeForNumBits(hint) < (hash->size >> 1))
-         ++hint;
-   } else if (hint < MinNumBits) {
-      hint = MinNumBits;
-   }
-
-   if (hash->numBits != hint) {
-      struct cso_node *e = (struct cso_node *)(hash);
-      struct cso_node **oldBuckets = hash->buckets;
-      int oldNumBuckets = hash->numBuckets;
-      int  i = 0;
-
-      hash->numBits = (short)hint;
-      hash->numBuckets = primeForNumBits(hint);
-      hash->buckets = MALLOC(sizeof(struct cso_node*) * hash->numBuckets);
-      for (i = 0; i < hash->numBuckets; ++i)
-         hash->buckets[i] = e;
-
-      for (i = 0; i < oldNumBuckets; ++i) {
-         struct cso_node *firstNode = oldBuckets[i];
-         while (firstNode != e) {
-            unsigned h = firstNode->key;
-            struct cso_node *lastNode = firstNode;
-            struct cso_node *afterLastNode;
-            struct cso_node **beforeFirstNode;
-            
-            while (lastNode->next != e && lastNode->next->key == h)
-               lastNode = lastNode->next;
-
-            afterLastNode = lastNode->next;
-            beforeFirstNode = &hash->buckets[h % hash->numBuckets];
-            while (*beforeFirstNode != e)
-               beforeFirstNode = &(*beforeFirstNode)->next;
-            lastNode->next = *beforeFirstNode;
-            *beforeFirstNode = firstNode;
-            firstNode = afterLastNode;
-         }
-      }
-      FREE(oldBuckets);
+   for (index++; index < hash->num_slots; index++) {
+      if (hash->slots[index].state == CSO_SLOT_LIVE)
+         return index;
    }
+   return -1;
 }
 
-static void cso_data_might_grow(struct cso_hash_data *hash)
+/**
+ * Continue the probe sequence of slot index, returning the next live slot
+ * with the same key or -1.
+ */
+static int
+cso_hash_next_probe(const struct cso_hash *hash, int index)
 {
-   if (hash->size >= hash->numBuckets)
-      cso_data_rehash(hash, hash->numBits + 1);
+   const unsigned mask = hash->num_slots - 1;
+   const unsigned key = hash->slots[index].key;
+   int i;
+
+   for (i = (index + 1) & mask;
+        hash->slots[i].state != CSO_SLOT_EMPTY;
+        i = (i + 1) & mask) {
+      if (hash->slots[i].state == CSO_SLOT_LIVE && hash->slots[i].key == key)
+         return i;
+   }
+   return -1;
 }
 
-static void cso_data_has_shrunk(struct cso_hash_data *hash)
+static int
+cso_hash_find_slot(const struct cso_hash *hash, unsigned key)
 {
-   if (hash->size <= (hash->numBuckets >> 3) &&
-       hash->numBits > hash->userNumBits) {
-      int max = MAX(hash->numBits-2, hash->userNumBits);
-      cso_data_rehash(hash,  max);
+   const unsigned mask = hash->num_slots - 1;
+   int i;
+
+   if (!hash->num_slots)
+      return -1;
+
+   for (i = cso_hash_slot(hash, key);
+        hash->slots[i].state != CSO_SLOT_EMPTY;
+        i = (i + 1) & mask) {
+      if (hash->slots[i].state == CSO_SLOT_LIVE && hash->slots[i].key == key)
+         return i;
    }
+   return -1;
 }
 
-static struct cso_node *cso_data_first_node(struct cso_hash_data *hash)
+static boolean
+cso_hash_rehash(struct cso_hash *hash, int num_bits)
 {
-   struct cso_node *e = (struct cso_node *)(hash);
-   struct cso_node **bucket = hash->buckets;
-   int n = hash->numBuckets;
-   while (n--) {
-      if (*bucket != e)
-         return *bucket;
-      ++bucket;
+   const int num_slots = 1 << num_bits;
+   struct cso_node *old_slots = hash->slots;
+   int old_num_slots = hash->num_slots;
+   int i;
+
+   hash->slots = CALLOC(num_slots, sizeof(struct cso_node));
+   if (!hash->slots) {
+      hash->slots = old_slots;
+      return FALSE;
    }
-   return e;
-}
+   hash->num_slots = num_slots;
+   hash->num_bits = num_bits;
+   hash->used = hash->size;
 
-static struct cso_node **cso_hash_find_node(struct cso_hash *hash, unsigned akey)
-{
-   struct cso_node **node;
-
-   if (hash->data.d->numBuckets) {
-      node = (struct cso_node **)(&hash->data.d->buckets[akey % hash->data.d->numBuckets]);
-      assert(*node == hash->data.e || (*node)->next);
-      while (*node != hash->data.e && (*node)->key != akey)
-         node = &(*node)->next;
-   } else {
-      node = (struct cso_node **)((const struct cso_node * const *)(&hash->data.e));
+   for (i = 0; i < old_num_slots; i++) {
+      if (old_slots[i].state == CSO_SLOT_LIVE) {
+         int j = cso_hash_slot(hash, old_slots[i].key);
+
+         while (hash->slots[j].state != CSO_SLOT_EMPTY)
+            j = (j + 1) & (num_slots - 1);
+         hash->slots[j] = old_slots[i];
+      }
    }
-   return node;
+
+   FREE(old_slots);
+   return TRUE;
 }
 
 struct cso_hash_iter cso_hash_insert(struct cso_hash *hash,
                                        unsigned key, void *data)
 {
-   cso_data_might_grow(hash->data.d);
-
-   {
-      struct cso_node **nextNode = cso_hash_find_node(hash, key);
-      struct cso_node *node = cso_hash_create_node(hash, key, data, nextNode);
-      if (!node) {
-         struct cso_hash_iter null_iter = {hash, 0};
-         return null_iter;
-      }
-
-      {
-         struct cso_hash_iter iter = {hash, node};
-         return iter;
-      }
+   int i;
+
+   /* Keep the table at most half full, counting tombstones, so that
+    * lookups which miss only probe a couple of slots.
+    */
+   if ((hash->used + 1) * 2 > hash->num_slots) {
+      int num_bits = CSO_HASH_MIN_BITS;
+
+      while ((1 << num_bits) < (hash->size + 1) * 4)
+         num_bits++;
+      if (!cso_hash_rehash(hash, num_bits))
+         return cso_hash_make_iter(hash, -1, FALSE);
    }
+
+   /* Take the first empty or deleted slot of the probe sequence. */
+   i = cso_hash_slot(hash, key);
+   while (hash->slots[i].state == CSO_SLOT_LIVE)
+      i = (i + 1) & (hash->num_slots - 1);
+
+   if (hash->slots[i].state == CSO_SLOT_EMPTY)
+      hash->used++;
+   hash->slots[i].key = key;
+   hash->slots[i].state = CSO_SLOT_LIVE;
+   hash->slots[i].value = data;
+   hash->size++;
+
+   return cso_hash_make_iter(hash, i, FALSE);
 }
 
 struct cso_hash * cso_hash_create(void)
 {
-   struct cso_hash *hash = MALLOC_STRUCT(cso_hash);
-   if (!hash)
-      return NULL;
-
-   hash->data.d = MALLOC_STRUCT(cso_hash_data);
-   if (!hash->data.d) {
-      FREE(hash);
-      return NULL;
-   }
-
-   hash->data.d->fakeNext = 0;
-   hash->data.d->buckets = 0;
-   hash->data.d->size = 0;
-   hash->data.d->nodeSize = sizeof(struct cso_node);
-   hash->data.d->userNumBits = (short)MinNumBits;
-   hash->data.d->numBits = 0;
-   hash->data.d->numBuckets = 0;
-
-   return hash;
+   return CALLOC_STRUCT(cso_hash);
 }
 
 void cso_hash_delete(struct cso_hash *hash)
 {
-   struct cso_node *e_for_x = (struct cso_node *)(hash->data.d);
-   struct cso_node **bucket = (struct cso_node **)(hash->data.d->buckets);
-   int n = hash->data.d->numBuckets;
-   while (n--) {
-      struct cso_node *cur = *bucket++;
-      while (cur != e_for_x) {
-         struct cso_node *next = cur->next;
-         cso_free_node(cur);
-         cur = next;
-      }
-   }
-   FREE(hash->data.d->buckets);
-   FREE(hash->data.d);
+   FREE(hash->slots);
    FREE(hash);
 }
 
 struct cso_hash_iter cso_hash_find(struct cso_hash *hash,
                                      unsigned key)
 {
-   struct cso_node **nextNode = cso_hash_find_node(hash, key);
-   struct cso_hash_iter iter = {hash, *nextNode};
-   return iter;
+   return cso_hash_make_iter(hash, cso_hash_find_slot(hash, key), TRUE);
 }
 
 unsigned cso_hash_iter_key(struct cso_hash_iter iter)
 {
-   if (!iter.node || iter.hash->data.e == iter.node)
+   if (iter.index < 0)
       return 0;
-   return iter.node->key;
+   return iter.hash->slots[iter.index].key;
 }
 
 void * cso_hash_iter_data(struct cso_hash_iter iter)
 {
-   if (!iter.node || iter.hash->data.e == iter.node)
+   if (iter.index < 0)
       return 0;
-   return iter.node->value;
+   return iter.hash->slots[iter.index].value;
 }
 
-static struct cso_node *cso_hash_data_next(struct cso_node *node)
+struct cso_hash_iter cso_hash_iter_next(struct cso_hash_iter iter)
 {
-   union {
-      struct cso_node *next;
-      struct cso_node *e;
-      struct cso_hash_data *d;
-   } a;
-   int start;
-   struct cso_node **bucket;
-   int n;
-
-   a.next = node->next;
-   if (!a.next) {
+   if (iter.index < 0) {
       debug_printf("iterating beyond the last element\n");
-      return 0;
-   }
-   if (a.next->next)
-      return a.next;
-
-   start = (node->key % a.d->numBuckets) + 1;
-   bucket = a.d->buckets + start;
-   n = a.d->numBuckets - start;
-   while (n--) {
-      if (*bucket != a.e)
-         return *bucket;
-      ++bucket;
+      return iter;
    }
-   return a.e;
-}
-
 
-static struct cso_node *cso_hash_data_prev(struct cso_node *node)
-{
-   union {
-      struct cso_node *e;
-      struct cso_hash_data *d;
-   } a;
-   int start;
-   struct cso_node *sentinel;
-   struct cso_node **bucket;
-
-   a.e = node;
-   while (a.e->next)
-      a.e = a.e->next;
-
-   if (node == a.e)
-      start = a.d->numBuckets - 1;
+   if (iter.probing)
+      iter.index = cso_hash_next_probe(iter.hash, iter.index);
    else
-      start = node->key % a.d->numBuckets;
-
-   sentinel = node;
-   bucket = a.d->buckets + start;
-   while (start >= 0) {
-      if (*bucket != sentinel) {
-         struct cso_node *prev = *bucket;
-         while (prev->next != sentinel)
-            prev = prev->next;
-         return prev;
-      }
-
-      sentinel = a.e;
-      --bucket;
-      --start;
-   }
-   debug_printf("iterating backward beyond first element\n");
-   return a.e;
-}
-
-struct cso_hash_iter cso_hash_iter_next(struct cso_hash_iter iter)
-{
-   struct cso_hash_iter next = {iter.hash, cso_hash_data_next(iter.node)};
-   return next;
+      iter.index = cso_hash_next_live(iter.hash, iter.index);
+   return iter;
 }
 
 int cso_hash_iter_is_null(struct cso_hash_iter iter)
 {
-   if (!iter.node || iter.node == iter.hash->data.e)
-      return 1;
-   return 0;
+   return iter.index < 0;
 }
 
 void * cso_hash_take(struct cso_hash *hash,
                       unsigned akey)
 {
-   struct cso_node **node = cso_hash_find_node(hash, akey);
-   if (*node != hash->data.e) {
-      void *t = (*node)->value;
-      struct cso_node *next = (*node)->next;
-      cso_free_node(*node);
-      *node = next;
-      --hash->data.d->size;
-      cso_data_has_shrunk(hash->data.d);
+   int i = cso_hash_find_slot(hash, akey);
+
+   if (i >= 0) {
+      void *t = hash->slots[i].value;
+
+      hash->slots[i].state = CSO_SLOT_DELETED;
+      hash->slots[i].value = NULL;
+      --hash->size;
       return t;
    }
    return 0;
@@ -399,43 +267,42 @@ void * cso_hash_take(struct cso_hash *hash,
 
 struct cso_hash_iter cso_hash_iter_prev(struct cso_hash_iter iter)
 {
-   struct cso_hash_iter prev = {iter.hash,
-                                 cso_hash_data_prev(iter.node)};
-   return prev;
+   int i = iter.index < 0 ? iter.hash->num_slots : iter.index;
+
+   while (--i >= 0) {
+      if (iter.hash->slots[i].state == CSO_SLOT_LIVE)
+         return cso_hash_make_iter(iter.hash, i, FALSE);
+   }
+
+   debug_printf("iterating backward beyond first element\n");
+   return cso_hash_make_iter(iter.hash, -1, FALSE);
 }
 
 struct cso_hash_iter cso_hash_first_node(struct cso_hash *hash)
 {
-   struct cso_hash_iter iter = {hash, cso_data_first_node(hash->data.d)};
-   return iter;
+   return cso_hash_make_iter(hash, cso_hash_next_live(hash, -1), FALSE);
 }
 
 int cso_hash_size(struct cso_hash *hash)
 {
-   return hash->data.d->size;
+   return hash->size;
 }
 
 struct cso_hash_iter cso_hash_erase(struct cso_hash *hash, struct cso_hash_iter iter)
 {
-   struct cso_hash_iter ret = iter;
-   struct cso_node *node = iter.node;
-   struct cso_node **node_ptr;
+   struct cso_hash_iter ret;
 
-   if (node == hash->data.e)
+   if (iter.index < 0)
       return iter;
 
-   ret = cso_hash_iter_next(ret);
-   node_ptr = (struct cso_node**)(&hash->data.d->buckets[node->key % hash->data.d->numBuckets]);
-   while (*node_ptr != node)
-      node_ptr = &(*node_ptr)->next;
-   *node_ptr = node->next;
-   cso_free_node(node);
-   --hash->data.d->size;
+   ret = cso_hash_iter_next(iter);
+   hash->slots[iter.index].state = CSO_SLOT_DELETED;
+   hash->slots[iter.index].value = NULL;
+   --hash->size;
    return ret;
 }
 
 boolean cso_hash_contains(struct cso_hash *hash, unsigned key)
 {
-   struct cso_node **node = cso_hash_find_node(hash, key);
-   return (*node != hash->data.e);
+   return cso_hash_find_slot(hash, key) >= 0;
 }
@@ -30,13 +30,14 @@
  * Hash table implementation.
  * 
  * This file provides a hash implementation that is capable of dealing
- * with collisions. It stores colliding entries in linked list. All
- * functions operating on the hash return an iterator. The iterator
- * itself points to the collision list. If there wasn't any collision
+ * with collisions. It is an open addressing table which stores the keys
+ * inline. All functions operating on the hash return an iterator. An
+ * iterator returned by cso_hash_find() walks the collision list, i.e.
+ * all the entries with the same key. If there wasn't any collision
  * the list will have just one entry, otherwise client code should
  * iterate over the entries to find the exact entry among ones that
  * had the same key (e.g. memcmp could be used on the data to check
- * that)
+ * that). Iterators from cso_hash_first_node() walk the whole hash.
  * 
  * @author Zack Rusin <zackr@vmware.com>
  */
@@ -52,12 +53,12 @@ extern "C" {
 
 
 struct cso_hash;
-struct cso_node;
 
 
 struct cso_hash_iter {
    struct cso_hash *hash;
-   struct cso_node  *node;
+   int index;        /**< slot index, negative for the null iterator */
+   boolean probing;  /**< only visit entries with the same key */
 };
 
 
@@ -70,8 +71,8 @@ int              cso_hash_size(struct cso_hash *hash);
 
 /**
  * Adds a data with the given key to the hash. If entry with the given
- * key is already in the hash, this current entry is instered before it
- * in the collision list.
+ * key is already in the hash, this current entry is added to its
+ * collision list.
  * Function returns iterator pointing to the inserted item in the hash.
  */
 struct cso_hash_iter cso_hash_insert(struct cso_hash *hash, unsigned key,
@@ -25,9 +25,12 @@
  *
  **************************************************************************/
 
+#include "util/u_cpu_detect.h"
+#include "util/u_debug.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_prim.h"
+#include "util/u_queue.h"
 #include "draw/draw_context.h"
 #include "draw/draw_gs.h"
 #include "draw/draw_vbuf.h"
@@ -39,6 +42,30 @@
 #include "gallivm/lp_bld_init.h"
 
 
+/** Max number of worker threads running the vertex shader */
+#define LLVM_VS_MAX_THREADS 8
+
+/** Don't split vertex shading into slices smaller than this */
+#define LLVM_VS_MIN_SLICE 128
+
+DEBUG_GET_ONCE_NUM_OPTION(draw_num_threads, "DRAW_NUM_THREADS",
+                          MIN2(util_cpu_caps.nr_cpus - 1, LLVM_VS_MAX_THREADS))
+
+
+/**
+ * A slice of the vertices of one fetch, shaded by a worker thread.
+ */
+struct llvm_vs_job {
+   struct llvm_middle_end *fpme;
+   const struct draw_fetch_info *fetch_info;
+   struct vertex_header *verts;
+   unsigned first;      /**< first vertex of the slice */
+   unsigned count;
+   int clipped;
+   struct util_queue_fence fence;
+};
+
+
 struct llvm_middle_end {
    struct draw_pt_middle_end base;
    struct draw_context *draw;
@@ -56,6 +83,11 @@ struct llvm_middle_end {
 
    struct draw_llvm *llvm;
    struct draw_llvm_variant *current_variant;
+
+   /* Worker threads for large fetches, created on first use */
+   struct util_queue vs_queue;
+   unsigned vs_num_threads;
+   struct llvm_vs_job vs_jobs[LLVM_VS_MAX_THREADS];
 };
 
 
@@ -336,6 +368,128 @@ emit(struct pt_emit *emit,
 }
 
 
+/**
+ * Run the vertex shader on a slice of the fetched vertices.
+ */
+static int
+llvm_run_vs(struct llvm_middle_end *fpme,
+            const struct draw_fetch_info *fetch_info,
+            struct vertex_header *verts,
+            unsigned first,
+            unsigned count)
+{
+   struct draw_context *draw = fpme->draw;
+   struct vertex_header *io = (struct vertex_header *)
+      ((char *)verts + first * fpme->vertex_size);
+
+   if (fetch_info->linear)
+      return fpme->current_variant->jit_func( &fpme->llvm->jit_context,
+                                       io,
+                                       draw->pt.user.vbuffer,
+                                       fetch_info->start + first,
+                                       count,
+                                       fpme->vertex_size,
+                                       draw->pt.vertex_buffer,
+                                       draw->instance_id,
+                                       draw->start_index,
+                                       draw->start_instance);
+   else
+      return fpme->current_variant->jit_func_elts( &fpme->llvm->jit_context,
+                                            io,
+                                            draw->pt.user.vbuffer,
+                                            fetch_info->elts + first,
+                                            draw->pt.user.eltMax - first,
+                                            count,
+                                            fpme->vertex_size,
+                                            draw->pt.vertex_buffer,
+                                            draw->instance_id,
+                                            draw->pt.user.eltBias,
+                                            draw->start_instance);
+}
+
+
+static void
+llvm_vs_job_execute(void *data, int thread_index)
+{
+   struct llvm_vs_job *job = (struct llvm_vs_job *)data;
+   unsigned fpstate = util_fpstate_get();
+
+   /* Match the denorm handling draw_vbo() sets up on the calling thread */
+   util_fpstate_set_denorms_to_zero(fpstate);
+
+   job->clipped = llvm_run_vs(job->fpme, job->fetch_info, job->verts,
+                              job->first, job->count);
+
+   util_fpstate_set(fpstate);
+}
+
+
+/**
+ * Run the vertex shader on all fetched vertices.
+ * Large fetches are split into slices which are shaded by worker
+ * threads in parallel, the calling thread shading the last one.  All
+ * slices write disjoint parts of the same vertex buffer, so the output
+ * is identical to shading in one go.
+ */
+static int
+llvm_shade_vertices(struct llvm_middle_end *fpme,
+                    const struct draw_fetch_info *fetch_info,
+                    struct vertex_header *verts)
+{
+   const unsigned vector_length = lp_native_vector_width / 32;
+   unsigned num_slices, slice, first, i;
+   int clipped;
+
+   num_slices = MIN2(fpme->vs_num_threads + 1,
+                     fetch_info->count / LLVM_VS_MIN_SLICE);
+
+   /* The elts path checks the fetch position against eltMax, which
+    * can't be offset below zero.
+    */
+   if (!fetch_info->linear && fpme->draw->pt.user.eltMax < fetch_info->count)
+      num_slices = 1;
+
+   if (num_slices > 1 && !util_queue_is_initialized(&fpme->vs_queue)) {
+      if (!util_queue_init(&fpme->vs_queue, "draw_vs",
+                           LLVM_VS_MAX_THREADS, fpme->vs_num_threads)) {
+         fpme->vs_num_threads = 0;
+         num_slices = 1;
+      }
+   }
+
+   if (num_slices <= 1)
+      return llvm_run_vs(fpme, fetch_info, verts, 0, fetch_info->count);
+
+   /* The jit code always writes whole vectors of vertices, so slices
+    * must start at vector boundaries to not overwrite each other.
+    */
+   slice = align(DIV_ROUND_UP(fetch_info->count, num_slices), vector_length);
+   num_slices = DIV_ROUND_UP(fetch_info->count, slice);
+
+   for (i = 0, first = 0; i < num_slices - 1; i++, first += slice) {
+      struct llvm_vs_job *job = &fpme->vs_jobs[i];
+
+      job->fpme = fpme;
+      job->fetch_info = fetch_info;
+      job->verts = verts;
+      job->first = first;
+      job->count = slice;
+      util_queue_add_job(&fpme->vs_queue, job, &job->fence,
+                         llvm_vs_job_execute, NULL);
+   }
+
+   clipped = llvm_run_vs(fpme, fetch_info, verts, first,
+                         fetch_info->count - first);
+
+   for (i = 0; i < num_slices - 1; i++) {
+      util_queue_job_wait(&fpme->vs_jobs[i].fence);
+      clipped |= fpme->vs_jobs[i].clipped;
+   }
+
+   return clipped;
+}
+
+
 static void
 llvm_pipeline_generic(struct draw_pt_middle_end *middle,
                       const struct draw_fetch_info *fetch_info,
@@ -373,29 +527,7 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
       draw->statistics.vs_invocations += fetch_info->count;
    }
 
-   if (fetch_info->linear)
-      clipped = fpme->current_variant->jit_func( &fpme->llvm->jit_context,
-                                       llvm_vert_info.verts,
-                                       draw->pt.user.vbuffer,
-                                       fetch_info->start,
-                                       fetch_info->count,
-                                       fpme->vertex_size,
-                                       draw->pt.vertex_buffer,
-                                       draw->instance_id,
-                                       draw->start_index,
-                                       draw->start_instance);
-   else
-      clipped = fpme->current_variant->jit_func_elts( &fpme->llvm->jit_context,
-                                            llvm_vert_info.verts,
-                                            draw->pt.user.vbuffer,
-                                            fetch_info->elts,
-                                            draw->pt.user.eltMax,
-                                            fetch_info->count,
-                                            fpme->vertex_size,
-                                            draw->pt.vertex_buffer,
-                                            draw->instance_id,
-                                            draw->pt.user.eltBias,
-                                            draw->start_instance);
+   clipped = llvm_shade_vertices(fpme, fetch_info, llvm_vert_info.verts);
 
    /* Finished with fetch and vs:
     */
@@ -585,6 +717,13 @@ static void
 llvm_middle_end_destroy(struct draw_pt_middle_end *middle)
 {
    struct llvm_middle_end *fpme = llvm_middle_end(middle);
+   unsigned i;
+
+   if (util_queue_is_initialized(&fpme->vs_queue))
+      util_queue_destroy(&fpme->vs_queue);
+
+   for (i = 0; i < LLVM_VS_MAX_THREADS; i++)
+      util_queue_fence_destroy(&fpme->vs_jobs[i].fence);
 
    if (fpme->fetch)
       draw_pt_fetch_destroy( fpme->fetch );
@@ -606,6 +745,7 @@ struct draw_pt_middle_end *
 draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
 {
    struct llvm_middle_end *fpme = 0;
+   unsigned i;
 
    if (!draw->llvm)
       return NULL;
@@ -614,6 +754,9 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
    if (!fpme)
       goto fail;
 
+   for (i = 0; i < LLVM_VS_MAX_THREADS; i++)
+      util_queue_fence_init(&fpme->vs_jobs[i].fence);
+
    fpme->base.prepare         = llvm_middle_end_prepare;
    fpme->base.bind_parameters = llvm_middle_end_bind_parameters;
    fpme->base.run             = llvm_middle_end_run;
@@ -646,6 +789,9 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
 
    fpme->current_variant = NULL;
 
+   fpme->vs_num_threads = CLAMP(debug_get_option_draw_num_threads(),
+                                0, LLVM_VS_MAX_THREADS - 1);
+
    return &fpme->base;
 
  fail:
@@ -23,15 +23,33 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include <inttypes.h>
+
+#include "util/u_debug.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
+#include "util/u_prim.h"
 
 #include "draw/draw_context.h"
 #include "draw/draw_private.h"
 #include "draw/draw_pt.h"
 
+/* Draws are split into segments of at most this many vertices, which
+ * the middle end fetches, shades and emits independently.  The vertex
+ * cache below is cleared for each segment: the middle end releases the
+ * shaded vertices once a segment is emitted, so a vertex shared by two
+ * segments is shaded once in each.
+ */
 #define SEGMENT_SIZE 1024
-#define MAP_SIZE     256
+
+/* Default vertex cache size, twice a segment to keep probe chains short */
+#define MAP_SIZE     (2 * SEGMENT_SIZE)
+
+/* Number of slots looked at before a cache entry gets replaced */
+#define MAP_PROBES   8
+
+DEBUG_GET_ONCE_NUM_OPTION(vsplit_cache_size, "DRAW_VSPLIT_CACHE_SIZE", MAP_SIZE)
+DEBUG_GET_ONCE_BOOL_OPTION(vsplit_stats, "DRAW_VSPLIT_STATS", FALSE)
 
 /* The largest possible index withing an index buffer */
 #define MAX_ELT_IDX 0xffffffff
@@ -53,22 +71,39 @@ struct vsplit_frontend {
    ushort identity_draw_elts[SEGMENT_SIZE];
 
    struct {
-      /* map a fetch element to a draw element */
-      unsigned fetches[MAP_SIZE];
-      ushort draws[MAP_SIZE];
-      boolean has_max_fetch;
+      /* map a fetch element to a draw element, open addressing */
+      struct {
+         unsigned fetch;
+         ushort draw;
+         ushort generation;   /* entry is valid if it matches the cache's */
+      } *map;
+      unsigned map_mask;
+      unsigned map_shift;
+      ushort generation;
 
       ushort num_fetch_elts;
       ushort num_draw_elts;
    } cache;
+
+   /* vertex reuse statistics, for DRAW_VSPLIT_STATS */
+   struct {
+      boolean enabled;
+      uint64_t draw_elts;
+      uint64_t fetch_elts;
+      uint64_t prims;
+   } stats;
 };
 
 
 static void
 vsplit_clear_cache(struct vsplit_frontend *vsplit)
 {
-   memset(vsplit->cache.fetches, 0xff, sizeof(vsplit->cache.fetches));
-   vsplit->cache.has_max_fetch = FALSE;
+   /* Invalidate all entries at once, only clear on wrap around */
+   if (++vsplit->cache.generation == 0) {
+      memset(vsplit->cache.map, 0,
+             (vsplit->cache.map_mask + 1) * sizeof(vsplit->cache.map[0]));
+      vsplit->cache.generation = 1;
+   }
    vsplit->cache.num_fetch_elts = 0;
    vsplit->cache.num_draw_elts = 0;
 }
@@ -76,6 +111,14 @@ vsplit_clear_cache(struct vsplit_frontend *vsplit)
 static void
 vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned flags)
 {
+   if (vsplit->stats.enabled) {
+      vsplit->stats.draw_elts += vsplit->cache.num_draw_elts;
+      vsplit->stats.fetch_elts += vsplit->cache.num_fetch_elts;
+      vsplit->stats.prims +=
+         u_decomposed_prims_for_vertices(vsplit->prim,
+                                         vsplit->cache.num_draw_elts);
+   }
+
    vsplit->middle->run(vsplit->middle,
          vsplit->fetch_elts, vsplit->cache.num_fetch_elts,
          vsplit->draw_elts, vsplit->cache.num_draw_elts, flags);
@@ -83,27 +126,52 @@ vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned flags)
 
 /**
  * Add a fetch element and add it to the draw elements.
+ * Fetch elements already added to the segment are looked up in the
+ * cache, which only probes MAP_PROBES slots: a vertex whose entry was
+ * replaced, or which is shared with another segment, is fetched and
+ * shaded again.
  */
 static inline void
 vsplit_add_cache(struct vsplit_frontend *vsplit, unsigned fetch, unsigned ofbias)
 {
-   unsigned hash;
-
-   hash = fetch % MAP_SIZE;
-
-   /* If the value isn't in the cache or it's an overflow due to the
-    * element bias */
-   if (vsplit->cache.fetches[hash] != fetch || ofbias) {
-      /* update cache */
-      vsplit->cache.fetches[hash] = fetch;
-      vsplit->cache.draws[hash] = vsplit->cache.num_fetch_elts;
-
-      /* add fetch */
-      assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
-      vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
+   const unsigned mask = vsplit->cache.map_mask;
+   /* Multiplicative hash, taking the top bits of the product, so that
+    * strided and power-of-two index patterns don't pile up in
+    * neighbouring slots.
+    */
+   unsigned hash = (fetch * 2654435761u) >> vsplit->cache.map_shift;
+   unsigned slot = hash;
+   unsigned i;
+
+   /* An overflow due to the element bias always gets a new fetch */
+   if (!ofbias) {
+      for (i = 0; i < MAP_PROBES; i++) {
+         unsigned probe = (hash + i) & mask;
+
+         if (vsplit->cache.map[probe].generation != vsplit->cache.generation) {
+            /* free slot, not in the cache */
+            slot = probe;
+            break;
+         }
+
+         if (vsplit->cache.map[probe].fetch == fetch) {
+            vsplit->draw_elts[vsplit->cache.num_draw_elts++] =
+               vsplit->cache.map[probe].draw;
+            return;
+         }
+      }
    }
 
-   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = vsplit->cache.draws[hash];
+   /* update cache, replacing the first probed entry if all were taken */
+   vsplit->cache.map[slot].fetch = fetch;
+   vsplit->cache.map[slot].draw = vsplit->cache.num_fetch_elts;
+   vsplit->cache.map[slot].generation = vsplit->cache.generation;
+
+   /* add fetch */
+   assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
+   vsplit->draw_elts[vsplit->cache.num_draw_elts++] =
+      vsplit->cache.num_fetch_elts;
+   vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
 }
 
 /**
@@ -198,16 +266,7 @@ vsplit_add_cache_uint(struct vsplit_frontend *vsplit, const uint *elts,
                       unsigned start, unsigned fetch, int elt_bias)
 {
    struct draw_context *draw = vsplit->draw;
-   unsigned raw_elem_idx = start + fetch + elt_bias;
    VSPLIT_CREATE_IDX(elts, start, fetch, elt_bias);
-
-   /* special care for DRAW_MAX_FETCH_IDX */
-   if (raw_elem_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = fetch % MAP_SIZE;
-      vsplit->cache.fetches[hash] = raw_elem_idx - 1; /* force update */
-      vsplit->cache.has_max_fetch = TRUE;
-   }
-
    vsplit_add_cache(vsplit, elt_idx, ofbias);
 }
 
@@ -279,6 +338,21 @@ static void vsplit_flush(struct draw_pt_front_end *frontend, unsigned flags)
 
 static void vsplit_destroy(struct draw_pt_front_end *frontend)
 {
+   struct vsplit_frontend *vsplit = (struct vsplit_frontend *) frontend;
+
+   if (vsplit->stats.enabled && vsplit->stats.prims) {
+      debug_printf("vsplit: %"PRIu64" primitives, %"PRIu64" indices, "
+                   "%"PRIu64" vertex shader invocations "
+                   "(%.2f per primitive, %.2f per index)\n",
+                   vsplit->stats.prims,
+                   vsplit->stats.draw_elts,
+                   vsplit->stats.fetch_elts,
+                   (double)vsplit->stats.fetch_elts / vsplit->stats.prims,
+                   (double)vsplit->stats.fetch_elts /
+                   MAX2(vsplit->stats.draw_elts, 1));
+   }
+
+   FREE(vsplit->cache.map);
    FREE(frontend);
 }
 
@@ -286,11 +360,24 @@ static void vsplit_destroy(struct draw_pt_front_end *frontend)
 struct draw_pt_front_end *draw_pt_vsplit(struct draw_context *draw)
 {
    struct vsplit_frontend *vsplit = CALLOC_STRUCT(vsplit_frontend);
+   unsigned map_size;
    ushort i;
 
    if (!vsplit)
       return NULL;
 
+   map_size = util_next_power_of_two(
+      CLAMP(debug_get_option_vsplit_cache_size(), MAP_PROBES, 65536));
+   vsplit->cache.map = CALLOC(map_size, sizeof(vsplit->cache.map[0]));
+   if (!vsplit->cache.map) {
+      FREE(vsplit);
+      return NULL;
+   }
+   vsplit->cache.map_mask = map_size - 1;
+   vsplit->cache.map_shift = 32 - util_logbase2(map_size);
+
+   vsplit->stats.enabled = debug_get_option_vsplit_stats();
+
    vsplit->base.prepare = vsplit_prepare;
    vsplit->base.run     = NULL;
    vsplit->base.flush   = vsplit_flush;
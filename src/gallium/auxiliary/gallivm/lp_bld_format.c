@@ -44,9 +44,11 @@ lp_build_format_cache_type(struct gallivm_state *gallivm)
                        LP_BUILD_FORMAT_CACHE_SIZE);
 #if LP_BUILD_FORMAT_CACHE_DEBUG
    elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL] =
-         LLVMInt64TypeInContext(gallivm->context);
+         LLVMArrayType(LLVMInt64TypeInContext(gallivm->context),
+                       PIPE_FORMAT_COUNT);
    elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS] =
-         LLVMInt64TypeInContext(gallivm->context);
+         LLVMArrayType(LLVMInt64TypeInContext(gallivm->context),
+                       PIPE_FORMAT_COUNT);
 #endif
 
    s = LLVMStructTypeInContext(gallivm->context, elem_types,
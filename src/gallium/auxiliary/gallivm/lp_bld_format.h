@@ -56,14 +56,17 @@ struct lp_build_context;
 
 /*
  * Note: cache_data needs 16 byte alignment.
+ * Decoded blocks are stored row-major, i.e. cache_data[block][y][x].
+ * The debug access counters are kept per pipe_format so hit rates of
+ * different block-compressed formats can be told apart.
  */
 struct lp_build_format_cache
 {
    PIPE_ALIGN_VAR(16) uint32_t cache_data[LP_BUILD_FORMAT_CACHE_SIZE][4][4];
    uint64_t cache_tags[LP_BUILD_FORMAT_CACHE_SIZE];
 #if LP_BUILD_FORMAT_CACHE_DEBUG
-   uint64_t cache_access_total;
-   uint64_t cache_access_miss;
+   uint64_t cache_access_total[PIPE_FORMAT_COUNT];
+   uint64_t cache_access_miss[PIPE_FORMAT_COUNT];
 #endif
 };
 
@@ -82,6 +85,9 @@ enum {
 LLVMTypeRef
 lp_build_format_cache_type(struct gallivm_state *gallivm);
 
+boolean
+lp_build_format_cacheable(const struct util_format_description *format_desc);
+
 
 /*
  * AoS
@@ -33,6 +33,7 @@
 #include "lp_bld_swizzle.h"
 
 #include "util/u_math.h"
+#include "util/u_format.h"
 
 
 /**
@@ -43,7 +44,8 @@
  * a small cache helps.
  * The elements in the cache are the decoded blocks - currently things
  * are restricted to formats which are 4x4 block based, and the decoded
- * texels must fit into 4x8 bits.
+ * texels must fit into 4x8 bits. On a miss the whole block is decoded at
+ * once with util_format_description::unpack_rgba_8unorm().
  * The cache is direct mapped so hitrates aren't all that great and cache
  * thrashing could happen.
  *
@@ -51,20 +53,50 @@
  */
 
 
+/**
+ * Whether texels of the given format can be fetched through the block cache.
+ *
+ * This is true for all 4x4 block-compressed formats which have a block
+ * decode function and whose decoded values fit into 8 bit unorm (sRGB
+ * formats qualify if their linear counterpart does).
+ */
+boolean
+lp_build_format_cacheable(const struct util_format_description *format_desc)
+{
+   const struct util_format_description *linear_desc;
+
+   if (format_desc->layout == UTIL_FORMAT_LAYOUT_PLAIN ||
+       format_desc->layout == UTIL_FORMAT_LAYOUT_SUBSAMPLED ||
+       format_desc->block.width != 4 ||
+       format_desc->block.height != 4 ||
+       !format_desc->unpack_rgba_8unorm) {
+      return FALSE;
+   }
+
+   linear_desc = util_format_description(util_format_linear(format_desc->format));
+
+   return util_format_fits_8unorm(linear_desc);
+}
+
+
 #if LP_BUILD_FORMAT_CACHE_DEBUG
 static void
 update_cache_access(struct gallivm_state *gallivm,
+                    const struct util_format_description *format_desc,
                     LLVMValueRef ptr,
                     unsigned count,
                     unsigned index)
 {
    LLVMBuilderRef builder = gallivm->builder;
-   LLVMValueRef member_ptr, cache_access;
+   LLVMValueRef member_ptr, cache_access, indices[3];
 
    assert(index == LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL ||
           index == LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
 
-   member_ptr = lp_build_struct_get_ptr(gallivm, ptr, index, "");
+   indices[0] = lp_build_const_int32(gallivm, 0);
+   indices[1] = lp_build_const_int32(gallivm, index);
+   indices[2] = lp_build_const_int32(gallivm, format_desc->format);
+   member_ptr = LLVMBuildGEP(builder, ptr, indices, ARRAY_SIZE(indices), "");
    cache_access = LLVMBuildLoad(builder, member_ptr, "cache_access");
    cache_access = LLVMBuildAdd(builder, cache_access,
                                LLVMConstInt(LLVMInt64TypeInContext(gallivm->context),
@@ -75,35 +107,19 @@ update_cache_access(struct gallivm_state *gallivm,
 
 
 static void
-store_cached_block(struct gallivm_state *gallivm,
-                   LLVMValueRef *col,
-                   LLVMValueRef tag_value,
-                   LLVMValueRef hash_index,
-                   LLVMValueRef cache)
+store_cached_tag(struct gallivm_state *gallivm,
+                 LLVMValueRef tag_value,
+                 LLVMValueRef hash_index,
+                 LLVMValueRef cache)
 {
    LLVMBuilderRef builder = gallivm->builder;
    LLVMValueRef ptr, indices[3];
-   LLVMTypeRef type_ptr4x32;
-   unsigned count;
 
-   type_ptr4x32 = LLVMPointerType(LLVMVectorType(LLVMInt32TypeInContext(gallivm->context), 4), 0);
    indices[0] = lp_build_const_int32(gallivm, 0);
    indices[1] = lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_MEMBER_TAGS);
    indices[2] = hash_index;
    ptr = LLVMBuildGEP(builder, cache, indices, ARRAY_SIZE(indices), "");
    LLVMBuildStore(builder, tag_value, ptr);
-
-   indices[1] = lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_MEMBER_DATA);
-   hash_index = LLVMBuildMul(builder, hash_index,
-                             lp_build_const_int32(gallivm, 16), "");
-   for (count = 0; count < 4; count++) {
-      indices[2] = hash_index;
-      ptr = LLVMBuildGEP(builder, cache, indices, ARRAY_SIZE(indices), "");
-      ptr = LLVMBuildBitCast(builder, ptr, type_ptr4x32, "");
-      LLVMBuildStore(builder, col[count], ptr);
-      hash_index = LLVMBuildAdd(builder, hash_index,
-                                lp_build_const_int32(gallivm, 4), "");
-   }
 }
 
 
@@ -151,41 +167,35 @@ update_cached_block(struct gallivm_state *gallivm,
    LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
    LLVMTypeRef pi8t = LLVMPointerType(i8t, 0);
    LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
-   LLVMTypeRef i32x4 = LLVMVectorType(LLVMInt32TypeInContext(gallivm->context), 4);
    LLVMValueRef function;
-   LLVMValueRef tag_value, tmp_ptr;
-   LLVMValueRef col[4];
-   unsigned i, j;
-
-   /*
-    * Use format_desc->fetch_rgba_8unorm() for each pixel in the block.
-    * This doesn't actually make any sense whatsoever, someone would need
-    * to write a function doing this for all pixels in a block (either as
-    * an external c function or with generated code). Don't ask.
-    */
+   LLVMValueRef tag_value, dst_ptr, indices[3], args[6];
 
    {
       /*
        * Function to call looks like:
-       *   fetch(uint8_t *dst, const uint8_t *src, unsigned i, unsigned j)
+       *   unpack(uint8_t *dst, unsigned dst_stride,
+       *          const uint8_t *src, unsigned src_stride,
+       *          unsigned width, unsigned height)
        */
       LLVMTypeRef ret_type;
-      LLVMTypeRef arg_types[4];
+      LLVMTypeRef arg_types[6];
       LLVMTypeRef function_type;
 
-      assert(format_desc->fetch_rgba_8unorm);
+      assert(format_desc->unpack_rgba_8unorm);
 
       ret_type = LLVMVoidTypeInContext(gallivm->context);
       arg_types[0] = pi8t;
-      arg_types[1] = pi8t;
-      arg_types[2] = i32t;
+      arg_types[1] = i32t;
+      arg_types[2] = pi8t;
       arg_types[3] = i32t;
+      arg_types[4] = i32t;
+      arg_types[5] = i32t;
       function_type = LLVMFunctionType(ret_type, arg_types,
                                        ARRAY_SIZE(arg_types), 0);
 
-      /* make const pointer for the C fetch_rgba_8unorm function */
+      /* make const pointer for the C unpack_rgba_8unorm function */
       function = lp_build_const_int_pointer(gallivm,
-         func_to_pointer((func_pointer) format_desc->fetch_rgba_8unorm));
+         func_to_pointer((func_pointer) format_desc->unpack_rgba_8unorm));
 
       /* cast the callee pointer to the function's type */
       function = LLVMBuildBitCast(builder, function,
@@ -193,45 +203,29 @@ update_cached_block(struct gallivm_state *gallivm,
                                   "cast callee");
    }
 
-   tmp_ptr = lp_build_array_alloca(gallivm, i32x4,
-                                   lp_build_const_int32(gallivm, 16),
-                                   "tmp_decode_store");
-   tmp_ptr = LLVMBuildBitCast(builder, tmp_ptr, pi8t, "");
-
    /*
-    * Invoke format_desc->fetch_rgba_8unorm() for each pixel.
-    * This is going to be really really slow.
-    * Note: the block store format is actually
-    * x0y0x0y1x0y2x0y3 x1y0x1y1x1y2x1y3 ...
+    * Decode the whole block straight into its cache slot, a row of the
+    * decoded block being 4 texels (16 bytes) wide.
+    * Note we actually supply a pointer to the start of the block,
+    * not the start of the texture.
     */
-   for (i = 0; i < 4; ++i) {
-      for (j = 0; j < 4; ++j) {
-         LLVMValueRef args[4];
-         LLVMValueRef dst_offset = lp_build_const_int32(gallivm, (i * 4 + j) * 4);
-
-         /*
-          * Note we actually supply a pointer to the start of the block,
-          * not the start of the texture.
-          */
-         args[0] = LLVMBuildGEP(gallivm->builder, tmp_ptr, &dst_offset, 1, "");
-         args[1] = ptr_addr;
-         args[2] = LLVMConstInt(i32t, i, 0);
-         args[3] = LLVMConstInt(i32t, j, 0);
-         LLVMBuildCall(builder, function, args, ARRAY_SIZE(args), "");
-      }
-   }
+   indices[0] = lp_build_const_int32(gallivm, 0);
+   indices[1] = lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_MEMBER_DATA);
+   indices[2] = LLVMBuildMul(builder, hash_index,
+                             lp_build_const_int32(gallivm, 16), "");
+   dst_ptr = LLVMBuildGEP(builder, cache, indices, ARRAY_SIZE(indices), "");
 
-   /* Finally store the block - pointless mem copy + update tag. */
-   tmp_ptr = LLVMBuildBitCast(builder, tmp_ptr, LLVMPointerType(i32x4, 0), "");
-   for (i = 0; i < 4; ++i) {
-      LLVMValueRef tmp_offset = lp_build_const_int32(gallivm, i);
-      LLVMValueRef ptr = LLVMBuildGEP(gallivm->builder, tmp_ptr, &tmp_offset, 1, "");
-      col[i] = LLVMBuildLoad(builder, ptr, "");
-   }
+   args[0] = LLVMBuildBitCast(builder, dst_ptr, pi8t, "");
+   args[1] = lp_build_const_int32(gallivm, 4 * 4);
+   args[2] = ptr_addr;
+   args[3] = lp_build_const_int32(gallivm, format_desc->block.bits / 8);
+   args[4] = lp_build_const_int32(gallivm, format_desc->block.width);
+   args[5] = lp_build_const_int32(gallivm, format_desc->block.height);
+   LLVMBuildCall(builder, function, args, ARRAY_SIZE(args), "");
 
    tag_value = LLVMBuildPtrToInt(gallivm->builder, ptr_addr,
                                  LLVMInt64TypeInContext(gallivm->context), "");
-   store_cached_block(gallivm, col, tag_value, hash_index, cache);
+   store_cached_tag(gallivm, tag_value, hash_index, cache);
 }
 
 
@@ -264,8 +258,7 @@ lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
    type.width = 32;
    type.length = n;
 
-   assert(format_desc->block.width == 4);
-   assert(format_desc->block.height == 4);
+   assert(lp_build_format_cacheable(format_desc));
 
    lp_build_context_init(&bld32, gallivm, type);
 
@@ -302,8 +295,8 @@ lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
 
    hash_mask = lp_build_const_int_vec(gallivm, type, LP_BUILD_FORMAT_CACHE_SIZE - 1);
    hash_index = LLVMBuildAnd(builder, hash_index, hash_mask, "");
-   ij_index = LLVMBuildShl(builder, i, lp_build_const_int_vec(gallivm, type, 2), "");
-   ij_index = LLVMBuildAdd(builder, ij_index, j, "");
+   ij_index = LLVMBuildShl(builder, j, lp_build_const_int_vec(gallivm, type, 2), "");
+   ij_index = LLVMBuildAdd(builder, ij_index, i, "");
    block_index = LLVMBuildShl(builder, hash_index,
                               lp_build_const_int_vec(gallivm, type, 4), "");
    block_index = LLVMBuildAdd(builder, ij_index, block_index, "");
@@ -331,7 +324,7 @@ lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
                                           LLVMPointerType(i8t, 0), "");
             update_cached_block(gallivm, format_desc, ptr_addrx, hash_indexx, cache);
 #if LP_BUILD_FORMAT_CACHE_DEBUG
-            update_cache_access(gallivm, cache, 1,
+            update_cache_access(gallivm, format_desc, cache, 1,
                                 LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
 #endif
          }
@@ -357,7 +350,7 @@ lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
          tmp = LLVMBuildIntToPtr(builder, addr, LLVMPointerType(i8t, 0), "");
          update_cached_block(gallivm, format_desc, tmp, hash_index, cache);
 #if LP_BUILD_FORMAT_CACHE_DEBUG
-         update_cache_access(gallivm, cache, 1,
+         update_cache_access(gallivm, format_desc, cache, 1,
                              LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
 #endif
       }
@@ -366,7 +359,7 @@ lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
       color = lookup_cached_pixel(gallivm, cache, block_index);
    }
 #if LP_BUILD_FORMAT_CACHE_DEBUG
-   update_cache_access(gallivm, cache, n,
+   update_cache_access(gallivm, format_desc, cache, n,
                        LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL);
 #endif
    return LLVMBuildBitCast(builder, color, LLVMVectorType(i8t, n * 4), "");
@@ -3126,7 +3126,7 @@ lp_build_sample_gen_func(struct gallivm_state *gallivm,
    if (dynamic_state->cache_ptr) {
       const struct util_format_description *format_desc;
       format_desc = util_format_description(static_texture_state->format);
-      if (format_desc && format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC) {
+      if (format_desc && lp_build_format_cacheable(format_desc)) {
          need_cache = TRUE;
       }
    }
@@ -3241,7 +3241,7 @@ lp_build_sample_soa_func(struct gallivm_state *gallivm,
    if (dynamic_state->cache_ptr) {
       const struct util_format_description *format_desc;
       format_desc = util_format_description(static_texture_state->format);
-      if (format_desc && format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC) {
+      if (format_desc && lp_build_format_cacheable(format_desc)) {
          /*
           * This is not 100% correct, if we have cache but the
           * util_format_s3tc_prefer is true the cache won't get used
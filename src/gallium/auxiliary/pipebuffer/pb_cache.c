@@ -27,10 +27,18 @@
  **************************************************************************/
 
 #include "pb_cache.h"
+#include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_time.h"
 
 
+static inline unsigned
+pb_cache_size_class(pb_size size)
+{
+   return size ? util_last_bit64(size) - 1 : 0;
+}
+
+
 /**
  * Actually destroy the buffer.
  */
@@ -43,6 +51,7 @@ destroy_buffer_locked(struct pb_cache_entry *entry)
    assert(!pipe_is_referenced(&buf->reference));
    if (entry->head.next) {
       LIST_DEL(&entry->head);
+      LIST_DEL(&entry->bin);
       assert(mgr->num_buffers);
       --mgr->num_buffers;
       mgr->cache_size -= buf->size;
@@ -51,11 +60,12 @@ destroy_buffer_locked(struct pb_cache_entry *entry)
 }
 
 /**
- * Free as many cache buffers from the list head as possible.
+ * Free as many cache buffers from the LRU list head as possible.
  */
 static void
-release_expired_buffers_locked(struct list_head *cache)
+release_expired_buffers_locked(struct pb_cache *mgr)
 {
+   struct list_head *cache = &mgr->lru;
    struct list_head *curr, *next;
    struct pb_cache_entry *entry;
    int64_t now;
@@ -85,15 +95,14 @@ void
 pb_cache_add_buffer(struct pb_cache_entry *entry)
 {
    struct pb_cache *mgr = entry->mgr;
-   struct list_head *cache = &mgr->buckets[entry->bucket_index];
    struct pb_buffer *buf = entry->buffer;
-   unsigned i;
+   struct list_head *cache =
+      &mgr->buckets[entry->bucket_index][pb_cache_size_class(buf->size)];
 
    pipe_mutex_lock(mgr->mutex);
    assert(!pipe_is_referenced(&buf->reference));
 
-   for (i = 0; i < ARRAY_SIZE(mgr->buckets); i++)
-      release_expired_buffers_locked(&mgr->buckets[i]);
+   release_expired_buffers_locked(mgr);
 
    /* Directly release any buffer that exceeds the limit. */
    if (mgr->cache_size + buf->size > mgr->max_cache_size) {
@@ -104,7 +113,8 @@ pb_cache_add_buffer(struct pb_cache_entry *entry)
 
    entry->start = os_time_get();
    entry->end = entry->start + mgr->usecs;
-   LIST_ADDTAIL(&entry->head, cache);
+   LIST_ADDTAIL(&entry->head, &mgr->lru);
+   LIST_ADDTAIL(&entry->bin, cache);
    ++mgr->num_buffers;
    mgr->cache_size += buf->size;
    pipe_mutex_unlock(mgr->mutex);
@@ -142,62 +152,45 @@ pb_cache_is_buffer_compat(struct pb_cache_entry *entry,
 /**
  * Find a compatible buffer in the cache, return it, and remove it
  * from the cache.
+ *
+ * Only the size classes which can hold a buffer between size and
+ * size_factor * size are searched, smallest first. Within a size class
+ * buffers are ordered by release time, so the oldest (and least likely to
+ * be busy) ones are tried first.
  */
 struct pb_buffer *
 pb_cache_reclaim_buffer(struct pb_cache *mgr, pb_size size,
                         unsigned alignment, unsigned usage,
                         unsigned bucket_index)
 {
-   struct pb_cache_entry *entry;
-   struct pb_cache_entry *cur_entry;
-   struct list_head *cur, *next;
-   int64_t now;
-   int ret = 0;
-   struct list_head *cache = &mgr->buckets[bucket_index];
+   struct pb_cache_entry *entry = NULL;
+   unsigned first_class, last_class, i;
 
-   pipe_mutex_lock(mgr->mutex);
+   first_class = pb_cache_size_class(size);
+   last_class = pb_cache_size_class((pb_size)(mgr->size_factor * size));
+   last_class = MIN2(MAX2(last_class, first_class), PB_CACHE_SIZE_CLASSES - 1);
 
-   entry = NULL;
-   cur = cache->next;
-   next = cur->next;
-
-   /* search in the expired buffers, freeing them in the process */
-   now = os_time_get();
-   while (cur != cache) {
-      cur_entry = LIST_ENTRY(struct pb_cache_entry, cur, head);
-
-      if (!entry && (ret = pb_cache_is_buffer_compat(cur_entry, size,
-                                                     alignment, usage) > 0))
-         entry = cur_entry;
-      else if (os_time_timeout(cur_entry->start, cur_entry->end, now))
-         destroy_buffer_locked(cur_entry);
-      else
-         /* This buffer (and all hereafter) are still hot in cache */
-         break;
+   pipe_mutex_lock(mgr->mutex);
 
-      /* the buffer is busy (and probably all remaining ones too) */
-      if (ret == -1)
-         break;
+   release_expired_buffers_locked(mgr);
 
-      cur = next;
-      next = cur->next;
-   }
+   for (i = first_class; i <= last_class && !entry; i++) {
+      struct list_head *cache = &mgr->buckets[bucket_index][i];
+      struct list_head *cur;
 
-   /* keep searching in the hot buffers */
-   if (!entry && ret != -1) {
-      while (cur != cache) {
-         cur_entry = LIST_ENTRY(struct pb_cache_entry, cur, head);
-         ret = pb_cache_is_buffer_compat(cur_entry, size, alignment, usage);
+      for (cur = cache->next; cur != cache; cur = cur->next) {
+         struct pb_cache_entry *cur_entry =
+            LIST_ENTRY(struct pb_cache_entry, cur, bin);
+         int ret = pb_cache_is_buffer_compat(cur_entry, size, alignment,
+                                             usage);
 
          if (ret > 0) {
             entry = cur_entry;
             break;
          }
+         /* the buffer is busy (and probably all newer ones too) */
          if (ret == -1)
             break;
-         /* no need to check the timeout here */
-         cur = next;
-         next = cur->next;
       }
    }
 
@@ -207,6 +200,7 @@ pb_cache_reclaim_buffer(struct pb_cache *mgr, pb_size size,
 
       mgr->cache_size -= buf->size;
       LIST_DEL(&entry->head);
+      LIST_DEL(&entry->bin);
       --mgr->num_buffers;
       pipe_mutex_unlock(mgr->mutex);
       /* Increase refcount */
@@ -224,22 +218,18 @@ pb_cache_reclaim_buffer(struct pb_cache *mgr, pb_size size,
 void
 pb_cache_release_all_buffers(struct pb_cache *mgr)
 {
+   struct list_head *cache = &mgr->lru;
    struct list_head *curr, *next;
    struct pb_cache_entry *buf;
-   unsigned i;
 
    pipe_mutex_lock(mgr->mutex);
-   for (i = 0; i < ARRAY_SIZE(mgr->buckets); i++) {
-      struct list_head *cache = &mgr->buckets[i];
-
-      curr = cache->next;
+   curr = cache->next;
+   next = curr->next;
+   while (curr != cache) {
+      buf = LIST_ENTRY(struct pb_cache_entry, curr, head);
+      destroy_buffer_locked(buf);
+      curr = next;
       next = curr->next;
-      while (curr != cache) {
-         buf = LIST_ENTRY(struct pb_cache_entry, curr, head);
-         destroy_buffer_locked(buf);
-         curr = next;
-         next = curr->next;
-      }
    }
    pipe_mutex_unlock(mgr->mutex);
 }
@@ -275,10 +265,12 @@ pb_cache_init(struct pb_cache *mgr, uint usecs, float size_factor,
               void (*destroy_buffer)(struct pb_buffer *buf),
               bool (*can_reclaim)(struct pb_buffer *buf))
 {
-   unsigned i;
+   unsigned i, j;
 
    for (i = 0; i < ARRAY_SIZE(mgr->buckets); i++)
-      LIST_INITHEAD(&mgr->buckets[i]);
+      for (j = 0; j < ARRAY_SIZE(mgr->buckets[i]); j++)
+         LIST_INITHEAD(&mgr->buckets[i][j]);
+   LIST_INITHEAD(&mgr->lru);
 
    pipe_mutex_init(mgr->mutex);
    mgr->cache_size = 0;
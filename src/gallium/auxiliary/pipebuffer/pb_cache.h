@@ -33,12 +33,16 @@
 #include "util/list.h"
 #include "os/os_thread.h"
 
+/** Number of power-of-two size classes in each bucket */
+#define PB_CACHE_SIZE_CLASSES 64
+
 /**
  * Statically inserted into the driver-specific buffer structure.
  */
 struct pb_cache_entry
 {
-   struct list_head head;
+   struct list_head head; /**< In pb_cache::lru, ordered by release time */
+   struct list_head bin;  /**< In the size class list of its bucket */
    struct pb_buffer *buffer; /**< Pointer to the structure this is part of. */
    struct pb_cache *mgr;
    int64_t start, end; /**< Caching time interval */
@@ -49,8 +53,13 @@ struct pb_cache
 {
    /* The cache is divided into buckets for minimizing cache misses.
     * The driver controls which buffer goes into which bucket.
+    * Each bucket is further split into lists of buffers whose size has the
+    * same log2, so that a lookup only visits buffers of a usable size.
     */
-   struct list_head buckets[8];
+   struct list_head buckets[8][PB_CACHE_SIZE_CLASSES];
+
+   /* All cached buffers, oldest first, for expiring them in order. */
+   struct list_head lru;
 
    pipe_mutex mutex;
    uint64_t cache_size;
@@ -8,7 +8,11 @@
 
 
 /* Helper function to wrap a screen with
- * one or more debug driver: rbug, trace.
+ * one or more debug driver: noop, ddebug, rbug, trace.
+ *
+ * noop goes first so that the other wrappers see the calls which would
+ * reach the real driver, e.g. GALLIUM_NOOP=1 GALLIUM_TRACE=foo.gtrace
+ * records what the state tracker does without any rendering.
  */
 
 #ifdef GALLIUM_DDEBUG
@@ -34,6 +38,10 @@
 static inline struct pipe_screen *
 debug_screen_wrap(struct pipe_screen *screen)
 {
+#if defined(GALLIUM_NOOP)
+   screen = noop_screen_create(screen);
+#endif
+
 #if defined(GALLIUM_DDEBUG)
    screen = ddebug_screen_create(screen);
 #endif
@@ -46,10 +54,6 @@ debug_screen_wrap(struct pipe_screen *screen)
    screen = trace_screen_create(screen);
 #endif
 
-#if defined(GALLIUM_NOOP)
-   screen = noop_screen_create(screen);
-#endif
-
    if (debug_get_bool_option("GALLIUM_TESTS", FALSE))
       util_run_tests(screen);
 
@@ -62,6 +62,7 @@
 #include "util/u_memory.h"
 #include "util/u_math.h"
 #include "util/rounding.h"
+#include "util/u_sse.h"
 
 
 #define DEBUG_EXECUTION 0
@@ -69,6 +70,9 @@
 
 #define FAST_MATH 0
 
+/** Execution mask with all four quad lanes enabled */
+#define QUAD_MASK_ALL ((1 << TGSI_QUAD_SIZE) - 1)
+
 #define TILE_TOP_LEFT     0
 #define TILE_TOP_RIGHT    1
 #define TILE_BOTTOM_LEFT  2
@@ -84,14 +88,43 @@ struct tgsi_double_vector {
    union tgsi_double_channel zw;
 };
 
+#if defined(PIPE_ARCH_SSE)
+
+/*
+ * A tgsi_exec_channel holds exactly one quad, so the common float ALU
+ * micro ops below map one-to-one onto 4-wide SSE operations.  The channel
+ * unions are not guaranteed to be 16-byte aligned, hence the unaligned
+ * loads and stores.  Operand order is chosen so that NaN and signed zero
+ * handling matches the scalar C expressions exactly.
+ */
+
+static inline __m128
+chan_load(const union tgsi_exec_channel *chan)
+{
+   return _mm_loadu_ps(chan->f);
+}
+
+static inline void
+chan_store(union tgsi_exec_channel *chan, __m128 v)
+{
+   _mm_storeu_ps(chan->f, v);
+}
+
+#endif
+
 static void
 micro_abs(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
+#if defined(PIPE_ARCH_SSE)
+   const __m128 sign = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+   chan_store(dst, _mm_andnot_ps(sign, chan_load(src)));
+#else
    dst->f[0] = fabsf(src->f[0]);
    dst->f[1] = fabsf(src->f[1]);
    dst->f[2] = fabsf(src->f[2]);
    dst->f[3] = fabsf(src->f[3]);
+#endif
 }
 
 static void
@@ -496,10 +529,17 @@ micro_lrp(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src1,
           const union tgsi_exec_channel *src2)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_add_ps(_mm_mul_ps(chan_load(src0),
+                                         _mm_sub_ps(chan_load(src1),
+                                                    chan_load(src2))),
+                              chan_load(src2)));
+#else
    dst->f[0] = src0->f[0] * (src1->f[0] - src2->f[0]) + src2->f[0];
    dst->f[1] = src0->f[1] * (src1->f[1] - src2->f[1]) + src2->f[1];
    dst->f[2] = src0->f[2] * (src1->f[2] - src2->f[2]) + src2->f[2];
    dst->f[3] = src0->f[3] * (src1->f[3] - src2->f[3]) + src2->f[3];
+#endif
 }
 
 static void
@@ -508,20 +548,30 @@ micro_mad(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src1,
           const union tgsi_exec_channel *src2)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_add_ps(_mm_mul_ps(chan_load(src0), chan_load(src1)),
+                              chan_load(src2)));
+#else
    dst->f[0] = src0->f[0] * src1->f[0] + src2->f[0];
    dst->f[1] = src0->f[1] * src1->f[1] + src2->f[1];
    dst->f[2] = src0->f[2] * src1->f[2] + src2->f[2];
    dst->f[3] = src0->f[3] * src1->f[3] + src2->f[3];
+#endif
 }
 
 static void
 micro_mov(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
+#if defined(PIPE_ARCH_SSE)
+   _mm_storeu_si128((__m128i *)dst->u,
+                    _mm_loadu_si128((const __m128i *)src->u));
+#else
    dst->u[0] = src->u[0];
    dst->u[1] = src->u[1];
    dst->u[2] = src->u[2];
    dst->u[3] = src->u[3];
+#endif
 }
 
 static void
@@ -1111,10 +1161,14 @@ micro_add(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_add_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] + src1->f[0];
    dst->f[1] = src0->f[1] + src1->f[1];
    dst->f[2] = src0->f[2] + src1->f[2];
    dst->f[3] = src0->f[3] + src1->f[3];
+#endif
 }
 
 static void
@@ -1156,10 +1210,14 @@ micro_max(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_max_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] > src1->f[0] ? src0->f[0] : src1->f[0];
    dst->f[1] = src0->f[1] > src1->f[1] ? src0->f[1] : src1->f[1];
    dst->f[2] = src0->f[2] > src1->f[2] ? src0->f[2] : src1->f[2];
    dst->f[3] = src0->f[3] > src1->f[3] ? src0->f[3] : src1->f[3];
+#endif
 }
 
 static void
@@ -1167,10 +1225,14 @@ micro_min(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_min_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] < src1->f[0] ? src0->f[0] : src1->f[0];
    dst->f[1] = src0->f[1] < src1->f[1] ? src0->f[1] : src1->f[1];
    dst->f[2] = src0->f[2] < src1->f[2] ? src0->f[2] : src1->f[2];
    dst->f[3] = src0->f[3] < src1->f[3] ? src0->f[3] : src1->f[3];
+#endif
 }
 
 static void
@@ -1178,10 +1240,14 @@ micro_mul(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_mul_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] * src1->f[0];
    dst->f[1] = src0->f[1] * src1->f[1];
    dst->f[2] = src0->f[2] * src1->f[2];
    dst->f[3] = src0->f[3] * src1->f[3];
+#endif
 }
 
 static void
@@ -1189,10 +1255,15 @@ micro_neg(
    union tgsi_exec_channel *dst,
    const union tgsi_exec_channel *src )
 {
+#if defined(PIPE_ARCH_SSE)
+   const __m128 sign = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+   chan_store(dst, _mm_xor_ps(sign, chan_load(src)));
+#else
    dst->f[0] = -src->f[0];
    dst->f[1] = -src->f[1];
    dst->f[2] = -src->f[2];
    dst->f[3] = -src->f[3];
+#endif
 }
 
 static void
@@ -1219,10 +1290,14 @@ micro_sub(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   chan_store(dst, _mm_sub_ps(chan_load(src0), chan_load(src1)));
+#else
    dst->f[0] = src0->f[0] - src1->f[0];
    dst->f[1] = src0->f[1] - src1->f[1];
    dst->f[2] = src0->f[2] - src1->f[2];
    dst->f[3] = src0->f[3] - src1->f[3];
+#endif
 }
 
 static void
@@ -1357,6 +1432,64 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
    union tgsi_exec_channel index2D;
    uint swizzle;
 
+   /* Fast path for the most common case of a direct register access,
+    * where all lanes read the same register and no per-lane indices
+    * need to be built.
+    */
+   if (!reg->Register.Indirect &&
+       (!reg->Register.Dimension || !reg->Dimension.Indirect)) {
+      const int pos = reg->Register.Index;
+      uint i;
+
+      swizzle = tgsi_util_get_full_src_register_swizzle(reg, chan_index);
+
+      switch (reg->Register.File) {
+      case TGSI_FILE_TEMPORARY:
+         if (reg->Register.Dimension)
+            break;
+         assert(pos < TGSI_EXEC_NUM_TEMPS);
+         *chan = mach->Temps[pos].xyzw[swizzle];
+         return;
+
+      case TGSI_FILE_INPUT:
+         if (reg->Register.Dimension)
+            break;
+         assert(pos >= 0 && pos < PIPE_MAX_ATTRIBS);
+         *chan = mach->Inputs[pos].xyzw[swizzle];
+         return;
+
+      case TGSI_FILE_IMMEDIATE:
+         if (reg->Register.Dimension)
+            break;
+         assert(pos >= 0 && pos < (int)mach->ImmLimit);
+         for (i = 0; i < TGSI_QUAD_SIZE; i++)
+            chan->f[i] = mach->Imms[pos][swizzle];
+         return;
+
+      case TGSI_FILE_CONSTANT:
+         {
+            const uint constbuf = reg->Register.Dimension ?
+                                  reg->Dimension.Index : 0;
+            const int cpos = pos * 4 + swizzle;
+            uint value = 0;
+
+            assert(constbuf < PIPE_MAX_CONSTANT_BUFFERS);
+            assert(mach->Consts[constbuf]);
+
+            /* const buffer bounds check, as in fetch_src_file_channel */
+            if (cpos >= 0 && cpos < (int) mach->ConstsSize[constbuf])
+               value = ((const uint *)mach->Consts[constbuf])[cpos];
+
+            for (i = 0; i < TGSI_QUAD_SIZE; i++)
+               chan->u[i] = value;
+         }
+         return;
+
+      default:
+         break;
+      }
+   }
+
    /* We start with a direct index into a register file.
     *
     *    file[1],
@@ -1781,6 +1914,21 @@ store_dest(struct tgsi_exec_machine *mach,
    if (!dst)
       return;
 
+   /* Fast path: all lanes active, the usual case outside of control flow. */
+   if ((execmask & QUAD_MASK_ALL) == QUAD_MASK_ALL) {
+      if (!inst->Instruction.Saturate) {
+         *dst = *chan;
+         return;
+      }
+#if defined(PIPE_ARCH_SSE)
+      /* max(0, x) then min(1, x) keeps NaN and -0.0 like the scalar path */
+      chan_store(dst, _mm_min_ps(_mm_set1_ps(1.0f),
+                                 _mm_max_ps(_mm_setzero_ps(),
+                                            chan_load(chan))));
+      return;
+#endif
+   }
+
    if (!inst->Instruction.Saturate) {
       for (i = 0; i < TGSI_QUAD_SIZE; i++)
          if (execmask & (1 << i))
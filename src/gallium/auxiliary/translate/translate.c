@@ -42,6 +42,11 @@ struct translate *translate_create( const struct translate_key *key )
    translate = translate_sse2_create( key );
    if (translate)
       return translate;
+
+   /* only for the conversions the SSE backend can't do */
+   translate = translate_avx2_create( key );
+   if (translate)
+      return translate;
 #else
    (void)translate;
 #endif
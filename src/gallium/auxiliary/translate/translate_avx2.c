@@ -0,0 +1,527 @@
+/**************************************************************************
+ *
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * AVX2 vertex fetch.
+ *
+ * Fetches eight vertices per iteration: the indices are loaded into one
+ * vector, each 32-bit word of an attribute is fetched for all eight
+ * vertices with a single gather, and the channels are unpacked and
+ * converted to float in parallel.  The results are transposed back to
+ * vertex order and stored.
+ *
+ * Only fetches to R32..R32G32B32A32_FLOAT outputs, the layout used by the
+ * draw module, from plain formats made of whole 32-bit words (32-bit and
+ * 16-bit float, 8/10/16-bit normalized and scaled integers) are handled.
+ * Everything else, including keys which only copy data, is left to the
+ * other backends.
+ */
+
+#include "pipe/p_config.h"
+#include "pipe/p_compiler.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_format.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "translate.h"
+
+
+#if defined(PIPE_ARCH_X86_64) && defined(PIPE_ARCH_LITTLE_ENDIAN) && \
+    (defined(__clang__) || \
+     (defined(__GNUC__) && (__GNUC__ > 4 || \
+                            (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+
+#include <immintrin.h>
+
+#define AVX2_FUNC __attribute__((target("avx2")))
+
+#define AVX2_VERTS 8
+
+/** How a channel is unpacked from its 32-bit word */
+enum avx2_chan_type {
+   AVX2_CHAN_FLOAT32,
+   AVX2_CHAN_FLOAT16,
+   AVX2_CHAN_UNSIGNED,
+   AVX2_CHAN_SIGNED
+};
+
+struct avx2_chan {
+   enum avx2_chan_type type;
+   unsigned word;   /**< 32-bit word of the element holding the channel */
+   unsigned shift;  /**< bit offset within that word */
+   unsigned size;   /**< bits */
+   float scale;     /**< 1/max for normalized channels, 1 otherwise */
+};
+
+struct avx2_element {
+   unsigned buffer;
+   unsigned input_offset;
+   unsigned output_offset;
+   unsigned nr_words;           /**< 32-bit words per input element */
+   unsigned nr_outputs;         /**< float components written */
+   unsigned nr_channels;
+   struct avx2_chan chan[4];
+   unsigned char swizzle[4];    /**< PIPE_SWIZZLE_x per output component */
+
+   const uint8_t *input_ptr;
+   unsigned input_stride;
+   unsigned max_index;
+};
+
+struct translate_avx2 {
+   struct translate translate;
+
+   struct avx2_element element[TRANSLATE_MAX_ATTRIBS];
+   unsigned nr_elements;
+
+   /**
+    * Gathers take 32-bit signed offsets.  When the bound buffers may be
+    * larger than that, vertices are fetched with the generic path instead.
+    */
+   boolean offsets_fit;
+   struct translate *fallback;
+};
+
+
+static inline struct translate_avx2 *
+translate_avx2(struct translate *translate)
+{
+   return (struct translate_avx2 *)translate;
+}
+
+
+/**
+ * Convert eight half floats in the low 16 bits of each lane to floats.
+ * Uses the exponent rebias trick so it doesn't depend on F16C.
+ */
+static inline AVX2_FUNC __m256
+avx2_half_to_float(__m256i h)
+{
+   const __m256i mask_nosign = _mm256_set1_epi32(0x7fff);
+   const __m256 magic = _mm256_castsi256_ps(_mm256_set1_epi32((254 - 15) << 23));
+   const __m256i was_infnan = _mm256_set1_epi32(0x7bff);
+   const __m256 exp_infnan = _mm256_castsi256_ps(_mm256_set1_epi32(255 << 23));
+   __m256i expmant = _mm256_and_si256(h, mask_nosign);
+   __m256i justsign = _mm256_xor_si256(h, expmant);
+   __m256 scaled = _mm256_mul_ps(_mm256_castsi256_ps(_mm256_slli_epi32(expmant, 13)),
+                                 magic);
+   __m256 infnan = _mm256_and_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(expmant, was_infnan)),
+                                 exp_infnan);
+   __m256 sign = _mm256_castsi256_ps(_mm256_slli_epi32(justsign, 16));
+
+   return _mm256_or_ps(scaled, _mm256_or_ps(sign, infnan));
+}
+
+
+static inline AVX2_FUNC __m256
+avx2_unpack_chan(const struct avx2_chan *chan, __m256i word)
+{
+   __m256 f;
+
+   switch (chan->type) {
+   case AVX2_CHAN_FLOAT32:
+      return _mm256_castsi256_ps(word);
+   case AVX2_CHAN_FLOAT16:
+      word = _mm256_srli_epi32(word, chan->shift);
+      return avx2_half_to_float(_mm256_and_si256(word, _mm256_set1_epi32(0xffff)));
+   case AVX2_CHAN_UNSIGNED:
+      word = _mm256_srli_epi32(word, chan->shift);
+      word = _mm256_and_si256(word, _mm256_set1_epi32((1 << chan->size) - 1));
+      f = _mm256_cvtepi32_ps(word);
+      break;
+   case AVX2_CHAN_SIGNED:
+   default:
+      word = _mm256_slli_epi32(word, 32 - chan->shift - chan->size);
+      word = _mm256_srai_epi32(word, 32 - chan->size);
+      f = _mm256_cvtepi32_ps(word);
+      break;
+   }
+
+   if (chan->scale != 1.0f)
+      f = _mm256_mul_ps(f, _mm256_set1_ps(chan->scale));
+   return f;
+}
+
+
+/**
+ * Fetch one element for the eight vertices in idx and store the first
+ * count of them to out, which points at the element in the first vertex.
+ */
+static inline AVX2_FUNC void
+avx2_fetch_element(const struct avx2_element *elem,
+                   __m256i idx, unsigned count,
+                   uint8_t *out, unsigned out_stride)
+{
+   static const int store_masks[5][4] = {
+      {  0,  0,  0,  0 },
+      { -1,  0,  0,  0 },
+      { -1, -1,  0,  0 },
+      { -1, -1, -1,  0 },
+      { -1, -1, -1, -1 },
+   };
+   __m256i offsets, words[4];
+   __m256 chan[6], t0, t1, t2, t3;
+   __m128 v[AVX2_VERTS];
+   __m128i mask;
+   unsigned i;
+
+   idx = _mm256_min_epu32(idx, _mm256_set1_epi32(elem->max_index));
+   offsets = _mm256_mullo_epi32(idx, _mm256_set1_epi32(elem->input_stride));
+
+   for (i = 0; i < elem->nr_words; i++) {
+      words[i] = _mm256_i32gather_epi32((const int *)(elem->input_ptr + 4 * i),
+                                        offsets, 1);
+   }
+
+   for (i = 0; i < elem->nr_channels; i++)
+      chan[i] = avx2_unpack_chan(&elem->chan[i], words[elem->chan[i].word]);
+   chan[PIPE_SWIZZLE_0] = _mm256_setzero_ps();
+   chan[PIPE_SWIZZLE_1] = _mm256_set1_ps(1.0f);
+
+   /* Transpose xxxxxxxx yyyyyyyy zzzzzzzz wwwwwwww to xyzw per vertex. */
+   t0 = _mm256_unpacklo_ps(chan[elem->swizzle[0]], chan[elem->swizzle[1]]);
+   t1 = _mm256_unpackhi_ps(chan[elem->swizzle[0]], chan[elem->swizzle[1]]);
+   t2 = _mm256_unpacklo_ps(chan[elem->swizzle[2]], chan[elem->swizzle[3]]);
+   t3 = _mm256_unpackhi_ps(chan[elem->swizzle[2]], chan[elem->swizzle[3]]);
+   chan[0] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+   chan[1] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+   chan[2] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+   chan[3] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+   for (i = 0; i < 4; i++) {
+      v[i] = _mm256_castps256_ps128(chan[i]);
+      v[i + 4] = _mm256_extractf128_ps(chan[i], 1);
+   }
+
+   if (elem->nr_outputs == 4) {
+      for (i = 0; i < count; i++)
+         _mm_storeu_ps((float *)(out + i * out_stride), v[i]);
+   }
+   else {
+      mask = _mm_loadu_si128((const __m128i *)store_masks[elem->nr_outputs]);
+      for (i = 0; i < count; i++)
+         _mm_maskstore_ps((float *)(out + i * out_stride), mask, v[i]);
+   }
+}
+
+
+static inline AVX2_FUNC void
+avx2_fetch_vertices(struct translate_avx2 *tr, __m256i idx, unsigned count,
+                    uint8_t *out)
+{
+   const unsigned out_stride = tr->translate.key.output_stride;
+   unsigned i;
+
+   for (i = 0; i < tr->nr_elements; i++) {
+      const struct avx2_element *elem = &tr->element[i];
+
+      avx2_fetch_element(elem, idx, count, out + elem->output_offset,
+                         out_stride);
+   }
+}
+
+
+/**
+ * Whether every vertex up to index last can be addressed with the 32-bit
+ * signed offsets taken by the gathers.
+ */
+static boolean
+avx2_offsets_fit(const struct translate_avx2 *tr, unsigned last)
+{
+   unsigned i;
+
+   for (i = 0; i < tr->nr_elements; i++) {
+      const struct avx2_element *elem = &tr->element[i];
+
+      if ((uint64_t)MIN2(last, elem->max_index) * elem->input_stride >
+          INT32_MAX)
+         return FALSE;
+   }
+   return TRUE;
+}
+
+
+/**
+ * The last, partial group of indices is padded by repeating the last valid
+ * index, so that the gathers of the unused lanes stay in bounds.
+ */
+#define AVX2_RUN_ELTS(name, type)                                            \
+static AVX2_FUNC void PIPE_CDECL                                             \
+name(struct translate *translate, const type *elts, unsigned count,          \
+     unsigned start_instance, unsigned instance_id, void *output_buffer)    \
+{                                                                            \
+   struct translate_avx2 *tr = translate_avx2(translate);                    \
+   const unsigned stride = translate->key.output_stride;                     \
+   uint8_t *out = output_buffer;                                             \
+   unsigned i, j;                                                            \
+                                                                             \
+   if (!tr->offsets_fit) {                                                   \
+      tr->fallback->name(tr->fallback, elts, count, start_instance,          \
+                         instance_id, output_buffer);                        \
+      return;                                                                \
+   }                                                                         \
+                                                                             \
+   for (i = 0; i + AVX2_VERTS <= count; i += AVX2_VERTS) {                   \
+      avx2_fetch_vertices(tr, LOAD_ELTS(elts + i), AVX2_VERTS, out);         \
+      out += AVX2_VERTS * stride;                                            \
+   }                                                                         \
+                                                                             \
+   if (i < count) {                                                          \
+      unsigned tail[AVX2_VERTS];                                             \
+                                                                             \
+      for (j = 0; j < AVX2_VERTS; j++)                                       \
+         tail[j] = elts[MIN2(i + j, count - 1)];                             \
+      avx2_fetch_vertices(tr, _mm256_loadu_si256((const __m256i *)tail),     \
+                          count - i, out);                                   \
+   }                                                                         \
+}
+
+#define LOAD_ELTS(p) _mm256_loadu_si256((const __m256i *)(p))
+AVX2_RUN_ELTS(run_elts, unsigned)
+#undef LOAD_ELTS
+
+#define LOAD_ELTS(p) _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(p)))
+AVX2_RUN_ELTS(run_elts16, uint16_t)
+#undef LOAD_ELTS
+
+#define LOAD_ELTS(p) _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(p)))
+AVX2_RUN_ELTS(run_elts8, uint8_t)
+#undef LOAD_ELTS
+
+
+static AVX2_FUNC void PIPE_CDECL
+run_linear(struct translate *translate, unsigned start, unsigned count,
+           unsigned start_instance, unsigned instance_id, void *output_buffer)
+{
+   struct translate_avx2 *tr = translate_avx2(translate);
+   const unsigned stride = translate->key.output_stride;
+   const __m256i iota = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+   uint8_t *out = output_buffer;
+   unsigned i;
+
+   if (!tr->offsets_fit && !avx2_offsets_fit(tr, start + count - 1)) {
+      tr->fallback->run(tr->fallback, start, count, start_instance,
+                        instance_id, output_buffer);
+      return;
+   }
+
+   for (i = 0; i < count; i += AVX2_VERTS) {
+      __m256i idx = _mm256_add_epi32(_mm256_set1_epi32(start + i), iota);
+
+      /* Keep the padding lanes of the last group on a valid index. */
+      if (count - i < AVX2_VERTS)
+         idx = _mm256_min_epu32(idx, _mm256_set1_epi32(start + count - 1));
+
+      avx2_fetch_vertices(tr, idx, MIN2(count - i, AVX2_VERTS), out);
+      out += AVX2_VERTS * stride;
+   }
+}
+
+
+static void
+avx2_set_buffer(struct translate *translate, unsigned buf, const void *ptr,
+                unsigned stride, unsigned max_index)
+{
+   struct translate_avx2 *tr = translate_avx2(translate);
+   unsigned i;
+
+   tr->fallback->set_buffer(tr->fallback, buf, ptr, stride, max_index);
+
+   for (i = 0; i < tr->nr_elements; i++) {
+      struct avx2_element *elem = &tr->element[i];
+
+      if (elem->buffer == buf) {
+         elem->input_ptr = (const uint8_t *)ptr + elem->input_offset;
+         elem->input_stride = stride;
+         elem->max_index = max_index;
+      }
+   }
+
+   tr->offsets_fit = avx2_offsets_fit(tr, ~0u);
+}
+
+
+static void
+avx2_release(struct translate *translate)
+{
+   struct translate_avx2 *tr = translate_avx2(translate);
+
+   tr->fallback->release(tr->fallback);
+   FREE(tr);
+}
+
+
+static boolean
+avx2_init_element(struct avx2_element *elem,
+                  const struct translate_element *key)
+{
+   const struct util_format_description *in =
+      util_format_description(key->input_format);
+   unsigned i;
+
+   if (key->type != TRANSLATE_ELEMENT_NORMAL || key->instance_divisor)
+      return FALSE;
+
+   switch (key->output_format) {
+   case PIPE_FORMAT_R32_FLOAT:
+      elem->nr_outputs = 1;
+      break;
+   case PIPE_FORMAT_R32G32_FLOAT:
+      elem->nr_outputs = 2;
+      break;
+   case PIPE_FORMAT_R32G32B32_FLOAT:
+      elem->nr_outputs = 3;
+      break;
+   case PIPE_FORMAT_R32G32B32A32_FLOAT:
+      elem->nr_outputs = 4;
+      break;
+   default:
+      return FALSE;
+   }
+
+   if (!in ||
+       in->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       in->colorspace != UTIL_FORMAT_COLORSPACE_RGB ||
+       in->block.bits % 32 != 0 || in->block.bits > 128)
+      return FALSE;
+
+   elem->buffer = key->input_buffer;
+   elem->input_offset = key->input_offset;
+   elem->output_offset = key->output_offset;
+   elem->nr_words = in->block.bits / 32;
+   elem->nr_channels = in->nr_channels;
+
+   for (i = 0; i < in->nr_channels; i++) {
+      const struct util_format_channel_description *c = &in->channel[i];
+      struct avx2_chan *chan = &elem->chan[i];
+
+      if (c->pure_integer)
+         return FALSE;
+
+      chan->word = c->shift / 32;
+      chan->shift = c->shift % 32;
+      chan->size = c->size;
+      chan->scale = 1.0f;
+
+      if (chan->shift + chan->size > 32)
+         return FALSE;
+
+      switch (c->type) {
+      case UTIL_FORMAT_TYPE_FLOAT:
+         if (c->size == 32)
+            chan->type = AVX2_CHAN_FLOAT32;
+         else if (c->size == 16)
+            chan->type = AVX2_CHAN_FLOAT16;
+         else
+            return FALSE;
+         break;
+      case UTIL_FORMAT_TYPE_UNSIGNED:
+         if (c->size > 16)
+            return FALSE;
+         chan->type = AVX2_CHAN_UNSIGNED;
+         if (c->normalized)
+            chan->scale = 1.0f / ((1 << c->size) - 1);
+         break;
+      case UTIL_FORMAT_TYPE_SIGNED:
+         if (c->size > 16)
+            return FALSE;
+         chan->type = AVX2_CHAN_SIGNED;
+         if (c->normalized)
+            chan->scale = 1.0f / ((1 << (c->size - 1)) - 1);
+         break;
+      default:
+         return FALSE;
+      }
+   }
+
+   for (i = 0; i < 4; i++) {
+      unsigned swz = in->swizzle[i];
+
+      if (swz == PIPE_SWIZZLE_NONE)
+         swz = i == 3 ? PIPE_SWIZZLE_1 : PIPE_SWIZZLE_0;
+      elem->swizzle[i] = swz;
+   }
+
+   return TRUE;
+}
+
+
+struct translate *
+translate_avx2_create(const struct translate_key *key)
+{
+   struct translate_avx2 *tr;
+   boolean needs_conversion = FALSE;
+   unsigned i;
+
+   if (!util_cpu_caps.has_avx2)
+      return NULL;
+
+   /* Plain copies are faster with the SSE and memcpy based backends. */
+   for (i = 0; i < key->nr_elements; i++) {
+      if (key->element[i].input_format != key->element[i].output_format)
+         needs_conversion = TRUE;
+   }
+   if (!needs_conversion)
+      return NULL;
+
+   tr = CALLOC_STRUCT(translate_avx2);
+   if (!tr)
+      return NULL;
+
+   for (i = 0; i < key->nr_elements; i++) {
+      if (!avx2_init_element(&tr->element[i], &key->element[i]))
+         goto fail;
+   }
+   tr->nr_elements = key->nr_elements;
+
+   tr->fallback = translate_generic_create(key);
+   if (!tr->fallback)
+      goto fail;
+
+   tr->translate.key = *key;
+   tr->translate.release = avx2_release;
+   tr->translate.set_buffer = avx2_set_buffer;
+   tr->translate.run_elts = run_elts;
+   tr->translate.run_elts16 = run_elts16;
+   tr->translate.run_elts8 = run_elts8;
+   tr->translate.run = run_linear;
+
+   return &tr->translate;
+
+fail:
+   FREE(tr);
+   return NULL;
+}
+
+#else
+
+struct translate *
+translate_avx2_create(const struct translate_key *key)
+{
+   return NULL;
+}
+
+#endif
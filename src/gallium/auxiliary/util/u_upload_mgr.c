@@ -32,12 +32,29 @@
 #include "pipe/p_defines.h"
 #include "util/u_inlines.h"
 #include "pipe/p_context.h"
+#include "pipe/p_screen.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
 
 #include "u_upload_mgr.h"
 
 
+/* Number of full upload buffers kept around for reuse. */
+#define U_UPLOAD_MAX_RETIRED 4
+
+/**
+ * A full, persistently mapped upload buffer waiting for the GPU to finish
+ * with it.
+ */
+struct u_upload_retired {
+   struct pipe_resource *buffer;
+   struct pipe_transfer *transfer;
+   uint8_t *map;
+   int refs;
+   struct pipe_fence_handle *fence; /* NULL until the next u_upload_fence */
+};
+
+
 struct u_upload_mgr {
    struct pipe_context *pipe;
 
@@ -50,8 +67,17 @@ struct u_upload_mgr {
    struct pipe_resource *buffer;   /* Upload buffer. */
    struct pipe_transfer *transfer; /* Transfer object for the upload buffer. */
    uint8_t *map;    /* Pointer to the mapped upload buffer. */
+   int buffer_refs; /* References to the upload buffer held by us, including
+                     * the one the transfer may hold. */
    unsigned offset; /* Aligned offset to the upload buffer, pointing
                      * at the first unused byte. */
+
+   /* Full buffers, oldest first. Only used with persistent mappings, once
+    * the owner provides fences through u_upload_fence.
+    */
+   boolean use_fences;
+   struct u_upload_retired retired[U_UPLOAD_MAX_RETIRED];
+   unsigned num_retired;
 };
 
 
@@ -121,13 +147,110 @@ static void u_upload_release_buffer(struct u_upload_mgr *upload)
 }
 
 
+static void
+u_upload_release_retired(struct u_upload_mgr *upload, unsigned i)
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+   struct u_upload_retired *r = &upload->retired[i];
+
+   pipe_transfer_unmap(upload->pipe, r->transfer);
+   pipe_resource_reference(&r->buffer, NULL);
+   screen->fence_reference(screen, &r->fence, NULL);
+
+   --upload->num_retired;
+   memmove(r, r + 1, (upload->num_retired - i) * sizeof(*r));
+}
+
+
+/**
+ * Move the current, full buffer to the retired list, keeping it mapped.
+ */
+static void
+u_upload_retire_buffer(struct u_upload_mgr *upload)
+{
+   struct u_upload_retired *r;
+
+   if (upload->num_retired == U_UPLOAD_MAX_RETIRED)
+      u_upload_release_retired(upload, 0);
+
+   r = &upload->retired[upload->num_retired++];
+   r->buffer = upload->buffer;
+   r->transfer = upload->transfer;
+   r->map = upload->map;
+   r->refs = upload->buffer_refs;
+   r->fence = NULL;
+
+   upload->buffer = NULL;
+   upload->transfer = NULL;
+   upload->map = NULL;
+}
+
+
+/**
+ * Take back a retired buffer of at least min_size bytes, if the GPU is done
+ * with it and nobody else references it anymore, e.g. through a binding
+ * which is still in use.
+ */
+static boolean
+u_upload_reuse_retired(struct u_upload_mgr *upload, unsigned min_size)
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+   unsigned i;
+
+   for (i = 0; i < upload->num_retired; i++) {
+      struct u_upload_retired *r = &upload->retired[i];
+
+      if (!r->fence)
+         break; /* and neither have the newer ones */
+
+      if (r->buffer->width0 < min_size ||
+          p_atomic_read(&r->buffer->reference.count) != r->refs ||
+          !screen->fence_finish(screen, NULL, r->fence, 0))
+         continue;
+
+      upload->buffer = r->buffer;
+      upload->transfer = r->transfer;
+      upload->map = r->map;
+      upload->buffer_refs = r->refs;
+      upload->offset = 0;
+      screen->fence_reference(screen, &r->fence, NULL);
+
+      --upload->num_retired;
+      memmove(r, r + 1, (upload->num_retired - i) * sizeof(*r));
+      return TRUE;
+   }
+
+   return FALSE;
+}
+
+
 void u_upload_destroy( struct u_upload_mgr *upload )
 {
    u_upload_release_buffer( upload );
+   while (upload->num_retired)
+      u_upload_release_retired(upload, upload->num_retired - 1);
    FREE( upload );
 }
 
 
+void
+u_upload_fence(struct u_upload_mgr *upload, struct pipe_fence_handle *fence)
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+   unsigned i;
+
+   if (!upload->map_persistent || !fence)
+      return;
+
+   upload->use_fences = TRUE;
+
+   for (i = 0; i < upload->num_retired; i++) {
+      if (!upload->retired[i].fence)
+         screen->fence_reference(screen, &upload->retired[i].fence, fence);
+   }
+}
+
+
 static void
 u_upload_alloc_buffer(struct u_upload_mgr *upload,
                       unsigned min_size)
@@ -136,13 +259,25 @@ u_upload_alloc_buffer(struct u_upload_mgr *upload,
    struct pipe_resource buffer;
    unsigned size;
 
+   size = align(MAX2(upload->default_size, min_size), 4096);
+
+   /* With persistent mappings, recycle full buffers of the default size
+    * once the GPU is done with them. This saves creating and mapping a new
+    * buffer each time the current one runs out of space.
+    */
+   if (upload->use_fences && upload->buffer &&
+       upload->buffer->width0 == align(upload->default_size, 4096)) {
+      u_upload_retire_buffer(upload);
+      if (u_upload_reuse_retired(upload, min_size))
+         return;
+   }
+
    /* Release the old buffer, if present:
     */
    u_upload_release_buffer( upload );
 
    /* Allocate a new one: 
     */
-   size = align(MAX2(upload->default_size, min_size), 4096);
 
    memset(&buffer, 0, sizeof buffer);
    buffer.target = PIPE_BUFFER;
@@ -173,6 +308,8 @@ u_upload_alloc_buffer(struct u_upload_mgr *upload,
       return;
    }
 
+   /* Nobody else can reference the buffer yet, so these are all ours. */
+   upload->buffer_refs = p_atomic_read(&upload->buffer->reference.count);
    upload->offset = 0;
 }
 
@@ -37,6 +37,7 @@
 
 struct pipe_context;
 struct pipe_resource;
+struct pipe_fence_handle;
 
 
 /**
@@ -68,6 +69,21 @@ void u_upload_destroy( struct u_upload_mgr *upload );
  */
 void u_upload_unmap( struct u_upload_mgr *upload );
 
+/**
+ * Provide the fence of a flush.
+ *
+ * \param upload           Upload manager
+ * \param fence            Fence which signals once all commands submitted
+ *                         so far have completed
+ *
+ * With persistent mappings, upload buffers which were filled before the
+ * flush are kept mapped and reused once the fence has signalled, instead
+ * of creating new buffers. Owners which never call this get the default
+ * behaviour of allocating a new buffer whenever the current one is full.
+ */
+void u_upload_fence(struct u_upload_mgr *upload,
+                    struct pipe_fence_handle *fence);
+
 /**
  * Sub-allocate new memory from the upload buffer.
  *
@@ -97,6 +97,13 @@ struct llvmpipe_context {
 
    unsigned active_occlusion_queries;
 
+   /** Always maintained counters for the LP_QUERY_x driver queries */
+   struct {
+      uint64_t num_fs_variants_compiled;
+      uint64_t fs_compile_time;         /**< in microseconds */
+      uint64_t num_resource_flushes;
+   } hud;
+
    unsigned dirty; /**< Mask of LP_NEW_x flags */
 
    /** Mapped vertex buffers */
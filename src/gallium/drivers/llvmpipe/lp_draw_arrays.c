@@ -58,7 +58,7 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
    const void *mapped_indices = NULL;
    unsigned i;
 
-   if (!llvmpipe_check_render_cond(lp))
+   if (!llvmpipe_check_render_cond_draw(lp))
       return;
 
    if (info->indirect) {
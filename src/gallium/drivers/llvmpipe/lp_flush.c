@@ -119,12 +119,15 @@ llvmpipe_flush_resource(struct pipe_context *pipe,
          if (do_not_block)
             return FALSE;
 
+         llvmpipe_context(pipe)->hud.num_resource_flushes++;
+
          llvmpipe_finish(pipe, reason);
       } else {
          /*
           * Just flush.
           */
 
+         llvmpipe_context(pipe)->hud.num_resource_flushes++;
          llvmpipe_flush(pipe, NULL, reason);
       }
    }
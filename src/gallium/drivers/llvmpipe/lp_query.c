@@ -41,6 +41,7 @@
 #include "lp_screen.h"
 #include "lp_state.h"
 #include "lp_rast.h"
+#include "lp_setup_context.h"
 
 
 static struct llvmpipe_query *llvmpipe_query( struct pipe_query *p )
@@ -55,7 +56,8 @@ llvmpipe_create_query(struct pipe_context *pipe,
 {
    struct llvmpipe_query *pq;
 
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES ||
+          (type >= PIPE_QUERY_DRIVER_SPECIFIC && type < LP_QUERY_MAX));
 
    pq = CALLOC_STRUCT( llvmpipe_query );
 
@@ -67,23 +69,35 @@ llvmpipe_create_query(struct pipe_context *pipe,
 }
 
 
+static void
+wait_query_fence(struct pipe_context *pipe, struct lp_fence **fence)
+{
+   if (*fence) {
+      if (!lp_fence_issued(*fence))
+         llvmpipe_flush(pipe, NULL, __FUNCTION__);
+
+      if (!lp_fence_signalled(*fence))
+         lp_fence_wait(*fence);
+
+      lp_fence_reference(fence, NULL);
+   }
+}
+
+
 static void
 llvmpipe_destroy_query(struct pipe_context *pipe, struct pipe_query *q)
 {
+   struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (llvmpipe->setup->render_cond.query == pq)
+      lp_setup_set_render_condition(llvmpipe->setup, NULL, FALSE, FALSE);
+
    /* Ideally we would refcount queries & not get destroyed until the
     * last scene had finished with us.
     */
-   if (pq->fence) {
-      if (!lp_fence_issued(pq->fence))
-         llvmpipe_flush(pipe, NULL, __FUNCTION__);
-
-      if (!lp_fence_signalled(pq->fence))
-         lp_fence_wait(pq->fence);
-
-      lp_fence_reference(&pq->fence, NULL);
-   }
+   wait_query_fence(pipe, &pq->fence);
+   wait_query_fence(pipe, &pq->cond_fence);
 
    FREE(pq);
 }
@@ -175,6 +189,21 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
       *stats = pq->stats;
    }
       break;
+   case LP_QUERY_NUM_TILES_SHADED:
+   case LP_QUERY_NUM_BLOCKS_SHADED:
+      for (i = 0; i < num_threads; i++) {
+         *result += pq->end[i];
+      }
+      break;
+   case LP_QUERY_NUM_TRIANGLES_BINNED:
+   case LP_QUERY_NUM_TRIANGLES_CULLED:
+   case LP_QUERY_NUM_FS_VARIANTS_COMPILED:
+   case LP_QUERY_FS_COMPILE_TIME:
+   case LP_QUERY_NUM_SCENE_FLUSHES:
+   case LP_QUERY_NUM_SCENE_FLUSHES_FULL:
+   case LP_QUERY_NUM_RESOURCE_FLUSHES:
+      *result = pq->count;
+      break;
    default:
       assert(0);
       break;
@@ -184,6 +213,36 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
 }
 
 
+/**
+ * Current value of a LP_QUERY_x counter maintained on the app thread.
+ */
+static uint64_t
+llvmpipe_query_counter(struct llvmpipe_context *llvmpipe, unsigned type)
+{
+   struct lp_setup_context *setup = llvmpipe->setup;
+
+   switch (type) {
+   case LP_QUERY_NUM_TRIANGLES_BINNED:
+      return setup->hud.num_tris_binned;
+   case LP_QUERY_NUM_TRIANGLES_CULLED:
+      return setup->hud.num_tris_culled;
+   case LP_QUERY_NUM_FS_VARIANTS_COMPILED:
+      return llvmpipe->hud.num_fs_variants_compiled;
+   case LP_QUERY_FS_COMPILE_TIME:
+      return llvmpipe->hud.fs_compile_time;
+   case LP_QUERY_NUM_SCENE_FLUSHES:
+      return setup->hud.num_scene_flushes;
+   case LP_QUERY_NUM_SCENE_FLUSHES_FULL:
+      return setup->hud.num_scene_flushes_full;
+   case LP_QUERY_NUM_RESOURCE_FLUSHES:
+      return llvmpipe->hud.num_resource_flushes;
+   default:
+      assert(0);
+      return 0;
+   }
+}
+
+
 static boolean
 llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
 {
@@ -198,6 +257,11 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
       llvmpipe_finish(pipe, __FUNCTION__);
    }
 
+   /* Scenes predicated on this query read its results while they are
+    * rasterized, so they must be done before the results are reset.
+    */
+   wait_query_fence(pipe, &pq->cond_fence);
+
 
    memset(pq->start, 0, sizeof(pq->start));
    memset(pq->end, 0, sizeof(pq->end));
@@ -232,6 +296,15 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
       llvmpipe->active_occlusion_queries++;
       llvmpipe->dirty |= LP_NEW_OCCLUSION_QUERY;
       break;
+   case LP_QUERY_NUM_TRIANGLES_BINNED:
+   case LP_QUERY_NUM_TRIANGLES_CULLED:
+   case LP_QUERY_NUM_FS_VARIANTS_COMPILED:
+   case LP_QUERY_FS_COMPILE_TIME:
+   case LP_QUERY_NUM_SCENE_FLUSHES:
+   case LP_QUERY_NUM_SCENE_FLUSHES_FULL:
+   case LP_QUERY_NUM_RESOURCE_FLUSHES:
+      pq->count = llvmpipe_query_counter(llvmpipe, pq->type);
+      break;
    default:
       break;
    }
@@ -295,6 +368,15 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
       llvmpipe->active_occlusion_queries--;
       llvmpipe->dirty |= LP_NEW_OCCLUSION_QUERY;
       break;
+   case LP_QUERY_NUM_TRIANGLES_BINNED:
+   case LP_QUERY_NUM_TRIANGLES_CULLED:
+   case LP_QUERY_NUM_FS_VARIANTS_COMPILED:
+   case LP_QUERY_FS_COMPILE_TIME:
+   case LP_QUERY_NUM_SCENE_FLUSHES:
+   case LP_QUERY_NUM_SCENE_FLUSHES_FULL:
+   case LP_QUERY_NUM_RESOURCE_FLUSHES:
+      pq->count = llvmpipe_query_counter(llvmpipe, pq->type) - pq->count;
+      break;
    default:
       break;
    }
@@ -322,6 +404,50 @@ llvmpipe_check_render_cond(struct llvmpipe_context *lp)
       return TRUE;
 }
 
+/**
+ * Like llvmpipe_check_render_cond(), but for draws.  Those are binned,
+ * so if the occlusion query result isn't available yet but the
+ * rasterizer will be able to evaluate it by the time it gets to the
+ * draws, the draws are predicated in the scene instead of waiting for
+ * the result:
+ * - if the query ended in an earlier scene, that scene is completely
+ *   rasterized before the current one, so its result is final;
+ * - for the by-region modes, if the whole query is in the current scene
+ *   each tile uses its own sample count, which is what those modes
+ *   allow.
+ */
+boolean
+llvmpipe_check_render_cond_draw(struct llvmpipe_context *lp)
+{
+   struct lp_setup_context *setup = lp->setup;
+   struct llvmpipe_query *pq = llvmpipe_query(lp->render_cond_query);
+
+   if (pq &&
+       (pq->type == PIPE_QUERY_OCCLUSION_COUNTER ||
+        pq->type == PIPE_QUERY_OCCLUSION_PREDICATE) &&
+       pq->fence && !lp_fence_signalled(pq->fence)) {
+      boolean by_region =
+         (lp->render_cond_mode == PIPE_RENDER_COND_BY_REGION_WAIT ||
+          lp->render_cond_mode == PIPE_RENDER_COND_BY_REGION_NO_WAIT);
+
+      if (!setup->scene || pq->end_scene != setup->scene_seq) {
+         lp_setup_set_render_condition(setup, pq, lp->render_cond_cond,
+                                       FALSE);
+         return TRUE;
+      }
+
+      if (by_region && pq->begin_scene == setup->scene_seq) {
+         lp_setup_set_render_condition(setup, pq, lp->render_cond_cond,
+                                       TRUE);
+         return TRUE;
+      }
+   }
+
+   lp_setup_set_render_condition(setup, NULL, FALSE, FALSE);
+
+   return llvmpipe_check_render_cond(lp);
+}
+
 static void
 llvmpipe_set_active_query_state(struct pipe_context *pipe, boolean enable)
 {
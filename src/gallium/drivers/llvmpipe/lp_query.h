@@ -41,6 +41,25 @@
 struct llvmpipe_context;
 
 
+/*
+ * Driver specific queries, see llvmpipe_get_driver_query_info().
+ *
+ * The tile and block counters are gathered per rasterizer thread through
+ * binned begin/end query commands, the others are sampled on the
+ * application thread.
+ */
+#define LP_QUERY_NUM_TRIANGLES_BINNED     (PIPE_QUERY_DRIVER_SPECIFIC + 0)
+#define LP_QUERY_NUM_TRIANGLES_CULLED     (PIPE_QUERY_DRIVER_SPECIFIC + 1)
+#define LP_QUERY_NUM_TILES_SHADED         (PIPE_QUERY_DRIVER_SPECIFIC + 2)
+#define LP_QUERY_NUM_BLOCKS_SHADED        (PIPE_QUERY_DRIVER_SPECIFIC + 3)
+#define LP_QUERY_NUM_FS_VARIANTS_COMPILED (PIPE_QUERY_DRIVER_SPECIFIC + 4)
+#define LP_QUERY_FS_COMPILE_TIME          (PIPE_QUERY_DRIVER_SPECIFIC + 5)
+#define LP_QUERY_NUM_SCENE_FLUSHES        (PIPE_QUERY_DRIVER_SPECIFIC + 6)
+#define LP_QUERY_NUM_SCENE_FLUSHES_FULL   (PIPE_QUERY_DRIVER_SPECIFIC + 7)
+#define LP_QUERY_NUM_RESOURCE_FLUSHES     (PIPE_QUERY_DRIVER_SPECIFIC + 8)
+#define LP_QUERY_MAX                      (PIPE_QUERY_DRIVER_SPECIFIC + 9)
+
+
 struct llvmpipe_query {
    uint64_t start[LP_MAX_THREADS];  /* start count value for each thread */
    uint64_t end[LP_MAX_THREADS];    /* end count value for each thread */
@@ -48,13 +67,37 @@ struct llvmpipe_query {
    unsigned type;                   /* PIPE_QUERY_* */
    unsigned num_primitives_generated;
    unsigned num_primitives_written;
+   uint64_t count;                  /* LP_QUERY_x sampled on app thread */
+
+   /* occlusion count of the last tile each thread finished the query in */
+   uint64_t tile_samples[LP_MAX_THREADS];
+   unsigned begin_scene;            /* lp_setup scene_seq of begin */
+   unsigned end_scene;              /* lp_setup scene_seq of end */
+   struct lp_fence *cond_fence;     /* last scene this predicated */
 
    struct pipe_query_data_pipeline_statistics stats;
 };
 
 
+/**
+ * Whether the query result is gathered by the rasterizer threads, through
+ * begin/end query commands put in all bins.
+ */
+static inline boolean
+lp_query_is_binned(unsigned type)
+{
+   return type == PIPE_QUERY_OCCLUSION_COUNTER ||
+          type == PIPE_QUERY_OCCLUSION_PREDICATE ||
+          type == PIPE_QUERY_PIPELINE_STATISTICS ||
+          type == LP_QUERY_NUM_TILES_SHADED ||
+          type == LP_QUERY_NUM_BLOCKS_SHADED;
+}
+
+
 extern void llvmpipe_init_query_funcs(struct llvmpipe_context * );
 
 extern boolean llvmpipe_check_render_cond(struct llvmpipe_context *);
 
+extern boolean llvmpipe_check_render_cond_draw(struct llvmpipe_context *);
+
 #endif /* LP_QUERY_H */
@@ -107,6 +107,9 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
 
    task->thread_data.vis_counter = 0;
    task->ps_invocations = 0;
+   task->num_tiles_shaded = 0;
+   task->num_blocks_shaded = 0;
+   task->skip_draws = FALSE;
 
    for (i = 0; i < task->scene->fb.nr_cbufs; i++) {
       if (task->scene->fb.cbufs[i]) {
@@ -315,6 +318,9 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    }
    variant = state->variant;
 
+   task->num_tiles_shaded++;
+   task->num_blocks_shaded += (task->width / 4) * (task->height / 4);
+
    /* render the whole 64x64 tile in 4x4 chunks */
    for (y = 0; y < task->height; y += 4){
       for (x = 0; x < task->width; x += 4) {
@@ -448,6 +454,7 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
       /* not very accurate would need a popcount on the mask */
       /* always count this not worth bothering? */
       task->ps_invocations += 1 * variant->ps_inv_multiplier;
+      task->num_blocks_shaded++;
 
       /* Propagate non-interpolated raster state. */
       task->thread_data.raster_state.viewport_index = inputs->viewport_index;
@@ -491,6 +498,12 @@ lp_rast_begin_query(struct lp_rasterizer_task *task,
    case PIPE_QUERY_PIPELINE_STATISTICS:
       pq->start[task->thread_index] = task->ps_invocations;
       break;
+   case LP_QUERY_NUM_TILES_SHADED:
+      pq->start[task->thread_index] = task->num_tiles_shaded;
+      break;
+   case LP_QUERY_NUM_BLOCKS_SHADED:
+      pq->start[task->thread_index] = task->num_blocks_shaded;
+      break;
    default:
       assert(0);
       break;
@@ -512,8 +525,9 @@ lp_rast_end_query(struct lp_rasterizer_task *task,
    switch (pq->type) {
    case PIPE_QUERY_OCCLUSION_COUNTER:
    case PIPE_QUERY_OCCLUSION_PREDICATE:
-      pq->end[task->thread_index] +=
+      pq->tile_samples[task->thread_index] =
          task->thread_data.vis_counter - pq->start[task->thread_index];
+      pq->end[task->thread_index] += pq->tile_samples[task->thread_index];
       pq->start[task->thread_index] = 0;
       break;
    case PIPE_QUERY_TIMESTAMP:
@@ -524,6 +538,16 @@ lp_rast_end_query(struct lp_rasterizer_task *task,
          task->ps_invocations - pq->start[task->thread_index];
       pq->start[task->thread_index] = 0;
       break;
+   case LP_QUERY_NUM_TILES_SHADED:
+      pq->end[task->thread_index] +=
+         task->num_tiles_shaded - pq->start[task->thread_index];
+      pq->start[task->thread_index] = 0;
+      break;
+   case LP_QUERY_NUM_BLOCKS_SHADED:
+      pq->end[task->thread_index] +=
+         task->num_blocks_shaded - pq->start[task->thread_index];
+      pq->start[task->thread_index] = 0;
+      break;
    default:
       assert(0);
       break;
@@ -539,6 +563,64 @@ lp_rast_set_state(struct lp_rasterizer_task *task,
 }
 
 
+/**
+ * Evaluate a render condition for the current tile.
+ * For by-region conditions the query ended earlier in this same bin, so
+ * the per-tile sample count is used.  Otherwise the query ended in an
+ * earlier scene which has been completely rasterized already, so the
+ * final result can be summed up here.
+ * This is a bin command put in all bins.
+ * Called per thread.
+ */
+static void
+lp_rast_begin_condition(struct lp_rasterizer_task *task,
+                        const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_condition *cond = arg.condition;
+   struct llvmpipe_query *pq = cond->query;
+   uint64_t samples = 0;
+   unsigned i;
+
+   if (cond->by_region) {
+      samples = pq->tile_samples[task->thread_index];
+   }
+   else {
+      for (i = 0; i < MAX2(1, task->rast->num_threads); i++) {
+         samples += pq->end[i];
+      }
+   }
+
+   task->skip_draws = (!samples) != cond->condition;
+}
+
+
+/**
+ * End of a render condition, draw commands are executed again.
+ * This is a bin command put in all bins.
+ * Called per thread.
+ */
+static void
+lp_rast_end_condition(struct lp_rasterizer_task *task,
+                      const union lp_rast_cmd_arg arg)
+{
+   task->skip_draws = FALSE;
+}
+
+
+/**
+ * Whether the command is skipped while a render condition failed.
+ * Queries, clears and state changes still need to be executed.
+ */
+static inline boolean
+lp_rast_cmd_is_draw(unsigned cmd)
+{
+   return (cmd >= LP_RAST_OP_TRIANGLE_1 &&
+           cmd <= LP_RAST_OP_SHADE_TILE_OPAQUE) ||
+          (cmd >= LP_RAST_OP_TRIANGLE_32_1 &&
+           cmd <= LP_RAST_OP_TRIANGLE_32_4_16);
+}
+
+
 
 /**
  * Called when we're done writing to a color tile.
@@ -589,7 +671,9 @@ static lp_rast_cmd_func dispatch[LP_RAST_OP_MAX] =
    lp_rast_triangle_32_8,
    lp_rast_triangle_32_3_4,
    lp_rast_triangle_32_3_16,
-   lp_rast_triangle_32_4_16
+   lp_rast_triangle_32_4_16,
+   lp_rast_begin_condition,
+   lp_rast_end_condition
 };
 
 
@@ -606,6 +690,8 @@ do_rasterize_bin(struct lp_rasterizer_task *task,
 
    for (block = bin->head; block; block = block->next) {
       for (k = 0; k < block->count; k++) {
+         if (task->skip_draws && lp_rast_cmd_is_draw(block->cmd[k]))
+            continue;
          dispatch[block->cmd[k]]( task, block->arg[k] );
       }
    }
@@ -671,8 +757,10 @@ rasterize_scene(struct lp_rasterizer_task *task,
    memset(task->thread_data.cache->cache_tags, 0,
           sizeof(task->thread_data.cache->cache_tags));
 #if LP_BUILD_FORMAT_CACHE_DEBUG
-   task->thread_data.cache->cache_access_total = 0;
-   task->thread_data.cache->cache_access_miss = 0;
+   memset(task->thread_data.cache->cache_access_total, 0,
+          sizeof(task->thread_data.cache->cache_access_total));
+   memset(task->thread_data.cache->cache_access_miss, 0,
+          sizeof(task->thread_data.cache->cache_access_miss));
 #endif
 #endif
 
@@ -693,14 +781,18 @@ rasterize_scene(struct lp_rasterizer_task *task,
 
 #if LP_BUILD_FORMAT_CACHE_DEBUG
    {
-      uint64_t total, miss;
-      total = task->thread_data.cache->cache_access_total;
-      miss = task->thread_data.cache->cache_access_miss;
-      if (total) {
-         debug_printf("thread %d cache access %llu miss %llu hit rate %f\n",
-                 task->thread_index, (long long unsigned)total,
-                 (long long unsigned)miss,
-                 (float)(total - miss)/(float)total);
+      enum pipe_format format;
+      for (format = 0; format < PIPE_FORMAT_COUNT; format++) {
+         uint64_t total, miss;
+         total = task->thread_data.cache->cache_access_total[format];
+         miss = task->thread_data.cache->cache_access_miss[format];
+         if (total) {
+            debug_printf("thread %d %s cache access %llu miss %llu hit rate %f\n",
+                    task->thread_index, util_format_short_name(format),
+                    (long long unsigned)total,
+                    (long long unsigned)miss,
+                    (float)(total - miss)/(float)total);
+         }
       }
    }
 #endif
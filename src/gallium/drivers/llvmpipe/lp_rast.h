@@ -149,6 +149,19 @@ struct lp_rast_clear_rb {
 };
 
 
+/**
+ * Render condition, evaluated by the rasterizer for each tile.
+ * Draw commands following a begin_condition command in a bin are skipped
+ * unless the occlusion query result matches, up to the next
+ * end_condition command.
+ */
+struct lp_rast_condition {
+   struct llvmpipe_query *query;
+   boolean condition;   /**< draw if (query result == 0) == condition */
+   boolean by_region;   /**< use the query result of the current tile only */
+};
+
+
 #define GET_A0(inputs) ((float (*)[4])((inputs)+1))
 #define GET_DADX(inputs) ((float (*)[4])((char *)((inputs) + 1) + (inputs)->stride))
 #define GET_DADY(inputs) ((float (*)[4])((char *)((inputs) + 1) + 2 * (inputs)->stride))
@@ -185,6 +198,7 @@ union lp_rast_cmd_arg {
    const struct lp_rast_state *state;
    struct lp_fence *fence;
    struct llvmpipe_query *query_obj;
+   const struct lp_rast_condition *condition;
 };
 
 
@@ -259,6 +273,14 @@ lp_rast_arg_query( struct llvmpipe_query *pq )
    return arg;
 }
 
+static inline union lp_rast_cmd_arg
+lp_rast_arg_condition( const struct lp_rast_condition *condition )
+{
+   union lp_rast_cmd_arg arg;
+   arg.condition = condition;
+   return arg;
+}
+
 static inline union lp_rast_cmd_arg
 lp_rast_arg_null( void )
 {
@@ -302,8 +324,10 @@ lp_rast_arg_null( void )
 #define LP_RAST_OP_TRIANGLE_32_3_4   0x1a
 #define LP_RAST_OP_TRIANGLE_32_3_16  0x1b
 #define LP_RAST_OP_TRIANGLE_32_4_16  0x1c
+#define LP_RAST_OP_BEGIN_CONDITION   0x1d
+#define LP_RAST_OP_END_CONDITION     0x1e
 
-#define LP_RAST_OP_MAX               0x1d
+#define LP_RAST_OP_MAX               0x1f
 #define LP_RAST_OP_MASK              0xff
 
 void
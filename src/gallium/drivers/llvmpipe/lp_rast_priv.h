@@ -102,6 +102,13 @@ struct lp_rasterizer_task
    uint64_t ps_invocations;
    uint8_t ps_inv_multiplier;
 
+   /** Per-tile counters for the LP_QUERY_x driver queries */
+   uint64_t num_tiles_shaded;
+   uint64_t num_blocks_shaded;
+
+   /** Skip draw commands, set by a failing begin_condition command */
+   boolean skip_draws;
+
    pipe_semaphore work_ready;
    pipe_semaphore work_done;
 };
@@ -262,6 +269,7 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
       /* not very accurate would need a popcount on the mask */
       /* always count this not worth bothering? */
       task->ps_invocations += 1 * variant->ps_inv_multiplier;
+      task->num_blocks_shaded++;
 
       /* Propagate non-interpolated raster state. */
       task->thread_data.raster_state.viewport_index = inputs->viewport_index;
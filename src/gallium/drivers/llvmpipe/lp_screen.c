@@ -48,6 +48,7 @@
 #include "lp_public.h"
 #include "lp_limits.h"
 #include "lp_rast.h"
+#include "lp_query.h"
 
 #include "state_tracker/sw_winsys.h"
 
@@ -592,6 +593,47 @@ llvmpipe_get_timestamp(struct pipe_screen *_screen)
    return os_time_get_nano();
 }
 
+
+static int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+#define QUERY(NAME, ENUM, UNITS) \
+   {NAME, ENUM, {0}, UNITS, PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE, 0, 0x0}
+
+   static const struct pipe_driver_query_info queries[] = {
+      QUERY("num-triangles-binned", LP_QUERY_NUM_TRIANGLES_BINNED,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("num-triangles-culled", LP_QUERY_NUM_TRIANGLES_CULLED,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("num-tiles-shaded", LP_QUERY_NUM_TILES_SHADED,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("num-blocks-shaded", LP_QUERY_NUM_BLOCKS_SHADED,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("num-fs-variants-compiled", LP_QUERY_NUM_FS_VARIANTS_COMPILED,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("fs-compile-time", LP_QUERY_FS_COMPILE_TIME,
+            PIPE_DRIVER_QUERY_TYPE_MICROSECONDS),
+      QUERY("num-scene-flushes", LP_QUERY_NUM_SCENE_FLUSHES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("num-scene-flushes-full", LP_QUERY_NUM_SCENE_FLUSHES_FULL,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("num-resource-flushes", LP_QUERY_NUM_RESOURCE_FLUSHES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+   };
+#undef QUERY
+
+   if (!info)
+      return ARRAY_SIZE(queries);
+
+   if (index >= ARRAY_SIZE(queries))
+      return 0;
+
+   *info = queries[index];
+   return 1;
+}
+
 /**
  * Create a new pipe_screen object
  * Note: we're not presently subclassing pipe_screen (no llvmpipe_screen).
@@ -636,6 +678,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.fence_finish = llvmpipe_fence_finish;
 
    screen->base.get_timestamp = llvmpipe_get_timestamp;
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
 
    llvmpipe_init_screen_resource_funcs(&screen->base);
 
@@ -71,6 +71,7 @@ lp_setup_get_empty_scene(struct lp_setup_context *setup)
 
    setup->scene_idx++;
    setup->scene_idx %= ARRAY_SIZE(setup->scenes);
+   setup->scene_seq++;
 
    setup->scene = setup->scenes[setup->scene_idx];
 
@@ -98,6 +99,16 @@ first_triangle( struct lp_setup_context *setup,
    setup->triangle( setup, v0, v1, v2 );
 }
 
+static void
+first_triangles( struct lp_setup_context *setup,
+                 const float (*const *v)[4],
+                 unsigned nr)
+{
+   assert(setup->state == SETUP_ACTIVE);
+   lp_setup_choose_triangle( setup );
+   setup->triangles( setup, v, nr );
+}
+
 static void
 first_line( struct lp_setup_context *setup,
 	    const float (*v0)[4],
@@ -129,6 +140,7 @@ void lp_setup_reset( struct lp_setup_context *setup )
       setup->constants[i].stored_data = NULL;
    }
    setup->fs.stored = NULL;
+   setup->render_cond.binned = FALSE;
    setup->dirty = ~0;
 
    /* no current bin */
@@ -144,6 +156,7 @@ void lp_setup_reset( struct lp_setup_context *setup )
    setup->line = first_line;
    setup->point = first_point;
    setup->triangle = first_triangle;
+   setup->triangles = first_triangles;
 }
 
 
@@ -154,6 +167,8 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
    struct lp_scene *scene = setup->scene;
    struct llvmpipe_screen *screen = llvmpipe_screen(scene->pipe->screen);
 
+   setup->hud.num_scene_flushes++;
+
    scene->num_active_queries = setup->active_binned_queries;
    memcpy(scene->active_queries, setup->active_queries,
           scene->num_active_queries * sizeof(scene->active_queries[0]));
@@ -260,7 +275,8 @@ begin_binning( struct lp_setup_context *setup )
    setup->clear.zsmask = 0;
    setup->clear.zsvalue = 0;
 
-   scene->had_queries = !!setup->active_binned_queries;
+   scene->had_queries = (setup->active_binned_queries != 0 ||
+                         setup->render_cond.binned);
 
    LP_DBG(DEBUG_SETUP, "%s done\n", __FUNCTION__);
    return TRUE;
@@ -588,6 +604,7 @@ lp_setup_set_triangle_state( struct lp_setup_context *setup,
    setup->ccw_is_frontface = ccw_is_frontface;
    setup->cullmode = cull_mode;
    setup->triangle = first_triangle;
+   setup->triangles = first_triangles;
    setup->pixel_offset = half_pixel_center ? 0.5f : 0.0f;
    setup->bottom_edge_rule = bottom_edge_rule;
 
@@ -992,6 +1009,57 @@ lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
 }
 
 
+/**
+ * Put the current render condition into all bins, ending the previous
+ * one if any.
+ */
+static boolean
+update_render_condition( struct lp_setup_context *setup )
+{
+   struct lp_scene *scene = setup->scene;
+   struct llvmpipe_query *pq = setup->render_cond.query;
+
+   if (setup->render_cond.binned) {
+      if (!lp_scene_bin_everywhere(scene,
+                                   LP_RAST_OP_END_CONDITION,
+                                   lp_rast_arg_null()))
+         return FALSE;
+      setup->render_cond.binned = FALSE;
+   }
+
+   if (pq) {
+      struct lp_rast_condition *cond;
+
+      cond = (struct lp_rast_condition *) lp_scene_alloc(scene, sizeof *cond);
+      if (!cond)
+         return FALSE;
+
+      cond->query = pq;
+      cond->condition = setup->render_cond.condition;
+      /* Per-tile results are only usable if the whole query is in
+       * this scene, otherwise the query must have ended in an earlier
+       * scene and the final result is used.
+       */
+      cond->by_region = setup->render_cond.by_region &&
+                        pq->begin_scene == setup->scene_seq &&
+                        pq->end_scene == setup->scene_seq;
+      assert(cond->by_region || pq->end_scene != setup->scene_seq);
+
+      if (!lp_scene_bin_everywhere(scene,
+                                   LP_RAST_OP_BEGIN_CONDITION,
+                                   lp_rast_arg_condition(cond)))
+         return FALSE;
+
+      lp_fence_reference(&pq->cond_fence, scene->fence);
+      /* bins must not be reset by opaque whole-tile draws anymore */
+      scene->had_queries = TRUE;
+      setup->render_cond.binned = TRUE;
+   }
+
+   return TRUE;
+}
+
+
 /**
  * Called by vbuf code when we're about to draw something.
  *
@@ -1171,6 +1239,13 @@ try_update_scene_state( struct lp_setup_context *setup )
       }
    }
 
+   if (setup->dirty & LP_SETUP_NEW_RENDER_COND) {
+      if (!update_render_condition(setup)) {
+         assert(!new_scene);
+         return FALSE;
+      }
+   }
+
    if (setup->dirty & LP_SETUP_NEW_SCISSOR) {
       unsigned i;
       for (i = 0; i < PIPE_MAX_VIEWPORTS; ++i) {
@@ -1342,6 +1417,7 @@ lp_setup_create( struct pipe_context *pipe,
    }
 
    setup->triangle = first_triangle;
+   setup->triangles = first_triangles;
    setup->line     = first_line;
    setup->point    = first_point;
    
@@ -1374,9 +1450,9 @@ lp_setup_begin_query(struct lp_setup_context *setup,
 
    set_scene_state(setup, SETUP_ACTIVE, "begin_query");
 
-   if (!(pq->type == PIPE_QUERY_OCCLUSION_COUNTER ||
-         pq->type == PIPE_QUERY_OCCLUSION_PREDICATE ||
-         pq->type == PIPE_QUERY_PIPELINE_STATISTICS))
+   pq->begin_scene = 0;
+
+   if (!lp_query_is_binned(pq->type))
       return;
 
    /* init the query to its beginning state */
@@ -1405,6 +1481,7 @@ lp_setup_begin_query(struct lp_setup_context *setup,
          }
       }
       setup->scene->had_queries |= TRUE;
+      pq->begin_scene = setup->scene_seq;
    }
 }
 
@@ -1424,9 +1501,7 @@ lp_setup_end_query(struct lp_setup_context *setup, struct llvmpipe_query *pq)
        */
       lp_fence_reference(&pq->fence, setup->scene->fence);
 
-      if (pq->type == PIPE_QUERY_OCCLUSION_COUNTER ||
-          pq->type == PIPE_QUERY_OCCLUSION_PREDICATE ||
-          pq->type == PIPE_QUERY_PIPELINE_STATISTICS ||
+      if (lp_query_is_binned(pq->type) ||
           pq->type == PIPE_QUERY_TIMESTAMP) {
          if (pq->type == PIPE_QUERY_TIMESTAMP &&
                !(setup->scene->tiles_x | setup->scene->tiles_y)) {
@@ -1451,6 +1526,7 @@ lp_setup_end_query(struct lp_setup_context *setup, struct llvmpipe_query *pq)
          }
          setup->scene->had_queries |= TRUE;
       }
+      pq->end_scene = setup->scene_seq;
    }
    else {
       lp_fence_reference(&pq->fence, setup->last_fence);
@@ -1460,9 +1536,7 @@ fail:
    /* Need to do this now not earlier since it still needs to be marked as
     * active when binning it would cause a flush.
     */
-   if (pq->type == PIPE_QUERY_OCCLUSION_COUNTER ||
-      pq->type == PIPE_QUERY_OCCLUSION_PREDICATE ||
-      pq->type == PIPE_QUERY_PIPELINE_STATISTICS) {
+   if (lp_query_is_binned(pq->type)) {
       unsigned i;
 
       /* remove from active binned query list */
@@ -1480,6 +1554,29 @@ fail:
 }
 
 
+/**
+ * Set the render condition for subsequent draws, or none if pq is NULL.
+ * The caller needs to ensure the rasterizer can evaluate the condition,
+ * see llvmpipe_check_render_cond_draw().
+ */
+void
+lp_setup_set_render_condition(struct lp_setup_context *setup,
+                              struct llvmpipe_query *pq,
+                              boolean condition,
+                              boolean by_region)
+{
+   if (setup->render_cond.query == pq &&
+       setup->render_cond.condition == condition &&
+       setup->render_cond.by_region == by_region)
+      return;
+
+   setup->render_cond.query = pq;
+   setup->render_cond.condition = condition;
+   setup->render_cond.by_region = by_region;
+   setup->dirty |= LP_SETUP_NEW_RENDER_COND;
+}
+
+
 boolean
 lp_setup_flush_and_restart(struct lp_setup_context *setup)
 {
@@ -1487,6 +1584,8 @@ lp_setup_flush_and_restart(struct lp_setup_context *setup)
 
    assert(setup->state == SETUP_ACTIVE);
 
+   setup->hud.num_scene_flushes_full++;
+
    if (!set_scene_state(setup, SETUP_FLUSHED, __FUNCTION__))
       return FALSE;
    
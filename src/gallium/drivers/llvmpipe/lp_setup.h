@@ -159,6 +159,12 @@ void
 lp_setup_end_query(struct lp_setup_context *setup,
                    struct llvmpipe_query *pq);
 
+void
+lp_setup_set_render_condition(struct lp_setup_context *setup,
+                              struct llvmpipe_query *pq,
+                              boolean condition,
+                              boolean by_region);
+
 static inline unsigned
 lp_clamp_viewport_idx(int idx)
 {
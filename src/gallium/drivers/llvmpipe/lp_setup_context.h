@@ -49,6 +49,7 @@
 #define LP_SETUP_NEW_BLEND_COLOR 0x04
 #define LP_SETUP_NEW_SCISSOR     0x08
 #define LP_SETUP_NEW_VIEWPORTS   0x10
+#define LP_SETUP_NEW_RENDER_COND 0x20
 
 
 struct lp_setup_variant;
@@ -60,6 +61,9 @@ struct lp_setup_variant;
 
 
 
+/** Max number of triangles set up together by setup->triangles() */
+#define LP_SETUP_TRI_BATCH 8
+
 /**
  * Point/line/triangle setup context.
  * Note: "stored" below indicates data which is stored in the bins,
@@ -88,6 +92,7 @@ struct lp_setup_context
    struct draw_stage *vbuf;
    unsigned num_threads;
    unsigned scene_idx;
+   unsigned scene_seq;                   /**< incremented for each new scene */
    struct lp_scene *scenes[MAX_SCENES];  /**< all the scenes */
    struct lp_scene *scene;               /**< current scene being built */
 
@@ -95,6 +100,14 @@ struct lp_setup_context
    struct llvmpipe_query *active_queries[LP_MAX_ACTIVE_BINNED_QUERIES];
    unsigned active_binned_queries;
 
+   /** Always maintained counters for the LP_QUERY_x driver queries */
+   struct {
+      uint64_t num_tris_binned;
+      uint64_t num_tris_culled;
+      uint64_t num_scene_flushes;
+      uint64_t num_scene_flushes_full;  /**< scene ran out of bin memory */
+   } hud;
+
    boolean flatshade_first;
    boolean ccw_is_frontface;
    boolean scissor_test;
@@ -148,6 +161,14 @@ struct lp_setup_context
       uint8_t *stored;
    } blend_color;
 
+   /** Render condition evaluated by the rasterizer */
+   struct {
+      struct llvmpipe_query *query;
+      boolean condition;
+      boolean by_region;
+      boolean binned;   /**< begin_condition is in the current scene */
+   } render_cond;
+
 
    struct {
       const struct lp_setup_variant *variant;
@@ -166,6 +187,11 @@ struct lp_setup_context
                      const float (*v0)[4],
                      const float (*v1)[4],
                      const float (*v2)[4]);
+
+   /** Set up nr independent triangles, given as 3 * nr vertex pointers */
+   void (*triangles)( struct lp_setup_context *,
+                      const float (*const *v)[4],
+                      unsigned nr);
 };
 
 static inline void
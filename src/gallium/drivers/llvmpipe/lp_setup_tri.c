@@ -64,7 +64,11 @@ fixed_to_float(int a)
 }
 
 
-/* Position and area in fixed point coordinates */
+/* Position and area in fixed point coordinates.
+ * x, y and dx01..dy20 are accessed with aligned SSE loads/stores, so the
+ * size is padded to a multiple of 16 bytes to keep every element of a
+ * batch (see triangles_##name) aligned.
+ */
 struct fixed_position {
    int32_t x[4];
    int32_t y[4];
@@ -73,6 +77,7 @@ struct fixed_position {
    int32_t dx20;
    int32_t dy20;
    int64_t area;
+   int64_t pad;
 };
 
 
@@ -259,6 +264,36 @@ lp_setup_whole_tile(struct lp_setup_context *setup,
 }
 
 
+/**
+ * Check whether a triangle with a bounding box of at most 2x2 pixels
+ * covers any pixel center.  This evaluates the edge functions exactly
+ * like the rasterizer does, hence only the three triangle edges are
+ * needed (scissor planes can only remove coverage).
+ */
+static inline boolean
+tiny_tri_covers_pixel(const struct lp_rast_plane *plane,
+                      const struct u_rect *bbox)
+{
+   int x, y, i;
+
+   for (y = bbox->y0; y <= bbox->y1; y++) {
+      for (x = bbox->x0; x <= bbox->x1; x++) {
+         for (i = 0; i < 3; i++) {
+            int64_t c = plane[i].c -
+                        IMUL64(plane[i].dcdx, x) +
+                        IMUL64(plane[i].dcdy, y);
+            if (c <= 0)
+               break;
+         }
+         if (i == 3)
+            return TRUE;
+      }
+   }
+
+   return FALSE;
+}
+
+
 /**
  * Do basic setup for triangle rasterization and determine which
  * framebuffer tiles are touched.  Put the triangle in the scene's
@@ -326,12 +361,14 @@ do_triangle_ccw(struct lp_setup_context *setup,
        bbox.y1 < bbox.y0) {
       if (0) debug_printf("empty bounding box\n");
       LP_COUNT(nr_culled_tris);
+      setup->hud.num_tris_culled++;
       return TRUE;
    }
 
    if (!u_rect_test_intersection(&setup->draw_regions[viewport_index], &bbox)) {
       if (0) debug_printf("offscreen\n");
       LP_COUNT(nr_culled_tris);
+      setup->hud.num_tris_culled++;
       return TRUE;
    }
 
@@ -370,28 +407,6 @@ do_triangle_ccw(struct lp_setup_context *setup,
    tri->v[2][1] = v2[0][1];
 #endif
 
-   LP_COUNT(nr_tris);
-
-   /* Setup parameter interpolants:
-    */
-   setup->setup.variant->jit_function(v0, v1, v2,
-                                      frontfacing,
-                                      GET_A0(&tri->inputs),
-                                      GET_DADX(&tri->inputs),
-                                      GET_DADY(&tri->inputs));
-
-   tri->inputs.frontfacing = frontfacing;
-   tri->inputs.disable = FALSE;
-   tri->inputs.opaque = setup->fs.current.variant->opaque;
-   tri->inputs.layer = layer;
-   tri->inputs.viewport_index = viewport_index;
-
-   if (0)
-      lp_dump_setup_coef(&setup->setup.variant->key,
-                         (const float (*)[4])GET_A0(&tri->inputs),
-                         (const float (*)[4])GET_DADX(&tri->inputs),
-                         (const float (*)[4])GET_DADY(&tri->inputs));
-
    plane = GET_PLANES(tri);
 
 #if defined(PIPE_ARCH_SSE)
@@ -659,6 +674,40 @@ do_triangle_ccw(struct lp_setup_context *setup,
                    plane[2].eo);
    }
 
+   /*
+    * Tiny triangles frequently don't cover any pixel center at all.
+    * Drop those before doing interpolant setup and binning.
+    */
+   if (bbox.x1 - bbox.x0 <= 1 &&
+       bbox.y1 - bbox.y0 <= 1 &&
+       !tiny_tri_covers_pixel(plane, &bbox)) {
+      lp_scene_putback_data(scene, tri_bytes);
+      LP_COUNT(nr_culled_tris);
+      setup->hud.num_tris_culled++;
+      return TRUE;
+   }
+
+   LP_COUNT(nr_tris);
+
+   /* Setup parameter interpolants:
+    */
+   setup->setup.variant->jit_function(v0, v1, v2,
+                                      frontfacing,
+                                      GET_A0(&tri->inputs),
+                                      GET_DADX(&tri->inputs),
+                                      GET_DADY(&tri->inputs));
+
+   tri->inputs.frontfacing = frontfacing;
+   tri->inputs.disable = FALSE;
+   tri->inputs.opaque = setup->fs.current.variant->opaque;
+   tri->inputs.layer = layer;
+   tri->inputs.viewport_index = viewport_index;
+
+   if (0)
+      lp_dump_setup_coef(&setup->setup.variant->key,
+                         (const float (*)[4])GET_A0(&tri->inputs),
+                         (const float (*)[4])GET_DADX(&tri->inputs),
+                         (const float (*)[4])GET_DADY(&tri->inputs));
 
    /* 
     * When rasterizing scissored tris, use the intersection of the
@@ -719,7 +768,14 @@ do_triangle_ccw(struct lp_setup_context *setup,
       assert(plane_s == &plane[nr_planes]);
    }
 
-   return lp_setup_bin_triangle(setup, tri, &bbox, nr_planes, viewport_index);
+   if (!lp_setup_bin_triangle(setup, tri, &bbox, nr_planes, viewport_index))
+      return FALSE;
+
+   /* Only counted once binned, as a triangle that didn't fit in the scene
+    * is retried in a new one.
+    */
+   setup->hud.num_tris_binned++;
+   return TRUE;
 }
 
 /*
@@ -1111,51 +1167,73 @@ rotate_fixed_position_12( struct fixed_position* position )
 
 
 /**
- * Draw triangle if it's CW, cull otherwise.
+ * Calculate fixed position data for nr triangles, given as 3 * nr
+ * vertex pointers.
  */
-static void triangle_cw(struct lp_setup_context *setup,
-                        const float (*v0)[4],
-                        const float (*v1)[4],
-                        const float (*v2)[4])
+static inline void
+calc_fixed_positions(struct lp_setup_context *setup,
+                     struct fixed_position *position,
+                     const float (*const *v)[4],
+                     unsigned nr)
 {
-   PIPE_ALIGN_VAR(16) struct fixed_position position;
+   unsigned i;
+
+   STATIC_ASSERT(sizeof(struct fixed_position) % 16 == 0);
+
+   for (i = 0; i < nr; i++)
+      calc_fixed_position(setup, &position[i], v[i*3+0], v[i*3+1], v[i*3+2]);
+}
 
-   calc_fixed_position(setup, &position, v0, v1, v2);
 
-   if (position.area < 0) {
+/**
+ * Draw triangle with precalculated position if it's CW, cull otherwise.
+ */
+static inline void
+draw_triangle_cw(struct lp_setup_context *setup,
+                 struct fixed_position *position,
+                 const float (*v0)[4],
+                 const float (*v1)[4],
+                 const float (*v2)[4])
+{
+   if (position->area < 0) {
       if (setup->flatshade_first) {
-         rotate_fixed_position_12(&position);
-         retry_triangle_ccw(setup, &position, v0, v2, v1, !setup->ccw_is_frontface);
+         rotate_fixed_position_12(position);
+         retry_triangle_ccw(setup, position, v0, v2, v1, !setup->ccw_is_frontface);
       } else {
-         rotate_fixed_position_01(&position);
-         retry_triangle_ccw(setup, &position, v1, v0, v2, !setup->ccw_is_frontface);
+         rotate_fixed_position_01(position);
+         retry_triangle_ccw(setup, position, v1, v0, v2, !setup->ccw_is_frontface);
       }
    }
+   else {
+      LP_COUNT(nr_culled_tris);
+      setup->hud.num_tris_culled++;
+   }
 }
 
 
-static void triangle_ccw(struct lp_setup_context *setup,
-                         const float (*v0)[4],
-                         const float (*v1)[4],
-                         const float (*v2)[4])
+static inline void
+draw_triangle_ccw(struct lp_setup_context *setup,
+                  struct fixed_position *position,
+                  const float (*v0)[4],
+                  const float (*v1)[4],
+                  const float (*v2)[4])
 {
-   PIPE_ALIGN_VAR(16) struct fixed_position position;
-
-   calc_fixed_position(setup, &position, v0, v1, v2);
-
-   if (position.area > 0)
-      retry_triangle_ccw(setup, &position, v0, v1, v2, setup->ccw_is_frontface);
+   if (position->area > 0)
+      retry_triangle_ccw(setup, position, v0, v1, v2, setup->ccw_is_frontface);
+   else {
+      LP_COUNT(nr_culled_tris);
+      setup->hud.num_tris_culled++;
+   }
 }
 
-/**
- * Draw triangle whether it's CW or CCW.
- */
-static void triangle_both(struct lp_setup_context *setup,
-                          const float (*v0)[4],
-                          const float (*v1)[4],
-                          const float (*v2)[4])
+
+static inline void
+draw_triangle_both(struct lp_setup_context *setup,
+                   struct fixed_position *position,
+                   const float (*v0)[4],
+                   const float (*v1)[4],
+                   const float (*v2)[4])
 {
-   PIPE_ALIGN_VAR(16) struct fixed_position position;
    struct llvmpipe_context *lp_context = (struct llvmpipe_context *)setup->pipe;
 
    if (lp_context->active_statistics_queries &&
@@ -1163,8 +1241,6 @@ static void triangle_both(struct lp_setup_context *setup,
       lp_context->pipeline_statistics.c_primitives++;
    }
 
-   calc_fixed_position(setup, &position, v0, v1, v2);
-
    if (0) {
       assert(!util_is_inf_or_nan(v0[0][0]));
       assert(!util_is_inf_or_nan(v0[0][1]));
@@ -1174,25 +1250,80 @@ static void triangle_both(struct lp_setup_context *setup,
       assert(!util_is_inf_or_nan(v2[0][1]));
    }
 
-   if (position.area > 0)
-      retry_triangle_ccw( setup, &position, v0, v1, v2, setup->ccw_is_frontface );
-   else if (position.area < 0) {
+   if (position->area > 0)
+      retry_triangle_ccw( setup, position, v0, v1, v2, setup->ccw_is_frontface );
+   else if (position->area < 0) {
       if (setup->flatshade_first) {
-         rotate_fixed_position_12( &position );
-         retry_triangle_ccw( setup, &position, v0, v2, v1, !setup->ccw_is_frontface );
+         rotate_fixed_position_12( position );
+         retry_triangle_ccw( setup, position, v0, v2, v1, !setup->ccw_is_frontface );
       } else {
-         rotate_fixed_position_01( &position );
-         retry_triangle_ccw( setup, &position, v1, v0, v2, !setup->ccw_is_frontface );
+         rotate_fixed_position_01( position );
+         retry_triangle_ccw( setup, position, v1, v0, v2, !setup->ccw_is_frontface );
       }
    }
+   else {
+      /* zero area */
+      LP_COUNT(nr_culled_tris);
+      setup->hud.num_tris_culled++;
+   }
+}
+
+
+/**
+ * Generate the single triangle and the batched triangle entry points
+ * for each of the cull modes.
+ */
+#define TRIANGLE_FUNCS(name)                                            \
+static void triangle_##name(struct lp_setup_context *setup,            \
+                            const float (*v0)[4],                       \
+                            const float (*v1)[4],                       \
+                            const float (*v2)[4])                       \
+{                                                                       \
+   PIPE_ALIGN_VAR(16) struct fixed_position position;                   \
+                                                                        \
+   calc_fixed_position(setup, &position, v0, v1, v2);                   \
+   draw_triangle_##name(setup, &position, v0, v1, v2);                  \
+}                                                                       \
+                                                                        \
+static void triangles_##name(struct lp_setup_context *setup,           \
+                             const float (*const *v)[4],                \
+                             unsigned nr)                               \
+{                                                                       \
+   PIPE_ALIGN_VAR(16) struct fixed_position position[LP_SETUP_TRI_BATCH]; \
+   unsigned i, j;                                                       \
+                                                                        \
+   for (i = 0; i < nr; i += LP_SETUP_TRI_BATCH) {                       \
+      unsigned count = MIN2(nr - i, LP_SETUP_TRI_BATCH);                \
+                                                                        \
+      calc_fixed_positions(setup, position, &v[i * 3], count);          \
+      for (j = 0; j < count; j++) {                                     \
+         const float (*const *tv)[4] = &v[(i + j) * 3];                 \
+         draw_triangle_##name(setup, &position[j], tv[0], tv[1], tv[2]); \
+      }                                                                 \
+   }                                                                    \
 }
 
+TRIANGLE_FUNCS(cw)
+TRIANGLE_FUNCS(ccw)
+TRIANGLE_FUNCS(both)
+
 
 static void triangle_nop( struct lp_setup_context *setup,
 			  const float (*v0)[4],
 			  const float (*v1)[4],
 			  const float (*v2)[4] )
 {
+   LP_COUNT(nr_culled_tris);
+   setup->hud.num_tris_culled++;
+}
+
+
+static void triangles_nop( struct lp_setup_context *setup,
+                           const float (*const *v)[4],
+                           unsigned nr )
+{
+   LP_COUNT_ADD(nr_culled_tris, nr);
+   setup->hud.num_tris_culled += nr;
 }
 
 
@@ -1202,15 +1333,19 @@ lp_setup_choose_triangle( struct lp_setup_context *setup )
    switch (setup->cullmode) {
    case PIPE_FACE_NONE:
       setup->triangle = triangle_both;
+      setup->triangles = triangles_both;
       break;
    case PIPE_FACE_BACK:
       setup->triangle = setup->ccw_is_frontface ? triangle_ccw : triangle_cw;
+      setup->triangles = setup->ccw_is_frontface ? triangles_ccw : triangles_cw;
       break;
    case PIPE_FACE_FRONT:
       setup->triangle = setup->ccw_is_frontface ? triangle_cw : triangle_ccw;
+      setup->triangles = setup->ccw_is_frontface ? triangles_cw : triangles_ccw;
       break;
    default:
       setup->triangle = triangle_nop;
+      setup->triangles = triangles_nop;
       break;
    }
 }
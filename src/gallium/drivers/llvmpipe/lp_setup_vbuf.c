@@ -184,11 +184,16 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
       break;
 
    case PIPE_PRIM_TRIANGLES:
-      for (i = 2; i < nr; i += 3) {
-         setup->triangle( setup,
-                          get_vert(vertex_buffer, indices[i-2], stride),
-                          get_vert(vertex_buffer, indices[i-1], stride),
-                          get_vert(vertex_buffer, indices[i-0], stride) );
+      for (i = 2; i < nr; ) {
+         const float (*v[3 * LP_SETUP_TRI_BATCH])[4];
+         unsigned n;
+
+         for (n = 0; n < LP_SETUP_TRI_BATCH && i < nr; n++, i += 3) {
+            v[n * 3 + 0] = get_vert(vertex_buffer, indices[i-2], stride);
+            v[n * 3 + 1] = get_vert(vertex_buffer, indices[i-1], stride);
+            v[n * 3 + 2] = get_vert(vertex_buffer, indices[i-0], stride);
+         }
+         setup->triangles( setup, v, n );
       }
       break;
 
@@ -382,11 +387,16 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
       break;
 
    case PIPE_PRIM_TRIANGLES:
-      for (i = 2; i < nr; i += 3) {
-         setup->triangle( setup,
-                          get_vert(vertex_buffer, i-2, stride),
-                          get_vert(vertex_buffer, i-1, stride),
-                          get_vert(vertex_buffer, i-0, stride) );
+      for (i = 2; i < nr; ) {
+         const float (*v[3 * LP_SETUP_TRI_BATCH])[4];
+         unsigned n;
+
+         for (n = 0; n < LP_SETUP_TRI_BATCH && i < nr; n++, i += 3) {
+            v[n * 3 + 0] = get_vert(vertex_buffer, i-2, stride);
+            v[n * 3 + 1] = get_vert(vertex_buffer, i-1, stride);
+            v[n * 3 + 2] = get_vert(vertex_buffer, i-0, stride);
+         }
+         setup->triangles( setup, v, n );
       }
       break;
 
@@ -3206,6 +3206,8 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       dt = t1 - t0;
       LP_COUNT_ADD(llvm_compile_time, dt);
       LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+      lp->hud.num_fs_variants_compiled++;
+      lp->hud.fs_compile_time += dt;
 
       /* Put the new variant into the list */
       if (variant) {
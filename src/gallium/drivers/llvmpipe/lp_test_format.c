@@ -420,9 +420,147 @@ test_some(unsigned verbose, FILE *fp,
 }
 
 
+/*
+ * Sampling benchmark for the texel block cache.
+ *
+ * Fetches every texel of a random block-compressed texture with a 2x2
+ * (bilinear) footprint, once bypassing and once through the cache, and
+ * reports the cost per fetched texel.
+ */
+
+#define BENCH_TEX_SIZE 256
+
+static double
+bench_fetch(fetch_ptr_t fetch_ptr,
+            const struct util_format_description *desc,
+            const uint8_t *packed,
+            struct lp_build_format_cache *cache)
+{
+   const unsigned block_size = desc->block.bits / 8;
+   const unsigned blocks_per_row = BENCH_TEX_SIZE / desc->block.width;
+   uint8_t unpacked[4];
+   int64_t start_counter, end_counter;
+   unsigned x, y, k;
+
+   if (cache) {
+      memset(cache->cache_tags, 0, sizeof(cache->cache_tags));
+   }
+
+   start_counter = rdtsc();
+   for (y = 0; y < BENCH_TEX_SIZE; ++y) {
+      for (x = 0; x < BENCH_TEX_SIZE; ++x) {
+         for (k = 0; k < 4; ++k) {
+            unsigned tx = MIN2(x + (k & 1), BENCH_TEX_SIZE - 1);
+            unsigned ty = MIN2(y + (k >> 1), BENCH_TEX_SIZE - 1);
+            const uint8_t *block = packed +
+               ((ty / desc->block.height) * blocks_per_row +
+                tx / desc->block.width) * block_size;
+
+            fetch_ptr(unpacked, block,
+                      tx % desc->block.width, ty % desc->block.height,
+                      cache);
+         }
+      }
+   }
+   end_counter = rdtsc();
+
+   return (double)(end_counter - start_counter) /
+          (BENCH_TEX_SIZE * BENCH_TEX_SIZE * 4);
+}
+
+
+PIPE_ALIGN_STACK
+static void
+bench_format(unsigned verbose, FILE *fp,
+             const struct util_format_description *desc,
+             struct lp_build_format_cache *cache)
+{
+   LLVMContextRef context;
+   struct gallivm_state *gallivm;
+   LLVMValueRef fetch, fetch_cached;
+   fetch_ptr_t fetch_ptr, fetch_cached_ptr;
+   struct lp_build_format_cache *saved_cache_ptr = cache_ptr;
+   uint8_t *packed;
+   unsigned size, i;
+   double uncached, cached;
+
+   size = util_format_get_2d_size(desc->format,
+                                  util_format_get_stride(desc->format,
+                                                         BENCH_TEX_SIZE),
+                                  BENCH_TEX_SIZE);
+   packed = align_malloc(size, 16);
+   for (i = 0; i < size; ++i) {
+      packed[i] = rand();
+   }
+
+   context = LLVMContextCreate();
+   gallivm = gallivm_create("bench_module_unorm8", context);
+
+   /* add_fetch_rgba_test() only wires up the cache when cache_ptr is set */
+   cache_ptr = NULL;
+   fetch = add_fetch_rgba_test(gallivm, verbose, desc, lp_unorm8_vec4_type());
+   cache_ptr = cache;
+   fetch_cached = add_fetch_rgba_test(gallivm, verbose, desc,
+                                      lp_unorm8_vec4_type());
+   cache_ptr = saved_cache_ptr;
+
+   gallivm_compile_module(gallivm);
+
+   fetch_ptr = (fetch_ptr_t) gallivm_jit_function(gallivm, fetch);
+   fetch_cached_ptr = (fetch_ptr_t) gallivm_jit_function(gallivm, fetch_cached);
+
+   gallivm_free_ir(gallivm);
+
+   uncached = bench_fetch(fetch_ptr, desc, packed, NULL);
+   cached = bench_fetch(fetch_cached_ptr, desc, packed, cache);
+
+   printf("%-24s %8.1f cycles/texel uncached %8.1f cycles/texel cached\n",
+          desc->short_name, uncached, cached);
+#if LP_BUILD_FORMAT_CACHE_DEBUG
+   if (cache->cache_access_total[desc->format]) {
+      printf("%-24s hit rate %f\n", desc->short_name,
+             (float)(cache->cache_access_total[desc->format] -
+                     cache->cache_access_miss[desc->format]) /
+             (float)cache->cache_access_total[desc->format]);
+   }
+#endif
+   fflush(stdout);
+
+   gallivm_destroy(gallivm);
+   LLVMContextDispose(context);
+
+   align_free(packed);
+}
+
+
 boolean
 test_single(unsigned verbose, FILE *fp)
 {
-   printf("no test_single()");
+   struct lp_build_format_cache *cache;
+   enum pipe_format format;
+
+   util_format_s3tc_init();
+
+   cache = align_malloc(sizeof(struct lp_build_format_cache), 16);
+   memset(cache, 0, sizeof *cache);
+
+   for (format = 1; format < PIPE_FORMAT_COUNT; ++format) {
+      const struct util_format_description *format_desc;
+
+      format_desc = util_format_description(format);
+      if (!format_desc || !lp_build_format_cacheable(format_desc)) {
+         continue;
+      }
+
+      if (format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC &&
+          !util_format_s3tc_enabled) {
+         continue;
+      }
+
+      bench_format(verbose, fp, format_desc, cache);
+   }
+
+   align_free(cache);
+
    return TRUE;
 }
@@ -239,13 +239,13 @@ trace_dump_trace_close(void)
 
 
 static void
-trace_dump_call_time(int64_t time)
+trace_dump_call_time(const char *name, int64_t time)
 {
    if (stream) {
       trace_dump_indent(2);
-      trace_dump_tag_begin("time");
+      trace_dump_tag_begin(name);
       trace_dump_int(time);
-      trace_dump_tag_end("time");
+      trace_dump_tag_end(name);
       trace_dump_newline();
    }
 }
@@ -358,11 +358,24 @@ boolean trace_dumping_enabled(void)
 
 static int64_t call_start_time = 0;
 
+/* Time at which the previous call returned to the caller, and the time
+ * the caller spent until making the current call.  The latter is the
+ * state tracker's (and application's) CPU time, which is all that is
+ * left when wrapping a noop driver.
+ */
+static int64_t last_call_end_time = 0;
+static int64_t caller_time = -1;
+
 void trace_dump_call_begin_locked(const char *klass, const char *method)
 {
+   int64_t now;
+
    if (!dumping)
       return;
 
+   now = os_time_get();
+   caller_time = last_call_end_time ? now - last_call_end_time : -1;
+
    ++call_no;
    trace_dump_indent(1);
    trace_dump_writes("<call no=\'");
@@ -386,11 +399,15 @@ void trace_dump_call_end_locked(void)
 
    call_end_time = os_time_get();
 
-   trace_dump_call_time(call_end_time - call_start_time);
+   trace_dump_call_time("time", call_end_time - call_start_time);
+   if (caller_time >= 0)
+      trace_dump_call_time("caller_time", caller_time);
    trace_dump_indent(1);
    trace_dump_tag_end("call");
    trace_dump_newline();
    fflush(stream);
+
+   last_call_end_time = os_time_get();
 }
 
 void trace_dump_call_begin(const char *klass, const char *method)
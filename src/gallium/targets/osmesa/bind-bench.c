@@ -0,0 +1,317 @@
+/**************************************************************************
+ *
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Object bind CPU overhead benchmark.
+ *
+ * Binds textures, buffers and vertex arrays out of a set of many objects
+ * in a pseudo-random order and reports the binds per second.  Nothing is
+ * drawn, so the time is spent in the GL API, the object name lookups and
+ * the state updates the binds trigger.  The "-sparse" scenarios use large,
+ * scattered names instead of the dense ones glGen*() returns.
+ *
+ * Usage: bind-bench [-n binds] [scenario ...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "GL/osmesa.h"
+#include "GL/glext.h"
+
+
+#define WIDTH 64
+#define HEIGHT 64
+#define NUM_NAMES 4096
+#define NUM_WARMUP 1000
+
+
+#define GL_FUNCTIONS(F) \
+   F(PFNGLBINDBUFFERPROC, glBindBuffer) \
+   F(PFNGLBINDVERTEXARRAYPROC, glBindVertexArray) \
+   F(PFNGLDELETEBUFFERSPROC, glDeleteBuffers) \
+   F(PFNGLDELETEVERTEXARRAYSPROC, glDeleteVertexArrays) \
+   F(PFNGLGENBUFFERSPROC, glGenBuffers) \
+   F(PFNGLGENVERTEXARRAYSPROC, glGenVertexArrays)
+
+#define DECLARE_FUNCTION(type, name) static type p_##name;
+GL_FUNCTIONS(DECLARE_FUNCTION)
+
+
+struct bench
+{
+   OSMesaContext ctx;
+   GLubyte *buffer;
+
+   GLuint names[NUM_NAMES];
+};
+
+
+static void
+fail(const char *msg)
+{
+   fprintf(stderr, "bind-bench: %s\n", msg);
+   exit(1);
+}
+
+
+/**
+ * Names that glGen*() won't return, spread over the whole name space.
+ */
+static void
+make_sparse_names(struct bench *b)
+{
+   unsigned i;
+
+   for (i = 0; i < NUM_NAMES; i++)
+      b->names[i] = (i * 2654435761u) | 0x10000000u;
+}
+
+
+static void
+init_textures(struct bench *b, GLboolean sparse)
+{
+   unsigned i;
+
+   if (sparse)
+      make_sparse_names(b);
+   else
+      glGenTextures(NUM_NAMES, b->names);
+
+   for (i = 0; i < NUM_NAMES; i++)
+      glBindTexture(GL_TEXTURE_2D, b->names[i]);
+}
+
+static void
+init_dense_textures(struct bench *b)
+{
+   init_textures(b, GL_FALSE);
+}
+
+static void
+init_sparse_textures(struct bench *b)
+{
+   init_textures(b, GL_TRUE);
+}
+
+static void
+bind_texture(struct bench *b, GLuint name)
+{
+   glBindTexture(GL_TEXTURE_2D, name);
+}
+
+static void
+fini_textures(struct bench *b)
+{
+   glDeleteTextures(NUM_NAMES, b->names);
+}
+
+
+static void
+init_buffers(struct bench *b, GLboolean sparse)
+{
+   unsigned i;
+
+   if (sparse)
+      make_sparse_names(b);
+   else
+      p_glGenBuffers(NUM_NAMES, b->names);
+
+   for (i = 0; i < NUM_NAMES; i++)
+      p_glBindBuffer(GL_ARRAY_BUFFER, b->names[i]);
+}
+
+static void
+init_dense_buffers(struct bench *b)
+{
+   init_buffers(b, GL_FALSE);
+}
+
+static void
+init_sparse_buffers(struct bench *b)
+{
+   init_buffers(b, GL_TRUE);
+}
+
+static void
+bind_buffer(struct bench *b, GLuint name)
+{
+   p_glBindBuffer(GL_ARRAY_BUFFER, name);
+}
+
+static void
+fini_buffers(struct bench *b)
+{
+   p_glDeleteBuffers(NUM_NAMES, b->names);
+}
+
+
+static void
+init_vaos(struct bench *b)
+{
+   p_glGenVertexArrays(NUM_NAMES, b->names);
+}
+
+static void
+bind_vao(struct bench *b, GLuint name)
+{
+   p_glBindVertexArray(name);
+}
+
+static void
+fini_vaos(struct bench *b)
+{
+   p_glBindVertexArray(0);
+   p_glDeleteVertexArrays(NUM_NAMES, b->names);
+}
+
+
+static const struct {
+   const char *name;
+   void (*init)(struct bench *b);
+   void (*bind)(struct bench *b, GLuint name);
+   void (*fini)(struct bench *b);
+} scenarios[] = {
+   { "texture", init_dense_textures, bind_texture, fini_textures },
+   { "texture-sparse", init_sparse_textures, bind_texture, fini_textures },
+   { "buffer", init_dense_buffers, bind_buffer, fini_buffers },
+   { "buffer-sparse", init_sparse_buffers, bind_buffer, fini_buffers },
+   { "vao", init_vaos, bind_vao, fini_vaos },
+};
+
+
+static double
+get_time(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void
+init_bench(struct bench *b)
+{
+   b->ctx = OSMesaCreateContextExt(OSMESA_RGBA, 24, 0, 0, NULL);
+   if (!b->ctx)
+      fail("couldn't create an OSMesa context");
+
+   b->buffer = malloc(WIDTH * HEIGHT * 4);
+   if (!b->buffer ||
+       !OSMesaMakeCurrent(b->ctx, b->buffer, GL_UNSIGNED_BYTE, WIDTH, HEIGHT))
+      fail("couldn't make the context current");
+
+#define GET_FUNCTION(type, name) \
+   p_##name = (type) OSMesaGetProcAddress(#name); \
+   if (!p_##name) \
+      fail("missing " #name);
+   GL_FUNCTIONS(GET_FUNCTION)
+#undef GET_FUNCTION
+}
+
+
+static void
+destroy_bench(struct bench *b)
+{
+   OSMesaDestroyContext(b->ctx);
+   free(b->buffer);
+}
+
+
+static void
+run_scenario(unsigned s, unsigned num_binds)
+{
+   struct bench b;
+   double start, secs;
+   unsigned i, index = 0;
+
+   memset(&b, 0, sizeof(b));
+   init_bench(&b);
+   scenarios[s].init(&b);
+   if (glGetError() != GL_NO_ERROR)
+      fail("GL error during setup");
+
+   for (i = 0; i < NUM_WARMUP; i++)
+      scenarios[s].bind(&b, b.names[i % NUM_NAMES]);
+
+   start = get_time();
+   for (i = 0; i < num_binds; i++) {
+      /* a full-period LCG, so that consecutive binds use different names */
+      index = (index * 1664525u + 1013904223u) % NUM_NAMES;
+      scenarios[s].bind(&b, b.names[index]);
+   }
+   glFinish();
+   secs = get_time() - start;
+
+   if (glGetError() != GL_NO_ERROR)
+      fail("GL error during the binds");
+
+   printf("%-15s %10.0f binds/s %8.1f ns/bind\n", scenarios[s].name,
+          num_binds / secs, secs * 1e9 / num_binds);
+   fflush(stdout);
+
+   scenarios[s].fini(&b);
+   destroy_bench(&b);
+}
+
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_binds = 2000000;
+   unsigned s;
+   int i, selected = 0;
+
+   for (i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+         num_binds = atoi(argv[++i]);
+         if (!num_binds)
+            fail("invalid number of binds");
+      }
+      else {
+         selected++;
+      }
+   }
+
+   for (s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+      int run = !selected;
+
+      for (i = 1; i < argc; i++) {
+         if (strcmp(argv[i], "-n") == 0)
+            i++;
+         else if (strcmp(argv[i], scenarios[s].name) == 0)
+            run = 1;
+      }
+
+      if (run)
+         run_scenario(s, num_binds);
+   }
+
+   return 0;
+}
@@ -0,0 +1,421 @@
+/**************************************************************************
+ *
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Display list playback test.
+ *
+ * Compiles strips, fans, polygons, quads, line strips and loops into one
+ * display list, which vbo_save draws as decomposed, indexed points, lines
+ * and triangles when that gives the same result.  Each case sets up some
+ * state and checks that calling the list renders the same image, or
+ * returns the same feedback buffer, as the same calls made in immediate
+ * mode.  The "draw-arrays-current" case checks that a glColor call after
+ * glDrawArrays in a list isn't dropped, as drawing arrays from a list
+ * doesn't change the current color.
+ *
+ * Usage: dlist-test [case ...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "GL/osmesa.h"
+#include "GL/glext.h"
+
+
+#define WIDTH 64
+#define HEIGHT 64
+#define FEEDBACK_SIZE 8192
+
+/* one bit of rounding difference from the triangle vertex order */
+#define TOLERANCE 1
+
+
+static PFNGLPROVOKINGVERTEXEXTPROC p_glProvokingVertexEXT;
+
+
+static void
+fail(const char *msg)
+{
+   fprintf(stderr, "dlist-test: %s\n", msg);
+   exit(1);
+}
+
+
+static void
+vertex(unsigned *n, GLfloat x, GLfloat y)
+{
+   const unsigned i = (*n)++;
+
+   glColor3ub((i * 53) & 255, (i * 97 + 40) & 255, (i * 29 + 128) & 255);
+   glVertex2f(x, y);
+}
+
+
+/**
+ * Primitives that merge_prims() can't join, in one vertex list: the
+ * polygons and strips first, then the lines.
+ */
+static void
+draw_scene(void)
+{
+   unsigned n = 0, i;
+
+   glBegin(GL_TRIANGLE_STRIP);
+   for (i = 0; i < 6; i++)
+      vertex(&n, 4.0f + 6.0f * (i / 2), 4.0f + 10.0f * (i & 1));
+   glEnd();
+
+   glBegin(GL_TRIANGLE_FAN);
+   vertex(&n, 30.0f, 9.0f);
+   vertex(&n, 38.0f, 4.0f);
+   vertex(&n, 40.0f, 12.0f);
+   vertex(&n, 34.0f, 16.0f);
+   vertex(&n, 26.0f, 16.0f);
+   vertex(&n, 22.0f, 10.0f);
+   glEnd();
+
+   glBegin(GL_POLYGON);
+   vertex(&n, 46.0f, 9.0f);
+   vertex(&n, 49.0f, 4.0f);
+   vertex(&n, 55.0f, 4.0f);
+   vertex(&n, 58.0f, 9.0f);
+   vertex(&n, 55.0f, 14.0f);
+   vertex(&n, 49.0f, 14.0f);
+   glEnd();
+
+   glBegin(GL_QUADS);
+   vertex(&n, 4.0f, 20.0f);
+   vertex(&n, 14.0f, 20.0f);
+   vertex(&n, 14.0f, 30.0f);
+   vertex(&n, 4.0f, 30.0f);
+   vertex(&n, 18.0f, 20.0f);
+   vertex(&n, 28.0f, 22.0f);
+   vertex(&n, 26.0f, 30.0f);
+   vertex(&n, 18.0f, 30.0f);
+   glEnd();
+
+   glBegin(GL_QUAD_STRIP);
+   for (i = 0; i < 6; i++)
+      vertex(&n, 32.0f + 6.0f * (i / 2), 20.0f + 10.0f * (i & 1));
+   glEnd();
+
+   /* back facing */
+   glBegin(GL_POLYGON);
+   vertex(&n, 50.0f, 20.0f);
+   vertex(&n, 50.0f, 30.0f);
+   vertex(&n, 60.0f, 30.0f);
+   vertex(&n, 60.0f, 20.0f);
+   glEnd();
+
+   glBegin(GL_LINE_STRIP);
+   vertex(&n, 4.0f, 40.0f);
+   vertex(&n, 20.0f, 44.0f);
+   vertex(&n, 36.0f, 38.0f);
+   vertex(&n, 60.0f, 46.0f);
+   glEnd();
+
+   glBegin(GL_LINE_LOOP);
+   vertex(&n, 4.0f, 50.0f);
+   vertex(&n, 30.0f, 50.0f);
+   vertex(&n, 30.0f, 60.0f);
+   vertex(&n, 4.0f, 60.0f);
+   glEnd();
+
+   glBegin(GL_LINE_STRIP);
+   vertex(&n, 36.0f, 52.0f);
+   vertex(&n, 60.0f, 58.0f);
+   vertex(&n, 40.0f, 62.0f);
+   glEnd();
+}
+
+
+static void
+init_smooth(void)
+{
+}
+
+static void
+init_flat_last(void)
+{
+   glShadeModel(GL_FLAT);
+}
+
+static void
+init_flat_first(void)
+{
+   glShadeModel(GL_FLAT);
+   p_glProvokingVertexEXT(GL_FIRST_VERTEX_CONVENTION_EXT);
+}
+
+static void
+init_polygon_line(void)
+{
+   glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+}
+
+static void
+init_polygon_back_point(void)
+{
+   glPolygonMode(GL_BACK, GL_POINT);
+}
+
+static void
+init_stipple(void)
+{
+   glLineStipple(3, 0x0f0f);
+   glEnable(GL_LINE_STIPPLE);
+}
+
+
+static void
+reset_state(void)
+{
+   glShadeModel(GL_SMOOTH);
+   p_glProvokingVertexEXT(GL_LAST_VERTEX_CONVENTION_EXT);
+   glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+   glDisable(GL_LINE_STIPPLE);
+}
+
+
+static const struct {
+   const char *name;
+   void (*init)(void);
+   GLboolean feedback;
+} cases[] = {
+   { "smooth", init_smooth, GL_FALSE },
+   { "flat-last", init_flat_last, GL_FALSE },
+   { "flat-first", init_flat_first, GL_FALSE },
+   { "polygon-line", init_polygon_line, GL_FALSE },
+   { "polygon-back-point", init_polygon_back_point, GL_FALSE },
+   { "stipple", init_stipple, GL_FALSE },
+   { "feedback", init_smooth, GL_TRUE },
+   { "feedback-flat", init_flat_last, GL_TRUE },
+};
+
+
+/**
+ * Render with the list or in immediate mode.
+ * \return the number of feedback values, or 0 when not in feedback mode
+ */
+static GLint
+render(unsigned c, GLuint list, GLfloat *feedback)
+{
+   glClear(GL_COLOR_BUFFER_BIT);
+
+   if (cases[c].feedback) {
+      glFeedbackBuffer(FEEDBACK_SIZE, GL_3D_COLOR, feedback);
+      glRenderMode(GL_FEEDBACK);
+   }
+
+   if (list)
+      glCallList(list);
+   else
+      draw_scene();
+
+   glFinish();
+
+   return cases[c].feedback ? glRenderMode(GL_RENDER) : 0;
+}
+
+
+/**
+ * \return true if the current color is set by the glColor call following
+ * the glDrawArrays call in a list, when the last array color is the same.
+ */
+static GLboolean
+run_draw_arrays_current_case(void)
+{
+   static const GLfloat verts[] = { 4, 4, 12, 4, 8, 12 };
+   static const GLfloat colors[] = { 0, 0, 1, 0, 1, 0, 1, 0, 0 };
+   GLfloat color[4];
+   GLuint list;
+   GLboolean pass;
+
+   reset_state();
+
+   glVertexPointer(2, GL_FLOAT, 0, verts);
+   glColorPointer(3, GL_FLOAT, 0, colors);
+   glEnableClientState(GL_VERTEX_ARRAY);
+   glEnableClientState(GL_COLOR_ARRAY);
+
+   list = glGenLists(1);
+   glNewList(list, GL_COMPILE);
+   glDrawArrays(GL_TRIANGLES, 0, 3);
+   glColor3f(1.0f, 0.0f, 0.0f);
+   glEndList();
+
+   glDisableClientState(GL_COLOR_ARRAY);
+   glDisableClientState(GL_VERTEX_ARRAY);
+
+   glColor3f(0.0f, 1.0f, 0.0f);
+   glCallList(list);
+   glGetFloatv(GL_CURRENT_COLOR, color);
+   glDeleteLists(list, 1);
+
+   if (glGetError() != GL_NO_ERROR)
+      fail("GL error while drawing arrays");
+
+   pass = color[0] == 1.0f && color[1] == 0.0f && color[2] == 0.0f;
+   printf("%-20s %s (current color %g %g %g)\n", "draw-arrays-current",
+          pass ? "pass" : "FAIL", color[0], color[1], color[2]);
+   fflush(stdout);
+
+   return pass;
+}
+
+
+static GLboolean
+is_selected(int argc, char **argv, const char *name)
+{
+   int i;
+
+   if (argc == 1)
+      return GL_TRUE;
+
+   for (i = 1; i < argc; i++) {
+      if (strcmp(argv[i], name) == 0)
+         return GL_TRUE;
+   }
+
+   return GL_FALSE;
+}
+
+
+static unsigned
+count_different_pixels(const GLubyte *a, const GLubyte *b)
+{
+   unsigned i, chan, count = 0;
+
+   for (i = 0; i < WIDTH * HEIGHT; i++) {
+      for (chan = 0; chan < 4; chan++) {
+         if (abs(a[i * 4 + chan] - b[i * 4 + chan]) > TOLERANCE) {
+            count++;
+            break;
+         }
+      }
+   }
+
+   return count;
+}
+
+
+/**
+ * \return true if the case passed
+ */
+static GLboolean
+run_case(unsigned c, GLuint list, GLubyte *buffer)
+{
+   static GLubyte expected_image[WIDTH * HEIGHT * 4];
+   static GLfloat expected_feedback[FEEDBACK_SIZE], feedback[FEEDBACK_SIZE];
+   GLint expected_count, count;
+   GLboolean pass;
+
+   reset_state();
+   cases[c].init();
+
+   expected_count = render(c, 0, expected_feedback);
+   memcpy(expected_image, buffer, sizeof expected_image);
+
+   count = render(c, list, feedback);
+
+   if (glGetError() != GL_NO_ERROR)
+      fail("GL error while drawing");
+
+   if (cases[c].feedback) {
+      pass = count > 0 && count == expected_count &&
+             memcmp(feedback, expected_feedback,
+                    count * sizeof(GLfloat)) == 0;
+      printf("%-20s %s (%d and %d feedback values)\n", cases[c].name,
+             pass ? "pass" : "FAIL", count, expected_count);
+   }
+   else {
+      const unsigned different =
+         count_different_pixels(buffer, expected_image);
+
+      pass = different == 0;
+      printf("%-20s %s (%u pixels differ)\n", cases[c].name,
+             pass ? "pass" : "FAIL", different);
+   }
+   fflush(stdout);
+
+   return pass;
+}
+
+
+int
+main(int argc, char **argv)
+{
+   OSMesaContext ctx;
+   GLubyte *buffer;
+   GLuint list;
+   unsigned c;
+   int failures = 0;
+
+   ctx = OSMesaCreateContextExt(OSMESA_RGBA, 0, 0, 0, NULL);
+   if (!ctx)
+      fail("couldn't create an OSMesa context");
+
+   buffer = malloc(WIDTH * HEIGHT * 4);
+   if (!buffer ||
+       !OSMesaMakeCurrent(ctx, buffer, GL_UNSIGNED_BYTE, WIDTH, HEIGHT))
+      fail("couldn't make the context current");
+
+   p_glProvokingVertexEXT = (PFNGLPROVOKINGVERTEXEXTPROC)
+      OSMesaGetProcAddress("glProvokingVertexEXT");
+   if (!p_glProvokingVertexEXT)
+      fail("missing glProvokingVertexEXT");
+
+   glViewport(0, 0, WIDTH, HEIGHT);
+   glMatrixMode(GL_PROJECTION);
+   glLoadIdentity();
+   glOrtho(0.0, WIDTH, 0.0, HEIGHT, -1.0, 1.0);
+   glMatrixMode(GL_MODELVIEW);
+   glLoadIdentity();
+
+   list = glGenLists(1);
+   glNewList(list, GL_COMPILE);
+   draw_scene();
+   glEndList();
+
+   for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+      if (is_selected(argc, argv, cases[c].name) &&
+          !run_case(c, list, buffer))
+         failures++;
+   }
+
+   glDeleteLists(list, 1);
+
+   if (is_selected(argc, argv, "draw-arrays-current") &&
+       !run_draw_arrays_current_case())
+      failures++;
+   OSMesaDestroyContext(ctx);
+   free(buffer);
+
+   return failures ? 1 : 0;
+}
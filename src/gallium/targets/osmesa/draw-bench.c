@@ -0,0 +1,357 @@
+/**************************************************************************
+ *
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Draw call CPU overhead benchmark.
+ *
+ * Renders many tiny triangles through OSMesa with a different kind of
+ * state change between consecutive draws and reports the draws per second
+ * for each scenario.  The triangles hardly cover any pixels, so with
+ * llvmpipe or softpipe (GALLIUM_DRIVER=...) the time is dominated by the
+ * GL API, the Mesa core, the state tracker and the driver's CPU work.
+ *
+ * Each scenario runs in a fresh context.  Run with ST_DRAW_STATS=1 to
+ * have the state tracker print how much of every draw was spent in
+ * st_validate_state() (the atoms) and in the driver when the context is
+ * destroyed; the rest of the time per draw reported here is spent in the
+ * GL API and the Mesa core validation.
+ *
+ * Usage: draw-bench [-n draws] [scenario ...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "GL/osmesa.h"
+#include "GL/glext.h"
+
+
+#define WIDTH 64
+#define HEIGHT 64
+#define NUM_WARMUP 1000
+#define NUM_INSTANCES 16
+
+
+#define GL_FUNCTIONS(F) \
+   F(PFNGLATTACHSHADERPROC, glAttachShader) \
+   F(PFNGLBINDBUFFERPROC, glBindBuffer) \
+   F(PFNGLBINDVERTEXARRAYPROC, glBindVertexArray) \
+   F(PFNGLBUFFERDATAPROC, glBufferData) \
+   F(PFNGLCOMPILESHADERPROC, glCompileShader) \
+   F(PFNGLCREATEPROGRAMPROC, glCreateProgram) \
+   F(PFNGLCREATESHADERPROC, glCreateShader) \
+   F(PFNGLDRAWARRAYSINSTANCEDPROC, glDrawArraysInstanced) \
+   F(PFNGLENABLEVERTEXATTRIBARRAYPROC, glEnableVertexAttribArray) \
+   F(PFNGLGENBUFFERSPROC, glGenBuffers) \
+   F(PFNGLGENVERTEXARRAYSPROC, glGenVertexArrays) \
+   F(PFNGLGETPROGRAMIVPROC, glGetProgramiv) \
+   F(PFNGLGETUNIFORMLOCATIONPROC, glGetUniformLocation) \
+   F(PFNGLLINKPROGRAMPROC, glLinkProgram) \
+   F(PFNGLSHADERSOURCEPROC, glShaderSource) \
+   F(PFNGLUNIFORM1IPROC, glUniform1i) \
+   F(PFNGLUNIFORM4FPROC, glUniform4f) \
+   F(PFNGLUSEPROGRAMPROC, glUseProgram) \
+   F(PFNGLVERTEXATTRIBPOINTERPROC, glVertexAttribPointer)
+
+#define DECLARE_FUNCTION(type, name) static type p_##name;
+GL_FUNCTIONS(DECLARE_FUNCTION)
+
+
+static const char *vs_source =
+   "#version 130\n"
+   "in vec4 pos;\n"
+   "out vec2 coord;\n"
+   "void main() {\n"
+   "   coord = pos.xy;\n"
+   "   gl_Position = pos;\n"
+   "}\n";
+
+static const char *fs_source[2] = {
+   "#version 130\n"
+   "uniform sampler2D tex;\n"
+   "uniform vec4 color;\n"
+   "in vec2 coord;\n"
+   "void main() {\n"
+   "   gl_FragColor = texture(tex, coord) * color;\n"
+   "}\n",
+
+   "#version 130\n"
+   "uniform sampler2D tex;\n"
+   "uniform vec4 color;\n"
+   "in vec2 coord;\n"
+   "void main() {\n"
+   "   gl_FragColor = texture(tex, coord) + color;\n"
+   "}\n"
+};
+
+
+struct bench
+{
+   OSMesaContext ctx;
+   GLubyte *buffer;
+
+   GLuint program[2];
+   GLint color_loc[2];
+   GLuint texture[2];
+   GLuint vao[2];
+   GLuint vbo[2];
+};
+
+
+static void
+draw_plain(struct bench *b, unsigned i)
+{
+   glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+static void
+draw_texture(struct bench *b, unsigned i)
+{
+   glBindTexture(GL_TEXTURE_2D, b->texture[i & 1]);
+   glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+static void
+draw_uniform(struct bench *b, unsigned i)
+{
+   p_glUniform4f(b->color_loc[0], (float)(i & 255) / 255.0f, 0.5f, 0.5f, 1.0f);
+   glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+static void
+draw_program(struct bench *b, unsigned i)
+{
+   p_glUseProgram(b->program[i & 1]);
+   glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+static void
+draw_vao(struct bench *b, unsigned i)
+{
+   p_glBindVertexArray(b->vao[i & 1]);
+   glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+static void
+draw_instanced(struct bench *b, unsigned i)
+{
+   p_glDrawArraysInstanced(GL_TRIANGLES, 0, 3, NUM_INSTANCES);
+}
+
+
+static const struct {
+   const char *name;
+   void (*draw)(struct bench *b, unsigned i);
+} scenarios[] = {
+   { "none", draw_plain },
+   { "texture", draw_texture },
+   { "uniform", draw_uniform },
+   { "program", draw_program },
+   { "vao", draw_vao },
+   { "instanced", draw_instanced },
+};
+
+
+static void
+fail(const char *msg)
+{
+   fprintf(stderr, "draw-bench: %s\n", msg);
+   exit(1);
+}
+
+
+static double
+get_time(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static GLuint
+compile_shader(GLenum type, const char *source)
+{
+   GLuint shader = p_glCreateShader(type);
+   p_glShaderSource(shader, 1, &source, NULL);
+   p_glCompileShader(shader);
+   return shader;
+}
+
+
+static void
+init_bench(struct bench *b)
+{
+   GLuint vs;
+   unsigned i;
+
+   b->ctx = OSMesaCreateContextExt(OSMESA_RGBA, 24, 0, 0, NULL);
+   if (!b->ctx)
+      fail("couldn't create an OSMesa context");
+
+   b->buffer = malloc(WIDTH * HEIGHT * 4);
+   if (!b->buffer ||
+       !OSMesaMakeCurrent(b->ctx, b->buffer, GL_UNSIGNED_BYTE, WIDTH, HEIGHT))
+      fail("couldn't make the context current");
+
+#define GET_FUNCTION(type, name) \
+   p_##name = (type) OSMesaGetProcAddress(#name); \
+   if (!p_##name) \
+      fail("missing " #name);
+   GL_FUNCTIONS(GET_FUNCTION)
+#undef GET_FUNCTION
+
+   vs = compile_shader(GL_VERTEX_SHADER, vs_source);
+
+   for (i = 0; i < 2; i++) {
+      static const GLubyte texels[2][4 * 4] = {
+         { 255, 0, 0, 255,  0, 255, 0, 255,  0, 0, 255, 255,  255, 255, 255, 255 },
+         { 0, 0, 0, 255,  255, 0, 255, 255,  0, 255, 255, 255,  255, 255, 0, 255 }
+      };
+      /* tiny triangles in different corners of the viewport */
+      const GLfloat x = i ? 0.5f : -1.0f;
+      const GLfloat verts[3][4] = {
+         { x, -1.0f, 0.0f, 1.0f },
+         { x + 0.05f, -1.0f, 0.0f, 1.0f },
+         { x, -0.95f, 0.0f, 1.0f }
+      };
+      GLint status;
+
+      b->program[i] = p_glCreateProgram();
+      p_glAttachShader(b->program[i], vs);
+      p_glAttachShader(b->program[i],
+                       compile_shader(GL_FRAGMENT_SHADER, fs_source[i]));
+      p_glLinkProgram(b->program[i]);
+      p_glGetProgramiv(b->program[i], GL_LINK_STATUS, &status);
+      if (!status)
+         fail("couldn't link the shaders");
+
+      p_glUseProgram(b->program[i]);
+      p_glUniform1i(p_glGetUniformLocation(b->program[i], "tex"), 0);
+      b->color_loc[i] = p_glGetUniformLocation(b->program[i], "color");
+      p_glUniform4f(b->color_loc[i], 1.0f, 1.0f, 1.0f, 1.0f);
+
+      glGenTextures(1, &b->texture[i]);
+      glBindTexture(GL_TEXTURE_2D, b->texture[i]);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 2, 2, 0,
+                   GL_RGBA, GL_UNSIGNED_BYTE, texels[i]);
+
+      p_glGenVertexArrays(1, &b->vao[i]);
+      p_glBindVertexArray(b->vao[i]);
+      p_glGenBuffers(1, &b->vbo[i]);
+      p_glBindBuffer(GL_ARRAY_BUFFER, b->vbo[i]);
+      p_glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
+      p_glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, NULL);
+      p_glEnableVertexAttribArray(0);
+   }
+
+   /* all scenarios start from the same state */
+   p_glUseProgram(b->program[0]);
+   glBindTexture(GL_TEXTURE_2D, b->texture[0]);
+   p_glBindVertexArray(b->vao[0]);
+   glViewport(0, 0, WIDTH, HEIGHT);
+
+   if (glGetError() != GL_NO_ERROR)
+      fail("GL error during setup");
+}
+
+
+static void
+destroy_bench(struct bench *b)
+{
+   OSMesaDestroyContext(b->ctx);
+   free(b->buffer);
+}
+
+
+static void
+run_scenario(unsigned s, unsigned num_draws)
+{
+   struct bench b;
+   double start, secs;
+   unsigned i;
+
+   memset(&b, 0, sizeof(b));
+   init_bench(&b);
+
+   /* compile shader variants etc. */
+   for (i = 0; i < NUM_WARMUP; i++)
+      scenarios[s].draw(&b, i);
+   glFinish();
+
+   start = get_time();
+   for (i = 0; i < num_draws; i++)
+      scenarios[s].draw(&b, i);
+   glFinish();
+   secs = get_time() - start;
+
+   printf("%-10s %10.0f draws/s %8.1f ns/draw\n", scenarios[s].name,
+          num_draws / secs, secs * 1e9 / num_draws);
+   fflush(stdout);
+
+   destroy_bench(&b);
+}
+
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_draws = 200000;
+   unsigned s;
+   int i, selected = 0;
+
+   for (i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+         num_draws = atoi(argv[++i]);
+         if (!num_draws)
+            fail("invalid number of draws");
+      }
+      else {
+         selected++;
+      }
+   }
+
+   for (s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+      int run = !selected;
+
+      for (i = 1; i < argc; i++) {
+         if (strcmp(argv[i], "-n") == 0)
+            i++;
+         else if (strcmp(argv[i], scenarios[s].name) == 0)
+            run = 1;
+      }
+
+      if (run)
+         run_scenario(s, num_draws);
+   }
+
+   return 0;
+}
@@ -0,0 +1,294 @@
+/**************************************************************************
+ *
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Legacy immediate-mode benchmark.
+ *
+ * Draws many small glBegin/glEnd objects the way old fixed-function
+ * applications do, wrapping each one in the matrix, attribute and query
+ * calls those applications typically make, and reports the objects drawn
+ * per second.  Each scenario adds one such pattern; comparing it with
+ * "plain" shows what the pattern costs, mostly in draws split by vertex
+ * flushes.  "translate" changes the matrix for real and is the reference
+ * for an unavoidable flush per object.
+ *
+ * Usage: immediate-bench [-n objects] [scenario ...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "GL/osmesa.h"
+
+
+#define WIDTH 256
+#define HEIGHT 256
+#define GRID 32
+#define NUM_WARMUP 1000
+
+
+static const GLfloat camera[16] = {
+   1.0f / GRID, 0.0f, 0.0f, 0.0f,
+   0.0f, 1.0f / GRID, 0.0f, 0.0f,
+   0.0f, 0.0f, 1.0f, 0.0f,
+   -1.0f, -1.0f, 0.0f, 1.0f
+};
+
+
+static void
+fail(const char *msg)
+{
+   fprintf(stderr, "immediate-bench: %s\n", msg);
+   exit(1);
+}
+
+
+/**
+ * One quad in cell \p i of a GRID x GRID grid, with a per-object color.
+ */
+static void
+emit_quad(unsigned i, GLfloat x, GLfloat y)
+{
+   glColor3f((i & 7) / 7.0f, ((i >> 3) & 7) / 7.0f, 0.5f);
+   glBegin(GL_QUADS);
+   glNormal3f(0.0f, 0.0f, 1.0f);
+   glVertex2f(x, y);
+   glVertex2f(x + 1.5f, y);
+   glVertex2f(x + 1.5f, y + 1.5f);
+   glVertex2f(x, y + 1.5f);
+   glEnd();
+}
+
+static void
+cell(unsigned i, GLfloat *x, GLfloat *y)
+{
+   *x = (GLfloat) (i % GRID) * 2.0f;
+   *y = (GLfloat) ((i / GRID) % GRID) * 2.0f;
+}
+
+
+static void
+draw_plain(unsigned i)
+{
+   GLfloat x, y;
+
+   cell(i, &x, &y);
+   emit_quad(i, x, y);
+}
+
+static void
+draw_push_pop(unsigned i)
+{
+   GLfloat x, y;
+
+   cell(i, &x, &y);
+   glPushMatrix();
+   emit_quad(i, x, y);
+   glPopMatrix();
+}
+
+static void
+draw_load_camera(unsigned i)
+{
+   GLfloat x, y;
+
+   cell(i, &x, &y);
+   glLoadMatrixf(camera);
+   emit_quad(i, x, y);
+}
+
+static void
+draw_push_attrib(unsigned i)
+{
+   GLfloat x, y;
+
+   cell(i, &x, &y);
+   glPushAttrib(GL_CURRENT_BIT | GL_LIGHTING_BIT);
+   emit_quad(i, x, y);
+   glPopAttrib();
+}
+
+static void
+draw_query(unsigned i)
+{
+   GLfloat x, y, color[4];
+
+   cell(i, &x, &y);
+   emit_quad(i, x, y);
+   glGetFloatv(GL_CURRENT_COLOR, color);
+}
+
+static void
+draw_lit(unsigned i)
+{
+   GLfloat x, y;
+
+   cell(i, &x, &y);
+   glPushMatrix();
+   glTranslatef(0.0f, 0.0f, 0.0f);
+   glRotatef(0.0f, 0.0f, 0.0f, 1.0f);
+   emit_quad(i, x, y);
+   glPopMatrix();
+}
+
+static void
+draw_translate(unsigned i)
+{
+   GLfloat x, y;
+
+   cell(i, &x, &y);
+   glPushMatrix();
+   glTranslatef(x, y, 0.0f);
+   emit_quad(i, 0.0f, 0.0f);
+   glPopMatrix();
+}
+
+
+static void
+init_unlit(void)
+{
+   glDisable(GL_LIGHTING);
+   glDisable(GL_COLOR_MATERIAL);
+}
+
+static void
+init_lit(void)
+{
+   glEnable(GL_LIGHTING);
+   glEnable(GL_LIGHT0);
+   glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+   glEnable(GL_COLOR_MATERIAL);
+}
+
+
+static const struct {
+   const char *name;
+   void (*init)(void);
+   void (*draw)(unsigned i);
+} scenarios[] = {
+   { "plain", init_unlit, draw_plain },
+   { "push-pop", init_unlit, draw_push_pop },
+   { "load-camera", init_unlit, draw_load_camera },
+   { "push-attrib", init_lit, draw_push_attrib },
+   { "query", init_unlit, draw_query },
+   { "lit", init_lit, draw_lit },
+   { "translate", init_unlit, draw_translate },
+};
+
+
+static double
+get_time(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void
+run_scenario(unsigned s, unsigned num_objects)
+{
+   OSMesaContext ctx;
+   GLubyte *buffer;
+   double start, secs;
+   unsigned i;
+
+   ctx = OSMesaCreateContextExt(OSMESA_RGBA, 24, 0, 0, NULL);
+   if (!ctx)
+      fail("couldn't create an OSMesa context");
+
+   buffer = malloc(WIDTH * HEIGHT * 4);
+   if (!buffer ||
+       !OSMesaMakeCurrent(ctx, buffer, GL_UNSIGNED_BYTE, WIDTH, HEIGHT))
+      fail("couldn't make the context current");
+
+   glViewport(0, 0, WIDTH, HEIGHT);
+   glMatrixMode(GL_PROJECTION);
+   glLoadIdentity();
+   glMatrixMode(GL_MODELVIEW);
+   glLoadMatrixf(camera);
+   scenarios[s].init();
+   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+   for (i = 0; i < NUM_WARMUP; i++)
+      scenarios[s].draw(i);
+   glFinish();
+
+   start = get_time();
+   for (i = 0; i < num_objects; i++)
+      scenarios[s].draw(i);
+   glFinish();
+   secs = get_time() - start;
+
+   if (glGetError() != GL_NO_ERROR)
+      fail("GL error while drawing");
+
+   printf("%-12s %10.0f objects/s %8.1f ns/object\n", scenarios[s].name,
+          num_objects / secs, secs * 1e9 / num_objects);
+   fflush(stdout);
+
+   OSMesaDestroyContext(ctx);
+   free(buffer);
+}
+
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_objects = 1000000;
+   unsigned s;
+   int i, selected = 0;
+
+   for (i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+         num_objects = atoi(argv[++i]);
+         if (!num_objects)
+            fail("invalid number of objects");
+      }
+      else {
+         selected++;
+      }
+   }
+
+   for (s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+      int run = !selected;
+
+      for (i = 1; i < argc; i++) {
+         if (strcmp(argv[i], "-n") == 0)
+            i++;
+         else if (strcmp(argv[i], scenarios[s].name) == 0)
+            run = 1;
+      }
+
+      if (run)
+         run_scenario(s, num_objects);
+   }
+
+   return 0;
+}
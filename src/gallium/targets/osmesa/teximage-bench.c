@@ -0,0 +1,282 @@
+/**************************************************************************
+ *
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+/*
+ * Texture upload and readback throughput benchmark.
+ *
+ * Uploads a large image with glTexSubImage2D() and reads the framebuffer
+ * back with glReadPixels(), to client memory or to a pixel buffer object
+ * that is then mapped, in a few common format/type combinations and
+ * reports the throughput in megapixels per second and the latency of each
+ * transfer.  Combinations that
+ * need a conversion go through _mesa_format_convert() and
+ * _mesa_swizzle_and_convert() (texstore.c, readpix.c) unless the driver
+ * can do them with a blit.  The bptc-* scenarios measure the software
+ * BPTC compressor (texcompress_bptc.c).
+ *
+ * Usage: teximage-bench [-n iterations] [-s WIDTHxHEIGHT] [scenario ...]
+ *
+ * "-s 3840x2160" measures 4K frame readback.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "GL/osmesa.h"
+#include "GL/glext.h"
+
+
+#define NUM_WARMUP 2
+
+
+enum transfer_mode {
+   UPLOAD,
+   READ,
+   READ_PBO,
+};
+
+
+static const struct {
+   const char *name;
+   enum transfer_mode mode;
+   GLenum internal_format;
+   GLenum format;
+   GLenum type;
+   unsigned bpp;
+} scenarios[] = {
+   { "rgba8-rgba", UPLOAD, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4 },
+   { "rgba8-bgra", UPLOAD, GL_RGBA8, GL_BGRA, GL_UNSIGNED_BYTE, 4 },
+   { "rgba8-rgb", UPLOAD, GL_RGBA8, GL_RGB, GL_UNSIGNED_BYTE, 3 },
+   { "rgba8-float", UPLOAD, GL_RGBA8, GL_RGBA, GL_FLOAT, 16 },
+   { "rgba32f-ubyte", UPLOAD, GL_RGBA32F, GL_RGBA, GL_UNSIGNED_BYTE, 4 },
+   { "rgba32f-half", UPLOAD, GL_RGBA32F, GL_RGBA, GL_HALF_FLOAT, 8 },
+   { "bptc-rgba8", UPLOAD, GL_COMPRESSED_RGBA_BPTC_UNORM,
+     GL_RGBA, GL_UNSIGNED_BYTE, 4 },
+   { "bptc-rgb-float", UPLOAD, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT,
+     GL_RGB, GL_FLOAT, 12 },
+   { "read-rgba", READ, 0, GL_RGBA, GL_UNSIGNED_BYTE, 4 },
+   { "read-bgra", READ, 0, GL_BGRA, GL_UNSIGNED_BYTE, 4 },
+   { "read-float", READ, 0, GL_RGBA, GL_FLOAT, 16 },
+   { "read-rgba-pbo", READ_PBO, 0, GL_RGBA, GL_UNSIGNED_BYTE, 4 },
+   { "read-bgra-pbo", READ_PBO, 0, GL_BGRA, GL_UNSIGNED_BYTE, 4 },
+};
+
+
+#define GL_FUNCTIONS(F) \
+   F(PFNGLBINDBUFFERPROC, glBindBuffer) \
+   F(PFNGLBUFFERDATAPROC, glBufferData) \
+   F(PFNGLDELETEBUFFERSPROC, glDeleteBuffers) \
+   F(PFNGLGENBUFFERSPROC, glGenBuffers) \
+   F(PFNGLMAPBUFFERPROC, glMapBuffer) \
+   F(PFNGLUNMAPBUFFERPROC, glUnmapBuffer)
+
+#define DECLARE_FUNCTION(type, name) static type p_##name;
+GL_FUNCTIONS(DECLARE_FUNCTION)
+#undef DECLARE_FUNCTION
+
+
+static int width = 1024, height = 1024;
+
+
+static void
+fail(const char *msg)
+{
+   fprintf(stderr, "teximage-bench: %s\n", msg);
+   exit(1);
+}
+
+
+static double
+get_time(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void
+transfer(unsigned s, void *pixels)
+{
+   const void *map;
+
+   switch (scenarios[s].mode) {
+   case UPLOAD:
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height,
+                      scenarios[s].format, scenarios[s].type, pixels);
+      break;
+   case READ:
+      glReadPixels(0, 0, width, height, scenarios[s].format,
+                   scenarios[s].type, pixels);
+      break;
+   case READ_PBO:
+      /* the data is only complete once the buffer can be mapped */
+      glReadPixels(0, 0, width, height, scenarios[s].format,
+                   scenarios[s].type, NULL);
+      map = p_glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+      if (!map)
+         fail("couldn't map the pixel pack buffer");
+      p_glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      break;
+   }
+}
+
+
+static void
+run_scenario(unsigned s, unsigned iterations)
+{
+   OSMesaContext ctx;
+   GLubyte *buffer, *pixels;
+   GLuint texture, pbo;
+   double start, secs;
+   unsigned i;
+
+   ctx = OSMesaCreateContextExt(OSMESA_RGBA, 0, 0, 0, NULL);
+   if (!ctx)
+      fail("couldn't create an OSMesa context");
+
+   buffer = malloc((size_t) width * height * 4);
+   if (!buffer ||
+       !OSMesaMakeCurrent(ctx, buffer, GL_UNSIGNED_BYTE, width, height))
+      fail("couldn't make the context current");
+
+#define GET_FUNCTION(type, name) \
+   p_##name = (type) OSMesaGetProcAddress(#name); \
+   if (!p_##name) \
+      fail("missing " #name);
+   GL_FUNCTIONS(GET_FUNCTION)
+#undef GET_FUNCTION
+
+   pixels = malloc((size_t) width * height * scenarios[s].bpp);
+   if (!pixels)
+      fail("out of memory");
+
+   /* something that isn't trivially compressible, in range for floats */
+   if (scenarios[s].type == GL_FLOAT) {
+      GLfloat *f = (GLfloat *) pixels;
+      for (i = 0; i < width * height * scenarios[s].bpp / 4; i++)
+         f[i] = (GLfloat) (i % 251) / 250.0f;
+   }
+   else {
+      for (i = 0; i < width * height * scenarios[s].bpp; i++)
+         pixels[i] = i % 251;
+   }
+
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+   glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+   if (scenarios[s].mode != UPLOAD) {
+      glClearColor(0.25f, 0.5f, 0.75f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+   }
+   if (scenarios[s].mode == READ_PBO) {
+      p_glGenBuffers(1, &pbo);
+      p_glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+      p_glBufferData(GL_PIXEL_PACK_BUFFER,
+                     (GLsizeiptr) width * height * scenarios[s].bpp, NULL,
+                     GL_STREAM_READ);
+   }
+   if (scenarios[s].mode == UPLOAD) {
+      glGenTextures(1, &texture);
+      glBindTexture(GL_TEXTURE_2D, texture);
+      glTexImage2D(GL_TEXTURE_2D, 0, scenarios[s].internal_format,
+                   width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+   }
+
+   if (glGetError() != GL_NO_ERROR)
+      fail("GL error during setup");
+
+   for (i = 0; i < NUM_WARMUP; i++)
+      transfer(s, pixels);
+   glFinish();
+
+   start = get_time();
+   for (i = 0; i < iterations; i++)
+      transfer(s, pixels);
+   glFinish();
+   secs = get_time() - start;
+
+   if (glGetError() != GL_NO_ERROR)
+      fail("GL error during the transfers");
+
+   printf("%-14s %8.1f Mpixels/s %8.1f MB/s %8.2f ms\n", scenarios[s].name,
+          (double) width * height * iterations / secs * 1e-6,
+          (double) width * height * scenarios[s].bpp * iterations / secs * 1e-6,
+          secs / iterations * 1e3);
+   fflush(stdout);
+
+   if (scenarios[s].mode == READ_PBO)
+      p_glDeleteBuffers(1, &pbo);
+
+   OSMesaDestroyContext(ctx);
+   free(pixels);
+   free(buffer);
+}
+
+
+int
+main(int argc, char **argv)
+{
+   unsigned iterations = 50;
+   unsigned s;
+   int i, selected = 0;
+
+   for (i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+         iterations = atoi(argv[++i]);
+         if (!iterations)
+            fail("invalid number of iterations");
+      }
+      else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+         if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 ||
+             width <= 0 || height <= 0)
+            fail("invalid image size");
+      }
+      else {
+         selected++;
+      }
+   }
+
+   for (s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+      int run = !selected;
+
+      for (i = 1; i < argc; i++) {
+         if (strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "-s") == 0)
+            i++;
+         else if (strcmp(argv[i], scenarios[s].name) == 0)
+            run = 1;
+      }
+
+      if (run)
+         run_scenario(s, iterations);
+   }
+
+   return 0;
+}
@@ -0,0 +1,358 @@
+/**************************************************************************
+ *
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Texture/sampler binding microbenchmark.
+ *
+ * Binds NUM_UNITS textures and samplers before every draw the way a
+ * state tracker does when it revalidates texture state, and reports how
+ * many tiny draws per second the driver sustains when nothing, one
+ * texture or one sampler changes between draws.  This is mostly useful
+ * for measuring the CPU cost of redundant state binding.
+ */
+
+#define WIDTH 64
+#define HEIGHT 64
+#define NUM_UNITS 8
+#define NUM_DRAWS 100000
+
+#include <stdio.h>
+
+/* pipe_*_state structs */
+#include "pipe/p_state.h"
+/* pipe_context */
+#include "pipe/p_context.h"
+/* pipe_screen */
+#include "pipe/p_screen.h"
+/* PIPE_* */
+#include "pipe/p_defines.h"
+/* TGSI_SEMANTIC_{POSITION|GENERIC} */
+#include "pipe/p_shader_tokens.h"
+/* pipe_buffer_* helpers */
+#include "util/u_inlines.h"
+
+/* constant state object helper */
+#include "cso_cache/cso_context.h"
+
+/* os_time_get_nano */
+#include "os/os_time.h"
+/* u_sampler_view_default_template */
+#include "util/u_sampler.h"
+/* util_draw_vertex_buffer helper */
+#include "util/u_draw_quad.h"
+/* FREE & CALLOC_STRUCT */
+#include "util/u_memory.h"
+/* util_make_[fragment|vertex]_passthrough_shader */
+#include "util/u_simple_shaders.h"
+/* to get a hardware pipe driver */
+#include "pipe-loader/pipe_loader.h"
+
+struct program
+{
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	struct pipe_context *pipe;
+	struct cso_context *cso;
+
+	struct pipe_blend_state blend;
+	struct pipe_depth_stencil_alpha_state depthstencil;
+	struct pipe_rasterizer_state rasterizer;
+	struct pipe_sampler_state sampler[NUM_UNITS];
+	struct pipe_sampler_state sampler_alt;
+	struct pipe_viewport_state viewport;
+	struct pipe_framebuffer_state framebuffer;
+	struct pipe_vertex_element velem[2];
+
+	void *vs;
+	void *fs;
+
+	struct pipe_resource *vbuf;
+	struct pipe_resource *target;
+	struct pipe_resource *tex[NUM_UNITS + 1];
+	struct pipe_sampler_view *view[NUM_UNITS + 1];
+};
+
+static void init_prog(struct program *p)
+{
+	struct pipe_surface surf_tmpl;
+	int ret;
+	unsigned i;
+
+	/* find a hardware device */
+	ret = pipe_loader_probe(&p->dev, 1);
+	assert(ret);
+
+	/* init a pipe screen */
+	p->screen = pipe_loader_create_screen(p->dev);
+	assert(p->screen);
+
+	/* create the pipe driver context and cso context */
+	p->pipe = p->screen->context_create(p->screen, NULL, 0);
+	p->cso = cso_create_context(p->pipe);
+
+	/* vertex buffer, a single small triangle */
+	{
+		float vertices[3][2][4] = {
+			{
+				{ -1.0f, -1.0f, 0.0f, 1.0f },
+				{ 0.0f, 0.0f, 0.0f, 1.0f }
+			},
+			{
+				{ -0.9f, -1.0f, 0.0f, 1.0f },
+				{ 1.0f, 0.0f, 0.0f, 1.0f }
+			},
+			{
+				{ -1.0f, -0.9f, 0.0f, 1.0f },
+				{ 0.0f, 1.0f, 0.0f, 1.0f }
+			}
+		};
+
+		p->vbuf = pipe_buffer_create(p->screen, PIPE_BIND_VERTEX_BUFFER,
+					     PIPE_USAGE_DEFAULT, sizeof(vertices));
+		pipe_buffer_write(p->pipe, p->vbuf, 0, sizeof(vertices), vertices);
+	}
+
+	/* render target texture */
+	{
+		struct pipe_resource tmplt;
+		memset(&tmplt, 0, sizeof(tmplt));
+		tmplt.target = PIPE_TEXTURE_2D;
+		tmplt.format = PIPE_FORMAT_B8G8R8A8_UNORM; /* All drivers support this */
+		tmplt.width0 = WIDTH;
+		tmplt.height0 = HEIGHT;
+		tmplt.depth0 = 1;
+		tmplt.array_size = 1;
+		tmplt.last_level = 0;
+		tmplt.bind = PIPE_BIND_RENDER_TARGET;
+
+		p->target = p->screen->resource_create(p->screen, &tmplt);
+	}
+
+	/* sampler textures, one more than units for toggling */
+	for (i = 0; i < NUM_UNITS + 1; i++) {
+		struct pipe_resource t_tmplt;
+		struct pipe_sampler_view v_tmplt;
+
+		memset(&t_tmplt, 0, sizeof(t_tmplt));
+		t_tmplt.target = PIPE_TEXTURE_2D;
+		t_tmplt.format = PIPE_FORMAT_B8G8R8A8_UNORM; /* All drivers support this */
+		t_tmplt.width0 = 4;
+		t_tmplt.height0 = 4;
+		t_tmplt.depth0 = 1;
+		t_tmplt.array_size = 1;
+		t_tmplt.last_level = 0;
+		t_tmplt.bind = PIPE_BIND_SAMPLER_VIEW;
+
+		p->tex[i] = p->screen->resource_create(p->screen, &t_tmplt);
+
+		u_sampler_view_default_template(&v_tmplt, p->tex[i], p->tex[i]->format);
+		p->view[i] = p->pipe->create_sampler_view(p->pipe, p->tex[i], &v_tmplt);
+	}
+
+	/* samplers, the alternative one only differs in filtering */
+	for (i = 0; i < NUM_UNITS; i++) {
+		memset(&p->sampler[i], 0, sizeof(p->sampler[i]));
+		p->sampler[i].wrap_s = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+		p->sampler[i].wrap_t = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+		p->sampler[i].wrap_r = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+		p->sampler[i].min_mip_filter = PIPE_TEX_MIPFILTER_NONE;
+		p->sampler[i].min_img_filter = PIPE_TEX_FILTER_NEAREST;
+		p->sampler[i].mag_img_filter = PIPE_TEX_FILTER_NEAREST;
+		p->sampler[i].normalized_coords = 1;
+	}
+	p->sampler_alt = p->sampler[0];
+	p->sampler_alt.min_img_filter = PIPE_TEX_FILTER_LINEAR;
+	p->sampler_alt.mag_img_filter = PIPE_TEX_FILTER_LINEAR;
+
+	/* disabled blending/masking */
+	memset(&p->blend, 0, sizeof(p->blend));
+	p->blend.rt[0].colormask = PIPE_MASK_RGBA;
+
+	/* no-op depth/stencil/alpha */
+	memset(&p->depthstencil, 0, sizeof(p->depthstencil));
+
+	/* rasterizer */
+	memset(&p->rasterizer, 0, sizeof(p->rasterizer));
+	p->rasterizer.cull_face = PIPE_FACE_NONE;
+	p->rasterizer.half_pixel_center = 1;
+	p->rasterizer.bottom_edge_rule = 1;
+	p->rasterizer.depth_clip = 1;
+
+	surf_tmpl.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	surf_tmpl.u.tex.level = 0;
+	surf_tmpl.u.tex.first_layer = 0;
+	surf_tmpl.u.tex.last_layer = 0;
+	/* drawing destination */
+	memset(&p->framebuffer, 0, sizeof(p->framebuffer));
+	p->framebuffer.width = WIDTH;
+	p->framebuffer.height = HEIGHT;
+	p->framebuffer.nr_cbufs = 1;
+	p->framebuffer.cbufs[0] = p->pipe->create_surface(p->pipe, p->target, &surf_tmpl);
+
+	/* viewport, depth isn't really needed */
+	p->viewport.scale[0] = (float)WIDTH / 2.0f;
+	p->viewport.scale[1] = (float)HEIGHT / 2.0f;
+	p->viewport.scale[2] = 0.5f;
+	p->viewport.translate[0] = (float)WIDTH / 2.0f;
+	p->viewport.translate[1] = (float)HEIGHT / 2.0f;
+	p->viewport.translate[2] = 0.5f;
+
+	/* vertex elements state */
+	memset(p->velem, 0, sizeof(p->velem));
+	p->velem[0].src_offset = 0 * 4 * sizeof(float); /* offset 0, first element */
+	p->velem[0].instance_divisor = 0;
+	p->velem[0].vertex_buffer_index = 0;
+	p->velem[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	p->velem[1].src_offset = 1 * 4 * sizeof(float); /* offset 16, second element */
+	p->velem[1].instance_divisor = 0;
+	p->velem[1].vertex_buffer_index = 0;
+	p->velem[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	/* vertex shader */
+	{
+			const uint semantic_names[] = { TGSI_SEMANTIC_POSITION,
+							TGSI_SEMANTIC_GENERIC };
+			const uint semantic_indexes[] = { 0, 0 };
+			p->vs = util_make_vertex_passthrough_shader(p->pipe, 2, semantic_names, semantic_indexes, FALSE);
+	}
+
+	/* fragment shader */
+	p->fs = util_make_fragment_tex_shader(p->pipe, TGSI_TEXTURE_2D,
+	                                      TGSI_INTERPOLATE_LINEAR,
+	                                      TGSI_RETURN_TYPE_FLOAT);
+}
+
+static void close_prog(struct program *p)
+{
+	unsigned i;
+
+	cso_destroy_context(p->cso);
+
+	p->pipe->delete_vs_state(p->pipe, p->vs);
+	p->pipe->delete_fs_state(p->pipe, p->fs);
+
+	for (i = 0; i < NUM_UNITS + 1; i++) {
+		pipe_sampler_view_reference(&p->view[i], NULL);
+		pipe_resource_reference(&p->tex[i], NULL);
+	}
+	pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+	pipe_resource_reference(&p->target, NULL);
+	pipe_resource_reference(&p->vbuf, NULL);
+
+	p->pipe->destroy(p->pipe);
+	p->screen->destroy(p->screen);
+	pipe_loader_release(&p->dev, 1);
+
+	FREE(p);
+}
+
+/*
+ * Draw NUM_DRAWS triangles, rebinding all samplers and sampler views
+ * before each one.  On odd draws unit 0 gets the alternative texture
+ * and/or sampler state.
+ */
+static void bench(struct program *p, const char *name,
+		  boolean toggle_view, boolean toggle_sampler)
+{
+	const struct pipe_sampler_state *samplers[NUM_UNITS];
+	struct pipe_sampler_view *views[NUM_UNITS];
+	struct pipe_fence_handle *fence = NULL;
+	int64_t start, end;
+	double secs;
+	unsigned i, j;
+
+	for (j = 0; j < NUM_UNITS; j++) {
+		samplers[j] = &p->sampler[j];
+		views[j] = p->view[j];
+	}
+
+	start = os_time_get_nano();
+
+	for (i = 0; i < NUM_DRAWS; i++) {
+		if (toggle_view)
+			views[0] = p->view[(i & 1) ? NUM_UNITS : 0];
+		if (toggle_sampler)
+			samplers[0] = (i & 1) ? &p->sampler_alt : &p->sampler[0];
+
+		cso_set_samplers(p->cso, PIPE_SHADER_FRAGMENT, NUM_UNITS, samplers);
+		cso_set_sampler_views(p->cso, PIPE_SHADER_FRAGMENT, NUM_UNITS, views);
+
+		util_draw_vertex_buffer(p->pipe, p->cso,
+		                        p->vbuf, 0, 0,
+		                        PIPE_PRIM_TRIANGLES,
+		                        3,  /* verts */
+		                        2); /* attribs/vert */
+	}
+
+	p->pipe->flush(p->pipe, &fence, 0);
+	p->screen->fence_finish(p->screen, NULL, fence,
+				 PIPE_TIMEOUT_INFINITE);
+	p->screen->fence_reference(p->screen, &fence, NULL);
+
+	end = os_time_get_nano();
+
+	secs = (end - start) / 1000000000.0;
+	printf("%-10s %10.0f draws/s %8.1f ns/draw\n",
+	       name, NUM_DRAWS / secs, secs * 1e9 / NUM_DRAWS);
+}
+
+static void draw(struct program *p)
+{
+	/* set the render target */
+	cso_set_framebuffer(p->cso, &p->framebuffer);
+
+	/* set misc state we care about */
+	cso_set_blend(p->cso, &p->blend);
+	cso_set_depth_stencil_alpha(p->cso, &p->depthstencil);
+	cso_set_rasterizer(p->cso, &p->rasterizer);
+	cso_set_viewport(p->cso, &p->viewport);
+
+	/* shaders */
+	cso_set_fragment_shader_handle(p->cso, p->fs);
+	cso_set_vertex_shader_handle(p->cso, p->vs);
+
+	/* vertex element data */
+	cso_set_vertex_elements(p->cso, 2, p->velem);
+
+	/* the first pass also warms up shader variants etc. */
+	bench(p, "unchanged", FALSE, FALSE);
+	bench(p, "unchanged", FALSE, FALSE);
+	bench(p, "texture", TRUE, FALSE);
+	bench(p, "sampler", FALSE, TRUE);
+	bench(p, "both", TRUE, TRUE);
+}
+
+int main(int argc, char** argv)
+{
+	struct program *p = CALLOC_STRUCT(program);
+
+	init_prog(p);
+	draw(p);
+	close_prog(p);
+
+	return 0;
+}
@@ -0,0 +1,376 @@
+/**************************************************************************
+ *
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Draws many independent triangles in a single draw call and checks
+ * that each one ends up where it should, in its own color, for every
+ * cull mode.  Drivers which set up triangles in batches (llvmpipe) see
+ * full batches as well as a partial one at the end.
+ *
+ * Every grid cell holds two triangles of opposite winding, so culling
+ * either face must keep exactly one triangle of each cell.
+ *
+ * Returns non-zero on failure.
+ */
+
+#define WIDTH 256
+#define HEIGHT 256
+#define CELL 32
+#define SIZE 28
+#define NUM_CELLS 61 /* 122 triangles, not a multiple of the batch size */
+#define NUM_TRIS (NUM_CELLS * 2)
+
+#define WIN_TO_NDC(v, size) ((v) * 2.0f / (float)(size) - 1.0f)
+
+#include <stdio.h>
+
+/* pipe_*_state structs */
+#include "pipe/p_state.h"
+/* pipe_context */
+#include "pipe/p_context.h"
+/* pipe_screen */
+#include "pipe/p_screen.h"
+/* PIPE_* */
+#include "pipe/p_defines.h"
+/* TGSI_SEMANTIC_{POSITION|GENERIC} */
+#include "pipe/p_shader_tokens.h"
+/* pipe_buffer_* helpers */
+#include "util/u_inlines.h"
+
+/* constant state object helper */
+#include "cso_cache/cso_context.h"
+
+/* util_draw_vertex_buffer helper */
+#include "util/u_draw_quad.h"
+/* FREE & CALLOC_STRUCT */
+#include "util/u_memory.h"
+/* util_make_[fragment|vertex]_passthrough_shader */
+#include "util/u_simple_shaders.h"
+/* to get a hardware pipe driver */
+#include "pipe-loader/pipe_loader.h"
+
+struct program
+{
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	struct pipe_context *pipe;
+	struct cso_context *cso;
+
+	struct pipe_blend_state blend;
+	struct pipe_depth_stencil_alpha_state depthstencil;
+	struct pipe_rasterizer_state rasterizer;
+	struct pipe_viewport_state viewport;
+	struct pipe_framebuffer_state framebuffer;
+	struct pipe_vertex_element velem[2];
+
+	void *vs;
+	void *fs;
+
+	union pipe_color_union clear_color;
+
+	struct pipe_resource *vbuf;
+	struct pipe_resource *target;
+};
+
+/* window position of the lower left corner of a cell */
+static void cell_origin(int cell, float *x, float *y)
+{
+	*x = (float)((cell % (WIDTH / CELL)) * CELL + 2);
+	*y = (float)((cell / (WIDTH / CELL)) * CELL + 2);
+}
+
+/* unique, exactly representable color of triangle t */
+static void tri_color(int t, unsigned char rgb[3])
+{
+	rgb[0] = (t & 15) * 17;
+	rgb[1] = (t >> 4) * 17;
+	rgb[2] = 255;
+}
+
+static void fill_vbuf(struct program *p)
+{
+	float verts[NUM_TRIS * 3][2][4];
+	int cell, i, j;
+
+	for (cell = 0; cell < NUM_CELLS; cell++) {
+		/* lower left triangle, and upper right one wound the other way */
+		static const float corners[2][3][2] = {
+			{ { 0, 0 }, { SIZE, 0 }, { 0, SIZE } },
+			{ { SIZE, SIZE }, { SIZE, 0 }, { 0, SIZE } }
+		};
+		float x, y;
+
+		cell_origin(cell, &x, &y);
+
+		for (i = 0; i < 2; i++) {
+			int t = cell * 2 + i;
+			unsigned char rgb[3];
+
+			tri_color(t, rgb);
+
+			for (j = 0; j < 3; j++) {
+				float *v = verts[t * 3 + j][0];
+				float *c = verts[t * 3 + j][1];
+
+				v[0] = WIN_TO_NDC(x + corners[i][j][0], WIDTH);
+				v[1] = WIN_TO_NDC(y + corners[i][j][1], HEIGHT);
+				v[2] = 0.0f;
+				v[3] = 1.0f;
+				c[0] = rgb[0] / 255.0f;
+				c[1] = rgb[1] / 255.0f;
+				c[2] = rgb[2] / 255.0f;
+				c[3] = 1.0f;
+			}
+		}
+	}
+
+	pipe_buffer_write(p->pipe, p->vbuf, 0, sizeof(verts), verts);
+}
+
+static void init_prog(struct program *p)
+{
+	struct pipe_surface surf_tmpl;
+	int ret;
+
+	/* find a hardware device */
+	ret = pipe_loader_probe(&p->dev, 1);
+	assert(ret);
+
+	/* init a pipe screen */
+	p->screen = pipe_loader_create_screen(p->dev);
+	assert(p->screen);
+
+	/* create the pipe driver context and cso context */
+	p->pipe = p->screen->context_create(p->screen, NULL, 0);
+	p->cso = cso_create_context(p->pipe);
+
+	/* black, which no triangle uses */
+	memset(&p->clear_color, 0, sizeof(p->clear_color));
+
+	/* vertex buffer */
+	p->vbuf = pipe_buffer_create(p->screen, PIPE_BIND_VERTEX_BUFFER,
+				     PIPE_USAGE_DEFAULT,
+				     NUM_TRIS * 3 * 2 * 4 * sizeof(float));
+	fill_vbuf(p);
+
+	/* render target texture */
+	{
+		struct pipe_resource tmplt;
+		memset(&tmplt, 0, sizeof(tmplt));
+		tmplt.target = PIPE_TEXTURE_2D;
+		tmplt.format = PIPE_FORMAT_B8G8R8A8_UNORM; /* All drivers support this */
+		tmplt.width0 = WIDTH;
+		tmplt.height0 = HEIGHT;
+		tmplt.depth0 = 1;
+		tmplt.array_size = 1;
+		tmplt.last_level = 0;
+		tmplt.bind = PIPE_BIND_RENDER_TARGET;
+
+		p->target = p->screen->resource_create(p->screen, &tmplt);
+	}
+
+	/* disabled blending/masking */
+	memset(&p->blend, 0, sizeof(p->blend));
+	p->blend.rt[0].colormask = PIPE_MASK_RGBA;
+
+	/* no-op depth/stencil/alpha */
+	memset(&p->depthstencil, 0, sizeof(p->depthstencil));
+
+	/* rasterizer */
+	memset(&p->rasterizer, 0, sizeof(p->rasterizer));
+	p->rasterizer.cull_face = PIPE_FACE_NONE;
+	p->rasterizer.half_pixel_center = 1;
+	p->rasterizer.bottom_edge_rule = 1;
+	p->rasterizer.depth_clip = 1;
+
+	surf_tmpl.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	surf_tmpl.u.tex.level = 0;
+	surf_tmpl.u.tex.first_layer = 0;
+	surf_tmpl.u.tex.last_layer = 0;
+	/* drawing destination */
+	memset(&p->framebuffer, 0, sizeof(p->framebuffer));
+	p->framebuffer.width = WIDTH;
+	p->framebuffer.height = HEIGHT;
+	p->framebuffer.nr_cbufs = 1;
+	p->framebuffer.cbufs[0] = p->pipe->create_surface(p->pipe, p->target, &surf_tmpl);
+
+	/* viewport, depth isn't really needed */
+	p->viewport.scale[0] = (float)WIDTH / 2.0f;
+	p->viewport.scale[1] = (float)HEIGHT / 2.0f;
+	p->viewport.scale[2] = 0.5f;
+	p->viewport.translate[0] = (float)WIDTH / 2.0f;
+	p->viewport.translate[1] = (float)HEIGHT / 2.0f;
+	p->viewport.translate[2] = 0.5f;
+
+	/* vertex elements state */
+	memset(p->velem, 0, sizeof(p->velem));
+	p->velem[0].src_offset = 0 * 4 * sizeof(float); /* offset 0, first element */
+	p->velem[0].instance_divisor = 0;
+	p->velem[0].vertex_buffer_index = 0;
+	p->velem[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	p->velem[1].src_offset = 1 * 4 * sizeof(float); /* offset 16, second element */
+	p->velem[1].instance_divisor = 0;
+	p->velem[1].vertex_buffer_index = 0;
+	p->velem[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	/* vertex shader */
+	{
+			const uint semantic_names[] = { TGSI_SEMANTIC_POSITION,
+							TGSI_SEMANTIC_COLOR };
+			const uint semantic_indexes[] = { 0, 0 };
+			p->vs = util_make_vertex_passthrough_shader(p->pipe, 2, semantic_names, semantic_indexes, FALSE);
+	}
+
+	/* fragment shader */
+	p->fs = util_make_fragment_passthrough_shader(p->pipe,
+                    TGSI_SEMANTIC_COLOR, TGSI_INTERPOLATE_PERSPECTIVE, TRUE);
+}
+
+static void close_prog(struct program *p)
+{
+	cso_destroy_context(p->cso);
+
+	p->pipe->delete_vs_state(p->pipe, p->vs);
+	p->pipe->delete_fs_state(p->pipe, p->fs);
+
+	pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+	pipe_resource_reference(&p->target, NULL);
+	pipe_resource_reference(&p->vbuf, NULL);
+
+	p->pipe->destroy(p->pipe);
+	p->screen->destroy(p->screen);
+	pipe_loader_release(&p->dev, 1);
+
+	FREE(p);
+}
+
+/*
+ * Draw all triangles with the given cull mode and return a bitmask per
+ * winding (bit 0: lower left triangles, bit 1: upper right ones) of which
+ * triangles were drawn, or -1 if the result is inconsistent.
+ */
+static int draw(struct program *p, unsigned cull_face)
+{
+	struct pipe_transfer *transfer;
+	const unsigned char *map;
+	int cell, i, drawn[2] = { 0, 0 };
+
+	p->rasterizer.cull_face = cull_face;
+
+	/* set the render target */
+	cso_set_framebuffer(p->cso, &p->framebuffer);
+
+	/* clear the render target */
+	p->pipe->clear(p->pipe, PIPE_CLEAR_COLOR, &p->clear_color, 0, 0);
+
+	/* set misc state we care about */
+	cso_set_blend(p->cso, &p->blend);
+	cso_set_depth_stencil_alpha(p->cso, &p->depthstencil);
+	cso_set_rasterizer(p->cso, &p->rasterizer);
+	cso_set_viewport(p->cso, &p->viewport);
+
+	/* shaders */
+	cso_set_fragment_shader_handle(p->cso, p->fs);
+	cso_set_vertex_shader_handle(p->cso, p->vs);
+
+	/* vertex element data */
+	cso_set_vertex_elements(p->cso, 2, p->velem);
+
+	util_draw_vertex_buffer(p->pipe, p->cso,
+	                        p->vbuf, 0, 0,
+	                        PIPE_PRIM_TRIANGLES,
+	                        NUM_TRIS * 3, /* verts */
+	                        2);           /* attribs/vert */
+
+	p->pipe->flush(p->pipe, NULL, 0);
+
+	map = pipe_transfer_map(p->pipe, p->target, 0, 0, PIPE_TRANSFER_READ,
+				0, 0, WIDTH, HEIGHT, &transfer);
+	assert(map);
+
+	/* probe the centroid of every triangle */
+	for (cell = 0; cell < NUM_CELLS; cell++) {
+		float x, y;
+
+		cell_origin(cell, &x, &y);
+
+		for (i = 0; i < 2; i++) {
+			int t = cell * 2 + i;
+			int px = (int)(x + SIZE * (i + 1) / 3.0f);
+			int py = (int)(y + SIZE * (i + 1) / 3.0f);
+			const unsigned char *bgra = map + py * transfer->stride + px * 4;
+			unsigned char rgb[3];
+
+			tri_color(t, rgb);
+
+			if (bgra[0] == rgb[2] && bgra[1] == rgb[1] && bgra[2] == rgb[0])
+				drawn[i] |= 1;
+			else if (bgra[0] == 0 && bgra[1] == 0 && bgra[2] == 0)
+				drawn[i] |= 2;
+			else
+				drawn[i] |= 4;
+		}
+	}
+
+	pipe_transfer_unmap(p->pipe, transfer);
+
+	/* all triangles of a winding must be either drawn or culled */
+	if (drawn[0] != 1 && drawn[0] != 2)
+		return -1;
+	if (drawn[1] != 1 && drawn[1] != 2)
+		return -1;
+
+	return (drawn[0] == 1) | (drawn[1] == 1) << 1;
+}
+
+int main(int argc, char** argv)
+{
+	struct program *p = CALLOC_STRUCT(program);
+	int none, back, front, both;
+	int fail;
+
+	init_prog(p);
+
+	none = draw(p, PIPE_FACE_NONE);
+	back = draw(p, PIPE_FACE_BACK);
+	front = draw(p, PIPE_FACE_FRONT);
+	both = draw(p, PIPE_FACE_FRONT_AND_BACK);
+
+	printf("cull none:  %s\n", none == 3 ? "ok" : "FAIL");
+	printf("cull back:  %s\n", back == 1 || back == 2 ? "ok" : "FAIL");
+	printf("cull front: %s\n", front == (back ^ 3) ? "ok" : "FAIL");
+	printf("cull both:  %s\n", both == 0 ? "ok" : "FAIL");
+
+	fail = none != 3 ||
+	       (back != 1 && back != 2) ||
+	       front != (back ^ 3) ||
+	       both != 0;
+
+	close_prog(p);
+
+	return fail;
+}
@@ -0,0 +1,355 @@
+/**************************************************************************
+ *
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Triangle setup/rasterization microbenchmark.
+ *
+ * Draws large batches of small, unconnected triangles of varying
+ * size and reports the triangle throughput for each size.  This is
+ * mostly useful for measuring the driver's per-triangle overhead,
+ * which dominates with highly tessellated geometry.  A last pass with
+ * all triangles culled measures vertex processing throughput.
+ */
+
+#define WIDTH 512
+#define HEIGHT 512
+#define NUM_TRIS 65536
+#define NUM_LOOPS 8
+
+#define WIN_TO_NDC(v, size) ((v) * 2.0f / (float)(size) - 1.0f)
+
+#include <stdio.h>
+
+/* pipe_*_state structs */
+#include "pipe/p_state.h"
+/* pipe_context */
+#include "pipe/p_context.h"
+/* pipe_screen */
+#include "pipe/p_screen.h"
+/* PIPE_* */
+#include "pipe/p_defines.h"
+/* TGSI_SEMANTIC_{POSITION|GENERIC} */
+#include "pipe/p_shader_tokens.h"
+/* pipe_buffer_* helpers */
+#include "util/u_inlines.h"
+
+/* constant state object helper */
+#include "cso_cache/cso_context.h"
+
+/* os_time_get_nano */
+#include "os/os_time.h"
+/* util_draw_vertex_buffer helper */
+#include "util/u_draw_quad.h"
+/* FREE & CALLOC_STRUCT */
+#include "util/u_memory.h"
+/* util_make_[fragment|vertex]_passthrough_shader */
+#include "util/u_simple_shaders.h"
+/* to get a hardware pipe driver */
+#include "pipe-loader/pipe_loader.h"
+
+struct program
+{
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	struct pipe_context *pipe;
+	struct cso_context *cso;
+
+	struct pipe_blend_state blend;
+	struct pipe_depth_stencil_alpha_state depthstencil;
+	struct pipe_rasterizer_state rasterizer;
+	struct pipe_viewport_state viewport;
+	struct pipe_framebuffer_state framebuffer;
+	struct pipe_vertex_element velem[2];
+
+	void *vs;
+	void *fs;
+
+	union pipe_color_union clear_color;
+
+	struct pipe_resource *vbuf;
+	struct pipe_resource *target;
+};
+
+/* triangle edge lengths to benchmark, in pixels */
+static const float tri_sizes[] = {
+	0.25f, 0.5f, 1.0f, 2.0f, 4.0f, 8.0f, 16.0f, 32.0f
+};
+
+static void init_prog(struct program *p)
+{
+	struct pipe_surface surf_tmpl;
+	int ret;
+
+	/* find a hardware device */
+	ret = pipe_loader_probe(&p->dev, 1);
+	assert(ret);
+
+	/* init a pipe screen */
+	p->screen = pipe_loader_create_screen(p->dev);
+	assert(p->screen);
+
+	/* create the pipe driver context and cso context */
+	p->pipe = p->screen->context_create(p->screen, NULL, 0);
+	p->cso = cso_create_context(p->pipe);
+
+	/* set clear color */
+	p->clear_color.f[0] = 0.3;
+	p->clear_color.f[1] = 0.1;
+	p->clear_color.f[2] = 0.3;
+	p->clear_color.f[3] = 1.0;
+
+	/* vertex buffer, filled in for each triangle size */
+	p->vbuf = pipe_buffer_create(p->screen, PIPE_BIND_VERTEX_BUFFER,
+				     PIPE_USAGE_DEFAULT,
+				     NUM_TRIS * 3 * 2 * 4 * sizeof(float));
+
+	/* render target texture */
+	{
+		struct pipe_resource tmplt;
+		memset(&tmplt, 0, sizeof(tmplt));
+		tmplt.target = PIPE_TEXTURE_2D;
+		tmplt.format = PIPE_FORMAT_B8G8R8A8_UNORM; /* All drivers support this */
+		tmplt.width0 = WIDTH;
+		tmplt.height0 = HEIGHT;
+		tmplt.depth0 = 1;
+		tmplt.array_size = 1;
+		tmplt.last_level = 0;
+		tmplt.bind = PIPE_BIND_RENDER_TARGET;
+
+		p->target = p->screen->resource_create(p->screen, &tmplt);
+	}
+
+	/* disabled blending/masking */
+	memset(&p->blend, 0, sizeof(p->blend));
+	p->blend.rt[0].colormask = PIPE_MASK_RGBA;
+
+	/* no-op depth/stencil/alpha */
+	memset(&p->depthstencil, 0, sizeof(p->depthstencil));
+
+	/* rasterizer */
+	memset(&p->rasterizer, 0, sizeof(p->rasterizer));
+	p->rasterizer.cull_face = PIPE_FACE_NONE;
+	p->rasterizer.half_pixel_center = 1;
+	p->rasterizer.bottom_edge_rule = 1;
+	p->rasterizer.depth_clip = 1;
+
+	surf_tmpl.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	surf_tmpl.u.tex.level = 0;
+	surf_tmpl.u.tex.first_layer = 0;
+	surf_tmpl.u.tex.last_layer = 0;
+	/* drawing destination */
+	memset(&p->framebuffer, 0, sizeof(p->framebuffer));
+	p->framebuffer.width = WIDTH;
+	p->framebuffer.height = HEIGHT;
+	p->framebuffer.nr_cbufs = 1;
+	p->framebuffer.cbufs[0] = p->pipe->create_surface(p->pipe, p->target, &surf_tmpl);
+
+	/* viewport, depth isn't really needed */
+	p->viewport.scale[0] = (float)WIDTH / 2.0f;
+	p->viewport.scale[1] = (float)HEIGHT / 2.0f;
+	p->viewport.scale[2] = 0.5f;
+	p->viewport.translate[0] = (float)WIDTH / 2.0f;
+	p->viewport.translate[1] = (float)HEIGHT / 2.0f;
+	p->viewport.translate[2] = 0.5f;
+
+	/* vertex elements state */
+	memset(p->velem, 0, sizeof(p->velem));
+	p->velem[0].src_offset = 0 * 4 * sizeof(float); /* offset 0, first element */
+	p->velem[0].instance_divisor = 0;
+	p->velem[0].vertex_buffer_index = 0;
+	p->velem[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	p->velem[1].src_offset = 1 * 4 * sizeof(float); /* offset 16, second element */
+	p->velem[1].instance_divisor = 0;
+	p->velem[1].vertex_buffer_index = 0;
+	p->velem[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	/* vertex shader */
+	{
+			const uint semantic_names[] = { TGSI_SEMANTIC_POSITION,
+							TGSI_SEMANTIC_COLOR };
+			const uint semantic_indexes[] = { 0, 0 };
+			p->vs = util_make_vertex_passthrough_shader(p->pipe, 2, semantic_names, semantic_indexes, FALSE);
+	}
+
+	/* fragment shader */
+	p->fs = util_make_fragment_passthrough_shader(p->pipe,
+                    TGSI_SEMANTIC_COLOR, TGSI_INTERPOLATE_PERSPECTIVE, TRUE);
+}
+
+static void close_prog(struct program *p)
+{
+	cso_destroy_context(p->cso);
+
+	p->pipe->delete_vs_state(p->pipe, p->vs);
+	p->pipe->delete_fs_state(p->pipe, p->fs);
+
+	pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+	pipe_resource_reference(&p->target, NULL);
+	pipe_resource_reference(&p->vbuf, NULL);
+
+	p->pipe->destroy(p->pipe);
+	p->screen->destroy(p->screen);
+	pipe_loader_release(&p->dev, 1);
+
+	FREE(p);
+}
+
+/*
+ * Lay out NUM_TRIS right triangles with edges of the given length on a
+ * grid covering the render target.  The grid origin is slightly off the
+ * pixel centers so that sub-pixel triangles hit the "covers nothing"
+ * case most of the time, as they do in real workloads.
+ */
+static void fill_vbuf(struct program *p, float size)
+{
+	float (*verts)[2][4];
+	float step = size < 1.0f ? 1.0f : size + 1.0f;
+	int per_row = (int)(WIDTH / step);
+	int per_col = (int)(HEIGHT / step);
+	int i;
+
+	verts = MALLOC(NUM_TRIS * 3 * sizeof(*verts));
+
+	for (i = 0; i < NUM_TRIS; i++) {
+		int cell = i % (per_row * per_col);
+		float x = (cell % per_row) * step + 0.125f;
+		float y = (cell / per_row) * step + 0.125f;
+		float *pos[3];
+		int j;
+
+		for (j = 0; j < 3; j++) {
+			pos[j] = verts[i * 3 + j][0];
+			pos[j][2] = 0.0f;
+			pos[j][3] = 1.0f;
+			verts[i * 3 + j][1][0] = (float)(j == 0);
+			verts[i * 3 + j][1][1] = (float)(j == 1);
+			verts[i * 3 + j][1][2] = (float)(j == 2);
+			verts[i * 3 + j][1][3] = 1.0f;
+		}
+
+		/* window coordinates to NDC */
+		pos[0][0] = WIN_TO_NDC(x, WIDTH);
+		pos[0][1] = WIN_TO_NDC(y, HEIGHT);
+		pos[1][0] = WIN_TO_NDC(x + size, WIDTH);
+		pos[1][1] = WIN_TO_NDC(y, HEIGHT);
+		pos[2][0] = WIN_TO_NDC(x, WIDTH);
+		pos[2][1] = WIN_TO_NDC(y + size, HEIGHT);
+	}
+
+	pipe_buffer_write(p->pipe, p->vbuf, 0,
+			  NUM_TRIS * 3 * sizeof(*verts), verts);
+
+	FREE(verts);
+}
+
+static void bench(struct program *p, const char *name, float size)
+{
+	struct pipe_fence_handle *fence = NULL;
+	int64_t start, end;
+	double secs;
+	int i;
+
+	fill_vbuf(p, size);
+
+	/* warm up, this compiles shader variants etc. */
+	util_draw_vertex_buffer(p->pipe, p->cso,
+	                        p->vbuf, 0, 0,
+	                        PIPE_PRIM_TRIANGLES,
+	                        3,  /* verts */
+	                        2); /* attribs/vert */
+	p->pipe->flush(p->pipe, &fence, 0);
+	p->screen->fence_finish(p->screen, NULL, fence,
+				 PIPE_TIMEOUT_INFINITE);
+	p->screen->fence_reference(p->screen, &fence, NULL);
+
+	start = os_time_get_nano();
+
+	for (i = 0; i < NUM_LOOPS; i++) {
+		util_draw_vertex_buffer(p->pipe, p->cso,
+		                        p->vbuf, 0, 0,
+		                        PIPE_PRIM_TRIANGLES,
+		                        NUM_TRIS * 3, /* verts */
+		                        2);           /* attribs/vert */
+	}
+
+	p->pipe->flush(p->pipe, &fence, 0);
+	p->screen->fence_finish(p->screen, NULL, fence,
+				 PIPE_TIMEOUT_INFINITE);
+	p->screen->fence_reference(p->screen, &fence, NULL);
+
+	end = os_time_get_nano();
+
+	secs = (end - start) / 1000000000.0;
+	printf("%-8s %6.2f px: %10.0f tris/s %10.0f verts/s (%.3f ms)\n",
+	       name, size,
+	       (double)NUM_TRIS * NUM_LOOPS / secs,
+	       (double)NUM_TRIS * NUM_LOOPS * 3 / secs,
+	       secs * 1000.0);
+}
+
+static void draw(struct program *p)
+{
+	unsigned i;
+
+	/* set the render target */
+	cso_set_framebuffer(p->cso, &p->framebuffer);
+
+	/* clear the render target */
+	p->pipe->clear(p->pipe, PIPE_CLEAR_COLOR, &p->clear_color, 0, 0);
+
+	/* set misc state we care about */
+	cso_set_blend(p->cso, &p->blend);
+	cso_set_depth_stencil_alpha(p->cso, &p->depthstencil);
+	cso_set_rasterizer(p->cso, &p->rasterizer);
+	cso_set_viewport(p->cso, &p->viewport);
+
+	/* shaders */
+	cso_set_fragment_shader_handle(p->cso, p->fs);
+	cso_set_vertex_shader_handle(p->cso, p->vs);
+
+	/* vertex element data */
+	cso_set_vertex_elements(p->cso, 2, p->velem);
+
+	for (i = 0; i < ARRAY_SIZE(tri_sizes); i++)
+		bench(p, "drawn", tri_sizes[i]);
+
+	/* cull everything, leaving mostly vertex processing */
+	p->rasterizer.cull_face = PIPE_FACE_FRONT_AND_BACK;
+	cso_set_rasterizer(p->cso, &p->rasterizer);
+	bench(p, "culled", 4.0f);
+}
+
+int main(int argc, char** argv)
+{
+	struct program *p = CALLOC_STRUCT(program);
+
+	init_prog(p);
+	draw(p);
+	close_prog(p);
+
+	return 0;
+}
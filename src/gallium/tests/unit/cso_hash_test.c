@@ -0,0 +1,196 @@
+/**************************************************************************
+ *
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * cso_hash tests and state object lookup benchmark.
+ *
+ * Checks insertion, lookup through the collision lists, removal and
+ * iteration against a reference array, then measures how many blend state
+ * lookups per second the CSO cache sustains for a working set similar to a
+ * draw-call heavy frame, including lookups which miss.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cso_cache/cso_cache.h"
+#include "cso_cache/cso_hash.h"
+#include "os/os_time.h"
+#include "util/u_memory.h"
+
+
+#define NUM_ENTRIES 20000
+#define NUM_LOOKUPS 4000000
+
+
+static int
+test_hash(void)
+{
+   static unsigned values[NUM_ENTRIES];
+   static boolean present[NUM_ENTRIES];
+   struct cso_hash *hash = cso_hash_create();
+   struct cso_hash_iter iter;
+   unsigned i, count, failures = 0;
+
+   /* Few distinct keys, so that the collision lists are long. */
+   for (i = 0; i < NUM_ENTRIES; i++) {
+      values[i] = i;
+      present[i] = TRUE;
+      cso_hash_insert(hash, i % 997, &values[i]);
+   }
+
+   /* Remove every third entry through the collision lists. */
+   for (i = 0; i < NUM_ENTRIES; i += 3) {
+      iter = cso_hash_find(hash, i % 997);
+      while (!cso_hash_iter_is_null(iter) && cso_hash_iter_data(iter) != &values[i])
+         iter = cso_hash_iter_next(iter);
+      if (cso_hash_iter_is_null(iter)) {
+         failures++;
+         continue;
+      }
+      cso_hash_erase(hash, iter);
+      present[i] = FALSE;
+   }
+
+   /* Every remaining entry must be found with its key. */
+   for (i = 0; i < NUM_ENTRIES; i++) {
+      boolean found = FALSE;
+
+      iter = cso_hash_find(hash, i % 997);
+      while (!cso_hash_iter_is_null(iter)) {
+         if (cso_hash_iter_key(iter) != i % 997)
+            failures++;
+         if (cso_hash_iter_data(iter) == &values[i])
+            found = TRUE;
+         iter = cso_hash_iter_next(iter);
+      }
+      if (found != present[i])
+         failures++;
+   }
+
+   /* Iteration visits every live entry exactly once. */
+   count = 0;
+   for (iter = cso_hash_first_node(hash); !cso_hash_iter_is_null(iter);
+        iter = cso_hash_iter_next(iter)) {
+      unsigned *value = cso_hash_iter_data(iter);
+
+      if (!present[*value])
+         failures++;
+      count++;
+   }
+   if (count != (unsigned)cso_hash_size(hash))
+      failures++;
+
+   /* Empty it while iterating. */
+   iter = cso_hash_first_node(hash);
+   while (!cso_hash_iter_is_null(iter))
+      iter = cso_hash_erase(hash, iter);
+   if (cso_hash_size(hash) != 0 || cso_hash_contains(hash, 1))
+      failures++;
+
+   cso_hash_delete(hash);
+
+   printf("cso_hash: %s\n", failures ? "FAIL" : "PASS");
+   return failures != 0;
+}
+
+
+static void
+make_blend_state(struct pipe_blend_state *blend, unsigned seed)
+{
+   memset(blend, 0, sizeof *blend);
+   blend->rt[0].blend_enable = 1;
+   blend->rt[0].colormask = seed & 0xf;
+   blend->rt[0].rgb_src_factor = (seed >> 4) & 0x1f;
+   blend->rt[0].rgb_dst_factor = (seed >> 9) & 0x1f;
+   blend->rt[0].alpha_src_factor = (seed >> 14) & 0x1f;
+}
+
+
+static void
+bench_lookups(unsigned num_states)
+{
+   struct pipe_blend_state *templ = CALLOC(num_states, sizeof *templ);
+   unsigned *keys = CALLOC(num_states, sizeof *keys);
+   unsigned *order = CALLOC(NUM_LOOKUPS, sizeof *order);
+   const unsigned key_size = (char *)&templ[0].rt[1] - (char *)&templ[0];
+   struct cso_cache *cache = cso_cache_create();
+   unsigned i, hits = 0;
+   int64_t start, end;
+
+   cso_set_maximum_cache_size(cache, 2 * num_states);
+
+   for (i = 0; i < num_states; i++) {
+      make_blend_state(&templ[i], i);
+      keys[i] = cso_construct_key(&templ[i], key_size);
+
+      /* Insert three quarters of the states; the rest will miss. */
+      if (i % 4) {
+         struct cso_blend *cso = CALLOC_STRUCT(cso_blend);
+
+         memcpy(&cso->state, &templ[i], key_size);
+         cso_insert_state(cache, keys[i], CSO_BLEND, cso);
+      }
+   }
+
+   srand(0);
+   for (i = 0; i < NUM_LOOKUPS; i++)
+      order[i] = rand() % num_states;
+
+   start = os_time_get_nano();
+   for (i = 0; i < NUM_LOOKUPS; i++) {
+      unsigned s = order[i];
+      struct cso_hash_iter iter =
+         cso_find_state_template(cache, keys[s], CSO_BLEND, &templ[s],
+                                 key_size);
+
+      hits += !cso_hash_iter_is_null(iter);
+   }
+   end = os_time_get_nano();
+
+   printf("cso_cache: %6u blend states, %u%% hits, %6.1f M lookups/s\n",
+          num_states, hits * 100 / NUM_LOOKUPS,
+          NUM_LOOKUPS * 1000.0 / (end - start));
+
+   cso_cache_delete(cache);
+   FREE(templ);
+   FREE(keys);
+   FREE(order);
+}
+
+
+int main(int argc, char **argv)
+{
+   int ret = test_hash();
+
+   bench_lookups(64);
+   bench_lookups(1024);
+   bench_lookups(16384);
+
+   return ret;
+}
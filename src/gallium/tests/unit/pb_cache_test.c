@@ -0,0 +1,149 @@
+/**************************************************************************
+ *
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * pb_cache allocation microbenchmark.
+ *
+ * Simulates a streaming workload: every iteration asks the cache for a
+ * buffer of a random size, allocating a new one on a miss, and releases
+ * the oldest buffer in flight back to the cache.  Also checks that every
+ * reclaimed buffer is compatible with the request.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pipebuffer/pb_cache.h"
+#include "os/os_time.h"
+#include "util/u_memory.h"
+
+
+#define NUM_ITERATIONS 1000000
+#define NUM_IN_FLIGHT  256
+#define NUM_BUCKETS    4
+
+
+struct test_buffer
+{
+   struct pb_buffer base;
+   struct pb_cache_entry cache_entry;
+};
+
+
+static unsigned num_allocated = 0;
+
+
+static void
+test_destroy_buffer(struct pb_buffer *buf)
+{
+   FREE(buf);
+   num_allocated--;
+}
+
+
+static bool
+test_can_reclaim(struct pb_buffer *buf)
+{
+   return true;
+}
+
+
+static struct test_buffer *
+test_create_buffer(struct pb_cache *cache, pb_size size, unsigned bucket)
+{
+   struct test_buffer *buf = CALLOC_STRUCT(test_buffer);
+
+   pipe_reference_init(&buf->base.reference, 1);
+   buf->base.size = size;
+   buf->base.alignment = 4096;
+   buf->base.usage = bucket;
+   pb_cache_init_entry(cache, &buf->cache_entry, &buf->base, bucket);
+   num_allocated++;
+   return buf;
+}
+
+
+int main(int argc, char **argv)
+{
+   struct test_buffer *in_flight[NUM_IN_FLIGHT] = {0};
+   struct pb_cache cache;
+   unsigned hits = 0, failures = 0;
+   int64_t start, end;
+   unsigned i;
+
+   pb_cache_init(&cache, 1000000, 2.0f, 0, 256 * 1024 * 1024,
+                 test_destroy_buffer, test_can_reclaim);
+   srand(0);
+
+   start = os_time_get_nano();
+
+   for (i = 0; i < NUM_ITERATIONS; i++) {
+      unsigned slot = i % NUM_IN_FLIGHT;
+      unsigned bucket = rand() % NUM_BUCKETS;
+      pb_size size = align(1 + rand() % (1024 * 1024), 4096);
+      struct pb_buffer *reclaimed;
+
+      if (in_flight[slot]) {
+         pipe_reference(&in_flight[slot]->base.reference, NULL);
+         pb_cache_add_buffer(&in_flight[slot]->cache_entry);
+         in_flight[slot] = NULL;
+      }
+
+      reclaimed = pb_cache_reclaim_buffer(&cache, size, 4096, bucket, bucket);
+      if (reclaimed) {
+         if (reclaimed->size < size || reclaimed->size > 2 * size ||
+             reclaimed->usage != bucket)
+            failures++;
+         in_flight[slot] = (struct test_buffer *)reclaimed;
+         hits++;
+      } else {
+         in_flight[slot] = test_create_buffer(&cache, size, bucket);
+      }
+   }
+
+   end = os_time_get_nano();
+
+   for (i = 0; i < NUM_IN_FLIGHT; i++) {
+      if (in_flight[i]) {
+         pipe_reference(&in_flight[i]->base.reference, NULL);
+         test_destroy_buffer(&in_flight[i]->base);
+      }
+   }
+   pb_cache_deinit(&cache);
+
+   printf("%u allocations, %u cache hits, %.1f ns per allocation\n",
+          NUM_ITERATIONS, hits, (double)(end - start) / NUM_ITERATIONS);
+
+   if (failures || num_allocated) {
+      printf("FAILED: %u incompatible buffers, %u leaked\n",
+             failures, num_allocated);
+      return 1;
+   }
+
+   return 0;
+}
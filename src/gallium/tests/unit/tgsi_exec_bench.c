@@ -0,0 +1,244 @@
+/**************************************************************************
+ *
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Benchmark for the tgsi_exec interpreter.
+ *
+ * Runs a few vertex shaders on quads of vertices the way draw's non-LLVM
+ * path does, and reports quads and instructions executed per second.
+ * Compare runs of builds with and without a tgsi_exec change to measure
+ * it.  A checksum of the outputs is printed too, so that such runs can
+ * also be checked for identical results.
+ *
+ * Usage: tgsi_exec_bench [-n quads] [shader ...]
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "os/os_time.h"
+#include "tgsi/tgsi_exec.h"
+#include "tgsi/tgsi_text.h"
+#include "util/u_memory.h"
+
+
+#define NUM_TOKENS 1024
+#define NUM_CONSTS 16
+
+
+/* fixed function like transform and lighting */
+static const char transform_text[] =
+   "VERT\n"
+   "DCL IN[0]\n"
+   "DCL IN[1]\n"
+   "DCL IN[2]\n"
+   "DCL OUT[0], POSITION\n"
+   "DCL OUT[1], COLOR\n"
+   "DCL OUT[2], GENERIC[0]\n"
+   "DCL CONST[0..15]\n"
+   "DCL TEMP[0..2]\n"
+   "IMM[0] FLT32 { 0.0, 1.0, 0.5, 16.0 }\n"
+   "  0: MUL TEMP[0], IN[0].xxxx, CONST[0]\n"
+   "  1: MAD TEMP[0], IN[0].yyyy, CONST[1], TEMP[0]\n"
+   "  2: MAD TEMP[0], IN[0].zzzz, CONST[2], TEMP[0]\n"
+   "  3: MAD OUT[0], IN[0].wwww, CONST[3], TEMP[0]\n"
+   "  4: MUL TEMP[1], IN[1].xxxx, CONST[4]\n"
+   "  5: MAD TEMP[1], IN[1].yyyy, CONST[5], TEMP[1]\n"
+   "  6: MAD TEMP[1], IN[1].zzzz, CONST[6], TEMP[1]\n"
+   "  7: DP3 TEMP[2].x, TEMP[1], CONST[8]\n"
+   "  8: MAX TEMP[2].x, TEMP[2].xxxx, IMM[0].xxxx\n"
+   "  9: MAD TEMP[2], TEMP[2].xxxx, CONST[9], CONST[10]\n"
+   " 10: MIN OUT[1], TEMP[2], IMM[0].yyyy\n"
+   " 11: MOV OUT[2], IN[2]\n"
+   " 12: END\n";
+
+/* long chain of the plain float ALU ops */
+static const char alu_text[] =
+   "VERT\n"
+   "DCL IN[0]\n"
+   "DCL IN[1]\n"
+   "DCL OUT[0], POSITION\n"
+   "DCL OUT[1], GENERIC[0]\n"
+   "DCL CONST[0..15]\n"
+   "DCL TEMP[0..3]\n"
+   "  0: ADD TEMP[0], IN[0], CONST[0]\n"
+   "  1: MUL TEMP[1], IN[1], CONST[1]\n"
+   "  2: MAD TEMP[2], TEMP[0], TEMP[1], CONST[2]\n"
+   "  3: SUB TEMP[3], TEMP[2], TEMP[0]\n"
+   "  4: LRP TEMP[0], CONST[3], TEMP[3], TEMP[1]\n"
+   "  5: MIN TEMP[1], TEMP[0], CONST[4]\n"
+   "  6: MAX TEMP[2], TEMP[1], -CONST[4]\n"
+   "  7: MAD TEMP[3], TEMP[2], CONST[5], |TEMP[0]|\n"
+   "  8: ADD TEMP[0], TEMP[3], -TEMP[1]\n"
+   "  9: MUL TEMP[1], TEMP[0], CONST[6]\n"
+   " 10: MAD TEMP[2], TEMP[1], CONST[7], TEMP[3]\n"
+   " 11: LRP TEMP[3], CONST[3], TEMP[2], TEMP[0]\n"
+   " 12: MOV_SAT TEMP[0], TEMP[3]\n"
+   " 13: ADD OUT[0], TEMP[0], TEMP[2]\n"
+   " 14: MOV OUT[1], TEMP[1]\n"
+   " 15: END\n";
+
+/* transcendentals and swizzles, which have no vector paths */
+static const char math_text[] =
+   "VERT\n"
+   "DCL IN[0]\n"
+   "DCL OUT[0], POSITION\n"
+   "DCL OUT[1], GENERIC[0]\n"
+   "DCL CONST[0..15]\n"
+   "DCL TEMP[0..1]\n"
+   "IMM[0] FLT32 { 0.0, 1.0, 0.5, 16.0 }\n"
+   "  0: DP3 TEMP[0].x, IN[0], IN[0]\n"
+   "  1: RSQ TEMP[0].x, TEMP[0].xxxx\n"
+   "  2: MUL TEMP[1], IN[0], TEMP[0].xxxx\n"
+   "  3: EX2 TEMP[0].y, TEMP[1].xxxx\n"
+   "  4: LG2 TEMP[0].z, TEMP[1].yyyy\n"
+   "  5: RCP TEMP[0].w, IMM[0].wwww\n"
+   "  6: FRC TEMP[1], TEMP[1].wzyx\n"
+   "  7: POW TEMP[0].x, TEMP[0].yyyy, IMM[0].zzzz\n"
+   "  8: MOV OUT[0], TEMP[0]\n"
+   "  9: MOV OUT[1], TEMP[1]\n"
+   " 10: END\n";
+
+static const struct {
+   const char *name;
+   const char *text;
+   unsigned num_inputs;
+   unsigned num_outputs;
+} shaders[] = {
+   { "transform", transform_text, 3, 3 },
+   { "alu", alu_text, 2, 2 },
+   { "math", math_text, 1, 2 },
+};
+
+
+static void
+run_shader(unsigned s, unsigned num_quads)
+{
+   struct tgsi_token tokens[NUM_TOKENS];
+   struct tgsi_exec_machine *mach;
+   float consts[NUM_CONSTS][4];
+   const void *bufs[PIPE_MAX_CONSTANT_BUFFERS];
+   unsigned buf_sizes[PIPE_MAX_CONSTANT_BUFFERS];
+   unsigned i, slot, chan, j;
+   int64_t start, end;
+   double secs, checksum = 0.0;
+
+   if (!tgsi_text_translate(shaders[s].text, tokens, NUM_TOKENS)) {
+      fprintf(stderr, "%s: failed to translate shader\n", shaders[s].name);
+      exit(1);
+   }
+
+   for (i = 0; i < NUM_CONSTS; i++) {
+      for (chan = 0; chan < 4; chan++)
+         consts[i][chan] = (float)((i * 4 + chan) % 7) * 0.25f - 0.5f;
+   }
+
+   memset(bufs, 0, sizeof bufs);
+   memset(buf_sizes, 0, sizeof buf_sizes);
+   bufs[0] = consts;
+   buf_sizes[0] = sizeof consts;
+
+   mach = tgsi_exec_machine_create(PIPE_SHADER_VERTEX);
+   tgsi_exec_machine_bind_shader(mach, tokens, NULL, NULL, NULL);
+   tgsi_exec_set_constant_buffers(mach, PIPE_MAX_CONSTANT_BUFFERS,
+                                  bufs, buf_sizes);
+   mach->NonHelperMask = (1 << TGSI_QUAD_SIZE) - 1;
+
+   start = os_time_get_nano();
+
+   for (i = 0; i < num_quads; i++) {
+      for (slot = 0; slot < shaders[s].num_inputs; slot++) {
+         for (chan = 0; chan < 4; chan++) {
+            for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+               mach->Inputs[slot].xyzw[chan].f[j] =
+                  (float)((i + j + slot + chan) & 255) * (1.0f / 64.0f) + 0.125f;
+            }
+         }
+      }
+
+      tgsi_exec_machine_run(mach, 0);
+
+      checksum += mach->Outputs[0].xyzw[0].f[i % TGSI_QUAD_SIZE];
+   }
+
+   end = os_time_get_nano();
+
+   for (slot = 0; slot < shaders[s].num_outputs; slot++) {
+      for (chan = 0; chan < 4; chan++) {
+         for (j = 0; j < TGSI_QUAD_SIZE; j++)
+            checksum += mach->Outputs[slot].xyzw[chan].f[j];
+      }
+   }
+
+   secs = (end - start) / 1000000000.0;
+   printf("%-10s %10.0f quads/s %8.1f Minstr/s  checksum %f\n",
+          shaders[s].name, num_quads / secs,
+          num_quads * (double)mach->NumInstructions / secs / 1000000.0,
+          checksum);
+
+   tgsi_exec_machine_destroy(mach);
+}
+
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_quads = 1000000;
+   unsigned s;
+   int i, selected = 0;
+
+   for (i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+         num_quads = atoi(argv[++i]);
+         if (!num_quads) {
+            fprintf(stderr, "invalid number of quads\n");
+            return 1;
+         }
+      }
+      else {
+         selected++;
+      }
+   }
+
+   for (s = 0; s < ARRAY_SIZE(shaders); s++) {
+      boolean run = !selected;
+
+      for (i = 1; i < argc; i++) {
+         if (strcmp(argv[i], "-n") == 0)
+            i++;
+         else if (strcmp(argv[i], shaders[s].name) == 0)
+            run = TRUE;
+      }
+
+      if (run)
+         run_shader(s, num_quads);
+   }
+
+   return 0;
+}
@@ -30,6 +30,7 @@
 #include "util/u_half.h"
 #include "util/u_cpu_detect.h"
 #include "rtasm/rtasm_cpu.h"
+#include "os/os_time.h"
 
 /* don't use this for serious use */
 static double rand_double()
@@ -46,6 +47,89 @@ static double rand_double()
    return v;
 }
 
+/**
+ * Measure the throughput of the vertex fetch backends for a few common
+ * vertex formats, converting to the float4 layout used by draw.
+ */
+static int
+run_benchmark(void)
+{
+   static const enum pipe_format formats[] = {
+      PIPE_FORMAT_R32G32B32A32_FLOAT,
+      PIPE_FORMAT_R32G32B32_FLOAT,
+      PIPE_FORMAT_R16G16B16A16_FLOAT,
+      PIPE_FORMAT_R16G16_SNORM,
+      PIPE_FORMAT_R8G8B8A8_UNORM,
+      PIPE_FORMAT_R10G10B10A2_SNORM,
+   };
+   static const struct {
+      const char *name;
+      struct translate *(*create)(const struct translate_key *key);
+   } backends[] = {
+      { "generic", translate_generic_create },
+      { "sse2", translate_sse2_create },
+      { "avx2", translate_avx2_create },
+   };
+   const unsigned num_verts = 65536;
+   const unsigned num_loops = 64;
+   const unsigned input_stride = 16;
+   const unsigned output_stride = 16;
+   unsigned char *input = align_malloc(num_verts * input_stride, 64);
+   unsigned char *output = align_malloc(num_verts * output_stride, 64);
+   unsigned *elts = align_malloc(num_verts * sizeof *elts, 64);
+   struct translate_key key;
+   unsigned i, j, k;
+
+   for (i = 0; i < num_verts * input_stride; ++i)
+      input[i] = rand();
+
+   /* mostly sequential indices with some reuse, like a typical mesh */
+   for (i = 0; i < num_verts; ++i)
+      elts[i] = MIN2(i / 2 + (rand() & 7), num_verts - 1);
+
+   memset(&key, 0, sizeof key);
+   key.nr_elements = 1;
+   key.output_stride = output_stride;
+   key.element[0].type = TRANSLATE_ELEMENT_NORMAL;
+   key.element[0].output_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+   for (i = 0; i < ARRAY_SIZE(formats); ++i) {
+      key.element[0].input_format = formats[i];
+
+      printf("%-36s", util_format_name(formats[i]));
+
+      for (j = 0; j < ARRAY_SIZE(backends); ++j) {
+         struct translate *translate = backends[j].create(&key);
+         int64_t start, end;
+
+         if (!translate) {
+            printf("  %7s: %8s", backends[j].name, "n/a");
+            continue;
+         }
+
+         translate->set_buffer(translate, 0, input, input_stride,
+                               num_verts - 1);
+
+         start = os_time_get_nano();
+         for (k = 0; k < num_loops; ++k)
+            translate->run_elts(translate, elts, num_verts, 0, 0, output);
+         end = os_time_get_nano();
+
+         printf("  %7s: %8.1f", backends[j].name,
+                (double)num_verts * num_loops * 1000.0 / (end - start));
+
+         translate->release(translate);
+      }
+
+      printf("  Mverts/s\n");
+   }
+
+   align_free(input);
+   align_free(output);
+   align_free(elts);
+   return 0;
+}
+
 int main(int argc, char** argv)
 {
    struct translate *(*create_fn)(const struct translate_key *key) = 0;
@@ -77,6 +161,17 @@ int main(int argc, char** argv)
       create_fn = translate_generic_create;
    else if (!strcmp(argv[1], "x86"))
       create_fn = translate_sse2_create;
+   else if (!strcmp(argv[1], "avx2"))
+   {
+      if(!util_cpu_caps.has_avx2)
+      {
+         printf("Error: CPU doesn't support AVX2\n");
+         return 2;
+      }
+      create_fn = translate_avx2_create;
+   }
+   else if (!strcmp(argv[1], "bench"))
+      return run_benchmark();
    else if (!strcmp(argv[1], "nosse"))
    {
       util_cpu_caps.has_sse = 0;
@@ -130,7 +225,7 @@ int main(int argc, char** argv)
 
    if (!create_fn)
    {
-      printf("Usage: ./translate_test [default|generic|x86|nosse|sse|sse2|sse3|sse4.1]\n");
+      printf("Usage: ./translate_test [default|generic|x86|avx2|nosse|sse|sse2|sse3|sse4.1|bench]\n");
       return 2;
    }
 
@@ -0,0 +1,263 @@
+/**************************************************************************
+ *
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Upload manager buffer recycling test.
+ *
+ * Runs u_upload_mgr on a fake screen with persistent mappings, whose
+ * transfers reference the mapped buffer like the llvmpipe and softpipe
+ * ones do, and checks that a full buffer is reused once its fence has
+ * signalled and nothing but the upload manager references it, and only
+ * then.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_upload_mgr.h"
+
+
+#define BUFFER_SIZE 4096
+
+
+struct test_buffer
+{
+   struct pipe_resource base;
+   uint8_t data[BUFFER_SIZE];
+};
+
+
+static unsigned num_created = 0;
+static unsigned num_buffers = 0;
+static boolean fence_signalled = TRUE;
+
+
+static int
+test_get_param(struct pipe_screen *screen, enum pipe_cap param)
+{
+   return param == PIPE_CAP_BUFFER_MAP_PERSISTENT_COHERENT;
+}
+
+
+static struct pipe_resource *
+test_resource_create(struct pipe_screen *screen,
+                     const struct pipe_resource *templat)
+{
+   struct test_buffer *buf;
+
+   if (templat->width0 > BUFFER_SIZE)
+      return NULL;
+
+   buf = CALLOC_STRUCT(test_buffer);
+   if (!buf)
+      return NULL;
+
+   buf->base = *templat;
+   buf->base.screen = screen;
+   pipe_reference_init(&buf->base.reference, 1);
+
+   num_created++;
+   num_buffers++;
+   return &buf->base;
+}
+
+
+static void
+test_resource_destroy(struct pipe_screen *screen,
+                      struct pipe_resource *resource)
+{
+   FREE(resource);
+   num_buffers--;
+}
+
+
+static void
+test_fence_reference(struct pipe_screen *screen,
+                     struct pipe_fence_handle **ptr,
+                     struct pipe_fence_handle *fence)
+{
+   *ptr = fence;
+}
+
+
+static boolean
+test_fence_finish(struct pipe_screen *screen,
+                  struct pipe_context *ctx,
+                  struct pipe_fence_handle *fence,
+                  uint64_t timeout)
+{
+   return fence_signalled;
+}
+
+
+static void *
+test_transfer_map(struct pipe_context *pipe,
+                  struct pipe_resource *resource,
+                  unsigned level,
+                  unsigned usage,
+                  const struct pipe_box *box,
+                  struct pipe_transfer **transfer)
+{
+   struct pipe_transfer *pt = CALLOC_STRUCT(pipe_transfer);
+
+   if (!pt)
+      return NULL;
+
+   /* like llvmpipe and softpipe, hold a reference while mapped */
+   pipe_resource_reference(&pt->resource, resource);
+   pt->usage = usage;
+   pt->box = *box;
+
+   *transfer = pt;
+   return ((struct test_buffer *)resource)->data + box->x;
+}
+
+
+static void
+test_transfer_flush_region(struct pipe_context *pipe,
+                           struct pipe_transfer *transfer,
+                           const struct pipe_box *box)
+{
+}
+
+
+static void
+test_transfer_unmap(struct pipe_context *pipe,
+                    struct pipe_transfer *transfer)
+{
+   pipe_resource_reference(&transfer->resource, NULL);
+   FREE(transfer);
+}
+
+
+/**
+ * Fill the current upload buffer, so that the next upload needs a new one,
+ * and return the buffer filled.
+ */
+static struct pipe_resource *
+fill_buffer(struct u_upload_mgr *upload)
+{
+   struct pipe_resource *buffer = NULL;
+   unsigned offset;
+   void *ptr;
+
+   u_upload_alloc(upload, 0, BUFFER_SIZE, 4, &offset, &buffer, &ptr);
+   if (!ptr) {
+      printf("Failure! Couldn't allocate upload space.\n");
+      exit(1);
+   }
+
+   return buffer;
+}
+
+
+static unsigned
+check(boolean ok, const char *what)
+{
+   if (!ok)
+      printf("Failed: %s\n", what);
+   return ok ? 0 : 1;
+}
+
+
+int
+main(int argc, char **argv)
+{
+   struct pipe_screen screen;
+   struct pipe_context pipe;
+   struct pipe_fence_handle *fence = (struct pipe_fence_handle *)&screen;
+   struct pipe_resource *a, *b, *c, *d;
+   struct u_upload_mgr *upload;
+   unsigned fails = 0;
+
+   memset(&screen, 0, sizeof screen);
+   screen.get_param = test_get_param;
+   screen.resource_create = test_resource_create;
+   screen.resource_destroy = test_resource_destroy;
+   screen.fence_reference = test_fence_reference;
+   screen.fence_finish = test_fence_finish;
+
+   memset(&pipe, 0, sizeof pipe);
+   pipe.screen = &screen;
+   pipe.transfer_map = test_transfer_map;
+   pipe.transfer_flush_region = test_transfer_flush_region;
+   pipe.transfer_unmap = test_transfer_unmap;
+
+   upload = u_upload_create(&pipe, BUFFER_SIZE, PIPE_BIND_VERTEX_BUFFER,
+                            PIPE_USAGE_STREAM);
+   if (!upload) {
+      printf("Failure! Couldn't create the upload manager.\n");
+      return 1;
+   }
+
+   /* The buffers are only recycled once the owner provides fences. */
+   u_upload_fence(upload, fence);
+
+   /* a is retired without a fence, so b has to be a new buffer. */
+   a = fill_buffer(upload);
+   b = fill_buffer(upload);
+   fails += check(b != a, "reused a buffer before it was fenced");
+
+   /* a is fenced and no longer bound, so it is taken back. */
+   pipe_resource_reference(&a, NULL);
+   u_upload_fence(upload, fence);
+   c = fill_buffer(upload);
+   fails += check(num_created == 2, "didn't reuse a retired buffer");
+
+   /* b is still bound, so d has to be a new buffer. */
+   u_upload_fence(upload, fence);
+   d = fill_buffer(upload);
+   fails += check(d != b && d != c, "reused a buffer still referenced");
+   fails += check(num_created == 3, "didn't create a new buffer");
+
+   /* c isn't referenced anymore, but the GPU isn't done with it. */
+   pipe_resource_reference(&c, NULL);
+   u_upload_fence(upload, fence);
+   fence_signalled = FALSE;
+   pipe_resource_reference(&d, NULL);
+   d = fill_buffer(upload);
+   fails += check(num_created == 4, "reused a buffer still in use");
+   fence_signalled = TRUE;
+
+   pipe_resource_reference(&b, NULL);
+   pipe_resource_reference(&d, NULL);
+   u_upload_destroy(upload);
+   fails += check(num_buffers == 0, "leaked upload buffers");
+
+   if (fails)
+      printf("Failure! %u checks failed.\n", fails);
+   else
+      printf("Success!\n");
+
+   return fails ? 1 : 0;
+}
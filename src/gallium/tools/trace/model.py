@@ -119,13 +119,14 @@ class Pointer(Node):
 
 class Call:
     
-    def __init__(self, no, klass, method, args, ret, time):
+    def __init__(self, no, klass, method, args, ret, time, caller_time = None):
         self.no = no
         self.klass = klass
         self.method = method
         self.args = args
         self.ret = ret
         self.time = time
+        self.caller_time = caller_time
         
     def visit(self, visitor):
         visitor.visit_call(self)
@@ -215,6 +215,7 @@ class TraceParser(XmlParser):
         args = []
         ret = None
         time = None
+        caller_time = None
         while self.token.type == ELEMENT_START:
             if self.token.name_or_data == 'arg':
                 arg = self.parse_arg()
@@ -226,11 +227,13 @@ class TraceParser(XmlParser):
                 self.parse_call()
             elif self.token.name_or_data == 'time':
                 time = self.parse_time()
+            elif self.token.name_or_data == 'caller_time':
+                caller_time = self.parse_time('caller_time')
             else:
                 raise TokenMismatch("<arg ...> or <ret ...>", self.token)
         self.element_end('call')
         
-        return Call(no, klass, method, args, ret, time)
+        return Call(no, klass, method, args, ret, time, caller_time)
 
     def parse_arg(self):
         attrs = self.element_start('arg')
@@ -247,10 +250,10 @@ class TraceParser(XmlParser):
 
         return value
 
-    def parse_time(self):
-        attrs = self.element_start('time')
+    def parse_time(self, name = 'time'):
+        attrs = self.element_start(name)
         time = self.parse_value();
-        self.element_end('time')
+        self.element_end(name)
         return time
 
     def parse_value(self):
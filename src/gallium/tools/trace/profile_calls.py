@@ -0,0 +1,129 @@
+#!/usr/bin/env python
+##########################################################################
+# 
+# Copyright 2016 The Mesa Authors
+# 
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sub license, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+# 
+# The above copyright notice and this permission notice (including the
+# next paragraph) shall be included in all copies or substantial portions
+# of the Software.
+# 
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+# OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+# ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+# 
+##########################################################################
+
+
+"""Per-call CPU time statistics for a gallium trace.
+
+For every class::method it reports how often it was called, the time spent
+in the driver below the trace wrapper ("time") and the time spent by the
+caller since the previous call returned ("caller_time"), along with a log2
+histogram of the latter.  With GALLIUM_NOOP=1 the driver does nothing, so
+the caller time is the CPU cost of the API and the state tracker for each
+gallium call.  All times are in microseconds.
+"""
+
+
+import sys
+
+import parse
+from parse import *
+
+
+class CallStats:
+
+    def __init__(self, name):
+        self.name = name
+        self.count = 0
+        self.time = 0
+        self.caller_time = 0
+        self.histogram = {}
+
+    def add(self, time, caller_time):
+        self.count += 1
+        self.time += time
+        if caller_time is not None:
+            self.caller_time += caller_time
+            bucket = 0
+            while (1 << bucket) <= caller_time:
+                bucket += 1
+            self.histogram[bucket] = self.histogram.get(bucket, 0) + 1
+
+
+class Profiler(TraceParser):
+
+    def __init__(self, fp):
+        TraceParser.__init__(self, fp)
+        self.stats = {}
+
+    def handle_call(self, call):
+        name = '%s::%s' % (call.klass, call.method)
+        try:
+            stats = self.stats[name]
+        except KeyError:
+            stats = self.stats[name] = CallStats(name)
+
+        time = 0
+        if call.time is not None:
+            time = call.time.value
+        caller_time = None
+        if call.caller_time is not None:
+            caller_time = call.caller_time.value
+        stats.add(time, caller_time)
+
+    def report(self, num_histograms, out = sys.stdout):
+        calls = sorted(self.stats.values(),
+                       key = lambda stats: stats.caller_time + stats.time,
+                       reverse = True)
+        total = sum([stats.caller_time + stats.time for stats in calls])
+
+        out.write('%-48s %10s %12s %12s %7s\n' % (
+            'call', 'count', 'caller us', 'driver us', '%'))
+        for stats in calls:
+            out.write('%-48s %10u %12u %12u %6.2f%%\n' % (
+                stats.name, stats.count, stats.caller_time, stats.time,
+                100.0 * (stats.caller_time + stats.time) / max(total, 1)))
+
+        for stats in calls[:num_histograms]:
+            if not stats.histogram:
+                continue
+            out.write('\n%s caller time:\n' % stats.name)
+            for bucket in sorted(stats.histogram.keys()):
+                count = stats.histogram[bucket]
+                if bucket:
+                    low = 1 << (bucket - 1)
+                else:
+                    low = 0
+                out.write('  %8u .. %8u us: %10u %s\n' % (
+                    low, (1 << bucket) - 1, count,
+                    '#' * (count * 50 // stats.count)))
+
+
+class Main(parse.Main):
+
+    def get_optparser(self):
+        optparser = parse.Main.get_optparser(self)
+        optparser.add_option("-n", "--histograms", action="store", type="int", dest="histograms", default=10, help="number of calls to show histograms for")
+        return optparser
+
+    def process_arg(self, stream, options):
+        profiler = Profiler(stream)
+        profiler.parse()
+        profiler.report(options.histograms)
+
+
+if __name__ == '__main__':
+    Main().main()
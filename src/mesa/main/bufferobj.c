@@ -465,6 +465,7 @@ _mesa_delete_buffer_object(struct gl_context *ctx,
    (void) ctx;
 
    vbo_delete_minmax_cache(bufObj);
+   vbo_delete_restart_cache(bufObj);
    _mesa_align_free(bufObj->Data);
 
    /* assign strange values here to help w/ debugging */
@@ -1572,6 +1573,7 @@ _mesa_buffer_storage(struct gl_context *ctx, struct gl_buffer_object *bufObj,
    bufObj->Written = GL_TRUE;
    bufObj->Immutable = GL_TRUE;
    bufObj->MinMaxCacheDirty = true;
+   bufObj->RestartCacheDirty = true;
 
    assert(ctx->Driver.BufferData);
    if (!ctx->Driver.BufferData(ctx, target, size, data, GL_DYNAMIC_DRAW,
@@ -1686,6 +1688,7 @@ _mesa_buffer_data(struct gl_context *ctx, struct gl_buffer_object *bufObj,
 
    bufObj->Written = GL_TRUE;
    bufObj->MinMaxCacheDirty = true;
+   bufObj->RestartCacheDirty = true;
 
 #ifdef VBO_DEBUG
    printf("glBufferDataARB(%u, sz %ld, from %p, usage 0x%x)\n",
@@ -1799,6 +1802,7 @@ _mesa_buffer_sub_data(struct gl_context *ctx, struct gl_buffer_object *bufObj,
 
    bufObj->Written = GL_TRUE;
    bufObj->MinMaxCacheDirty = true;
+   bufObj->RestartCacheDirty = true;
 
    assert(ctx->Driver.BufferSubData);
    ctx->Driver.BufferSubData(ctx, offset, size, data, bufObj);
@@ -1919,6 +1923,7 @@ _mesa_clear_buffer_sub_data(struct gl_context *ctx,
       return;
 
    bufObj->MinMaxCacheDirty = true;
+   bufObj->RestartCacheDirty = true;
 
    if (data == NULL) {
       /* clear to zeros, per the spec */
@@ -2334,6 +2339,7 @@ _mesa_copy_buffer_sub_data(struct gl_context *ctx,
    }
 
    dst->MinMaxCacheDirty = true;
+   dst->RestartCacheDirty = true;
 
    ctx->Driver.CopyBufferSubData(ctx, src, dst, readOffset, writeOffset, size);
 }
@@ -2543,6 +2549,7 @@ _mesa_map_buffer_range(struct gl_context *ctx,
    if (access & GL_MAP_WRITE_BIT) {
       bufObj->Written = GL_TRUE;
       bufObj->MinMaxCacheDirty = true;
+      bufObj->RestartCacheDirty = true;
    }
 
 #ifdef VBO_DEBUG
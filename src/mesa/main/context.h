@@ -245,6 +245,24 @@ do {								\
    ctx->NewState |= newstate;					\
 } while (0)
 
+/**
+ * Update current state without flushing stored vertices.
+ *
+ * \param ctx GL context.
+ *
+ * Like FLUSH_CURRENT, but the vertices buffered by the vbo module are left
+ * in place so that immediate-mode rendering keeps accumulating into the
+ * same draw.  Only for callers which read __struct gl_contextRec::Current
+ * or the material state without changing any rendering state.
+ */
+#define UPDATE_CURRENT(ctx)					\
+do {								\
+   if (MESA_VERBOSE & VERBOSE_STATE)				\
+      _mesa_debug(ctx, "UPDATE_CURRENT in %s\n", MESA_FUNCTION);	\
+   if (ctx->Driver.NeedFlush & FLUSH_UPDATE_CURRENT)		\
+      vbo_exec_UpdateCurrent(ctx);				\
+} while (0)
+
 /**
  * Macro to assert that the API call was made outside the
  * glBegin()/glEnd() pair, with return value.
@@ -2548,6 +2548,10 @@ save_EvalMesh1(GLenum mode, GLint i1, GLint i2)
       n[2].i = i1;
       n[3].i = i2;
    }
+
+   /* Evaluators set the current values of the attributes they generate */
+   invalidate_saved_current_state( ctx );
+
    if (ctx->ExecuteFlag) {
       CALL_EvalMesh1(ctx->Exec, (mode, i1, i2));
    }
@@ -2568,6 +2572,10 @@ save_EvalMesh2(GLenum mode, GLint i1, GLint i2, GLint j1, GLint j2)
       n[4].i = j1;
       n[5].i = j2;
    }
+
+   /* Evaluators set the current values of the attributes they generate */
+   invalidate_saved_current_state( ctx );
+
    if (ctx->ExecuteFlag) {
       CALL_EvalMesh2(ctx->Exec, (mode, i1, i2, j1, j2));
    }
@@ -3526,6 +3534,10 @@ save_PopAttrib(void)
    GET_CURRENT_CONTEXT(ctx);
    ASSERT_OUTSIDE_SAVE_BEGIN_END_AND_FLUSH(ctx);
    (void) alloc_instruction(ctx, OPCODE_POP_ATTRIB, 0);
+
+   /* The restored current values and materials aren't known here */
+   invalidate_saved_current_state( ctx );
+
    if (ctx->ExecuteFlag) {
       CALL_PopAttrib(ctx->Exec, ());
    }
@@ -5386,11 +5398,39 @@ save_SetFragmentShaderConstantATI(GLuint dst, const GLfloat *value)
    }
 }
 
+/**
+ * Whether setting attribute attr outside glBegin/End to a value of the given
+ * size has no effect, because the list already set it to that value.  Such
+ * calls are dropped, so that they don't end the current vertex list either.
+ */
+static inline GLboolean
+is_redundant_attr(const struct gl_context *ctx, GLenum attr, GLuint size,
+                  GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+{
+   GLfloat v[4];
+
+   if (attr == VERT_ATTRIB_POS ||
+       ctx->Driver.CurrentSavePrimitive != PRIM_OUTSIDE_BEGIN_END ||
+       ctx->ListState.ActiveAttribSize[attr] != size)
+      return GL_FALSE;
+
+   ASSIGN_4V(v, x, y, z, w);
+   return memcmp(ctx->ListState.CurrentAttrib[attr], v, sizeof(v)) == 0;
+}
+
 static void GLAPIENTRY
 save_Attr1fNV(GLenum attr, GLfloat x)
 {
    GET_CURRENT_CONTEXT(ctx);
    Node *n;
+
+   if (is_redundant_attr(ctx, attr, 1, x, 0, 0, 1)) {
+      if (ctx->ExecuteFlag) {
+         CALL_VertexAttrib1fNV(ctx->Exec, (attr, x));
+      }
+      return;
+   }
+
    SAVE_FLUSH_VERTICES(ctx);
    n = alloc_instruction(ctx, OPCODE_ATTR_1F_NV, 2);
    if (n) {
@@ -5412,6 +5452,14 @@ save_Attr2fNV(GLenum attr, GLfloat x, GLfloat y)
 {
    GET_CURRENT_CONTEXT(ctx);
    Node *n;
+
+   if (is_redundant_attr(ctx, attr, 2, x, y, 0, 1)) {
+      if (ctx->ExecuteFlag) {
+         CALL_VertexAttrib2fNV(ctx->Exec, (attr, x, y));
+      }
+      return;
+   }
+
    SAVE_FLUSH_VERTICES(ctx);
    n = alloc_instruction(ctx, OPCODE_ATTR_2F_NV, 3);
    if (n) {
@@ -5434,6 +5482,14 @@ save_Attr3fNV(GLenum attr, GLfloat x, GLfloat y, GLfloat z)
 {
    GET_CURRENT_CONTEXT(ctx);
    Node *n;
+
+   if (is_redundant_attr(ctx, attr, 3, x, y, z, 1)) {
+      if (ctx->ExecuteFlag) {
+         CALL_VertexAttrib3fNV(ctx->Exec, (attr, x, y, z));
+      }
+      return;
+   }
+
    SAVE_FLUSH_VERTICES(ctx);
    n = alloc_instruction(ctx, OPCODE_ATTR_3F_NV, 4);
    if (n) {
@@ -5457,6 +5513,14 @@ save_Attr4fNV(GLenum attr, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
 {
    GET_CURRENT_CONTEXT(ctx);
    Node *n;
+
+   if (is_redundant_attr(ctx, attr, 4, x, y, z, w)) {
+      if (ctx->ExecuteFlag) {
+         CALL_VertexAttrib4fNV(ctx->Exec, (attr, x, y, z, w));
+      }
+      return;
+   }
+
    SAVE_FLUSH_VERTICES(ctx);
    n = alloc_instruction(ctx, OPCODE_ATTR_4F_NV, 5);
    if (n) {
@@ -5490,8 +5554,9 @@ save_Attr1fARB(GLenum attr, GLfloat x)
    }
 
    assert(attr < MAX_VERTEX_GENERIC_ATTRIBS);
-   ctx->ListState.ActiveAttribSize[attr] = 1;
-   ASSIGN_4V(ctx->ListState.CurrentAttrib[attr], x, 0, 0, 1);
+   ctx->ListState.ActiveAttribSize[VERT_ATTRIB_GENERIC(attr)] = 1;
+   ASSIGN_4V(ctx->ListState.CurrentAttrib[VERT_ATTRIB_GENERIC(attr)],
+             x, 0, 0, 1);
 
    if (ctx->ExecuteFlag) {
       CALL_VertexAttrib1fARB(ctx->Exec, (attr, x));
@@ -5512,8 +5577,9 @@ save_Attr2fARB(GLenum attr, GLfloat x, GLfloat y)
    }
 
    assert(attr < MAX_VERTEX_GENERIC_ATTRIBS);
-   ctx->ListState.ActiveAttribSize[attr] = 2;
-   ASSIGN_4V(ctx->ListState.CurrentAttrib[attr], x, y, 0, 1);
+   ctx->ListState.ActiveAttribSize[VERT_ATTRIB_GENERIC(attr)] = 2;
+   ASSIGN_4V(ctx->ListState.CurrentAttrib[VERT_ATTRIB_GENERIC(attr)],
+             x, y, 0, 1);
 
    if (ctx->ExecuteFlag) {
       CALL_VertexAttrib2fARB(ctx->Exec, (attr, x, y));
@@ -5535,8 +5601,9 @@ save_Attr3fARB(GLenum attr, GLfloat x, GLfloat y, GLfloat z)
    }
 
    assert(attr < MAX_VERTEX_GENERIC_ATTRIBS);
-   ctx->ListState.ActiveAttribSize[attr] = 3;
-   ASSIGN_4V(ctx->ListState.CurrentAttrib[attr], x, y, z, 1);
+   ctx->ListState.ActiveAttribSize[VERT_ATTRIB_GENERIC(attr)] = 3;
+   ASSIGN_4V(ctx->ListState.CurrentAttrib[VERT_ATTRIB_GENERIC(attr)],
+             x, y, z, 1);
 
    if (ctx->ExecuteFlag) {
       CALL_VertexAttrib3fARB(ctx->Exec, (attr, x, y, z));
@@ -5559,8 +5626,9 @@ save_Attr4fARB(GLenum attr, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
    }
 
    assert(attr < MAX_VERTEX_GENERIC_ATTRIBS);
-   ctx->ListState.ActiveAttribSize[attr] = 4;
-   ASSIGN_4V(ctx->ListState.CurrentAttrib[attr], x, y, z, w);
+   ctx->ListState.ActiveAttribSize[VERT_ATTRIB_GENERIC(attr)] = 4;
+   ASSIGN_4V(ctx->ListState.CurrentAttrib[VERT_ATTRIB_GENERIC(attr)],
+             x, y, z, w);
 
    if (ctx->ExecuteFlag) {
       CALL_VertexAttrib4fARB(ctx->Exec, (attr, x, y, z, w));
@@ -5578,6 +5646,10 @@ save_EvalCoord1f(GLfloat x)
    if (n) {
       n[1].f = x;
    }
+
+   /* Evaluators set the current values of the attributes they generate */
+   invalidate_saved_current_state( ctx );
+
    if (ctx->ExecuteFlag) {
       CALL_EvalCoord1f(ctx->Exec, (x));
    }
@@ -5600,6 +5672,10 @@ save_EvalCoord2f(GLfloat x, GLfloat y)
       n[1].f = x;
       n[2].f = y;
    }
+
+   /* Evaluators set the current values of the attributes they generate */
+   invalidate_saved_current_state( ctx );
+
    if (ctx->ExecuteFlag) {
       CALL_EvalCoord2f(ctx->Exec, (x, y));
    }
@@ -5622,6 +5698,10 @@ save_EvalPoint1(GLint x)
    if (n) {
       n[1].i = x;
    }
+
+   /* Evaluators set the current values of the attributes they generate */
+   invalidate_saved_current_state( ctx );
+
    if (ctx->ExecuteFlag) {
       CALL_EvalPoint1(ctx->Exec, (x));
    }
@@ -5638,6 +5718,10 @@ save_EvalPoint2(GLint x, GLint y)
       n[1].i = x;
       n[2].i = y;
    }
+
+   /* Evaluators set the current values of the attributes they generate */
+   invalidate_saved_current_state( ctx );
+
    if (ctx->ExecuteFlag) {
       CALL_EvalPoint2(ctx->Exec, (x, y));
    }
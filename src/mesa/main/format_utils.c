@@ -26,6 +26,8 @@
 #include "glformats.h"
 #include "format_pack.h"
 #include "format_unpack.h"
+#include "sse_swizzle_convert.h"
+#include "x86/common_x86_asm.h"
 
 const mesa_array_format RGBA32_FLOAT =
    MESA_ARRAY_FORMAT(4, 1, 1, 1, 4, 0, 1, 2, 3);
@@ -191,6 +193,21 @@ convert_ubyte_rgba_to_bgra(size_t width, size_t height,
 {
    int row;
 
+#if defined(USE_SSE41)
+   if (cpu_has_sse4_1) {
+      static const uint8_t bgra[4] = { 2, 1, 0, 3 };
+
+      for (row = 0; row < height; row++) {
+         _mesa_swizzle_and_convert(dst, MESA_ARRAY_FORMAT_TYPE_UBYTE, 4,
+                                   src, MESA_ARRAY_FORMAT_TYPE_UBYTE, 4,
+                                   bgra, false, width);
+         src += src_stride;
+         dst += dst_stride;
+      }
+      return;
+   }
+#endif
+
    if (sizeof(void *) == 8 &&
        src_stride % 8 == 0 &&
        dst_stride % 8 == 0 &&
@@ -1496,6 +1513,24 @@ _mesa_swizzle_and_convert(void *void_dst, enum mesa_array_format_datatype dst_ty
                                   swizzle, normalized, count))
       return;
 
+#if defined(USE_SSE41)
+   if (cpu_has_sse4_1) {
+      int done = _mesa_sse41_swizzle_and_convert(void_dst, dst_type,
+                                                 num_dst_channels,
+                                                 void_src, src_type,
+                                                 num_src_channels,
+                                                 swizzle, normalized, count);
+      if (done == count)
+         return;
+
+      void_dst = (uint8_t *) void_dst + done * num_dst_channels *
+                 _mesa_array_format_datatype_get_size(dst_type);
+      void_src = (const uint8_t *) void_src + done * num_src_channels *
+                 _mesa_array_format_datatype_get_size(src_type);
+      count -= done;
+   }
+#endif
+
    switch (dst_type) {
    case MESA_ARRAY_FORMAT_TYPE_FLOAT:
       convert_float(void_dst, num_dst_channels, void_src, src_type,
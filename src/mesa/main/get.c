@@ -1179,7 +1179,7 @@ check_extra(struct gl_context *ctx, const char *func, const struct value_desc *d
 	    _mesa_update_state(ctx);
 	 break;
       case EXTRA_FLUSH_CURRENT:
-	 FLUSH_CURRENT(ctx, 0);
+	 UPDATE_CURRENT(ctx);
 	 break;
       case EXTRA_VALID_DRAW_BUFFER:
 	 if (d->pname - GL_DRAW_BUFFER0_ARB >= ctx->Const.MaxDrawBuffers) {
@@ -3,7 +3,9 @@
  * Generic hash table. 
  *
  * Used for display lists, texture objects, vertex/fragment programs,
- * buffer objects, etc.  The hash functions are thread-safe.
+ * buffer objects, etc.  Small keys are stored in a paged array, other keys
+ * in a util/hash_table.  The hash functions are thread-safe, and
+ * _mesa_HashLookup() doesn't lock anything for small keys.
  * 
  * \note key=0 is illegal.
  *
@@ -38,6 +40,7 @@
 #include "imports.h"
 #include "hash.h"
 #include "util/hash_table.h"
+#include "util/u_atomic.h"
 
 /**
  * Magic GLuint object name that gets stored outside of the struct hash_table.
@@ -52,6 +55,35 @@
  */
 #define DELETED_KEY_VALUE 1
 
+/**
+ * Keys below DENSE_MAX_KEY are stored in pages of DENSE_PAGE_SIZE entries
+ * that are indexed directly by the key, instead of in the hash table.  GL
+ * names are almost always small integers handed out by glGen*(), so this
+ * makes nearly every lookup two loads, and _mesa_HashLookup() can do it
+ * without locking the mutex.
+ *
+ * The page directory and the pages are allocated on first use.  The
+ * directory starts small and doubles when a larger key is inserted.  Old
+ * directories and all pages are only freed with the table, and every
+ * pointer stored into them is published with p_atomic_cmpxchg(), which is a
+ * full barrier, so lock-free readers always see a consistent state.
+ *
+ * If a directory or a page can't be allocated, the key goes into the hash
+ * table instead, and DenseFailed stops any further pages from being added,
+ * so that a missing page still tells which part holds a key.
+ */
+#define DENSE_PAGE_SHIFT 8
+#define DENSE_PAGE_SIZE (1 << DENSE_PAGE_SHIFT)
+#define DENSE_MIN_PAGES 4
+#define DENSE_MAX_PAGES 4096
+#define DENSE_MAX_KEY (DENSE_PAGE_SIZE * DENSE_MAX_PAGES)
+
+struct dense_directory {
+   GLuint NumPages;
+   struct dense_directory *Prev;   /**< smaller directory this replaced */
+   void ***Pages;                  /**< NumPages pointers after the struct */
+};
+
 /**
  * The hash table data structure.  
  */
@@ -63,6 +95,10 @@ struct _mesa_HashTable {
    GLboolean InDeleteAll;                /**< Debug check */
    /** Value that would be in the table for DELETED_KEY_VALUE. */
    void *deleted_key_data;
+   /** Entries with keys below DENSE_MAX_KEY */
+   struct dense_directory *Dense;
+   GLuint DenseCount;          /**< number of entries in Dense */
+   GLboolean DenseFailed;      /**< no more pages can be added */
 };
 
 /** @{
@@ -154,12 +190,27 @@ _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 {
    assert(table);
 
-   if (_mesa_hash_table_next_entry(table->ht, NULL) != NULL) {
+   if (_mesa_hash_table_next_entry(table->ht, NULL) != NULL ||
+       table->DenseCount) {
       _mesa_problem(NULL, "In _mesa_DeleteHashTable, found non-freed data");
    }
 
    _mesa_hash_table_destroy(table->ht, NULL);
 
+   if (table->Dense) {
+      struct dense_directory *dir = table->Dense;
+      GLuint i;
+
+      for (i = 0; i < dir->NumPages; i++)
+         free(dir->Pages[i]);
+
+      while (dir) {
+         struct dense_directory *prev = dir->Prev;
+         free(dir);
+         dir = prev;
+      }
+   }
+
    mtx_destroy(&table->Mutex);
    mtx_destroy(&table->WalkMutex);
    free(table);
@@ -167,6 +218,109 @@ _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 
 
 
+/**
+ * Store a pointer into the dense array so that lock-free readers see either
+ * the old or the new value, and everything written before the store.
+ * Called with the mutex locked.
+ */
+static inline void
+dense_publish(void **ptr, void *value)
+{
+   void *old = *ptr;
+
+   (void) p_atomic_cmpxchg(ptr, old, value);
+}
+
+
+/**
+ * Return the dense array slot for key, or NULL if key isn't below
+ * DENSE_MAX_KEY or its page doesn't exist.  Safe without the mutex.
+ */
+static inline void **
+dense_slot(const struct _mesa_HashTable *table, GLuint key)
+{
+   const struct dense_directory *dir = p_atomic_read(&table->Dense);
+   GLuint page_index = key >> DENSE_PAGE_SHIFT;
+   void **page;
+
+   if (!dir || page_index >= dir->NumPages)
+      return NULL;
+
+   page = p_atomic_read(&dir->Pages[page_index]);
+   if (!page)
+      return NULL;
+
+   return &page[key & (DENSE_PAGE_SIZE - 1)];
+}
+
+
+/**
+ * Whether a key that has no dense array slot is known not to be in the
+ * table, without looking at the hash table.
+ */
+static inline bool
+dense_owns_key(const struct _mesa_HashTable *table, GLuint key)
+{
+   return key < DENSE_MAX_KEY && !p_atomic_read(&table->DenseFailed);
+}
+
+
+/**
+ * Return the dense array slot for key, allocating or growing the page
+ * directory and allocating the page if needed.  Returns NULL if the key
+ * belongs in the hash table.  Called with the mutex locked.
+ */
+static void **
+dense_slot_create(struct _mesa_HashTable *table, GLuint key)
+{
+   struct dense_directory *dir = table->Dense;
+   GLuint page_index = key >> DENSE_PAGE_SHIFT;
+   void **slot;
+
+   slot = dense_slot(table, key);
+   if (slot || !dense_owns_key(table, key))
+      return slot;
+
+   if (!dir || page_index >= dir->NumPages) {
+      struct dense_directory *new_dir;
+      GLuint num_pages = dir ? dir->NumPages * 2 : DENSE_MIN_PAGES;
+
+      while (num_pages <= page_index)
+         num_pages *= 2;
+
+      new_dir = calloc(1, sizeof(*new_dir) + num_pages * sizeof(void **));
+      if (!new_dir)
+         goto fail;
+
+      new_dir->NumPages = num_pages;
+      new_dir->Prev = dir;
+      new_dir->Pages = (void ***) (new_dir + 1);
+      if (dir) {
+         memcpy(new_dir->Pages, dir->Pages,
+                dir->NumPages * sizeof(void **));
+      }
+      dense_publish((void **) &table->Dense, new_dir);
+      dir = new_dir;
+   }
+
+   if (!dir->Pages[page_index]) {
+      void **page = calloc(DENSE_PAGE_SIZE, sizeof(void *));
+      if (!page)
+         goto fail;
+      dense_publish((void **) &dir->Pages[page_index], page);
+   }
+
+   return dense_slot(table, key);
+
+fail:
+   /* The keys with existing pages stay in the dense array, the others go
+    * into the hash table from now on.
+    */
+   table->DenseFailed = GL_TRUE;
+   return NULL;
+}
+
+
 /**
  * Lookup an entry in the hash table, without locking.
  * \sa _mesa_HashLookup
@@ -176,9 +330,17 @@ _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
 {
    const struct hash_entry *entry;
 
+   void **slot;
+
    assert(table);
    assert(key);
 
+   slot = dense_slot(table, key);
+   if (slot)
+      return *slot;
+   if (dense_owns_key(table, key))
+      return NULL;
+
    if (key == DELETED_KEY_VALUE)
       return table->deleted_key_data;
 
@@ -201,8 +363,16 @@ _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
 void *
 _mesa_HashLookup(struct _mesa_HashTable *table, GLuint key)
 {
+   void **slot;
    void *res;
    assert(table);
+
+   slot = dense_slot(table, key);
+   if (slot)
+      return p_atomic_read(slot);
+   if (dense_owns_key(table, key))
+      return NULL;
+
    mtx_lock(&table->Mutex);
    res = _mesa_HashLookup_unlocked(table, key);
    mtx_unlock(&table->Mutex);
@@ -263,6 +433,7 @@ _mesa_HashInsert_unlocked(struct _mesa_HashTable *table, GLuint key, void *data)
 {
    uint32_t hash = uint_hash(key);
    struct hash_entry *entry;
+   void **slot;
 
    assert(table);
    assert(key);
@@ -270,6 +441,14 @@ _mesa_HashInsert_unlocked(struct _mesa_HashTable *table, GLuint key, void *data)
    if (key > table->MaxKey)
       table->MaxKey = key;
 
+   slot = dense_slot_create(table, key);
+   if (slot) {
+      if (!*slot)
+         table->DenseCount++;
+      dense_publish(slot, data);
+      return;
+   }
+
    if (key == DELETED_KEY_VALUE) {
       table->deleted_key_data = data;
    } else {
@@ -332,6 +511,7 @@ static inline void
 _mesa_HashRemove_unlocked(struct _mesa_HashTable *table, GLuint key)
 {
    struct hash_entry *entry;
+   void **slot;
 
    assert(table);
    assert(key);
@@ -343,6 +523,14 @@ _mesa_HashRemove_unlocked(struct _mesa_HashTable *table, GLuint key)
       return;
    }
 
+   slot = dense_slot(table, key);
+   if (slot) {
+      if (*slot)
+         table->DenseCount--;
+      dense_publish(slot, NULL);
+      return;
+   }
+
    if (key == DELETED_KEY_VALUE) {
       table->deleted_key_data = NULL;
    } else {
@@ -380,12 +568,28 @@ _mesa_HashDeleteAll(struct _mesa_HashTable *table,
                     void (*callback)(GLuint key, void *data, void *userData),
                     void *userData)
 {
+   struct dense_directory *dir;
    struct hash_entry *entry;
+   GLuint i, j;
 
    assert(table);
    assert(callback);
    mtx_lock(&table->Mutex);
    table->InDeleteAll = GL_TRUE;
+   dir = table->Dense;
+   for (i = 0; dir && i < dir->NumPages; i++) {
+      void **page = dir->Pages[i];
+
+      for (j = 0; page && j < DENSE_PAGE_SIZE; j++) {
+         void *data = page[j];
+
+         if (data) {
+            dense_publish(&page[j], NULL);
+            callback((i << DENSE_PAGE_SHIFT) + j, data, userData);
+         }
+      }
+   }
+   table->DenseCount = 0;
    hash_table_foreach(table->ht, entry) {
       callback((uintptr_t)entry->key, entry->data, userData);
       _mesa_hash_table_remove(table->ht, entry);
@@ -418,11 +622,27 @@ _mesa_HashWalk(const struct _mesa_HashTable *table,
 {
    /* cast-away const */
    struct _mesa_HashTable *table2 = (struct _mesa_HashTable *) table;
+   const struct dense_directory *dir;
    struct hash_entry *entry;
+   GLuint i, j;
 
    assert(table);
    assert(callback);
    mtx_lock(&table2->WalkMutex);
+   /* The callback may insert or remove entries and thereby grow the
+    * directory, but the pages of the old one stay valid.
+    */
+   dir = p_atomic_read(&table->Dense);
+   for (i = 0; dir && i < dir->NumPages; i++) {
+      void **page = p_atomic_read(&dir->Pages[i]);
+
+      for (j = 0; page && j < DENSE_PAGE_SIZE; j++) {
+         void *data = p_atomic_read(&page[j]);
+
+         if (data)
+            callback((i << DENSE_PAGE_SHIFT) + j, data, userData);
+      }
+   }
    hash_table_foreach(table->ht, entry) {
       callback((uintptr_t)entry->key, entry->data, userData);
    }
@@ -503,7 +723,7 @@ _mesa_HashFindFreeKeyBlock(struct _mesa_HashTable *table, GLuint numKeys)
 GLuint
 _mesa_HashNumEntries(const struct _mesa_HashTable *table)
 {
-   GLuint count = 0;
+   GLuint count = table->DenseCount;
 
    if (table->deleted_key_data)
       count++;
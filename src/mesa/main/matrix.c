@@ -46,6 +46,35 @@
 #include "util/bitscan.h"
 
 
+static const GLfloat Identity[16] = {
+   1.0F, 0.0F, 0.0F, 0.0F,
+   0.0F, 1.0F, 0.0F, 0.0F,
+   0.0F, 0.0F, 1.0F, 0.0F,
+   0.0F, 0.0F, 0.0F, 1.0F
+};
+
+
+/**
+ * Check whether replacing the top of the current matrix stack with \p m
+ * changes it, flushing stored vertices if so.
+ *
+ * Legacy immediate-mode applications tend to reload the same matrices
+ * around every object.  Not flushing when nothing changes lets the vbo
+ * module keep accumulating those objects' vertices into a single draw.
+ *
+ * \return GL_FALSE if \p m equals the current top matrix.
+ */
+static GLboolean
+matrix_changing(struct gl_context *ctx, const GLfloat *m)
+{
+   if (memcmp(ctx->CurrentStack->Top->m, m, 16 * sizeof(GLfloat)) == 0)
+      return GL_FALSE;
+
+   FLUSH_VERTICES(ctx, 0);
+   return GL_TRUE;
+}
+
+
 /**
  * Apply a perspective projection matrix.
  *
@@ -274,8 +303,8 @@ _mesa_PushMatrix( void )
  *
  * \sa glPopMatrix().
  * 
- * Flushes the vertices, verifies the current matrix stack is not empty, and
- * moves the stack head down.
+ * Verifies the current matrix stack is not empty, flushes the vertices if the
+ * matrix below differs from the top one, and moves the stack head down.
  * Marks __struct gl_contextRec::NewState with the dirty stack flag.
  */
 void GLAPIENTRY
@@ -284,8 +313,6 @@ _mesa_PopMatrix( void )
    GET_CURRENT_CONTEXT(ctx);
    struct gl_matrix_stack *stack = ctx->CurrentStack;
 
-   FLUSH_VERTICES(ctx, 0);
-
    if (MESA_VERBOSE&VERBOSE_API)
       _mesa_debug(ctx, "glPopMatrix %s\n",
                   _mesa_enum_to_string(ctx->Transform.MatrixMode));
@@ -302,6 +329,12 @@ _mesa_PopMatrix( void )
       }
       return;
    }
+
+   /* Popping back to an equal matrix needs no flush, but the stack is
+    * still marked dirty so that the new top gets analysed.
+    */
+   matrix_changing(ctx, stack->Stack[stack->Depth - 1].m);
+
    stack->Depth--;
    stack->Top = &(stack->Stack[stack->Depth]);
    ctx->NewState |= stack->DirtyFlag;
@@ -313,8 +346,8 @@ _mesa_PopMatrix( void )
  *
  * \sa glLoadIdentity().
  *
- * Flushes the vertices and calls _math_matrix_set_identity() with the
- * top-most matrix in the current stack.
+ * Unless the matrix already is the identity, flushes the vertices and calls
+ * _math_matrix_set_identity() with the top-most matrix in the current stack.
  * Marks __struct gl_contextRec::NewState with the stack dirty flag.
  */
 void GLAPIENTRY
@@ -322,11 +355,12 @@ _mesa_LoadIdentity( void )
 {
    GET_CURRENT_CONTEXT(ctx);
 
-   FLUSH_VERTICES(ctx, 0);
-
    if (MESA_VERBOSE & VERBOSE_API)
       _mesa_debug(ctx, "glLoadIdentity()\n");
 
+   if (!matrix_changing(ctx, Identity))
+      return;
+
    _math_matrix_set_identity( ctx->CurrentStack->Top );
    ctx->NewState |= ctx->CurrentStack->DirtyFlag;
 }
@@ -339,8 +373,9 @@ _mesa_LoadIdentity( void )
  *
  * \sa glLoadMatrixf().
  *
- * Flushes the vertices and calls _math_matrix_loadf() with the top-most
- * matrix in the current stack and the given matrix.
+ * Unless the matrix is unchanged, flushes the vertices and calls
+ * _math_matrix_loadf() with the top-most matrix in the current stack and the
+ * given matrix.
  * Marks __struct gl_contextRec::NewState with the dirty stack flag.
  */
 void GLAPIENTRY
@@ -356,7 +391,9 @@ _mesa_LoadMatrixf( const GLfloat *m )
           m[2], m[6], m[10], m[14],
           m[3], m[7], m[11], m[15]);
 
-   FLUSH_VERTICES(ctx, 0);
+   if (!matrix_changing(ctx, m))
+      return;
+
    _math_matrix_loadf( ctx->CurrentStack->Top, m );
    ctx->NewState |= ctx->CurrentStack->DirtyFlag;
 }
@@ -386,6 +423,9 @@ _mesa_MultMatrixf( const GLfloat *m )
           m[2], m[6], m[10], m[14],
           m[3], m[7], m[11], m[15]);
 
+   if (memcmp(m, Identity, sizeof(Identity)) == 0)
+      return;
+
    FLUSH_VERTICES(ctx, 0);
    _math_matrix_mul_floats( ctx->CurrentStack->Top, m );
    ctx->NewState |= ctx->CurrentStack->DirtyFlag;
@@ -411,8 +451,8 @@ _mesa_Rotatef( GLfloat angle, GLfloat x, GLfloat y, GLfloat z )
 {
    GET_CURRENT_CONTEXT(ctx);
 
-   FLUSH_VERTICES(ctx, 0);
    if (angle != 0.0F) {
+      FLUSH_VERTICES(ctx, 0);
       _math_matrix_rotate( ctx->CurrentStack->Top, angle, x, y, z);
       ctx->NewState |= ctx->CurrentStack->DirtyFlag;
    }
@@ -437,6 +477,9 @@ _mesa_Scalef( GLfloat x, GLfloat y, GLfloat z )
 {
    GET_CURRENT_CONTEXT(ctx);
 
+   if (x == 1.0F && y == 1.0F && z == 1.0F)
+      return;
+
    FLUSH_VERTICES(ctx, 0);
    _math_matrix_scale( ctx->CurrentStack->Top, x, y, z);
    ctx->NewState |= ctx->CurrentStack->DirtyFlag;
@@ -461,6 +504,9 @@ _mesa_Translatef( GLfloat x, GLfloat y, GLfloat z )
 {
    GET_CURRENT_CONTEXT(ctx);
 
+   if (x == 0.0F && y == 0.0F && z == 0.0F)
+      return;
+
    FLUSH_VERTICES(ctx, 0);
    _math_matrix_translate( ctx->CurrentStack->Top, x, y, z);
    ctx->NewState |= ctx->CurrentStack->DirtyFlag;
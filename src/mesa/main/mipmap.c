@@ -37,9 +37,16 @@
 #include "texstore.h"
 #include "image.h"
 #include "macros.h"
+#include "parallel.h"
+#include "sse_mipmap.h"
 #include "util/half_float.h"
 #include "util/format_rgb9e5.h"
 #include "util/format_r11g11b10f.h"
+#include "x86/common_x86_asm.h"
+
+
+/** Minimum destination bytes per thread that make splitting a level worthwhile */
+#define MIN_MIPMAP_THREAD_BYTES (128 * 1024)
 
 
 
@@ -162,11 +169,15 @@ do_row(GLenum datatype, GLuint comps, GLint srcWidth,
    */
 
    if (datatype == GL_UNSIGNED_BYTE && comps == 4) {
-      GLuint i, j, k;
+      GLuint i = 0, j, k;
       const GLubyte(*rowA)[4] = (const GLubyte(*)[4]) srcRowA;
       const GLubyte(*rowB)[4] = (const GLubyte(*)[4]) srcRowB;
       GLubyte(*dst)[4] = (GLubyte(*)[4]) dstRow;
-      for (i = j = 0, k = k0; i < (GLuint) dstWidth;
+#if defined(USE_SSE41)
+      if (cpu_has_sse4_1 && colStride == 2)
+         i = _mesa_sse41_box_row_ubyte4(srcRowA, srcRowB, dstWidth, dstRow);
+#endif
+      for (j = i * colStride, k = j + k0; i < (GLuint) dstWidth;
            i++, j += colStride, k += colStride) {
          dst[i][0] = (rowA[j][0] + rowA[k][0] + rowB[j][0] + rowB[k][0]) / 4;
          dst[i][1] = (rowA[j][1] + rowA[k][1] + rowB[j][1] + rowB[k][1]) / 4;
@@ -350,11 +361,15 @@ do_row(GLenum datatype, GLuint comps, GLint srcWidth,
    }
 
    else if (datatype == GL_FLOAT && comps == 4) {
-      GLuint i, j, k;
+      GLuint i = 0, j, k;
       const GLfloat(*rowA)[4] = (const GLfloat(*)[4]) srcRowA;
       const GLfloat(*rowB)[4] = (const GLfloat(*)[4]) srcRowB;
       GLfloat(*dst)[4] = (GLfloat(*)[4]) dstRow;
-      for (i = j = 0, k = k0; i < (GLuint) dstWidth;
+#if defined(USE_SSE41)
+      if (cpu_has_sse4_1 && colStride == 2)
+         i = _mesa_sse41_box_row_float4(srcRowA, srcRowB, dstWidth, dstRow);
+#endif
+      for (j = i * colStride, k = j + k0; i < (GLuint) dstWidth;
            i++, j += colStride, k += colStride) {
          dst[i][0] = (rowA[j][0] + rowA[k][0] +
                       rowB[j][0] + rowB[k][0]) * 0.25F;
@@ -1406,6 +1421,100 @@ do_row_3D(GLenum datatype, GLuint comps, GLint srcWidth,
 }
 
 
+/**
+ * The rows of a 2D or 3D mipmap level that don't involve the border.
+ * They don't depend on each other, so large levels are filtered in bands
+ * of rows on several threads.  For 3D, the rows of all the images are
+ * numbered consecutively.
+ */
+struct mipmap_rows
+{
+   GLenum datatype;
+   GLuint comps;
+   GLint border;
+   GLint bpt;
+   GLint srcWidthNB, dstWidthNB, dstHeightNB;
+   GLint srcRowStride, dstRowStride;
+
+   /* 2D: the first row of the source row pairs and their step in bytes */
+   const GLubyte *srcA, *srcB;
+   GLint srcRowStep;
+   GLubyte *dst;
+
+   /* 3D: the source and dest slices */
+   const GLubyte **srcImages;
+   GLubyte **dstImages;
+   GLint srcImageOffset, srcRowOffset;
+};
+
+
+/**
+ * Filter rows [0, count) of a mipmap level, on several threads if the
+ * level is large enough.
+ */
+static void
+filter_rows(struct mipmap_rows *rows, mesa_parallel_func filter, GLint count)
+{
+   const GLint rowBytes = MAX2(rows->dstWidthNB * rows->bpt, 1);
+
+   _mesa_parallel_for(count, MAX2(MIN_MIPMAP_THREAD_BYTES / rowBytes, 1),
+                      filter, rows);
+}
+
+
+static void
+filter_2d_rows(void *data, int first, int last)
+{
+   const struct mipmap_rows *rows = (const struct mipmap_rows *) data;
+   const GLubyte *srcA = rows->srcA + first * rows->srcRowStep;
+   const GLubyte *srcB = rows->srcB + first * rows->srcRowStep;
+   GLubyte *dst = rows->dst + first * rows->dstRowStride;
+   GLint row;
+
+   for (row = first; row < last; row++) {
+      do_row(rows->datatype, rows->comps, rows->srcWidthNB, srcA, srcB,
+             rows->dstWidthNB, dst);
+      srcA += rows->srcRowStep;
+      srcB += rows->srcRowStep;
+      dst += rows->dstRowStride;
+   }
+}
+
+
+static void
+filter_3d_rows(void *data, int first, int last)
+{
+   const struct mipmap_rows *rows = (const struct mipmap_rows *) data;
+   const GLint border = rows->border;
+   const GLint bpt = rows->bpt;
+   const GLint srcRowStep = rows->srcRowStride + rows->srcRowOffset;
+   GLint i;
+
+   for (i = first; i < last; i++) {
+      const GLint img = i / rows->dstHeightNB;
+      const GLint row = i % rows->dstHeightNB;
+
+      /* first source image row, skipping border */
+      const GLubyte *srcImgARowA = rows->srcImages[img * 2 + border]
+         + rows->srcRowStride * border + bpt * border + row * srcRowStep;
+      /* second source image row, skipping border */
+      const GLubyte *srcImgBRowA =
+         rows->srcImages[img * 2 + rows->srcImageOffset + border]
+         + rows->srcRowStride * border + bpt * border + row * srcRowStep;
+
+      /* address of the dest row, skipping border */
+      GLubyte *dstImgRow = rows->dstImages[img + border]
+         + rows->dstRowStride * border + bpt * border
+         + row * rows->dstRowStride;
+
+      do_row_3D(rows->datatype, rows->comps, rows->srcWidthNB,
+                srcImgARowA, srcImgARowA + rows->srcRowOffset,
+                srcImgBRowA, srcImgBRowA + rows->srcRowOffset,
+                rows->dstWidthNB, dstImgRow);
+   }
+}
+
+
 /*
  * These functions generate a 1/2-size mipmap image from a source image.
  * Texture borders are handled by copying or averaging the source image's
@@ -1453,6 +1562,7 @@ make_2d_mipmap(GLenum datatype, GLuint comps, GLint border,
    const GLint srcWidthNB = srcWidth - 2 * border;  /* sizes w/out border */
    const GLint dstWidthNB = dstWidth - 2 * border;
    const GLint dstHeightNB = dstHeight - 2 * border;
+   struct mipmap_rows rows;
    const GLubyte *srcA, *srcB;
    GLubyte *dst;
    GLint row, srcRowStep;
@@ -1472,13 +1582,18 @@ make_2d_mipmap(GLenum datatype, GLuint comps, GLint border,
 
    dst = dstPtr + border * ((dstWidth + 1) * bpt);
 
-   for (row = 0; row < dstHeightNB; row++) {
-      do_row(datatype, comps, srcWidthNB, srcA, srcB,
-             dstWidthNB, dst);
-      srcA += srcRowStep * srcRowStride;
-      srcB += srcRowStep * srcRowStride;
-      dst += dstRowStride;
-   }
+   memset(&rows, 0, sizeof(rows));
+   rows.datatype = datatype;
+   rows.comps = comps;
+   rows.bpt = bpt;
+   rows.srcWidthNB = srcWidthNB;
+   rows.dstWidthNB = dstWidthNB;
+   rows.dstRowStride = dstRowStride;
+   rows.srcA = srcA;
+   rows.srcB = srcB;
+   rows.srcRowStep = srcRowStep * srcRowStride;
+   rows.dst = dst;
+   filter_rows(&rows, filter_2d_rows, dstHeightNB);
 
    /* This is ugly but probably won't be used much */
    if (border > 0) {
@@ -1547,7 +1662,8 @@ make_3d_mipmap(GLenum datatype, GLuint comps, GLint border,
    const GLint dstWidthNB = dstWidth - 2 * border;
    const GLint dstHeightNB = dstHeight - 2 * border;
    const GLint dstDepthNB = dstDepth - 2 * border;
-   GLint img, row;
+   struct mipmap_rows rows;
+   GLint img;
    GLint bytesPerSrcImage, bytesPerDstImage;
    GLint srcImageOffset, srcRowOffset;
 
@@ -1575,39 +1691,21 @@ make_3d_mipmap(GLenum datatype, GLuint comps, GLint border,
           srcWidth, srcHeight, srcDepth, dstWidth, dstHeight, dstDepth);
    */
 
-   for (img = 0; img < dstDepthNB; img++) {
-      /* first source image pointer, skipping border */
-      const GLubyte *imgSrcA = srcPtr[img * 2 + border]
-         + srcRowStride * border + bpt * border;
-      /* second source image pointer, skipping border */
-      const GLubyte *imgSrcB = srcPtr[img * 2 + srcImageOffset + border]
-         + srcRowStride * border + bpt * border;
-
-      /* address of the dest image, skipping border */
-      GLubyte *imgDst = dstPtr[img + border]
-         + dstRowStride * border + bpt * border;
-
-      /* setup the four source row pointers and the dest row pointer */
-      const GLubyte *srcImgARowA = imgSrcA;
-      const GLubyte *srcImgARowB = imgSrcA + srcRowOffset;
-      const GLubyte *srcImgBRowA = imgSrcB;
-      const GLubyte *srcImgBRowB = imgSrcB + srcRowOffset;
-      GLubyte *dstImgRow = imgDst;
-
-      for (row = 0; row < dstHeightNB; row++) {
-         do_row_3D(datatype, comps, srcWidthNB, 
-                   srcImgARowA, srcImgARowB,
-                   srcImgBRowA, srcImgBRowB,
-                   dstWidthNB, dstImgRow);
-
-         /* advance to next rows */
-         srcImgARowA += srcRowStride + srcRowOffset;
-         srcImgARowB += srcRowStride + srcRowOffset;
-         srcImgBRowA += srcRowStride + srcRowOffset;
-         srcImgBRowB += srcRowStride + srcRowOffset;
-         dstImgRow += dstRowStride;
-      }
-   }
+   memset(&rows, 0, sizeof(rows));
+   rows.datatype = datatype;
+   rows.comps = comps;
+   rows.border = border;
+   rows.bpt = bpt;
+   rows.srcWidthNB = srcWidthNB;
+   rows.dstWidthNB = dstWidthNB;
+   rows.dstHeightNB = dstHeightNB;
+   rows.srcRowStride = srcRowStride;
+   rows.dstRowStride = dstRowStride;
+   rows.srcImages = srcPtr;
+   rows.dstImages = dstPtr;
+   rows.srcImageOffset = srcImageOffset;
+   rows.srcRowOffset = srcRowOffset;
+   filter_rows(&rows, filter_3d_rows, dstDepthNB * dstHeightNB);
 
 
    /* Luckily we can leverage the make_2d_mipmap() function here! */
@@ -1304,6 +1304,12 @@ struct gl_buffer_object
    unsigned MinMaxCacheHitIndices;
    unsigned MinMaxCacheMissIndices;
    bool MinMaxCacheDirty;
+
+   /** Memoization of primitive restart splits, see vbo_sw_primitive_restart */
+   struct hash_table *RestartCache;
+   unsigned RestartCacheHitIndices;
+   unsigned RestartCacheMissIndices;
+   bool RestartCacheDirty;
 };
 
 
@@ -0,0 +1,238 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file parallel.c
+ * Splitting large software texture operations (mipmap generation, texture
+ * compression and decompression, ReadPixels copies) over several threads.
+ *
+ * The work is done by a pool of worker threads, created the first time
+ * it is needed and joined at exit, which also runs when the library is
+ * unloaded with dlclose().  Each operation
+ * returns only once all its ranges are done, so callers don't need any
+ * synchronization besides not writing the same memory from two ranges.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "c11/threads.h"
+#include "macros.h"
+#include "parallel.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+
+/** Upper limit for the number of threads used by one operation */
+#define MAX_PARALLEL_THREADS 16
+
+
+/**
+ * The worker thread pool.  It runs one operation at a time, whose ranges
+ * are handed out to the workers and the submitting thread in order.
+ */
+static struct
+{
+   mtx_t submit;              /**< held while an operation is running */
+   mtx_t mutex;               /**< protects the fields below */
+   cnd_t work_cond;           /**< ranges are available */
+   cnd_t done_cond;           /**< the last range is done */
+
+   thrd_t threads[MAX_PARALLEL_THREADS];
+   int num_threads;
+   bool quit;                 /**< set when the workers should exit */
+
+   mesa_parallel_func func;
+   void *data;
+   int count;
+   int num_ranges;
+   int next_range;
+   int ranges_done;
+} pool;
+
+static once_flag pool_once = ONCE_FLAG_INIT;
+
+
+static int parallel_threads = 1;
+static once_flag parallel_threads_once = ONCE_FLAG_INIT;
+
+
+static void
+read_parallel_threads(void)
+{
+   const char *str = getenv("MESA_TEXTURE_THREADS");
+   int threads = 1;
+
+   if (str)
+      threads = atoi(str);
+#if defined(_SC_NPROCESSORS_ONLN)
+   else
+      threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+   parallel_threads = CLAMP(threads, 1, MAX_PARALLEL_THREADS);
+}
+
+
+/**
+ * Get the maximum number of threads for one operation: the value of
+ * MESA_TEXTURE_THREADS if set, otherwise the number of CPUs.
+ */
+int
+_mesa_get_parallel_threads(void)
+{
+   call_once(&parallel_threads_once, read_parallel_threads);
+   return parallel_threads;
+}
+
+
+/**
+ * Run ranges of the current operation until none are left.
+ * Called and returns with pool.mutex held.
+ */
+static void
+run_ranges_locked(void)
+{
+   while (pool.next_range < pool.num_ranges) {
+      const int i = pool.next_range++;
+      const mesa_parallel_func func = pool.func;
+      void *data = pool.data;
+      const int first = (int) ((int64_t) pool.count * i / pool.num_ranges);
+      const int last = (int) ((int64_t) pool.count * (i + 1) / pool.num_ranges);
+
+      mtx_unlock(&pool.mutex);
+      func(data, first, last);
+      mtx_lock(&pool.mutex);
+
+      if (++pool.ranges_done == pool.num_ranges)
+         cnd_signal(&pool.done_cond);
+   }
+}
+
+
+static int
+worker_thread(void *data)
+{
+   mtx_lock(&pool.mutex);
+   for (;;) {
+      while (!pool.quit && pool.next_range >= pool.num_ranges)
+         cnd_wait(&pool.work_cond, &pool.mutex);
+      if (pool.quit)
+         break;
+      run_ranges_locked();
+   }
+   mtx_unlock(&pool.mutex);
+   return 0;
+}
+
+
+static void
+destroy_pool(void)
+{
+   int i;
+
+   mtx_lock(&pool.mutex);
+   pool.quit = true;
+   cnd_broadcast(&pool.work_cond);
+   mtx_unlock(&pool.mutex);
+
+   for (i = 0; i < pool.num_threads; i++)
+      thrd_join(pool.threads[i], NULL);
+   pool.num_threads = 0;
+
+   cnd_destroy(&pool.done_cond);
+   cnd_destroy(&pool.work_cond);
+   mtx_destroy(&pool.mutex);
+   mtx_destroy(&pool.submit);
+}
+
+
+static void
+create_pool(void)
+{
+   int i;
+
+   mtx_init(&pool.submit, mtx_plain);
+   mtx_init(&pool.mutex, mtx_plain);
+   cnd_init(&pool.work_cond);
+   cnd_init(&pool.done_cond);
+
+   /* The submitting thread runs ranges too.  If a worker can't be
+    * created, the remaining threads just run more of the ranges.
+    */
+   for (i = 1; i < _mesa_get_parallel_threads(); i++) {
+      if (thrd_create(&pool.threads[pool.num_threads], worker_thread,
+                      NULL) != thrd_success)
+         break;
+      pool.num_threads++;
+   }
+
+   /* Don't leave the workers running code that dlclose() unmaps. */
+   atexit(destroy_pool);
+}
+
+
+/**
+ * Call func for [0, count), split into up to _mesa_get_parallel_threads()
+ * consecutive ranges of at least min_count_per_thread each.  The calling
+ * thread runs ranges as well.  If the pool is busy with an operation from
+ * another thread, or from func itself, everything runs on the calling
+ * thread.
+ */
+void
+_mesa_parallel_for(int count, int min_count_per_thread,
+                   mesa_parallel_func func, void *data)
+{
+   int num_ranges;
+
+   num_ranges = MIN2(count / MAX2(min_count_per_thread, 1),
+                     _mesa_get_parallel_threads());
+   if (num_ranges > 1) {
+      call_once(&pool_once, create_pool);
+
+      if (mtx_trylock(&pool.submit) == thrd_success) {
+         mtx_lock(&pool.mutex);
+         pool.func = func;
+         pool.data = data;
+         pool.count = count;
+         pool.num_ranges = num_ranges;
+         pool.next_range = 0;
+         pool.ranges_done = 0;
+         cnd_broadcast(&pool.work_cond);
+
+         run_ranges_locked();
+         while (pool.ranges_done < pool.num_ranges)
+            cnd_wait(&pool.done_cond, &pool.mutex);
+
+         pool.num_ranges = 0;
+         pool.next_range = 0;
+         mtx_unlock(&pool.mutex);
+         mtx_unlock(&pool.submit);
+         return;
+      }
+   }
+
+   if (count > 0)
+      func(data, 0, count);
+}
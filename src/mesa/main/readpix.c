@@ -40,7 +40,26 @@
 #include "glformats.h"
 #include "fbobject.h"
 #include "format_utils.h"
+#include "parallel.h"
 #include "pixeltransfer.h"
+#include "streaming-load-memcpy.h"
+#include "x86/common_x86_asm.h"
+#include "c11/threads.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+
+/**
+ * Copies bigger than the last-level cache use non-temporal stores, as the
+ * destination can't stay in the cache anyway.  This is the cache size
+ * assumed when the system doesn't report it.
+ */
+#define DEFAULT_STREAMING_COPY_BYTES (8 * 1024 * 1024)
+
+/** Minimum number of bytes per thread for parallel row copies */
+#define MIN_THREAD_COPY_BYTES (1024 * 1024)
 
 
 /**
@@ -209,6 +228,102 @@ readpixels_can_use_memcpy(const struct gl_context *ctx, GLenum format, GLenum ty
 }
 
 
+struct copy_rows
+{
+   GLubyte *dst;
+   GLint dstStride;
+   const GLubyte *src;
+   GLint srcStride;
+   GLuint bytesPerRow;
+   GLboolean streaming;
+};
+
+
+static uint64_t streaming_copy_bytes;
+static once_flag streaming_copy_bytes_once = ONCE_FLAG_INIT;
+
+
+static void
+read_streaming_copy_bytes(void)
+{
+   long cache_size = 0;
+#if defined(_SC_LEVEL3_CACHE_SIZE)
+   cache_size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+   streaming_copy_bytes = cache_size > 0 ? cache_size
+                                         : DEFAULT_STREAMING_COPY_BYTES;
+}
+
+
+static uint64_t
+get_streaming_copy_bytes(void)
+{
+   call_once(&streaming_copy_bytes_once, read_streaming_copy_bytes);
+   return streaming_copy_bytes;
+}
+
+
+static void
+copy_rows(void *data, int first, int last)
+{
+   const struct copy_rows *rows = (const struct copy_rows *) data;
+   GLubyte *dst = rows->dst + (ptrdiff_t) first * rows->dstStride;
+   const GLubyte *src = rows->src + (ptrdiff_t) first * rows->srcStride;
+   int j;
+
+   if (!rows->streaming &&
+       rows->dstStride == (GLint) rows->bytesPerRow &&
+       rows->srcStride == (GLint) rows->bytesPerRow) {
+      memcpy(dst, src, (size_t) (last - first) * rows->bytesPerRow);
+      return;
+   }
+
+   for (j = first; j < last; j++) {
+#if defined(USE_SSE41)
+      if (rows->streaming)
+         _mesa_streaming_memcpy(dst, (void *) src, rows->bytesPerRow);
+      else
+#endif
+         memcpy(dst, src, rows->bytesPerRow);
+
+      dst += rows->dstStride;
+      src += rows->srcStride;
+   }
+}
+
+
+/**
+ * Copy the rows of a mapped color buffer or staging texture to the
+ * ReadPixels destination.  Large images are split over several threads,
+ * and images that don't fit in the cache are copied with non-temporal
+ * stores when the CPU supports them.  Either stride may be negative.
+ */
+void
+_mesa_readpixels_copy_rows(GLubyte *dst, GLint dstStride,
+                           const GLubyte *src, GLint srcStride,
+                           GLuint bytesPerRow, GLuint height)
+{
+   struct copy_rows rows;
+
+   if (!bytesPerRow || !height)
+      return;
+
+   rows.dst = dst;
+   rows.dstStride = dstStride;
+   rows.src = src;
+   rows.srcStride = srcStride;
+   rows.bytesPerRow = bytesPerRow;
+   rows.streaming = GL_FALSE;
+#if defined(USE_SSE41)
+   rows.streaming = cpu_has_sse4_1 &&
+                    (uint64_t) bytesPerRow * height > get_streaming_copy_bytes();
+#endif
+
+   _mesa_parallel_for(height, MAX2(MIN_THREAD_COPY_BYTES / bytesPerRow, 1),
+                      copy_rows, &rows);
+}
+
+
 static GLboolean
 readpixels_memcpy(struct gl_context *ctx,
                   GLint x, GLint y,
@@ -220,7 +335,7 @@ readpixels_memcpy(struct gl_context *ctx,
    struct gl_renderbuffer *rb =
          _mesa_get_read_renderbuffer_for_format(ctx, format);
    GLubyte *dst, *map;
-   int dstStride, stride, j, texelBytes;
+   int dstStride, stride, texelBytes;
 
    /* Fail if memcpy cannot be used. */
    if (!readpixels_can_use_memcpy(ctx, format, type, packing)) {
@@ -240,12 +355,8 @@ readpixels_memcpy(struct gl_context *ctx,
 
    texelBytes = _mesa_get_format_bytes(rb->Format);
 
-   /* memcpy*/
-   for (j = 0; j < height; j++) {
-      memcpy(dst, map, width * texelBytes);
-      dst += dstStride;
-      map += stride;
-   }
+   _mesa_readpixels_copy_rows(dst, dstStride, map, stride,
+                              width * texelBytes, height);
 
    ctx->Driver.UnmapRenderbuffer(ctx, rb);
    return GL_TRUE;
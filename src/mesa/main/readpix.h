@@ -51,6 +51,11 @@ _mesa_get_readpixels_transfer_ops(const struct gl_context *ctx,
                                   GLenum format, GLenum type,
                                   GLboolean uses_blit);
 
+extern void
+_mesa_readpixels_copy_rows(GLubyte *dst, GLint dstStride,
+                           const GLubyte *src, GLint srcStride,
+                           GLuint bytesPerRow, GLuint height);
+
 extern void
 _mesa_readpixels(struct gl_context *ctx,
                  GLint x, GLint y, GLsizei width, GLsizei height,
@@ -0,0 +1,201 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "main/sse_bptc.h"
+#include <smmintrin.h>
+#include <string.h>
+
+static inline int
+hsum_epi32(__m128i v)
+{
+   v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+   v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+   return _mm_cvtsi128_si32(v);
+}
+
+static inline int
+count_lanes(__m128i mask)
+{
+   static const uint8_t bits[16] = {
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+   };
+   return bits[_mm_movemask_ps(_mm_castsi128_ps(mask))];
+}
+
+/* Computes clamp((value - first) * scale / (second - first), 0, max) with
+ * the rounding of C integer division.  The quotients are small enough that
+ * a float division truncates to the same integer.
+ */
+static inline __m128i
+get_indices(const __m128i value[4], int first, int second, int scale, int max)
+{
+   const __m128 divisor = _mm_set1_ps((float) (second - first));
+   __m128i result[4];
+   int y;
+
+   for (y = 0; y < 4; y++) {
+      __m128i num = _mm_mullo_epi32(_mm_sub_epi32(value[y],
+                                                  _mm_set1_epi32(first)),
+                                    _mm_set1_epi32(scale));
+      __m128i index =
+         _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(num), divisor));
+      index = _mm_max_epi32(index, _mm_setzero_si128());
+      result[y] = _mm_min_epi32(index, _mm_set1_epi32(max));
+   }
+
+   return _mm_packus_epi16(_mm_packs_epi32(result[0], result[1]),
+                           _mm_packs_epi32(result[2], result[3]));
+}
+
+void
+_mesa_sse41_bptc_rgba_unorm_block(const uint8_t *src, int src_rowstride,
+                                  uint8_t endpoints[2][4],
+                                  uint8_t rgb_indices[16],
+                                  uint8_t alpha_indices[16])
+{
+   const __m128i byte_mask = _mm_set1_epi32(0xff);
+   __m128i luminance[4], alpha[4];
+   __m128i rgb_left[4], alpha_left[4];
+   __m128i sum_lum = _mm_setzero_si128(), sum_alpha = _mm_setzero_si128();
+   __m128i sum_r = _mm_setzero_si128(), sum_g = _mm_setzero_si128();
+   __m128i sum_b = _mm_setzero_si128();
+   __m128i left_r = _mm_setzero_si128(), left_g = _mm_setzero_si128();
+   __m128i left_b = _mm_setzero_si128(), left_a = _mm_setzero_si128();
+   __m128i avg_lum, avg_alpha;
+   int sums[2][4];
+   int rgb_left_count = 0, alpha_left_count = 0;
+   int endpoint_luminances[2];
+   int midpoint, i, y;
+   uint8_t temp;
+
+   for (y = 0; y < 4; y++) {
+      const __m128i texels =
+         _mm_loadu_si128((const __m128i *) (src + y * src_rowstride));
+      /* r + g + b of each texel */
+      luminance[y] =
+         _mm_madd_epi16(_mm_maddubs_epi16(texels, _mm_set1_epi32(0x00010101)),
+                        _mm_set1_epi16(1));
+      alpha[y] = _mm_srli_epi32(texels, 24);
+      sum_lum = _mm_add_epi32(sum_lum, luminance[y]);
+      sum_alpha = _mm_add_epi32(sum_alpha, alpha[y]);
+   }
+
+   /* same as get_average_luminance_alpha_unorm() for 16 texels */
+   avg_lum = _mm_set1_epi32(hsum_epi32(sum_lum) / 16);
+   avg_alpha = _mm_set1_epi32(hsum_epi32(sum_alpha) / 16);
+
+   /* get_rgba_endpoints_unorm(): split the texels into two groups and
+    * average each.  Like the C code, the alpha split compares blue.
+    */
+   for (y = 0; y < 4; y++) {
+      const __m128i texels =
+         _mm_loadu_si128((const __m128i *) (src + y * src_rowstride));
+      const __m128i r = _mm_and_si128(texels, byte_mask);
+      const __m128i g = _mm_and_si128(_mm_srli_epi32(texels, 8), byte_mask);
+      const __m128i b = _mm_and_si128(_mm_srli_epi32(texels, 16), byte_mask);
+
+      rgb_left[y] = _mm_cmplt_epi32(luminance[y], avg_lum);
+      alpha_left[y] = _mm_cmplt_epi32(b, avg_alpha);
+      rgb_left_count += count_lanes(rgb_left[y]);
+      alpha_left_count += count_lanes(alpha_left[y]);
+
+      sum_r = _mm_add_epi32(sum_r, r);
+      sum_g = _mm_add_epi32(sum_g, g);
+      sum_b = _mm_add_epi32(sum_b, b);
+      left_r = _mm_add_epi32(left_r, _mm_and_si128(r, rgb_left[y]));
+      left_g = _mm_add_epi32(left_g, _mm_and_si128(g, rgb_left[y]));
+      left_b = _mm_add_epi32(left_b, _mm_and_si128(b, rgb_left[y]));
+      left_a = _mm_add_epi32(left_a, _mm_and_si128(alpha[y], alpha_left[y]));
+   }
+
+   sums[0][0] = hsum_epi32(left_r);
+   sums[0][1] = hsum_epi32(left_g);
+   sums[0][2] = hsum_epi32(left_b);
+   sums[0][3] = hsum_epi32(left_a);
+   sums[1][0] = hsum_epi32(sum_r) - sums[0][0];
+   sums[1][1] = hsum_epi32(sum_g) - sums[0][1];
+   sums[1][2] = hsum_epi32(sum_b) - sums[0][2];
+   sums[1][3] = hsum_epi32(sum_alpha) - sums[0][3];
+
+   if (rgb_left_count == 0 || rgb_left_count == 16) {
+      for (i = 0; i < 3; i++)
+         endpoints[0][i] = endpoints[1][i] = (sums[0][i] + sums[1][i]) / 16;
+   } else {
+      for (i = 0; i < 3; i++) {
+         endpoints[0][i] = sums[0][i] / rgb_left_count;
+         endpoints[1][i] = sums[1][i] / (16 - rgb_left_count);
+      }
+   }
+
+   if (alpha_left_count == 0 || alpha_left_count == 16) {
+      endpoints[0][3] = endpoints[1][3] = (sums[0][3] + sums[1][3]) / 16;
+   } else {
+      endpoints[0][3] = sums[0][3] / alpha_left_count;
+      endpoints[1][3] = sums[1][3] / (16 - alpha_left_count);
+   }
+
+   /* Swap the endpoints so that the most-significant bit of the first
+    * index is zero.
+    */
+   for (i = 0; i < 2; i++) {
+      endpoint_luminances[i] =
+         endpoints[i][0] + endpoints[i][1] + endpoints[i][2];
+   }
+   midpoint = (endpoint_luminances[0] + endpoint_luminances[1]) / 2;
+
+   if ((src[0] + src[1] + src[2] <= midpoint) !=
+       (endpoint_luminances[0] <= midpoint)) {
+      uint8_t temp3[3];
+      memcpy(temp3, endpoints[0], 3);
+      memcpy(endpoints[0], endpoints[1], 3);
+      memcpy(endpoints[1], temp3, 3);
+      i = endpoint_luminances[0];
+      endpoint_luminances[0] = endpoint_luminances[1];
+      endpoint_luminances[1] = i;
+   }
+
+   midpoint = (endpoints[0][3] + endpoints[1][3]) / 2;
+
+   if ((src[3] <= midpoint) != (endpoints[0][3] <= midpoint)) {
+      temp = endpoints[0][3];
+      endpoints[0][3] = endpoints[1][3];
+      endpoints[1][3] = temp;
+   }
+
+   /* get_rgb_indices_unorm() and get_alpha_indices_unorm() */
+   if (endpoint_luminances[0] == endpoint_luminances[1]) {
+      memset(rgb_indices, 0, 16);
+   } else {
+      _mm_storeu_si128((__m128i *) rgb_indices,
+                       get_indices(luminance, endpoint_luminances[0],
+                                   endpoint_luminances[1], 3, 3));
+   }
+
+   if (endpoints[0][3] == endpoints[1][3]) {
+      memset(alpha_indices, 0, 16);
+   } else {
+      _mm_storeu_si128((__m128i *) alpha_indices,
+                       get_indices(alpha, endpoints[0][3], endpoints[1][3],
+                                   7, 7));
+   }
+}
@@ -26,6 +26,7 @@
  */
 
 #include "main/sse_minmax.h"
+#include "util/bitscan.h"
 #include <smmintrin.h>
 #include <stdint.h>
 
@@ -92,3 +93,94 @@ _mesa_uint_array_min_max(const unsigned *ui_indices, unsigned *min_index,
    *min_index = min_ui;
    *max_index = max_ui;
 }
+
+void
+_mesa_ushort_array_min_max(const uint16_t *us_indices, unsigned *min_index,
+                           unsigned *max_index, const unsigned count)
+{
+   unsigned max_us = 0;
+   unsigned min_us = ~0U;
+   unsigned i = 0;
+
+   if (count >= 16) {
+      uint16_t max_arr[8] __attribute__ ((aligned (16)));
+      uint16_t min_arr[8] __attribute__ ((aligned (16)));
+      const unsigned vec_count = count & ~0x7;
+      __m128i max_us8 = _mm_setzero_si128();
+      __m128i min_us8 = _mm_set1_epi16(-1);
+      __m128i us_indices8;
+
+      for (i = 0; i < vec_count; i += 8) {
+         us_indices8 = _mm_loadu_si128((const __m128i *)&us_indices[i]);
+         max_us8 = _mm_max_epu16(us_indices8, max_us8);
+         min_us8 = _mm_min_epu16(us_indices8, min_us8);
+      }
+
+      _mm_store_si128((__m128i *)max_arr, max_us8);
+      _mm_store_si128((__m128i *)min_arr, min_us8);
+
+      for (i = 0; i < 8; i++) {
+         if (max_arr[i] > max_us)
+            max_us = max_arr[i];
+         if (min_arr[i] < min_us)
+            min_us = min_arr[i];
+      }
+      i = vec_count;
+   }
+
+   for (; i < count; i++) {
+      if (us_indices[i] > max_us)
+         max_us = us_indices[i];
+      if (us_indices[i] < min_us)
+         min_us = us_indices[i];
+   }
+
+   *min_index = min_us;
+   *max_index = max_us;
+}
+
+unsigned
+_mesa_ushort_array_find(const uint16_t *us_indices, unsigned value,
+                        unsigned start, unsigned end)
+{
+   const __m128i value8 = _mm_set1_epi16((short) value);
+   unsigned i = start;
+
+   for (; i + 8 <= end; i += 8) {
+      __m128i us_indices8 = _mm_loadu_si128((const __m128i *)&us_indices[i]);
+      int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(us_indices8, value8));
+
+      if (mask)
+         return i + (ffs(mask) - 1) / 2;
+   }
+
+   for (; i < end; i++) {
+      if (us_indices[i] == value)
+         return i;
+   }
+
+   return end;
+}
+
+unsigned
+_mesa_uint_array_find(const unsigned *ui_indices, unsigned value,
+                      unsigned start, unsigned end)
+{
+   const __m128i value4 = _mm_set1_epi32((int) value);
+   unsigned i = start;
+
+   for (; i + 4 <= end; i += 4) {
+      __m128i ui_indices4 = _mm_loadu_si128((const __m128i *)&ui_indices[i]);
+      int mask = _mm_movemask_epi8(_mm_cmpeq_epi32(ui_indices4, value4));
+
+      if (mask)
+         return i + (ffs(mask) - 1) / 4;
+   }
+
+   for (; i < end; i++) {
+      if (ui_indices[i] == value)
+         return i;
+   }
+
+   return end;
+}
@@ -25,6 +25,24 @@
  *
  */
 
+#include <stdint.h>
+
 void
 _mesa_uint_array_min_max(const unsigned *ui_indices, unsigned *min_index,
                          unsigned *max_index, const unsigned count);
+
+void
+_mesa_ushort_array_min_max(const uint16_t *us_indices, unsigned *min_index,
+                           unsigned *max_index, const unsigned count);
+
+/**
+ * Return the index of the first element in [start, end) equal to \p value,
+ * or \p end if there is none.
+ */
+unsigned
+_mesa_ushort_array_find(const uint16_t *us_indices, unsigned value,
+                        unsigned start, unsigned end);
+
+unsigned
+_mesa_uint_array_find(const unsigned *ui_indices, unsigned value,
+                      unsigned start, unsigned end);
@@ -0,0 +1,89 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "main/sse_mipmap.h"
+#include <smmintrin.h>
+
+/* Adds horizontally adjacent texels with 16 bits per channel: for
+ * a = { t0, t1 } and b = { t2, t3 } returns { t0 + t1, t2 + t3 }.
+ */
+static inline __m128i
+sum_pairs(__m128i a, __m128i b)
+{
+   return _mm_add_epi16(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+}
+
+int
+_mesa_sse41_box_row_ubyte4(const uint8_t *rowA, const uint8_t *rowB,
+                           int dstWidth, uint8_t *dst)
+{
+   int i;
+
+   /* 8 source texels from each row -> 4 destination texels */
+   for (i = 0; i + 4 <= dstWidth; i += 4) {
+      const __m128i a0 = _mm_loadu_si128((const __m128i *) rowA);
+      const __m128i a1 = _mm_loadu_si128((const __m128i *) (rowA + 16));
+      const __m128i b0 = _mm_loadu_si128((const __m128i *) rowB);
+      const __m128i b1 = _mm_loadu_si128((const __m128i *) (rowB + 16));
+      /* vertical sums of texels 0-1, 2-3, 4-5 and 6-7 */
+      const __m128i s01 = _mm_add_epi16(_mm_cvtepu8_epi16(a0),
+                                        _mm_cvtepu8_epi16(b0));
+      const __m128i s23 = _mm_add_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(a0, 8)),
+                                        _mm_cvtepu8_epi16(_mm_srli_si128(b0, 8)));
+      const __m128i s45 = _mm_add_epi16(_mm_cvtepu8_epi16(a1),
+                                        _mm_cvtepu8_epi16(b1));
+      const __m128i s67 = _mm_add_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(a1, 8)),
+                                        _mm_cvtepu8_epi16(_mm_srli_si128(b1, 8)));
+      /* same truncating divide by four as the C code */
+      const __m128i d01 = _mm_srli_epi16(sum_pairs(s01, s23), 2);
+      const __m128i d23 = _mm_srli_epi16(sum_pairs(s45, s67), 2);
+
+      _mm_storeu_si128((__m128i *) dst, _mm_packus_epi16(d01, d23));
+      rowA += 32;
+      rowB += 32;
+      dst += 16;
+   }
+
+   return i;
+}
+
+int
+_mesa_sse41_box_row_float4(const float *rowA, const float *rowB,
+                           int dstWidth, float *dst)
+{
+   const __m128 quarter = _mm_set1_ps(0.25f);
+   int i;
+
+   for (i = 0; i < dstWidth; i++) {
+      /* same order of operations as the C code for identical results */
+      __m128 sum = _mm_add_ps(_mm_loadu_ps(rowA), _mm_loadu_ps(rowA + 4));
+      sum = _mm_add_ps(sum, _mm_loadu_ps(rowB));
+      sum = _mm_add_ps(sum, _mm_loadu_ps(rowB + 4));
+      _mm_storeu_ps(dst, _mm_mul_ps(sum, quarter));
+      rowA += 8;
+      rowB += 8;
+      dst += 4;
+   }
+
+   return i;
+}
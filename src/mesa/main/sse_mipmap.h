@@ -0,0 +1,43 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef SSE_MIPMAP_H
+#define SSE_MIPMAP_H
+
+#include <stdint.h>
+
+/* SSE 4.1 versions of the 2x2 box filters in mipmap.c's do_row() for RGBA
+ * ubyte and RGBA float texels.  The source rows must be at least
+ * 2 * dstWidth texels wide.  Both return the number of destination texels
+ * that were written, always a multiple of 4 for ubyte; the caller filters
+ * the remaining ones.
+ */
+int
+_mesa_sse41_box_row_ubyte4(const uint8_t *rowA, const uint8_t *rowB,
+                           int dstWidth, uint8_t *dst);
+
+int
+_mesa_sse41_box_row_float4(const float *rowA, const float *rowB,
+                           int dstWidth, float *dst);
+
+#endif
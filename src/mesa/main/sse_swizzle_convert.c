@@ -0,0 +1,316 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* SSE 4.1 versions of the most common _mesa_swizzle_and_convert() cases.
+ *
+ * Every case first gathers the source channels of a few pixels into
+ * destination order with a single PSHUFB, ORs in the constant ONE
+ * channels, and then converts the whole register at once.  The results are
+ * bit-identical to the C paths in format_utils.c.
+ */
+
+#include "main/sse_swizzle_convert.h"
+#include <smmintrin.h>
+#include <string.h>
+
+struct sse_swizzle {
+   __m128i shuffle;  /* PSHUFB control producing one destination chunk */
+   __m128i one;      /* MESA_FORMAT_SWIZZLE_ONE channels */
+   int pixels;       /* pixels per chunk */
+   int src_size;     /* source chunk size in bytes */
+   int dst_size;     /* destination chunk size in bytes, before conversion */
+};
+
+static bool
+build_swizzle(struct sse_swizzle *sw, int elem_size, int pixels,
+              int num_dst_channels, int num_src_channels,
+              const uint8_t swizzle[4], uint32_t one)
+{
+   uint8_t shuffle[16], ones[16];
+   int p, c, b, i = 0;
+
+   for (p = 0; p < pixels; p++) {
+      for (c = 0; c < num_dst_channels; c++) {
+         for (b = 0; b < elem_size; b++, i++) {
+            if (swizzle[c] < num_src_channels) {
+               shuffle[i] = (p * num_src_channels + swizzle[c]) * elem_size + b;
+               ones[i] = 0;
+            } else if (swizzle[c] < MESA_FORMAT_SWIZZLE_ZERO) {
+               /* the C path reads an undefined value here */
+               return false;
+            } else {
+               shuffle[i] = 0x80;
+               ones[i] = swizzle[c] == MESA_FORMAT_SWIZZLE_ONE ?
+                         one >> (8 * b) : 0;
+            }
+         }
+      }
+   }
+   for (; i < 16; i++) {
+      shuffle[i] = 0x80;
+      ones[i] = 0;
+   }
+
+   sw->shuffle = _mm_loadu_si128((const __m128i *) shuffle);
+   sw->one = _mm_loadu_si128((const __m128i *) ones);
+   sw->pixels = pixels;
+   sw->src_size = pixels * num_src_channels * elem_size;
+   sw->dst_size = pixels * num_dst_channels * elem_size;
+   return true;
+}
+
+/* Chunks are always 4, 8, 12 or 16 bytes; never touch memory past them. */
+static inline __m128i
+load_chunk(const uint8_t *src, int size)
+{
+   uint32_t tail;
+
+   switch (size) {
+   case 16:
+      return _mm_loadu_si128((const __m128i *) src);
+   case 12:
+      memcpy(&tail, src + 8, sizeof(tail));
+      return _mm_insert_epi32(_mm_loadl_epi64((const __m128i *) src), tail, 2);
+   case 8:
+      return _mm_loadl_epi64((const __m128i *) src);
+   default:
+      memcpy(&tail, src, sizeof(tail));
+      return _mm_cvtsi32_si128(tail);
+   }
+}
+
+static inline void
+store_chunk(uint8_t *dst, __m128i v, int size)
+{
+   uint32_t tail;
+
+   switch (size) {
+   case 16:
+      _mm_storeu_si128((__m128i *) dst, v);
+      break;
+   case 12:
+      _mm_storel_epi64((__m128i *) dst, v);
+      tail = _mm_extract_epi32(v, 2);
+      memcpy(dst + 8, &tail, sizeof(tail));
+      break;
+   case 8:
+      _mm_storel_epi64((__m128i *) dst, v);
+      break;
+   default:
+      tail = _mm_cvtsi128_si32(v);
+      memcpy(dst, &tail, sizeof(tail));
+      break;
+   }
+}
+
+static inline __m128i
+swizzle_chunk(const struct sse_swizzle *sw, __m128i v)
+{
+   return _mm_or_si128(_mm_shuffle_epi8(v, sw->shuffle), sw->one);
+}
+
+/* Same as _mesa_half_to_float() for four halves in the low 16 bits of each
+ * lane, including denormals, infinities and NaNs.
+ */
+static inline __m128
+half4_to_float(__m128i h)
+{
+   const __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)),
+                                       16);
+   const __m128i em = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+   __m128i inf_nan, nan, special, bits;
+   __m128 f;
+
+   /* Zero, denormals and normal numbers: rebias the exponent by 2^112. */
+   f = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(em, 13)),
+                  _mm_castsi128_ps(_mm_set1_epi32(0x77800000)));
+
+   /* Infinities and NaNs; all NaNs become 0x7f800001 like in the C path. */
+   inf_nan = _mm_cmpgt_epi32(em, _mm_set1_epi32(0x7bff));
+   nan = _mm_cmpgt_epi32(em, _mm_set1_epi32(0x7c00));
+   special = _mm_or_si128(_mm_set1_epi32(0x7f800000), _mm_srli_epi32(nan, 31));
+   bits = _mm_blendv_epi8(_mm_castps_si128(f), special, inf_nan);
+
+   return _mm_castsi128_ps(_mm_or_si128(bits, sign));
+}
+
+/* Same as _mesa_float_to_unorm(x, 8), NaN included, leaving the result in
+ * the low byte of each lane.
+ */
+static inline __m128i
+float4_to_unorm8(__m128 f)
+{
+   /* MAXPS returns the second operand for NaN */
+   f = _mm_max_ps(f, _mm_setzero_ps());
+   f = _mm_min_ps(f, _mm_set1_ps(1.0f));
+   return _mm_cvtps_epi32(_mm_mul_ps(f, _mm_set1_ps(255.0f)));
+}
+
+static int
+swizzle_copy(uint8_t *dst, const uint8_t *src, const struct sse_swizzle *sw,
+             int count)
+{
+   int i;
+
+   for (i = 0; i + sw->pixels <= count; i += sw->pixels) {
+      store_chunk(dst, swizzle_chunk(sw, load_chunk(src, sw->src_size)),
+                  sw->dst_size);
+      src += sw->src_size;
+      dst += sw->dst_size;
+   }
+
+   return i;
+}
+
+static int
+convert_ubyte_to_float(float *dst, const uint8_t *src, int num_dst_channels,
+                       const struct sse_swizzle *sw, bool normalized,
+                       int count)
+{
+   /* same as _mesa_unorm_to_float(x, 8) */
+   const __m128 scale = _mm_set1_ps(normalized ? 1.0f / 255.0f : 1.0f);
+   int i, j;
+
+   for (i = 0; i + sw->pixels <= count; i += sw->pixels) {
+      __m128i v = swizzle_chunk(sw, load_chunk(src, sw->src_size));
+
+      for (j = 0; j < num_dst_channels; j++) {
+         __m128 f = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(v));
+         _mm_storeu_ps(dst, _mm_mul_ps(f, scale));
+         v = _mm_srli_si128(v, 4);
+         dst += 4;
+      }
+      src += sw->src_size;
+   }
+
+   return i;
+}
+
+static int
+convert_half_to_float(float *dst, const uint8_t *src, int num_dst_channels,
+                      const struct sse_swizzle *sw, int count)
+{
+   int i, j;
+
+   for (i = 0; i + sw->pixels <= count; i += sw->pixels) {
+      __m128i v = swizzle_chunk(sw, load_chunk(src, sw->src_size));
+
+      for (j = 0; j < num_dst_channels / 2; j++) {
+         _mm_storeu_ps(dst, half4_to_float(_mm_cvtepu16_epi32(v)));
+         v = _mm_srli_si128(v, 8);
+         dst += 4;
+      }
+      src += sw->src_size;
+   }
+
+   return i;
+}
+
+static int
+convert_float_to_unorm8(uint8_t *dst, const float *src, int num_src_channels,
+                        const struct sse_swizzle *sw, int count)
+{
+   int i, j;
+
+   for (i = 0; i + sw->pixels <= count; i += sw->pixels) {
+      __m128i v[4] = { _mm_setzero_si128(), _mm_setzero_si128(),
+                       _mm_setzero_si128(), _mm_setzero_si128() };
+      __m128i packed;
+
+      for (j = 0; j < num_src_channels; j++)
+         v[j] = float4_to_unorm8(_mm_loadu_ps(src + 4 * j));
+
+      packed = _mm_packus_epi16(_mm_packs_epi32(v[0], v[1]),
+                                _mm_packs_epi32(v[2], v[3]));
+      store_chunk(dst, swizzle_chunk(sw, packed), sw->dst_size);
+      src += 4 * num_src_channels;
+      dst += sw->dst_size;
+   }
+
+   return i;
+}
+
+int
+_mesa_sse41_swizzle_and_convert(void *dst,
+                                enum mesa_array_format_datatype dst_type,
+                                int num_dst_channels,
+                                const void *src,
+                                enum mesa_array_format_datatype src_type,
+                                int num_src_channels,
+                                const uint8_t swizzle[4], bool normalized,
+                                int count)
+{
+   struct sse_swizzle sw;
+
+   if (src_type == dst_type) {
+      switch (src_type) {
+      case MESA_ARRAY_FORMAT_TYPE_UBYTE:
+         if (!build_swizzle(&sw, 1, 4, num_dst_channels, num_src_channels,
+                            swizzle, normalized ? 0xff : 1))
+            return 0;
+         break;
+      case MESA_ARRAY_FORMAT_TYPE_HALF:
+         if (!build_swizzle(&sw, 2, 2, num_dst_channels, num_src_channels,
+                            swizzle, 0x3c00))
+            return 0;
+         break;
+      case MESA_ARRAY_FORMAT_TYPE_FLOAT:
+         if (!build_swizzle(&sw, 4, 1, num_dst_channels, num_src_channels,
+                            swizzle, 0x3f800000))
+            return 0;
+         break;
+      default:
+         return 0;
+      }
+      return swizzle_copy(dst, src, &sw, count);
+   }
+
+   if (dst_type == MESA_ARRAY_FORMAT_TYPE_FLOAT &&
+       src_type == MESA_ARRAY_FORMAT_TYPE_UBYTE) {
+      /* 255 * (1.0f / 255.0f) is exactly 1.0f */
+      if (!build_swizzle(&sw, 1, 4, num_dst_channels, num_src_channels,
+                         swizzle, normalized ? 0xff : 1))
+         return 0;
+      return convert_ubyte_to_float(dst, src, num_dst_channels, &sw,
+                                    normalized, count);
+   }
+
+   if (dst_type == MESA_ARRAY_FORMAT_TYPE_FLOAT &&
+       src_type == MESA_ARRAY_FORMAT_TYPE_HALF &&
+       (num_dst_channels == 2 || num_dst_channels == 4)) {
+      if (!build_swizzle(&sw, 2, 2, num_dst_channels, num_src_channels,
+                         swizzle, 0x3c00))
+         return 0;
+      return convert_half_to_float(dst, src, num_dst_channels, &sw, count);
+   }
+
+   if (dst_type == MESA_ARRAY_FORMAT_TYPE_UBYTE &&
+       src_type == MESA_ARRAY_FORMAT_TYPE_FLOAT && normalized) {
+      if (!build_swizzle(&sw, 1, 4, num_dst_channels, num_src_channels,
+                         swizzle, 0xff))
+         return 0;
+      return convert_float_to_unorm8(dst, src, num_src_channels, &sw, count);
+   }
+
+   return 0;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef SSE_SWIZZLE_CONVERT_H
+#define SSE_SWIZZLE_CONVERT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "main/formats.h"
+
+/* Converts as many pixels as possible with SSE 4.1 for the most common
+ * _mesa_swizzle_and_convert() combinations (ubyte, half and float sources
+ * with ubyte or float destinations).  Returns the number of pixels that
+ * were converted, which is zero for unsupported combinations; the caller
+ * is responsible for the remaining ones.
+ */
+int
+_mesa_sse41_swizzle_and_convert(void *dst,
+                                enum mesa_array_format_datatype dst_type,
+                                int num_dst_channels,
+                                const void *src,
+                                enum mesa_array_format_datatype src_type,
+                                int num_src_channels,
+                                const uint8_t swizzle[4], bool normalized,
+                                int count);
+
+#endif
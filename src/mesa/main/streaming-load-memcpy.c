@@ -86,3 +86,76 @@ _mesa_streaming_load_memcpy(void *restrict dst, void *restrict src, size_t len)
       memcpy(d, s, len);
    }
 }
+
+/* Copies memory from src to dst with streaming loads where src allows it
+ * and non-temporal stores, so that large copies don't evict everything
+ * else from the caches.
+ */
+void
+_mesa_streaming_memcpy(void *restrict dst, void *restrict src, size_t len)
+{
+   char *restrict d = dst;
+   char *restrict s = src;
+
+   /* memcpy() the header up to the first 16-byte boundary of <d>. */
+   if ((uintptr_t)d & 15) {
+      uintptr_t bytes_before_alignment_boundary = 16 - ((uintptr_t)d & 15);
+
+      memcpy(d, s, MIN2(bytes_before_alignment_boundary, len));
+
+      d += MIN2(bytes_before_alignment_boundary, len);
+      s += MIN2(bytes_before_alignment_boundary, len);
+      len -= MIN2(bytes_before_alignment_boundary, len);
+   }
+
+   if (((uintptr_t)s & 15) == 0) {
+      if (len >= 64)
+         _mm_mfence();
+
+      while (len >= 64) {
+         __m128i *dst_cacheline = (__m128i *)d;
+         __m128i *src_cacheline = (__m128i *)s;
+
+         __m128i temp1 = _mm_stream_load_si128(src_cacheline + 0);
+         __m128i temp2 = _mm_stream_load_si128(src_cacheline + 1);
+         __m128i temp3 = _mm_stream_load_si128(src_cacheline + 2);
+         __m128i temp4 = _mm_stream_load_si128(src_cacheline + 3);
+
+         _mm_stream_si128(dst_cacheline + 0, temp1);
+         _mm_stream_si128(dst_cacheline + 1, temp2);
+         _mm_stream_si128(dst_cacheline + 2, temp3);
+         _mm_stream_si128(dst_cacheline + 3, temp4);
+
+         d += 64;
+         s += 64;
+         len -= 64;
+      }
+   } else {
+      while (len >= 64) {
+         __m128i *dst_cacheline = (__m128i *)d;
+         __m128i *src_cacheline = (__m128i *)s;
+
+         __m128i temp1 = _mm_loadu_si128(src_cacheline + 0);
+         __m128i temp2 = _mm_loadu_si128(src_cacheline + 1);
+         __m128i temp3 = _mm_loadu_si128(src_cacheline + 2);
+         __m128i temp4 = _mm_loadu_si128(src_cacheline + 3);
+
+         _mm_stream_si128(dst_cacheline + 0, temp1);
+         _mm_stream_si128(dst_cacheline + 1, temp2);
+         _mm_stream_si128(dst_cacheline + 2, temp3);
+         _mm_stream_si128(dst_cacheline + 3, temp4);
+
+         d += 64;
+         s += 64;
+         len -= 64;
+      }
+   }
+
+   /* Make the non-temporal stores visible to other threads. */
+   _mm_sfence();
+
+   /* memcpy() the tail. */
+   if (len) {
+      memcpy(d, s, len);
+   }
+}
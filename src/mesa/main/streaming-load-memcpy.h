@@ -31,3 +31,9 @@
  */
 void
 _mesa_streaming_load_memcpy(void *restrict dst, void *restrict src, size_t len);
+
+/* Copies memory from src to dst with streaming loads and non-temporal
+ * stores, for large copies whose destination won't be read back soon.
+ */
+void
+_mesa_streaming_memcpy(void *restrict dst, void *restrict src, size_t len);
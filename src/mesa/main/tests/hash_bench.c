@@ -0,0 +1,248 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Hash table lookup benchmark.
+ *
+ * Times _mesa_HashLookup() from several threads sharing one table, the way
+ * contexts sharing objects do, with and without another thread inserting
+ * and removing names at the same time.  "dense" looks up names 1..N as
+ * handed out by glGen*(), "sparse" looks up large random names.  Also
+ * times removing and reinserting all the names, as glDelete*() and
+ * glGen*() do.
+ *
+ * Usage: hash-bench [-n lookups per thread]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "c11/threads.h"
+#include "main/glheader.h"
+#include "main/hash.h"
+
+
+#define NUM_KEYS 4096
+#define MAX_THREADS 16
+
+
+struct bench {
+   struct _mesa_HashTable *table;
+   GLuint keys[NUM_KEYS];
+   unsigned lookups;
+   volatile int stop;
+};
+
+struct lookup_thread {
+   struct bench *bench;
+   unsigned seed;
+   unsigned found;
+};
+
+
+static double
+get_time(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static int
+lookup_keys(void *data)
+{
+   struct lookup_thread *t = data;
+   const struct bench *b = t->bench;
+   unsigned i, index = t->seed, found = 0;
+
+   for (i = 0; i < b->lookups; i++) {
+      index = index * 1103515245u + 12345u;
+      if (_mesa_HashLookup(b->table, b->keys[(index >> 8) % NUM_KEYS]))
+         found++;
+   }
+
+   t->found = found;
+   return 0;
+}
+
+
+/**
+ * Remove and reinsert the second half of the keys until told to stop.
+ */
+static int
+churn_keys(void *data)
+{
+   struct bench *b = data;
+   unsigned i = NUM_KEYS / 2;
+
+   while (!b->stop) {
+      GLuint key = b->keys[i];
+
+      _mesa_HashRemove(b->table, key);
+      _mesa_HashInsert(b->table, key, &b->keys[i]);
+      if (++i == NUM_KEYS)
+         i = NUM_KEYS / 2;
+   }
+
+   return 0;
+}
+
+
+static void
+delete_key(GLuint key, void *data, void *userData)
+{
+}
+
+
+static void
+init_keys(GLuint *keys, GLboolean sparse)
+{
+   unsigned i;
+
+   srand(1);
+   for (i = 0; i < NUM_KEYS; i++) {
+      if (sparse)
+         keys[i] = (rand() | 0x40000000u) ^ i;
+      else
+         keys[i] = i + 1;
+   }
+}
+
+
+static void
+run_insert_remove(const char *name, GLboolean sparse, unsigned rounds)
+{
+   struct _mesa_HashTable *table = _mesa_NewHashTable();
+   GLuint keys[NUM_KEYS];
+   unsigned r, i;
+   double start, secs;
+
+   if (!table) {
+      fprintf(stderr, "hash-bench: out of memory\n");
+      exit(1);
+   }
+
+   init_keys(keys, sparse);
+
+   start = get_time();
+   for (r = 0; r < rounds; r++) {
+      for (i = 0; i < NUM_KEYS; i++)
+         _mesa_HashInsert(table, keys[i], &keys[i]);
+      for (i = 0; i < NUM_KEYS; i++)
+         _mesa_HashRemove(table, keys[i]);
+   }
+   secs = get_time() - start;
+
+   printf("%-8s insert+remove       %9.1f ns per operation\n", name,
+          secs * 1e9 / (2.0 * NUM_KEYS * rounds));
+   fflush(stdout);
+
+   _mesa_DeleteHashTable(table);
+}
+
+
+static void
+run_case(const char *name, GLboolean sparse, GLboolean churn,
+         unsigned num_threads, unsigned lookups)
+{
+   struct bench b;
+   struct lookup_thread threads[MAX_THREADS];
+   thrd_t ids[MAX_THREADS], churn_id;
+   unsigned i, found = 0;
+   double start, secs;
+
+   b.table = _mesa_NewHashTable();
+   b.lookups = lookups;
+   b.stop = 0;
+   if (!b.table) {
+      fprintf(stderr, "hash-bench: out of memory\n");
+      exit(1);
+   }
+
+   init_keys(b.keys, sparse);
+   for (i = 0; i < NUM_KEYS; i++)
+      _mesa_HashInsert(b.table, b.keys[i], &b.keys[i]);
+
+   if (churn &&
+       thrd_create(&churn_id, churn_keys, &b) != thrd_success)
+      churn = GL_FALSE;
+
+   start = get_time();
+   for (i = 0; i < num_threads; i++) {
+      threads[i].bench = &b;
+      threads[i].seed = i;
+      if (thrd_create(&ids[i], lookup_keys, &threads[i]) != thrd_success) {
+         fprintf(stderr, "hash-bench: can't create thread\n");
+         exit(1);
+      }
+   }
+   for (i = 0; i < num_threads; i++) {
+      thrd_join(ids[i], NULL);
+      found += threads[i].found;
+   }
+   secs = get_time() - start;
+
+   if (churn) {
+      b.stop = 1;
+      thrd_join(churn_id, NULL);
+   }
+
+   printf("%-8s %-8s %2u threads %9.1f Mlookups/s  %5.1f%% found\n",
+          name, churn ? "churn" : "static", num_threads,
+          (double) lookups * num_threads / secs * 1e-6,
+          100.0 * found / ((double) lookups * num_threads));
+   fflush(stdout);
+
+   _mesa_HashDeleteAll(b.table, delete_key, NULL);
+   _mesa_DeleteHashTable(b.table);
+}
+
+
+int
+main(int argc, char **argv)
+{
+   static const unsigned num_threads[] = { 1, 2, 4, 8, 16 };
+   unsigned lookups = 10000000;
+   unsigned s, c, t;
+
+   if (argc == 3 && strcmp(argv[1], "-n") == 0)
+      lookups = atoi(argv[2]);
+   if (!lookups) {
+      fprintf(stderr, "usage: hash-bench [-n lookups per thread]\n");
+      return 1;
+   }
+
+   for (s = 0; s < 2; s++) {
+      for (c = 0; c < 2; c++) {
+         for (t = 0; t < sizeof(num_threads) / sizeof(num_threads[0]); t++)
+            run_case(s ? "sparse" : "dense", s, c, num_threads[t], lookups);
+      }
+      run_insert_remove(s ? "sparse" : "dense", s,
+                        lookups / (2 * NUM_KEYS) + 1);
+   }
+
+   return 0;
+}
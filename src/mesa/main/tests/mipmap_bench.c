@@ -0,0 +1,176 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Software mipmap generation benchmark.
+ *
+ * Times _mesa_generate_mipmap_level() for the first level of a few texture
+ * targets, sizes and formats and prints a checksum of every result, so
+ * that the output of different builds or MESA_TEXTURE_THREADS settings can
+ * be compared.
+ *
+ * Usage: mipmap-bench [-n iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "main/glheader.h"
+#include "main/cpuinfo.h"
+#include "main/mipmap.h"
+
+
+static const struct {
+   const char *name;
+   GLenum target;
+   GLenum datatype;
+   GLuint comps;
+   GLint width, height, depth;
+} cases[] = {
+   { "2d rgba8", GL_TEXTURE_2D, GL_UNSIGNED_BYTE, 4, 1024, 1024, 1 },
+   { "2d rgba8", GL_TEXTURE_2D, GL_UNSIGNED_BYTE, 4, 4096, 4096, 1 },
+   { "2d rgba8", GL_TEXTURE_2D, GL_UNSIGNED_BYTE, 4, 8192, 8192, 1 },
+   { "2d rgb8", GL_TEXTURE_2D, GL_UNSIGNED_BYTE, 3, 4096, 4096, 1 },
+   { "2d r8", GL_TEXTURE_2D, GL_UNSIGNED_BYTE, 1, 4096, 4096, 1 },
+   { "2d rgba32f", GL_TEXTURE_2D, GL_FLOAT, 4, 2048, 2048, 1 },
+   { "2d rgba32f", GL_TEXTURE_2D, GL_FLOAT, 4, 4096, 4096, 1 },
+   { "2d-array rgba8", GL_TEXTURE_2D_ARRAY, GL_UNSIGNED_BYTE, 4, 1024, 1024, 16 },
+   { "3d rgba8", GL_TEXTURE_3D, GL_UNSIGNED_BYTE, 4, 256, 256, 256 },
+   { "3d rgba32f", GL_TEXTURE_3D, GL_FLOAT, 4, 128, 128, 128 },
+};
+
+
+static double
+get_time(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static unsigned
+checksum(const GLubyte *data, size_t size)
+{
+   unsigned hash = 2166136261u;
+   size_t i;
+
+   for (i = 0; i < size; i++)
+      hash = (hash ^ data[i]) * 16777619u;
+
+   return hash;
+}
+
+
+static void
+run_case(unsigned c, unsigned iterations)
+{
+   const GLint bpt = cases[c].comps *
+                     (cases[c].datatype == GL_FLOAT ? 4 : 1);
+   const GLint srcWidth = cases[c].width, srcHeight = cases[c].height;
+   const GLint srcDepth = cases[c].depth;
+   const size_t srcImageSize = (size_t) srcWidth * srcHeight * bpt;
+   const GLubyte **srcData;
+   GLubyte **dstData;
+   GLubyte *src, *dst;
+   GLint dstWidth, dstHeight, dstDepth;
+   size_t dstImageSize, i;
+   double start, secs;
+   unsigned iter;
+
+   _mesa_next_mipmap_level_size(cases[c].target, 0,
+                                srcWidth, srcHeight, srcDepth,
+                                &dstWidth, &dstHeight, &dstDepth);
+   dstImageSize = (size_t) dstWidth * dstHeight * bpt;
+
+   src = malloc(srcImageSize * srcDepth);
+   dst = malloc(dstImageSize * dstDepth);
+   srcData = malloc(srcDepth * sizeof(*srcData));
+   dstData = malloc(dstDepth * sizeof(*dstData));
+   if (!src || !dst || !srcData || !dstData) {
+      fprintf(stderr, "mipmap-bench: out of memory\n");
+      exit(1);
+   }
+
+   srand(c);
+   if (cases[c].datatype == GL_FLOAT) {
+      for (i = 0; i < srcImageSize * srcDepth / 4; i++)
+         ((GLfloat *) src)[i] = (GLfloat) rand() / RAND_MAX;
+   }
+   else {
+      for (i = 0; i < srcImageSize * srcDepth; i++)
+         src[i] = rand();
+   }
+   memset(dst, 0, dstImageSize * dstDepth);
+
+   for (i = 0; i < (size_t) srcDepth; i++)
+      srcData[i] = src + i * srcImageSize;
+   for (i = 0; i < (size_t) dstDepth; i++)
+      dstData[i] = dst + i * dstImageSize;
+
+   start = get_time();
+   for (iter = 0; iter < iterations; iter++) {
+      _mesa_generate_mipmap_level(cases[c].target, cases[c].datatype,
+                                  cases[c].comps, 0,
+                                  srcWidth, srcHeight, srcDepth,
+                                  srcData, srcWidth * bpt,
+                                  dstWidth, dstHeight, dstDepth,
+                                  dstData, dstWidth * bpt);
+   }
+   secs = (get_time() - start) / iterations;
+
+   printf("%-16s %5d x %5d x %3d %9.2f ms %8.1f MB/s  %08x\n",
+          cases[c].name, srcWidth, srcHeight, srcDepth, secs * 1e3,
+          srcImageSize * srcDepth / secs * 1e-6,
+          checksum(dst, dstImageSize * dstDepth));
+   fflush(stdout);
+
+   free(srcData);
+   free(dstData);
+   free(src);
+   free(dst);
+}
+
+
+int
+main(int argc, char **argv)
+{
+   unsigned iterations = 10;
+   unsigned c;
+
+   if (argc == 3 && strcmp(argv[1], "-n") == 0)
+      iterations = atoi(argv[2]);
+   if (!iterations) {
+      fprintf(stderr, "usage: mipmap-bench [-n iterations]\n");
+      return 1;
+   }
+
+   _mesa_get_cpu_features();
+
+   for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+      run_case(c, iterations);
+
+   return 0;
+}
@@ -0,0 +1,368 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Software primitive restart benchmark.
+ *
+ * Draws a terrain mesh made of one triangle strip per row, separated by
+ * restart indexes, through vbo_sw_primitive_restart() as drivers without
+ * native restart support do, and reports draws per second along with the
+ * number of calls that reached the driver per draw.  The "stream" cases
+ * rewrite the index buffer before every draw, "user" ones draw from client
+ * memory; neither can reuse a previous draw's split.
+ *
+ * After timing, each case checks the sub-primitives and index bounds that
+ * reached the driver against a plain scan of the indices, then moves the
+ * restart indexes, through _mesa_buffer_sub_data() for buffer objects, and
+ * checks again.  A split cached from before the update would fail that.
+ * The exit status is nonzero if any check failed.
+ *
+ * Usage: restart-bench [-n draws]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "main/glheader.h"
+#include "main/bufferobj.h"
+#include "main/context.h"
+#include "main/macros.h"
+#include "main/mtypes.h"
+#include "drivers/common/driverfuncs.h"
+#include "vbo/vbo.h"
+
+
+#define GRID_SIZE 256
+
+
+static unsigned driver_calls;
+static unsigned driver_prims;
+
+/* what reached the driver while checking the split */
+static const void *check_indices;
+static unsigned check_index_size;
+static struct _mesa_prim *check_prims;
+static unsigned num_check_prims;
+static unsigned max_check_prims;
+static unsigned bad_bounds;
+
+
+static unsigned
+get_index(const void *indices, unsigned index_size, unsigned i)
+{
+   if (index_size == 2)
+      return ((const GLushort *) indices)[i];
+   else
+      return ((const GLuint *) indices)[i];
+}
+
+
+static void
+set_index(void *indices, unsigned index_size, unsigned i, unsigned value)
+{
+   if (index_size == 2)
+      ((GLushort *) indices)[i] = value;
+   else
+      ((GLuint *) indices)[i] = value;
+}
+
+
+static unsigned
+restart_index(unsigned index_size)
+{
+   return index_size == 2 ? 0xffff : 0xffffffff;
+}
+
+
+static void
+count_draw(struct gl_context *ctx, const struct _mesa_prim *prims,
+           GLuint nr_prims, const struct _mesa_index_buffer *ib,
+           GLboolean index_bounds_valid, GLuint min_index, GLuint max_index,
+           struct gl_transform_feedback_object *tfb_vertcount,
+           unsigned stream, struct gl_buffer_object *indirect)
+{
+   GLuint min = ~0U, max = 0;
+   unsigned i, j;
+
+   driver_calls++;
+   driver_prims += nr_prims;
+
+   if (!check_indices)
+      return;
+
+   for (i = 0; i < nr_prims; i++) {
+      if (num_check_prims < max_check_prims)
+         check_prims[num_check_prims] = prims[i];
+      num_check_prims++;
+
+      for (j = prims[i].start; j < prims[i].start + prims[i].count; j++) {
+         const GLuint index = get_index(check_indices, check_index_size, j);
+         min = MIN2(min, index);
+         max = MAX2(max, index);
+      }
+   }
+
+   if (index_bounds_valid && (min_index != min || max_index != max))
+      bad_bounds++;
+}
+
+
+/**
+ * One triangle strip per row of a GRID_SIZE x GRID_SIZE vertex grid, each
+ * followed by a restart index.
+ */
+static void *
+make_terrain(unsigned index_size, unsigned *count)
+{
+   const unsigned n = (GRID_SIZE - 1) * (2 * GRID_SIZE + 1);
+   void *indices = malloc(n * index_size);
+   unsigned x, y, i = 0;
+
+   for (y = 0; y < GRID_SIZE - 1; y++) {
+      for (x = 0; x < GRID_SIZE; x++) {
+         set_index(indices, index_size, i++, y * GRID_SIZE + x);
+         set_index(indices, index_size, i++, (y + 1) * GRID_SIZE + x);
+      }
+      set_index(indices, index_size, i++, restart_index(index_size));
+   }
+
+   *count = n;
+   return indices;
+}
+
+
+/**
+ * Move the restart index of every row back by a few indexes, and split
+ * every third row in the middle too, with two restarts on every sixth.
+ */
+static void
+move_restarts(void *indices, unsigned index_size)
+{
+   const unsigned row = 2 * GRID_SIZE + 1;
+   const unsigned restart = restart_index(index_size);
+   unsigned y;
+
+   for (y = 0; y < GRID_SIZE - 1; y++) {
+      const unsigned end = y * row + row - 1;
+
+      set_index(indices, index_size, end, (y + 1) * GRID_SIZE);
+      set_index(indices, index_size, end - 1 - 2 * (y % 5), restart);
+
+      if (y % 3 == 0)
+         set_index(indices, index_size, y * row + GRID_SIZE, restart);
+      if (y % 6 == 0)
+         set_index(indices, index_size, y * row + GRID_SIZE + 1, restart);
+   }
+}
+
+
+/**
+ * Draw once and check that the driver got the runs of indices between
+ * restart indexes, in order, with exact index bounds.
+ * \return GL_TRUE if it did
+ */
+static GLboolean
+check_split(struct gl_context *ctx, const struct _mesa_prim *prim,
+            const struct _mesa_index_buffer *ib, const void *indices)
+{
+   const unsigned index_size = ib->type == GL_UNSIGNED_SHORT ? 2 : 4;
+   const unsigned restart = restart_index(index_size);
+   GLboolean pass = GL_TRUE;
+   unsigned i, start = 0, n = 0;
+
+   max_check_prims = (ib->count + 1) / 2;
+   check_prims = malloc(max_check_prims * sizeof(*check_prims));
+   check_indices = indices;
+   check_index_size = index_size;
+   num_check_prims = 0;
+   bad_bounds = 0;
+
+   vbo_sw_primitive_restart(ctx, prim, 1, ib, NULL);
+
+   for (i = 0; i <= ib->count; i++) {
+      if (i < ib->count && get_index(indices, index_size, i) != restart)
+         continue;
+
+      if (i > start) {
+         if (n >= num_check_prims || n >= max_check_prims ||
+             check_prims[n].start != start ||
+             check_prims[n].count != i - start ||
+             check_prims[n].mode != prim->mode)
+            pass = GL_FALSE;
+         n++;
+      }
+      start = i + 1;
+   }
+
+   if (n != num_check_prims || bad_bounds)
+      pass = GL_FALSE;
+
+   free(check_prims);
+   check_prims = NULL;
+   check_indices = NULL;
+
+   return pass;
+}
+
+
+static double
+get_time(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/**
+ * \return GL_TRUE if the split checks passed
+ */
+static GLboolean
+run_case(struct gl_context *ctx, const char *name, GLenum type,
+         GLboolean user, GLboolean stream, unsigned num_draws)
+{
+   const unsigned index_size = type == GL_UNSIGNED_SHORT ? 2 : 4;
+   struct gl_buffer_object *obj = NULL;
+   struct _mesa_index_buffer ib;
+   struct _mesa_prim prim;
+   double start, secs;
+   unsigned count, i;
+   GLboolean pass;
+   void *indices;
+
+   indices = make_terrain(index_size, &count);
+
+   memset(&ib, 0, sizeof(ib));
+   ib.count = count;
+   ib.type = type;
+   if (user) {
+      ib.obj = ctx->Shared->NullBufferObj;
+      ib.ptr = indices;
+   }
+   else {
+      obj = ctx->Driver.NewBufferObject(ctx, 1);
+      _mesa_buffer_data(ctx, obj, GL_ELEMENT_ARRAY_BUFFER,
+                        count * index_size, indices,
+                        stream ? GL_STREAM_DRAW : GL_STATIC_DRAW,
+                        "restart-bench");
+      ib.obj = obj;
+      ib.ptr = NULL;
+   }
+
+   memset(&prim, 0, sizeof(prim));
+   prim.mode = GL_TRIANGLE_STRIP;
+   prim.indexed = 1;
+   prim.begin = 1;
+   prim.end = 1;
+   prim.count = count;
+   prim.num_instances = 1;
+
+   /* warm up, and let the split be cached when it can be */
+   for (i = 0; i < 2; i++)
+      vbo_sw_primitive_restart(ctx, &prim, 1, &ib, NULL);
+
+   driver_calls = 0;
+   driver_prims = 0;
+   start = get_time();
+   for (i = 0; i < num_draws; i++) {
+      if (stream) {
+         _mesa_buffer_sub_data(ctx, obj, 0, count * index_size, indices,
+                               "restart-bench");
+      }
+      vbo_sw_primitive_restart(ctx, &prim, 1, &ib, NULL);
+   }
+   secs = get_time() - start;
+
+   printf("%-14s %10.0f draws/s %8.1f us/draw %6.1f calls/draw "
+          "%6.1f prims/draw\n", name, num_draws / secs,
+          secs * 1e6 / num_draws, (double) driver_calls / num_draws,
+          (double) driver_prims / num_draws);
+
+   pass = check_split(ctx, &prim, &ib, indices);
+   move_restarts(indices, index_size);
+   if (obj) {
+      _mesa_buffer_sub_data(ctx, obj, 0, count * index_size, indices,
+                            "restart-bench");
+   }
+   if (!check_split(ctx, &prim, &ib, indices))
+      pass = GL_FALSE;
+
+   if (!pass)
+      printf("%-14s FAIL: wrong sub-primitives reached the driver\n", name);
+   fflush(stdout);
+
+   if (obj)
+      _mesa_reference_buffer_object(ctx, &obj, NULL);
+   free(indices);
+
+   return pass;
+}
+
+
+int
+main(int argc, char **argv)
+{
+   static struct gl_context ctx;
+   struct dd_function_table driver_functions;
+   struct gl_config visual;
+   unsigned num_draws = 10000;
+   unsigned failures = 0;
+
+   if (argc == 3 && strcmp(argv[1], "-n") == 0)
+      num_draws = atoi(argv[2]);
+   if (!num_draws) {
+      fprintf(stderr, "usage: restart-bench [-n draws]\n");
+      return 1;
+   }
+
+   memset(&visual, 0, sizeof(visual));
+   memset(&driver_functions, 0, sizeof(driver_functions));
+   _mesa_init_driver_functions(&driver_functions);
+
+   if (!_mesa_initialize_context(&ctx, API_OPENGL_COMPAT, &visual, NULL,
+                                 &driver_functions) ||
+       !_vbo_CreateContext(&ctx)) {
+      fprintf(stderr, "restart-bench: context creation failed\n");
+      return 1;
+   }
+   vbo_set_draw_func(&ctx, count_draw);
+   ctx.Array.PrimitiveRestartFixedIndex = GL_TRUE;
+
+   failures += !run_case(&ctx, "ushort", GL_UNSIGNED_SHORT, GL_FALSE,
+                         GL_FALSE, num_draws);
+   failures += !run_case(&ctx, "uint", GL_UNSIGNED_INT, GL_FALSE, GL_FALSE,
+                         num_draws);
+   failures += !run_case(&ctx, "ushort-stream", GL_UNSIGNED_SHORT, GL_FALSE,
+                         GL_TRUE, num_draws);
+   failures += !run_case(&ctx, "ushort-user", GL_UNSIGNED_SHORT, GL_TRUE,
+                         GL_FALSE, num_draws);
+   failures += !run_case(&ctx, "uint-user", GL_UNSIGNED_INT, GL_TRUE,
+                         GL_FALSE, num_draws);
+
+   _vbo_DestroyContext(&ctx);
+   _mesa_free_context_data(&ctx);
+
+   return failures ? 1 : 0;
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \name texcompress_etc.cpp
+ *
+ * Check that the block decoders used by _mesa_unpack_etc2_format() agree
+ * with the per-texel fetch functions of every ETC2 format.
+ */
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+
+#include "main/texcompress_etc.h"
+
+extern "C" {
+extern GLfloat _mesa_ubyte_to_float_color_tab[256];
+extern const float util_format_srgb_8unorm_to_linear_float_table[256];
+}
+
+/* Block rows per thread are at least 16384 blocks, see texcompress_etc.c */
+#define MIN_THREAD_BLOCKS 16384
+
+/* The conversions of the fetch functions, see main/macros.h */
+static float
+ubyte_to_float(uint8_t u)
+{
+   return (float) u / 255.0F;
+}
+
+static float
+ushort_to_float(GLushort s)
+{
+   return (float) s * (1.0F / 65535.0F);
+}
+
+static float
+short_to_float(GLushort s)
+{
+   return (2.0F * s + 1.0F) * (1.0F / 65535.0F);
+}
+
+static void
+expected_texel(mesa_format format, const uint8_t *texel, float expected[4])
+{
+   const GLushort *comps = (const GLushort *) texel;
+
+   expected[0] = expected[1] = expected[2] = 0.0f;
+   expected[3] = 1.0f;
+
+   switch (format) {
+   case MESA_FORMAT_ETC2_RGB8:
+   case MESA_FORMAT_ETC2_RGBA8_EAC:
+   case MESA_FORMAT_ETC2_RGB8_PUNCHTHROUGH_ALPHA1:
+      for (int c = 0; c < 4; c++)
+         expected[c] = ubyte_to_float(texel[c]);
+      break;
+   case MESA_FORMAT_ETC2_SRGB8:
+   case MESA_FORMAT_ETC2_SRGB8_ALPHA8_EAC:
+   case MESA_FORMAT_ETC2_SRGB8_PUNCHTHROUGH_ALPHA1:
+      /* unpacked as BGRA */
+      for (int c = 0; c < 3; c++)
+         expected[c] = util_format_srgb_8unorm_to_linear_float_table[texel[2 - c]];
+      expected[3] = ubyte_to_float(texel[3]);
+      break;
+   case MESA_FORMAT_ETC2_RG11_EAC:
+      expected[1] = ushort_to_float(comps[1]);
+      /* fallthrough */
+   case MESA_FORMAT_ETC2_R11_EAC:
+      expected[0] = ushort_to_float(comps[0]);
+      break;
+   case MESA_FORMAT_ETC2_SIGNED_RG11_EAC:
+      expected[1] = short_to_float(comps[1]);
+      /* fallthrough */
+   case MESA_FORMAT_ETC2_SIGNED_R11_EAC:
+      expected[0] = short_to_float(comps[0]);
+      break;
+   default:
+      FAIL() << "unexpected format";
+   }
+}
+
+/**
+ * Unpack a random width x height image of every format, and compare each
+ * texel with the fetch function.
+ */
+static void
+check_unpack(unsigned width, unsigned height)
+{
+   static const mesa_format formats[] = {
+      MESA_FORMAT_ETC2_RGB8,
+      MESA_FORMAT_ETC2_SRGB8,
+      MESA_FORMAT_ETC2_RGBA8_EAC,
+      MESA_FORMAT_ETC2_SRGB8_ALPHA8_EAC,
+      MESA_FORMAT_ETC2_R11_EAC,
+      MESA_FORMAT_ETC2_RG11_EAC,
+      MESA_FORMAT_ETC2_SIGNED_R11_EAC,
+      MESA_FORMAT_ETC2_SIGNED_RG11_EAC,
+      MESA_FORMAT_ETC2_RGB8_PUNCHTHROUGH_ALPHA1,
+      MESA_FORMAT_ETC2_SRGB8_PUNCHTHROUGH_ALPHA1,
+   };
+   const unsigned blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+
+   /* normally set up by the first context creation */
+   for (int i = 0; i < 256; i++)
+      _mesa_ubyte_to_float_color_tab[i] = ubyte_to_float(i);
+
+   /* Split large images even on a single CPU.  This only has an effect
+    * if no earlier test unpacked an image.
+    */
+   setenv("MESA_TEXTURE_THREADS", "4", 0);
+
+   for (unsigned f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+      const mesa_format format = formats[f];
+      const unsigned block_size = _mesa_get_format_bytes(format);
+      const unsigned texel_size =
+         format == MESA_FORMAT_ETC2_R11_EAC ||
+         format == MESA_FORMAT_ETC2_SIGNED_R11_EAC ? 2 : 4;
+      const unsigned src_stride = blocks_x * block_size;
+      const unsigned dst_stride = width * texel_size + 4;
+      compressed_fetch_func fetch = _mesa_get_etc_fetch_func(format);
+      uint8_t *src = (uint8_t *) malloc(src_stride * blocks_y);
+      uint8_t *dst = (uint8_t *) malloc(dst_stride * height);
+      unsigned mismatches = 0;
+
+      SCOPED_TRACE(_mesa_get_format_name(format));
+      ASSERT_TRUE(fetch != NULL);
+
+      /* random blocks hit every mode, and both punchthrough cases */
+      srand(f);
+      for (unsigned i = 0; i < src_stride * blocks_y; i++)
+         src[i] = rand();
+
+      _mesa_unpack_etc2_format(dst, dst_stride, src, src_stride,
+                               width, height, format);
+
+      for (unsigned y = 0; y < height; y++) {
+         for (unsigned x = 0; x < width; x++) {
+            float texel[4], expected[4];
+
+            fetch(src, width, x, y, texel);
+            expected_texel(format, dst + y * dst_stride + x * texel_size,
+                           expected);
+
+            for (int c = 0; c < 4; c++) {
+               if (expected[c] != texel[c] && mismatches++ == 0) {
+                  ADD_FAILURE() << "texel " << x << ", " << y
+                                << " component " << c << ": expected "
+                                << expected[c] << ", fetched " << texel[c];
+               }
+            }
+         }
+      }
+
+      EXPECT_EQ(0u, mismatches);
+
+      free(src);
+      free(dst);
+   }
+}
+
+/* Not a multiple of the block size, and several block rows */
+TEST(TexcompressEtcTest, UnpackMatchesFetch)
+{
+   check_unpack(67, 45);
+}
+
+/* Enough block rows to be split over several threads */
+TEST(TexcompressEtcTest, UnpackMatchesFetchThreaded)
+{
+   const unsigned width = 1030, height = 518;
+   const unsigned blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+
+   ASSERT_GE(blocks_x * blocks_y, 2u * MIN_THREAD_BLOCKS);
+   check_unpack(width, height);
+}
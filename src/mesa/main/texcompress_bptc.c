@@ -34,11 +34,17 @@
 #include "texstore.h"
 #include "macros.h"
 #include "image.h"
+#include "parallel.h"
+#include "sse_bptc.h"
+#include "x86/common_x86_asm.h"
 
 #define BLOCK_SIZE 4
 #define N_PARTITIONS 64
 #define BLOCK_BYTES 16
 
+/* Minimum number of blocks per thread when compressing in parallel */
+#define MIN_THREAD_BLOCKS 4096
+
 struct bptc_unorm_mode {
    int n_subsets;
    int n_partition_bits;
@@ -71,11 +77,21 @@ struct bptc_float_mode {
 };
 
 struct bit_writer {
-   uint8_t buf;
+   uint32_t buf;
    int pos;
    uint8_t *dst;
 };
 
+/* The block rows of an image being compressed, see compress_rows() */
+struct compress_rows {
+   int width, height;
+   const uint8_t *src;
+   int src_rowstride;
+   uint8_t *dst;
+   int dst_rowstride;
+   bool is_signed;
+};
+
 static const struct bptc_unorm_mode
 bptc_unorm_modes[] = {
    /* 0 */ { 3, 4, false, false, 4, 0, true,  false, 3, 0 },
@@ -969,19 +985,63 @@ _mesa_get_bptc_fetch_func(mesa_format format)
 static void
 write_bits(struct bit_writer *writer, int n_bits, int value)
 {
-   do {
-      if (n_bits + writer->pos >= 8) {
-         *(writer->dst++) = writer->buf | (value << writer->pos);
-         writer->buf = 0;
-         value >>= (8 - writer->pos);
-         n_bits -= (8 - writer->pos);
-         writer->pos = 0;
-      } else {
-         writer->buf |= value << writer->pos;
-         writer->pos += n_bits;
-         break;
-      }
-   } while (n_bits > 0);
+   /* Less than 8 bits are pending, so 24 more always fit in the buffer */
+   while (n_bits > 24) {
+      write_bits(writer, 24, value & 0xffffff);
+      value >>= 24;
+      n_bits -= 24;
+   }
+
+   writer->buf |= (uint32_t) value << writer->pos;
+   writer->pos += n_bits;
+
+   while (writer->pos >= 8) {
+      *(writer->dst++) = writer->buf;
+      writer->buf >>= 8;
+      writer->pos -= 8;
+   }
+}
+
+static void
+write_indices(struct bit_writer *writer, const uint8_t indices[16],
+              int n_bits)
+{
+   int i;
+
+   /* The first index has one less bit */
+   write_bits(writer, n_bits - 1, indices[0]);
+
+   for (i = 1; i < BLOCK_SIZE * BLOCK_SIZE; i++)
+      write_bits(writer, n_bits, indices[i]);
+}
+
+/**
+ * Compress a whole image by calling func for ranges of its block rows,
+ * split over several threads for large images.
+ */
+static void
+compress_rows(int width, int height,
+              const uint8_t *src, int src_rowstride,
+              uint8_t *dst, int dst_rowstride, bool is_signed,
+              mesa_parallel_func func)
+{
+   const int blocks_per_row = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+   struct compress_rows rows;
+
+   rows.width = width;
+   rows.height = height;
+   rows.src = src;
+   rows.src_rowstride = src_rowstride;
+   rows.dst = dst;
+   if (dst_rowstride >= width * 4)
+      rows.dst_rowstride = dst_rowstride;
+   else
+      rows.dst_rowstride = blocks_per_row * BLOCK_BYTES;
+   rows.is_signed = is_signed;
+
+   _mesa_parallel_for((height + BLOCK_SIZE - 1) / BLOCK_SIZE,
+                      MAX2(MIN_THREAD_BLOCKS / blocks_per_row, 1),
+                      func, &rows);
 }
 
 static void
@@ -1103,10 +1163,9 @@ get_rgba_endpoints_unorm(int width, int height,
 }
 
 static void
-write_rgb_indices_unorm(struct bit_writer *writer,
-                        int src_width, int src_height,
-                        const uint8_t *src, int src_rowstride,
-                        uint8_t endpoints[][4])
+get_rgb_indices_unorm(int src_width, int src_height,
+                      const uint8_t *src, int src_rowstride,
+                      uint8_t endpoints[][4], uint8_t indices[16])
 {
    int luminance;
    int endpoint_luminances[2];
@@ -1121,12 +1180,13 @@ write_rgb_indices_unorm(struct bit_writer *writer,
          endpoints[endpoint][2];
    }
 
+   /* Texels outside of the image get index 0 */
+   memset(indices, 0, BLOCK_SIZE * BLOCK_SIZE);
+
    /* If the endpoints have the same luminance then we'll just use index 0 for
     * all of the texels */
-   if (endpoint_luminances[0] == endpoint_luminances[1]) {
-      write_bits(writer, BLOCK_SIZE * BLOCK_SIZE * 2 - 1, 0);
+   if (endpoint_luminances[0] == endpoint_luminances[1])
       return;
-   }
 
    for (y = 0; y < src_height; y++) {
       for (x = 0; x < src_width; x++) {
@@ -1141,38 +1201,30 @@ write_rgb_indices_unorm(struct bit_writer *writer,
 
          assert(x != 0 || y != 0 || index < 2);
 
-         write_bits(writer, (x == 0 && y == 0) ? 1 : 2, index);
+         indices[y * BLOCK_SIZE + x] = index;
 
          src += 4;
       }
 
-      /* Pad the indices out to the block size */
-      if (src_width < BLOCK_SIZE)
-         write_bits(writer, 2 * (BLOCK_SIZE - src_width), 0);
-
       src += src_rowstride - src_width * 4;
    }
-
-   /* Pad the indices out to the block size */
-   if (src_height < BLOCK_SIZE)
-      write_bits(writer, 2 * BLOCK_SIZE * (BLOCK_SIZE - src_height), 0);
 }
 
 static void
-write_alpha_indices_unorm(struct bit_writer *writer,
-                          int src_width, int src_height,
-                          const uint8_t *src, int src_rowstride,
-                          uint8_t endpoints[][4])
+get_alpha_indices_unorm(int src_width, int src_height,
+                        const uint8_t *src, int src_rowstride,
+                        uint8_t endpoints[][4], uint8_t indices[16])
 {
    int index;
    int y, x;
 
+   /* Texels outside of the image get index 0 */
+   memset(indices, 0, BLOCK_SIZE * BLOCK_SIZE);
+
    /* If the endpoints have the same alpha then we'll just use index 0 for
     * all of the texels */
-   if (endpoints[0][3] == endpoints[1][3]) {
-      write_bits(writer, BLOCK_SIZE * BLOCK_SIZE * 3 - 1, 0);
+   if (endpoints[0][3] == endpoints[1][3])
       return;
-   }
 
    for (y = 0; y < src_height; y++) {
       for (x = 0; x < src_width; x++) {
@@ -1185,22 +1237,13 @@ write_alpha_indices_unorm(struct bit_writer *writer,
 
          assert(x != 0 || y != 0 || index < 4);
 
-         /* The first index has one less bit */
-         write_bits(writer, (x == 0 && y == 0) ? 2 : 3, index);
+         indices[y * BLOCK_SIZE + x] = index;
 
          src += 4;
       }
 
-      /* Pad the indices out to the block size */
-      if (src_width < BLOCK_SIZE)
-         write_bits(writer, 3 * (BLOCK_SIZE - src_width), 0);
-
       src += src_rowstride - src_width * 4;
    }
-
-   /* Pad the indices out to the block size */
-   if (src_height < BLOCK_SIZE)
-      write_bits(writer, 3 * BLOCK_SIZE * (BLOCK_SIZE - src_height), 0);
 }
 
 static void
@@ -1210,14 +1253,31 @@ compress_rgba_unorm_block(int src_width, int src_height,
 {
    int average_luminance, average_alpha;
    uint8_t endpoints[2][4];
+   uint8_t rgb_indices[BLOCK_SIZE * BLOCK_SIZE];
+   uint8_t alpha_indices[BLOCK_SIZE * BLOCK_SIZE];
    struct bit_writer writer;
    int component, endpoint;
 
-   get_average_luminance_alpha_unorm(src_width, src_height, src, src_rowstride,
-                                     &average_luminance, &average_alpha);
-   get_rgba_endpoints_unorm(src_width, src_height, src, src_rowstride,
-                            average_luminance, average_alpha,
-                            endpoints);
+#if defined(USE_SSE41)
+   if (cpu_has_sse4_1 &&
+       src_width == BLOCK_SIZE && src_height == BLOCK_SIZE) {
+      _mesa_sse41_bptc_rgba_unorm_block(src, src_rowstride, endpoints,
+                                        rgb_indices, alpha_indices);
+   }
+   else
+#endif
+   {
+      get_average_luminance_alpha_unorm(src_width, src_height,
+                                        src, src_rowstride,
+                                        &average_luminance, &average_alpha);
+      get_rgba_endpoints_unorm(src_width, src_height, src, src_rowstride,
+                               average_luminance, average_alpha,
+                               endpoints);
+      get_rgb_indices_unorm(src_width, src_height, src, src_rowstride,
+                            endpoints, rgb_indices);
+      get_alpha_indices_unorm(src_width, src_height, src, src_rowstride,
+                              endpoints, alpha_indices);
+   }
 
    writer.dst = dst;
    writer.pos = 0;
@@ -1236,42 +1296,41 @@ compress_rgba_unorm_block(int src_width, int src_height,
    for (endpoint = 0; endpoint < 2; endpoint++)
       write_bits(&writer, 6, endpoints[endpoint][3] >> 2);
 
-   write_rgb_indices_unorm(&writer,
-                           src_width, src_height,
-                           src, src_rowstride,
-                           endpoints);
-   write_alpha_indices_unorm(&writer,
-                             src_width, src_height,
-                             src, src_rowstride,
-                             endpoints);
+   write_indices(&writer, rgb_indices, 2);
+   write_indices(&writer, alpha_indices, 3);
 }
 
 static void
-compress_rgba_unorm(int width, int height,
-                    const uint8_t *src, int src_rowstride,
-                    uint8_t *dst, int dst_rowstride)
+compress_rgba_unorm_rows(void *data, int first, int last)
 {
-   int dst_row_diff;
-   int y, x;
-
-   if (dst_rowstride >= width * 4)
-      dst_row_diff = dst_rowstride - ((width + 3) & ~3) * 4;
-   else
-      dst_row_diff = 0;
-
-   for (y = 0; y < height; y += BLOCK_SIZE) {
-      for (x = 0; x < width; x += BLOCK_SIZE) {
-         compress_rgba_unorm_block(MIN2(width - x, BLOCK_SIZE),
-                                   MIN2(height - y, BLOCK_SIZE),
-                                   src + x * 4 + y * src_rowstride,
-                                   src_rowstride,
+   const struct compress_rows *rows = (const struct compress_rows *) data;
+   int block_row, x, y;
+
+   for (block_row = first; block_row < last; block_row++) {
+      uint8_t *dst = rows->dst + block_row * rows->dst_rowstride;
+
+      y = block_row * BLOCK_SIZE;
+      for (x = 0; x < rows->width; x += BLOCK_SIZE) {
+         compress_rgba_unorm_block(MIN2(rows->width - x, BLOCK_SIZE),
+                                   MIN2(rows->height - y, BLOCK_SIZE),
+                                   rows->src + x * 4 +
+                                   y * rows->src_rowstride,
+                                   rows->src_rowstride,
                                    dst);
          dst += BLOCK_BYTES;
       }
-      dst += dst_row_diff;
    }
 }
 
+static void
+compress_rgba_unorm(int width, int height,
+                    const uint8_t *src, int src_rowstride,
+                    uint8_t *dst, int dst_rowstride)
+{
+   compress_rows(width, height, src, src_rowstride, dst, dst_rowstride,
+                 false, compress_rgba_unorm_rows);
+}
+
 GLboolean
 _mesa_texstore_bptc_rgba_unorm(TEXSTORE_PARAMS)
 {
@@ -1555,34 +1614,39 @@ compress_rgb_float_block(int src_width, int src_height,
 }
 
 static void
-compress_rgb_float(int width, int height,
-                   const float *src, int src_rowstride,
-                   uint8_t *dst, int dst_rowstride,
-                   bool is_signed)
+compress_rgb_float_rows(void *data, int first, int last)
 {
-   int dst_row_diff;
-   int y, x;
+   const struct compress_rows *rows = (const struct compress_rows *) data;
+   const float *src = (const float *) rows->src;
+   int block_row, x, y;
 
-   if (dst_rowstride >= width * 4)
-      dst_row_diff = dst_rowstride - ((width + 3) & ~3) * 4;
-   else
-      dst_row_diff = 0;
+   for (block_row = first; block_row < last; block_row++) {
+      uint8_t *dst = rows->dst + block_row * rows->dst_rowstride;
 
-   for (y = 0; y < height; y += BLOCK_SIZE) {
-      for (x = 0; x < width; x += BLOCK_SIZE) {
-         compress_rgb_float_block(MIN2(width - x, BLOCK_SIZE),
-                                  MIN2(height - y, BLOCK_SIZE),
+      y = block_row * BLOCK_SIZE;
+      for (x = 0; x < rows->width; x += BLOCK_SIZE) {
+         compress_rgb_float_block(MIN2(rows->width - x, BLOCK_SIZE),
+                                  MIN2(rows->height - y, BLOCK_SIZE),
                                   src + x * 3 +
-                                  y * src_rowstride / sizeof (float),
-                                  src_rowstride,
+                                  y * rows->src_rowstride / sizeof (float),
+                                  rows->src_rowstride,
                                   dst,
-                                  is_signed);
+                                  rows->is_signed);
          dst += BLOCK_BYTES;
       }
-      dst += dst_row_diff;
    }
 }
 
+static void
+compress_rgb_float(int width, int height,
+                   const float *src, int src_rowstride,
+                   uint8_t *dst, int dst_rowstride,
+                   bool is_signed)
+{
+   compress_rows(width, height, (const uint8_t *) src, src_rowstride,
+                 dst, dst_rowstride, is_signed, compress_rgb_float_rows);
+}
+
 static GLboolean
 texstore_bptc_rgb_float(TEXSTORE_PARAMS,
                         bool is_signed)
@@ -43,9 +43,14 @@
 #include "texstore.h"
 #include "macros.h"
 #include "format_unpack.h"
+#include "parallel.h"
 #include "util/format_srgb.h"
 
 
+/* Minimum number of blocks per thread when decompressing in parallel */
+#define MIN_THREAD_BLOCKS 16384
+
+
 struct etc2_block {
    int distance;
    uint64_t pixel_indices[2];
@@ -549,26 +554,27 @@ etc2_rgb8_fetch_texel(const struct etc2_block *block,
    }
 }
 
-static void
-etc2_alpha8_fetch_texel(const struct etc2_block *block,
-      int x, int y, uint8_t *dst)
+static uint8_t
+etc2_alpha8_value(const struct etc2_block *block, int idx)
 {
-   int modifier, alpha, idx;
-   /* get pixel index */
-   idx = etc2_get_pixel_index(block, x, y);
+   int modifier, alpha;
    modifier = etc2_modifier_tables[block->table_index][idx];
    alpha = block->base_codeword + modifier * block->multiplier;
-   dst[3] = etc2_clamp(alpha);
+   return etc2_clamp(alpha);
 }
 
 static void
-etc2_r11_fetch_texel(const struct etc2_block *block,
-                     int x, int y, uint8_t *dst)
+etc2_alpha8_fetch_texel(const struct etc2_block *block,
+      int x, int y, uint8_t *dst)
 {
-   GLint modifier, idx;
+   dst[3] = etc2_alpha8_value(block, etc2_get_pixel_index(block, x, y));
+}
+
+static GLushort
+etc2_r11_value(const struct etc2_block *block, int idx)
+{
+   GLint modifier;
    GLshort color;
-   /* Get pixel index */
-   idx = etc2_get_pixel_index(block, x, y);
    modifier = etc2_modifier_tables[block->table_index][idx];
 
    if (block->multiplier != 0)
@@ -584,22 +590,27 @@ etc2_r11_fetch_texel(const struct etc2_block *block,
     * 11 bits."
     */
    color = (color << 5) | (color >> 6);
-   ((GLushort *)dst)[0] = color;
+   return color;
 }
 
 static void
-etc2_signed_r11_fetch_texel(const struct etc2_block *block,
-                            int x, int y, uint8_t *dst)
+etc2_r11_fetch_texel(const struct etc2_block *block,
+                     int x, int y, uint8_t *dst)
 {
-   GLint modifier, idx;
+   ((GLushort *)dst)[0] =
+      etc2_r11_value(block, etc2_get_pixel_index(block, x, y));
+}
+
+static GLshort
+etc2_signed_r11_value(const struct etc2_block *block, int idx)
+{
+   GLint modifier;
    GLshort color;
    GLbyte base_codeword = (GLbyte) block->base_codeword;
 
    if (base_codeword == -128)
       base_codeword = -127;
 
-   /* Get pixel index */
-   idx = etc2_get_pixel_index(block, x, y);
    modifier = etc2_modifier_tables[block->table_index][idx];
 
    if (block->multiplier != 0)
@@ -622,7 +633,15 @@ etc2_signed_r11_fetch_texel(const struct etc2_block *block,
       color = (color << 5) | (color >> 5);
       color = -color;
    }
-   ((GLshort *)dst)[0] = color;
+   return color;
+}
+
+static void
+etc2_signed_r11_fetch_texel(const struct etc2_block *block,
+                            int x, int y, uint8_t *dst)
+{
+   ((GLshort *)dst)[0] =
+      etc2_signed_r11_value(block, etc2_get_pixel_index(block, x, y));
 }
 
 static void
@@ -665,432 +684,295 @@ etc2_rgba8_fetch_texel(const struct etc2_block *block,
    etc2_alpha8_fetch_texel(block, x, y, dst);
 }
 
+/**
+ * Decode the RGB part of a block into 16 RGBA texels in row-major order,
+ * with the same results as etc2_rgb8_fetch_texel() for each of them.  The
+ * at most eight colors a block can produce are computed up front, so each
+ * texel only costs a table lookup.
+ */
 static void
-etc2_unpack_rgb8(uint8_t *dst_row,
-                 unsigned dst_stride,
-                 const uint8_t *src_row,
-                 unsigned src_stride,
-                 unsigned width,
-                 unsigned height)
+etc2_rgb8_decode_block(const struct etc2_block *block, uint8_t texels[16][4],
+                       GLboolean punchthrough_alpha)
 {
-   const unsigned bw = 4, bh = 4, bs = 8, comps = 4;
-   struct etc2_block block;
-   unsigned x, y, i, j;
-
-   for (y = 0; y < height; y += bh) {
-      const uint8_t *src = src_row;
-      /*
-       * Destination texture may not be a multiple of four texels in
-       * height. Compute a safe height to avoid writing outside the texture.
-       */
-      const unsigned h = MIN2(bh, height - y);
+   /* Only the individual and differential modes have two subblocks */
+   const bool flipped = (block->is_ind_mode || block->is_diff_mode) &&
+                        block->flipped;
+   uint8_t colors[8][4];
+   int x, y, i, idx, blk, bit;
 
-      for (x = 0; x < width; x+= bw) {
-         /*
-          * Destination texture may not be a multiple of four texels in
-          * width. Compute a safe width to avoid writing outside the texture.
-          */
-         const unsigned w = MIN2(bw, width - x);
+   if (block->is_ind_mode || block->is_diff_mode) {
+      for (blk = 0; blk < 2; blk++) {
+         const uint8_t *base_color = block->base_colors[blk];
 
-         etc2_rgb8_parse_block(&block, src,
-                               false /* punchthrough_alpha */);
+         for (idx = 0; idx < 4; idx++) {
+            const int modifier = block->modifier_tables[blk][idx];
+            uint8_t *color = colors[blk * 4 + idx];
 
-         for (j = 0; j < h; j++) {
-            uint8_t *dst = dst_row + (y + j) * dst_stride + x * comps;
-            for (i = 0; i < w; i++) {
-               etc2_rgb8_fetch_texel(&block, i, j, dst,
-                                     false /* punchthrough_alpha */);
-               dst[3] = 255;
-               dst += comps;
-            }
+            color[0] = etc2_clamp(base_color[0] + modifier);
+            color[1] = etc2_clamp(base_color[1] + modifier);
+            color[2] = etc2_clamp(base_color[2] + modifier);
+            color[3] = 255;
          }
-
-         src += bs;
       }
-
-      src_row += src_stride;
    }
-}
-
-static void
-etc2_unpack_srgb8(uint8_t *dst_row,
-                  unsigned dst_stride,
-                  const uint8_t *src_row,
-                  unsigned src_stride,
-                  unsigned width,
-                  unsigned height)
-{
-   const unsigned bw = 4, bh = 4, bs = 8, comps = 4;
-   struct etc2_block block;
-   unsigned x, y, i, j;
-   uint8_t tmp;
-
-   for (y = 0; y < height; y += bh) {
-      const uint8_t *src = src_row;
-      const unsigned h = MIN2(bh, height - y);
-
-      for (x = 0; x < width; x+= bw) {
-         const unsigned w = MIN2(bw, width - x);
-         etc2_rgb8_parse_block(&block, src,
-                               false /* punchthrough_alpha */);
+   else if (block->is_t_mode || block->is_h_mode) {
+      /* Both halves of the table are the same, whichever subblock the
+       * texel lookup below picks.
+       */
+      for (idx = 0; idx < 4; idx++) {
+         for (i = 0; i < 3; i++)
+            colors[idx][i] = colors[idx + 4][i] = block->paint_colors[idx][i];
+         colors[idx][3] = colors[idx + 4][3] = 255;
+      }
+   }
+   else {
+      assert(block->is_planar_mode);
 
+      for (y = 0; y < 4; y++) {
+         for (x = 0; x < 4; x++) {
+            for (i = 0; i < 3; i++) {
+               const int o = block->base_colors[0][i];
+               const int h = block->base_colors[1][i];
+               const int v = block->base_colors[2][i];
 
-         for (j = 0; j < h; j++) {
-            uint8_t *dst = dst_row + (y + j) * dst_stride + x * comps;
-            for (i = 0; i < w; i++) {
-               etc2_rgb8_fetch_texel(&block, i, j, dst,
-                                     false /* punchthrough_alpha */);
-               /* Convert to MESA_FORMAT_B8G8R8A8_SRGB */
-               tmp = dst[0];
-               dst[0] = dst[2];
-               dst[2] = tmp;
-               dst[3] = 255;
-
-               dst += comps;
+               texels[y * 4 + x][i] =
+                  etc2_clamp((x * (h - o) + y * (v - o) + 4 * o + 2) >> 2);
             }
+            texels[y * 4 + x][3] = 255;
          }
-         src += bs;
       }
-
-      src_row += src_stride;
+      return;
    }
-}
-
-static void
-etc2_unpack_rgba8(uint8_t *dst_row,
-                  unsigned dst_stride,
-                  const uint8_t *src_row,
-                  unsigned src_stride,
-                  unsigned width,
-                  unsigned height)
-{
-   /* If internalformat is COMPRESSED_RGBA8_ETC2_EAC, each 4 × 4 block of
-    * RGBA8888 information is compressed to 128 bits. To decode a block, the
-    * two 64-bit integers int64bitAlpha and int64bitColor are calculated.
-   */
-   const unsigned bw = 4, bh = 4, bs = 16, comps = 4;
-   struct etc2_block block;
-   unsigned x, y, i, j;
 
-   for (y = 0; y < height; y += bh) {
-      const uint8_t *src = src_row;
-      const unsigned h = MIN2(bh, height - y);
-
-      for (x = 0; x < width; x+= bw) {
-         const unsigned w = MIN2(bw, width - x);
-         etc2_rgba8_parse_block(&block, src);
+   /* Index 2 is transparent black in non-opaque punchthrough blocks */
+   if (punchthrough_alpha && !block->opaque) {
+      memset(colors[2], 0, 4);
+      memset(colors[6], 0, 4);
+   }
 
-         for (j = 0; j < h; j++) {
-            uint8_t *dst = dst_row + (y + j) * dst_stride + x * comps;
-            for (i = 0; i < w; i++) {
-               etc2_rgba8_fetch_texel(&block, i, j, dst);
-               dst += comps;
-            }
-         }
-         src += bs;
+   for (y = 0; y < 4; y++) {
+      for (x = 0; x < 4; x++) {
+         bit = y + x * 4;
+         idx = ((block->pixel_indices[0] >> (15 + bit)) & 0x2) |
+               ((block->pixel_indices[0] >>      (bit)) & 0x1);
+         blk = flipped ? (y >= 2) : (x >= 2);
+         memcpy(texels[y * 4 + x], colors[blk * 4 + idx], 4);
       }
-
-      src_row += src_stride;
    }
 }
 
+/**
+ * Decode an EAC alpha block into the alpha channel of 16 RGBA texels.
+ */
 static void
-etc2_unpack_srgb8_alpha8(uint8_t *dst_row,
-                         unsigned dst_stride,
-                         const uint8_t *src_row,
-                         unsigned src_stride,
-                         unsigned width,
-                         unsigned height)
+etc2_alpha8_decode_block(const struct etc2_block *block, uint8_t texels[16][4])
 {
-   /* If internalformat is COMPRESSED_SRGB8_ALPHA8_ETC2_EAC, each 4 × 4 block
-    * of RGBA8888 information is compressed to 128 bits. To decode a block, the
-    * two 64-bit integers int64bitAlpha and int64bitColor are calculated.
-    */
-   const unsigned bw = 4, bh = 4, bs = 16, comps = 4;
-   struct etc2_block block;
-   unsigned x, y, i, j;
-   uint8_t tmp;
+   uint8_t alphas[8];
+   int x, y, idx;
 
-   for (y = 0; y < height; y += bh) {
-      const unsigned h = MIN2(bh, height - y);
-      const uint8_t *src = src_row;
+   for (idx = 0; idx < 8; idx++)
+      alphas[idx] = etc2_alpha8_value(block, idx);
 
-      for (x = 0; x < width; x+= bw) {
-         const unsigned w = MIN2(bw, width - x);
-         etc2_rgba8_parse_block(&block, src);
-
-         for (j = 0; j < h; j++) {
-            uint8_t *dst = dst_row + (y + j) * dst_stride + x * comps;
-            for (i = 0; i < w; i++) {
-               etc2_rgba8_fetch_texel(&block, i, j, dst);
-
-               /* Convert to MESA_FORMAT_B8G8R8A8_SRGB */
-               tmp = dst[0];
-               dst[0] = dst[2];
-               dst[2] = tmp;
-               dst[3] = dst[3];
-
-               dst += comps;
-            }
-         }
-         src += bs;
-      }
-
-      src_row += src_stride;
+   for (y = 0; y < 4; y++) {
+      for (x = 0; x < 4; x++)
+         texels[y * 4 + x][3] = alphas[etc2_get_pixel_index(block, x, y)];
    }
 }
 
+/**
+ * Decode an R11 block into every comps'th 16-bit component of dst, which
+ * holds 16 texels in row-major order.
+ */
 static void
-etc2_unpack_r11(uint8_t *dst_row,
-                unsigned dst_stride,
-                const uint8_t *src_row,
-                unsigned src_stride,
-                unsigned width,
-                unsigned height)
+etc2_r11_decode_block(const struct etc2_block *block, GLushort *dst,
+                      unsigned comps, GLboolean is_signed)
 {
-   /* If internalformat is COMPRESSED_R11_EAC, each 4 × 4 block of
-      color information is compressed to 64 bits.
-   */
-   const unsigned bw = 4, bh = 4, bs = 8, comps = 1, comp_size = 2;
-   struct etc2_block block;
-   unsigned x, y, i, j;
-
-   for (y = 0; y < height; y += bh) {
-      const unsigned h = MIN2(bh, height - y);
-      const uint8_t *src = src_row;
+   GLushort values[8];
+   int x, y, idx;
 
-      for (x = 0; x < width; x+= bw) {
-         const unsigned w = MIN2(bw, width - x);
-         etc2_r11_parse_block(&block, src);
+   for (idx = 0; idx < 8; idx++) {
+      values[idx] = is_signed ? (GLushort) etc2_signed_r11_value(block, idx) :
+                                etc2_r11_value(block, idx);
+   }
 
-         for (j = 0; j < h; j++) {
-            uint8_t *dst = dst_row + (y + j) * dst_stride + x * comps * comp_size;
-            for (i = 0; i < w; i++) {
-               etc2_r11_fetch_texel(&block, i, j, dst);
-               dst += comps * comp_size;
-            }
-         }
-         src += bs;
+   for (y = 0; y < 4; y++) {
+      for (x = 0; x < 4; x++) {
+         dst[(y * 4 + x) * comps] =
+            values[etc2_get_pixel_index(block, x, y)];
       }
-
-      src_row += src_stride;
    }
 }
 
 static void
-etc2_unpack_rg11(uint8_t *dst_row,
-                 unsigned dst_stride,
-                 const uint8_t *src_row,
-                 unsigned src_stride,
-                 unsigned width,
-                 unsigned height)
+etc2_swap_red_blue(uint8_t texels[16][4])
 {
-   /* If internalformat is COMPRESSED_RG11_EAC, each 4 × 4 block of
-      RG color information is compressed to 128 bits.
-   */
-   const unsigned bw = 4, bh = 4, bs = 16, comps = 2, comp_size = 2;
-   struct etc2_block block;
-   unsigned x, y, i, j;
-
-   for (y = 0; y < height; y += bh) {
-      const unsigned h = MIN2(bh, height - y);
-      const uint8_t *src = src_row;
-
-      for (x = 0; x < width; x+= bw) {
-         const unsigned w = MIN2(bw, width - x);
-         /* red component */
-         etc2_r11_parse_block(&block, src);
-
-         for (j = 0; j < h; j++) {
-            uint8_t *dst = dst_row + (y + j) * dst_stride +
-                           x * comps * comp_size;
-            for (i = 0; i < w; i++) {
-               etc2_r11_fetch_texel(&block, i, j, dst);
-               dst += comps * comp_size;
-            }
-         }
-         /* green component */
-         etc2_r11_parse_block(&block, src + 8);
-
-         for (j = 0; j < h; j++) {
-            uint8_t *dst = dst_row + (y + j) * dst_stride +
-                           x * comps * comp_size;
-            for (i = 0; i < w; i++) {
-               etc2_r11_fetch_texel(&block, i, j, dst + comp_size);
-               dst += comps * comp_size;
-            }
-         }
-         src += bs;
-      }
+   uint8_t tmp;
+   int i;
 
-      src_row += src_stride;
+   /* Convert to MESA_FORMAT_B8G8R8A8_SRGB */
+   for (i = 0; i < 16; i++) {
+      tmp = texels[i][0];
+      texels[i][0] = texels[i][2];
+      texels[i][2] = tmp;
    }
 }
 
-static void
-etc2_unpack_signed_r11(uint8_t *dst_row,
-                       unsigned dst_stride,
-                       const uint8_t *src_row,
-                       unsigned src_stride,
-                       unsigned width,
-                       unsigned height)
+/**
+ * Size in bytes of one compressed block of an ETC2 format, or 0 if the
+ * format isn't one.
+ */
+static unsigned
+etc2_block_size(mesa_format format)
 {
-   /* If internalformat is COMPRESSED_SIGNED_R11_EAC, each 4 × 4 block of
-      red color information is compressed to 64 bits.
-   */
-   const unsigned bw = 4, bh = 4, bs = 8, comps = 1, comp_size = 2;
-   struct etc2_block block;
-   unsigned x, y, i, j;
-
-   for (y = 0; y < height; y += bh) {
-      const unsigned h = MIN2(bh, height - y);
-      const uint8_t *src = src_row;
-
-      for (x = 0; x < width; x+= bw) {
-         const unsigned w = MIN2(bw, width - x);
-         etc2_r11_parse_block(&block, src);
-
-         for (j = 0; j < h; j++) {
-            uint8_t *dst = dst_row + (y + j) * dst_stride +
-                           x * comps * comp_size;
-            for (i = 0; i < w; i++) {
-               etc2_signed_r11_fetch_texel(&block, i, j, dst);
-               dst += comps * comp_size;
-            }
-         }
-         src += bs;
-      }
-
-      src_row += src_stride;
+   switch (format) {
+   case MESA_FORMAT_ETC2_RGB8:
+   case MESA_FORMAT_ETC2_SRGB8:
+   case MESA_FORMAT_ETC2_R11_EAC:
+   case MESA_FORMAT_ETC2_SIGNED_R11_EAC:
+   case MESA_FORMAT_ETC2_RGB8_PUNCHTHROUGH_ALPHA1:
+   case MESA_FORMAT_ETC2_SRGB8_PUNCHTHROUGH_ALPHA1:
+      return 8;
+   case MESA_FORMAT_ETC2_RGBA8_EAC:
+   case MESA_FORMAT_ETC2_SRGB8_ALPHA8_EAC:
+   case MESA_FORMAT_ETC2_RG11_EAC:
+   case MESA_FORMAT_ETC2_SIGNED_RG11_EAC:
+      return 16;
+   default:
+      return 0;
    }
 }
 
-static void
-etc2_unpack_signed_rg11(uint8_t *dst_row,
-                        unsigned dst_stride,
-                        const uint8_t *src_row,
-                        unsigned src_stride,
-                        unsigned width,
-                        unsigned height)
+/**
+ * Size in bytes of one decompressed texel of an ETC2 format.
+ */
+static unsigned
+etc2_texel_size(mesa_format format)
 {
-   /* If internalformat is COMPRESSED_SIGNED_RG11_EAC, each 4 × 4 block of
-      RG color information is compressed to 128 bits.
-   */
-   const unsigned bw = 4, bh = 4, bs = 16, comps = 2, comp_size = 2;
-   struct etc2_block block;
-   unsigned x, y, i, j;
-
-   for (y = 0; y < height; y += bh) {
-      const unsigned h = MIN2(bh, height - y);
-      const uint8_t *src = src_row;
-
-      for (x = 0; x < width; x+= bw) {
-         const unsigned w = MIN2(bw, width - x);
-         /* red component */
-         etc2_r11_parse_block(&block, src);
-
-         for (j = 0; j < h; j++) {
-            uint8_t *dst = dst_row + (y + j) * dst_stride +
-                          x * comps * comp_size;
-            for (i = 0; i < w; i++) {
-               etc2_signed_r11_fetch_texel(&block, i, j, dst);
-               dst += comps * comp_size;
-            }
-         }
-         /* green component */
-         etc2_r11_parse_block(&block, src + 8);
-
-         for (j = 0; j < h; j++) {
-            uint8_t *dst = dst_row + (y + j) * dst_stride +
-                           x * comps * comp_size;
-            for (i = 0; i < w; i++) {
-               etc2_signed_r11_fetch_texel(&block, i, j, dst + comp_size);
-               dst += comps * comp_size;
-            }
-         }
-         src += bs;
-      }
-
-      src_row += src_stride;
+   switch (format) {
+   case MESA_FORMAT_ETC2_R11_EAC:
+   case MESA_FORMAT_ETC2_SIGNED_R11_EAC:
+      return 2;
+   default:
+      return 4;
    }
 }
 
+/* The 16 decoded texels of a block: 4 ubytes or 1-2 ushorts each */
+union etc2_texels {
+   uint8_t ub[16][4];
+   GLushort us[16 * 2];
+};
+
+/**
+ * Decode one block of an ETC2 format into 16 texels in row-major order,
+ * in the layout _mesa_unpack_etc2_format() writes.
+ */
 static void
-etc2_unpack_rgb8_punchthrough_alpha1(uint8_t *dst_row,
-                                     unsigned dst_stride,
-                                     const uint8_t *src_row,
-                                     unsigned src_stride,
-                                     unsigned width,
-                                     unsigned height)
+etc2_decode_block(mesa_format format, const uint8_t *src,
+                  union etc2_texels *texels)
 {
-   const unsigned bw = 4, bh = 4, bs = 8, comps = 4;
    struct etc2_block block;
-   unsigned x, y, i, j;
-
-   for (y = 0; y < height; y += bh) {
-      const unsigned h = MIN2(bh, height - y);
-      const uint8_t *src = src_row;
-
-      for (x = 0; x < width; x+= bw) {
-         const unsigned w = MIN2(bw, width - x);
-         etc2_rgb8_parse_block(&block, src,
-                               true /* punchthrough_alpha */);
-         for (j = 0; j < h; j++) {
-            uint8_t *dst = dst_row + (y + j) * dst_stride + x * comps;
-            for (i = 0; i < w; i++) {
-               etc2_rgb8_fetch_texel(&block, i, j, dst,
-                                     true /* punchthrough_alpha */);
-               dst += comps;
-            }
-         }
-
-         src += bs;
-      }
 
-      src_row += src_stride;
+   switch (format) {
+   case MESA_FORMAT_ETC2_RGB8:
+   case MESA_FORMAT_ETC2_SRGB8:
+      etc2_rgb8_parse_block(&block, src,
+                            false /* punchthrough_alpha */);
+      etc2_rgb8_decode_block(&block, texels->ub,
+                             false /* punchthrough_alpha */);
+      break;
+   case MESA_FORMAT_ETC2_RGBA8_EAC:
+   case MESA_FORMAT_ETC2_SRGB8_ALPHA8_EAC:
+      etc2_rgba8_parse_block(&block, src);
+      etc2_rgb8_decode_block(&block, texels->ub,
+                             false /* punchthrough_alpha */);
+      etc2_alpha8_decode_block(&block, texels->ub);
+      break;
+   case MESA_FORMAT_ETC2_R11_EAC:
+   case MESA_FORMAT_ETC2_SIGNED_R11_EAC:
+      etc2_r11_parse_block(&block, src);
+      etc2_r11_decode_block(&block, &texels->us[0], 1,
+                            format == MESA_FORMAT_ETC2_SIGNED_R11_EAC);
+      break;
+   case MESA_FORMAT_ETC2_RG11_EAC:
+   case MESA_FORMAT_ETC2_SIGNED_RG11_EAC:
+      /* red component */
+      etc2_r11_parse_block(&block, src);
+      etc2_r11_decode_block(&block, &texels->us[0], 2,
+                            format == MESA_FORMAT_ETC2_SIGNED_RG11_EAC);
+      /* green component */
+      etc2_r11_parse_block(&block, src + 8);
+      etc2_r11_decode_block(&block, &texels->us[1], 2,
+                            format == MESA_FORMAT_ETC2_SIGNED_RG11_EAC);
+      break;
+   case MESA_FORMAT_ETC2_RGB8_PUNCHTHROUGH_ALPHA1:
+   case MESA_FORMAT_ETC2_SRGB8_PUNCHTHROUGH_ALPHA1:
+      etc2_rgb8_parse_block(&block, src,
+                            true /* punchthrough_alpha */);
+      etc2_rgb8_decode_block(&block, texels->ub,
+                             true /* punchthrough_alpha */);
+      break;
+   default:
+      unreachable("not an ETC2 format");
    }
+
+   if (format == MESA_FORMAT_ETC2_SRGB8 ||
+       format == MESA_FORMAT_ETC2_SRGB8_ALPHA8_EAC ||
+       format == MESA_FORMAT_ETC2_SRGB8_PUNCHTHROUGH_ALPHA1)
+      etc2_swap_red_blue(texels->ub);
 }
 
+/* The arguments of _mesa_unpack_etc2_format(), see etc2_unpack_rows() */
+struct etc2_unpack {
+   uint8_t *dst_row;
+   unsigned dst_stride;
+   const uint8_t *src_row;
+   unsigned src_stride;
+   unsigned width, height;
+   mesa_format format;
+};
+
+/**
+ * Decompress the block rows [first, last) of an image.
+ */
 static void
-etc2_unpack_srgb8_punchthrough_alpha1(uint8_t *dst_row,
-                                     unsigned dst_stride,
-                                     const uint8_t *src_row,
-                                     unsigned src_stride,
-                                     unsigned width,
-                                     unsigned height)
+etc2_unpack_rows(void *data, int first, int last)
 {
-   const unsigned bw = 4, bh = 4, bs = 8, comps = 4;
-   struct etc2_block block;
-   unsigned x, y, i, j;
-   uint8_t tmp;
+   const struct etc2_unpack *unpack = (const struct etc2_unpack *) data;
+   const unsigned bw = 4, bh = 4;
+   const unsigned bs = etc2_block_size(unpack->format);
+   const unsigned texel_size = etc2_texel_size(unpack->format);
+   union etc2_texels texels;
+   unsigned x, y, j;
+   int block_row;
+
+   for (block_row = first; block_row < last; block_row++) {
+      const uint8_t *src = unpack->src_row + block_row * unpack->src_stride;
+      /*
+       * Destination texture may not be a multiple of four texels in
+       * height. Compute a safe height to avoid writing outside the texture.
+       */
+      const unsigned h = MIN2(bh, unpack->height - block_row * bh);
+
+      y = block_row * bh;
+      for (x = 0; x < unpack->width; x += bw) {
+         /*
+          * Destination texture may not be a multiple of four texels in
+          * width. Compute a safe width to avoid writing outside the texture.
+          */
+         const unsigned w = MIN2(bw, unpack->width - x);
 
-   for (y = 0; y < height; y += bh) {
-      const unsigned h = MIN2(bh, height - y);
-      const uint8_t *src = src_row;
+         etc2_decode_block(unpack->format, src, &texels);
 
-      for (x = 0; x < width; x+= bw) {
-         const unsigned w = MIN2(bw, width - x);
-         etc2_rgb8_parse_block(&block, src,
-                               true /* punchthrough_alpha */);
          for (j = 0; j < h; j++) {
-            uint8_t *dst = dst_row + (y + j) * dst_stride + x * comps;
-            for (i = 0; i < w; i++) {
-               etc2_rgb8_fetch_texel(&block, i, j, dst,
-                                     true /* punchthrough_alpha */);
-               /* Convert to MESA_FORMAT_B8G8R8A8_SRGB */
-               tmp = dst[0];
-               dst[0] = dst[2];
-               dst[2] = tmp;
-               dst[3] = dst[3];
-
-               dst += comps;
-            }
+            memcpy(unpack->dst_row + (y + j) * unpack->dst_stride +
+                   x * texel_size,
+                   &texels.ub[0][0] + j * bw * texel_size,
+                   w * texel_size);
          }
 
          src += bs;
       }
-
-      src_row += src_stride;
    }
 }
 
@@ -1207,46 +1089,24 @@ _mesa_unpack_etc2_format(uint8_t *dst_row,
                          unsigned src_height,
                          mesa_format format)
 {
-   if (format == MESA_FORMAT_ETC2_RGB8)
-      etc2_unpack_rgb8(dst_row, dst_stride,
-                       src_row, src_stride,
-                       src_width, src_height);
-   else if (format == MESA_FORMAT_ETC2_SRGB8)
-      etc2_unpack_srgb8(dst_row, dst_stride,
-                        src_row, src_stride,
-                        src_width, src_height);
-   else if (format == MESA_FORMAT_ETC2_RGBA8_EAC)
-      etc2_unpack_rgba8(dst_row, dst_stride,
-                        src_row, src_stride,
-                        src_width, src_height);
-   else if (format == MESA_FORMAT_ETC2_SRGB8_ALPHA8_EAC)
-      etc2_unpack_srgb8_alpha8(dst_row, dst_stride,
-                               src_row, src_stride,
-                               src_width, src_height);
-   else if (format == MESA_FORMAT_ETC2_R11_EAC)
-      etc2_unpack_r11(dst_row, dst_stride,
-                      src_row, src_stride,
-                      src_width, src_height);
-   else if (format == MESA_FORMAT_ETC2_RG11_EAC)
-      etc2_unpack_rg11(dst_row, dst_stride,
-                       src_row, src_stride,
-                       src_width, src_height);
-   else if (format == MESA_FORMAT_ETC2_SIGNED_R11_EAC)
-      etc2_unpack_signed_r11(dst_row, dst_stride,
-                             src_row, src_stride,
-                             src_width, src_height);
-   else if (format == MESA_FORMAT_ETC2_SIGNED_RG11_EAC)
-      etc2_unpack_signed_rg11(dst_row, dst_stride,
-                              src_row, src_stride,
-                              src_width, src_height);
-   else if (format == MESA_FORMAT_ETC2_RGB8_PUNCHTHROUGH_ALPHA1)
-      etc2_unpack_rgb8_punchthrough_alpha1(dst_row, dst_stride,
-                                           src_row, src_stride,
-                                           src_width, src_height);
-   else if (format == MESA_FORMAT_ETC2_SRGB8_PUNCHTHROUGH_ALPHA1)
-      etc2_unpack_srgb8_punchthrough_alpha1(dst_row, dst_stride,
-                                            src_row, src_stride,
-                                            src_width, src_height);
+   const int blocks_per_row = (src_width + 3) / 4;
+   struct etc2_unpack unpack;
+
+   if (etc2_block_size(format) == 0 || blocks_per_row == 0)
+      return;
+
+   unpack.dst_row = dst_row;
+   unpack.dst_stride = dst_stride;
+   unpack.src_row = src_row;
+   unpack.src_stride = src_stride;
+   unpack.width = src_width;
+   unpack.height = src_height;
+   unpack.format = format;
+
+   /* Large images are split into bands of block rows over several threads */
+   _mesa_parallel_for((src_height + 3) / 4,
+                      MAX2(MIN_THREAD_BLOCKS / blocks_per_row, 1),
+                      etc2_unpack_rows, &unpack);
 }
 
 
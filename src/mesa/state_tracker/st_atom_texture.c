@@ -428,6 +428,7 @@ update_textures(struct st_context *st,
       st->ctx->_Shader->CurrentProgram[mesa_shader];
    unsigned glsl_version = shader ? shader->Version : 0;
    enum pipe_shader_type shader_stage = st_shader_stage_to_ptarget(mesa_shader);
+   boolean changed = FALSE;
 
    if (samplers_used == 0x0 && old_max == 0)
       return;
@@ -454,9 +455,19 @@ update_textures(struct st_context *st,
          break;
       }
 
-      pipe_sampler_view_reference(&(sampler_views[unit]), sampler_view);
+      if (sampler_views[unit] != sampler_view) {
+         pipe_sampler_view_reference(&(sampler_views[unit]), sampler_view);
+         changed = TRUE;
+      }
    }
 
+   /* Typically only a few units (or none) changed since the last update,
+    * e.g. when a single texture is swapped between draws.  There is no
+    * need to rebind anything if all the views are the same.
+    */
+   if (!changed && *num_textures == old_max)
+      return;
+
    cso_set_sampler_views(st->cso_context,
                          shader_stage,
                          *num_textures,
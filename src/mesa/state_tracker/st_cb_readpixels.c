@@ -521,21 +521,12 @@ st_ReadPixels(struct gl_context *ctx, GLint x, GLint y,
    {
       const uint bytesPerRow = width * util_format_get_blocksize(dst_format);
       const int destStride = _mesa_image_row_stride(pack, width, format, type);
-      char *dest = _mesa_image_address2d(pack, pixels,
-                                         width, height, format,
-                                         type, 0, 0);
+      GLubyte *dest = _mesa_image_address2d(pack, pixels,
+                                            width, height, format,
+                                            type, 0, 0);
 
-      if (tex_xfer->stride == bytesPerRow && destStride == bytesPerRow) {
-         memcpy(dest, map, bytesPerRow * height);
-      } else {
-         GLuint row;
-
-         for (row = 0; row < (unsigned) height; row++) {
-            memcpy(dest, map, bytesPerRow);
-            map += tex_xfer->stride;
-            dest += destStride;
-         }
-      }
+      _mesa_readpixels_copy_rows(dest, destStride, map, tex_xfer->stride,
+                                 bytesPerRow, height);
    }
 
    pipe_transfer_unmap(pipe, tex_xfer);
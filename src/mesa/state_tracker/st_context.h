@@ -253,6 +253,17 @@ struct st_context
    struct st_config_options options;
 
    struct st_perf_monitor_group *perfmon;
+
+   /** CPU time spent in st_draw_vbo(), see ST_DRAW_STATS in st_draw.c */
+   struct {
+      boolean enabled;
+      uint64_t draws;
+      uint64_t total_ns;     /**< all of st_draw_vbo() */
+      uint64_t validate_ns;  /**< st_validate_state(), i.e. the atoms */
+      uint64_t driver_ns;    /**< cso_draw_vbo() and the driver */
+      /** number of draws which took [2^(i-1), 2^i) ns in st_draw_vbo() */
+      uint64_t histogram[32];
+   } draw_stats;
 };
 
 
@@ -57,7 +57,9 @@
 
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
+#include "os/os_time.h"
 #include "util/u_inlines.h"
+#include "util/u_math.h"
 #include "util/u_format.h"
 #include "util/u_prim.h"
 #include "util/u_draw.h"
@@ -66,6 +68,35 @@
 #include "cso_cache/cso_context.h"
 
 
+/**
+ * Setting ST_DRAW_STATS makes each context account for the CPU time spent
+ * in st_draw_vbo() and print a summary when it's destroyed.  Whatever the
+ * GL API, the Mesa core and the VBO module spend before calling us is not
+ * included, so comparing against the application-side time per draw gives
+ * the full breakdown.
+ */
+DEBUG_GET_ONCE_BOOL_OPTION(st_draw_stats, "ST_DRAW_STATS", FALSE)
+
+
+static inline int64_t
+draw_stats_time(const struct st_context *st)
+{
+   return st->draw_stats.enabled ? os_time_get_nano() : 0;
+}
+
+
+static void
+st_draw_vbo_driver(struct st_context *st, const struct pipe_draw_info *info)
+{
+   int64_t start = draw_stats_time(st);
+
+   cso_draw_vbo(st->cso_context, info);
+
+   if (st->draw_stats.enabled)
+      st->draw_stats.driver_ns += os_time_get_nano() - start;
+}
+
+
 /**
  * This is very similar to vbo_all_varyings_in_vbos() but we are
  * only interested in per-vertex data.  See bug 38626.
@@ -164,6 +195,7 @@ st_draw_vbo(struct gl_context *ctx,
    struct pipe_index_buffer ibuffer = {0};
    struct pipe_draw_info info;
    const struct gl_client_array **arrays = ctx->Array._DrawArrays;
+   const int64_t start = draw_stats_time(st);
    unsigned i;
 
    /* Mesa core state should have been validated already */
@@ -175,7 +207,12 @@ st_draw_vbo(struct gl_context *ctx,
    /* Validate state. */
    if ((st->dirty | ctx->NewDriverState) & ST_PIPELINE_RENDER_STATE_MASK ||
        st->gfx_shaders_may_be_dirty) {
+      int64_t validate_start = draw_stats_time(st);
+
       st_validate_state(st, ST_PIPELINE_RENDER);
+
+      if (st->draw_stats.enabled)
+         st->draw_stats.validate_ns += os_time_get_nano() - validate_start;
    }
 
    if (st->vertex_array_out_of_memory) {
@@ -243,20 +280,30 @@ st_draw_vbo(struct gl_context *ctx,
       }
 
       if (info.count_from_stream_output) {
-         cso_draw_vbo(st->cso_context, &info);
+         st_draw_vbo_driver(st, &info);
       }
       else if (info.primitive_restart) {
          /* don't trim, restarts might be inside index list */
-         cso_draw_vbo(st->cso_context, &info);
+         st_draw_vbo_driver(st, &info);
       }
       else if (u_trim_pipe_prim(prims[i].mode, &info.count)) {
-         cso_draw_vbo(st->cso_context, &info);
+         st_draw_vbo_driver(st, &info);
       }
    }
 
    if (ib && st->indexbuf_uploader && !_mesa_is_bufferobj(ib->obj)) {
       pipe_resource_reference(&ibuffer.buffer, NULL);
    }
+
+   if (st->draw_stats.enabled) {
+      const uint64_t ns = os_time_get_nano() - start;
+      const unsigned bucket = MIN2(util_last_bit64(ns),
+                                   ARRAY_SIZE(st->draw_stats.histogram) - 1);
+
+      st->draw_stats.draws++;
+      st->draw_stats.total_ns += ns;
+      st->draw_stats.histogram[bucket]++;
+   }
 }
 
 static void
@@ -346,12 +393,49 @@ st_init_draw(struct st_context *st)
 
    vbo_set_draw_func(ctx, st_draw_vbo);
    vbo_set_indirect_draw_func(ctx, st_indirect_draw_vbo);
+
+   st->draw_stats.enabled = debug_get_option_st_draw_stats();
+}
+
+
+static void
+print_draw_stats(const struct st_context *st)
+{
+   const double draws = (double) MAX2(st->draw_stats.draws, 1);
+   const uint64_t other_ns = st->draw_stats.total_ns -
+                             st->draw_stats.validate_ns -
+                             st->draw_stats.driver_ns;
+   unsigned i;
+
+   _debug_printf("st/draw: %"PRIu64" draws, per draw: "
+                 "%.1f ns st_draw_vbo = %.1f ns st_validate_state + "
+                 "%.1f ns driver + %.1f ns other\n",
+                 st->draw_stats.draws,
+                 st->draw_stats.total_ns / draws,
+                 st->draw_stats.validate_ns / draws,
+                 st->draw_stats.driver_ns / draws,
+                 other_ns / draws);
+
+   for (i = 0; i < ARRAY_SIZE(st->draw_stats.histogram); i++) {
+      const uint64_t count = st->draw_stats.histogram[i];
+
+      if (count) {
+         _debug_printf("st/draw: %10"PRIu64" ns .. %10"PRIu64" ns: "
+                       "%10"PRIu64" draws (%5.1f%%)\n",
+                       i ? UINT64_C(1) << (i - 1) : 0,
+                       (UINT64_C(1) << i) - 1,
+                       count, 100.0 * count / draws);
+      }
+   }
 }
 
 
 void
 st_destroy_draw(struct st_context *st)
 {
+   if (st->draw_stats.enabled)
+      print_draw_stats(st);
+
    draw_destroy(st->draw);
 }
 
@@ -90,6 +90,7 @@ vbo_initialize_save_dispatch(const struct gl_context *ctx,
                              struct _glapi_table *exec);
 
 void vbo_exec_FlushVertices(struct gl_context *ctx, GLuint flags);
+void vbo_exec_UpdateCurrent(struct gl_context *ctx);
 void vbo_save_SaveFlushVertices(struct gl_context *ctx);
 GLboolean vbo_save_NotifyBegin(struct gl_context *ctx, GLenum mode);
 void vbo_save_NewList(struct gl_context *ctx, GLuint list, GLenum mode);
@@ -183,6 +184,9 @@ vbo_sizeof_ib_type(GLenum type)
 void
 vbo_delete_minmax_cache(struct gl_buffer_object *bufferObj);
 
+void
+vbo_delete_restart_cache(struct gl_buffer_object *bufferObj);
+
 void
 vbo_get_minmax_indices(struct gl_context *ctx, const struct _mesa_prim *prim,
                        const struct _mesa_index_buffer *ib,
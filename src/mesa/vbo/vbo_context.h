@@ -223,6 +223,10 @@ vbo_compute_max_verts(const struct vbo_exec_context *exec)
 }
 
 
+GLboolean
+vbo_use_minmax_cache(struct gl_buffer_object *bufferObj);
+
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -1275,6 +1275,25 @@ void vbo_exec_FlushVertices( struct gl_context *ctx, GLuint flags )
 #endif
 }
 
+
+/**
+ * Copy the values of the vertex being assembled to ctx->Current, but
+ * unlike vbo_exec_FlushVertices() neither draw the stored vertices nor
+ * reset the vertex format.  Used by queries, which legacy applications
+ * interleave with immediate-mode rendering and which don't change any
+ * state the stored vertices depend on.
+ */
+void vbo_exec_UpdateCurrent( struct gl_context *ctx )
+{
+   struct vbo_exec_context *exec = &vbo_context(ctx)->exec;
+
+   if (_mesa_inside_begin_end(ctx))
+      return;
+
+   if (exec->vtx.vertex_size)
+      vbo_exec_copy_to_current( exec );
+}
+
 void vbo_reset_attr(struct vbo_exec_context *exec, GLuint attr)
 {
    exec->vtx.attrsz[attr] = 0;
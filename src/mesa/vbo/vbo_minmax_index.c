@@ -33,6 +33,7 @@
 #include "main/sse_minmax.h"
 #include "x86/common_x86_asm.h"
 #include "util/hash_table.h"
+#include "vbo_context.h"
 
 
 struct minmax_cache_key {
@@ -71,7 +72,7 @@ vbo_minmax_cache_delete_entry(struct hash_entry *entry)
 }
 
 
-static GLboolean
+GLboolean
 vbo_use_minmax_cache(struct gl_buffer_object *bufferObj)
 {
    if (bufferObj->UsageHistory & (USAGE_TEXTURE_BUFFER |
@@ -31,30 +31,33 @@
 #include "main/imports.h"
 #include "main/bufferobj.h"
 #include "main/macros.h"
+#include "main/sse_minmax.h"
 #include "main/varray.h"
+#include "x86/common_x86_asm.h"
+#include "util/hash_table.h"
 
 #include "vbo.h"
 #include "vbo_context.h"
 
-#define UPDATE_MIN2(a, b) (a) = MIN2((a), (b))
-#define UPDATE_MAX2(a, b) (a) = MAX2((a), (b))
-
 /*
  * Notes on primitive restart:
  * The code below is used when the driver does not fully support primitive
  * restart (for example, if it only does restart index of ~0).
  *
  * We map the index buffer, find the restart indexes, unmap
- * the index buffer then draw the sub-primitives delineated by the restarts.
+ * the index buffer then draw the sub-primitives delineated by the restarts,
+ * passing as many of them as possible to each draw_prims call.
+ *
+ * The list of sub-primitive (start, count, min, max) values found in an
+ * index buffer object is saved in a cache attached to the buffer object for
+ * re-use in subsequent draws.  Like the min/max index cache, it is
+ * invalidated when the contents of the buffer change.
  *
- * A couple possible optimizations:
- * 1. Save the list of sub-primitive (start, count) values in a list attached
- *    to the index buffer for re-use in subsequent draws.  The list would be
- *    invalidated when the contents of the buffer changed.
- * 2. If drawing triangle strips or quad strips, create a new index buffer
- *    that uses duplicated vertices to render the disjoint strips as one
- *    long strip.  We'd have to be careful to avoid using too much memory
- *    for this.
+ * A possible further optimization: if drawing triangle strips or quad
+ * strips, create a new index buffer that uses duplicated vertices to render
+ * the disjoint strips as one long strip.  We'd have to be careful to avoid
+ * using too much memory for this, and the degenerate triangles would show
+ * up in primitive queries, transform feedback and gl_PrimitiveID.
  *
  * Finally, some apps might perform better if they don't use primitive restart
  * at all rather than this fallback path.  Set MESA_EXTENSION_OVERRIDE to
@@ -62,6 +65,10 @@
  */
 
 
+/** Max number of sub-primitives passed to a single draw_prims call */
+#define MAX_SUB_PRIMS_PER_DRAW 64
+
+
 struct sub_primitive
 {
    GLuint start;
@@ -71,81 +78,326 @@ struct sub_primitive
 };
 
 
+struct restart_cache_key {
+   GLintptr offset;
+   GLuint count;
+   GLenum type;
+   GLuint restart_index;
+};
+
+
+struct restart_cache_entry {
+   struct restart_cache_key key;
+   GLuint num_sub_prims;
+   struct sub_primitive *sub_prims;   /**< stored right after the entry */
+};
+
+
+static uint32_t
+vbo_restart_cache_hash(const struct restart_cache_key *key)
+{
+   return _mesa_hash_data(key, sizeof(*key));
+}
+
+
+static bool
+vbo_restart_cache_key_equal(const struct restart_cache_key *a,
+                            const struct restart_cache_key *b)
+{
+   return (a->offset == b->offset) && (a->count == b->count) &&
+          (a->type == b->type) && (a->restart_index == b->restart_index);
+}
+
+
+static void
+vbo_restart_cache_delete_entry(struct hash_entry *entry)
+{
+   free(entry->data);
+}
+
+
+void
+vbo_delete_restart_cache(struct gl_buffer_object *bufferObj)
+{
+   _mesa_hash_table_destroy(bufferObj->RestartCache,
+                            vbo_restart_cache_delete_entry);
+   bufferObj->RestartCache = NULL;
+}
+
+
 /**
- * Scan the elements array to find restart indexes.  Return an array
- * of struct sub_primitive to indicate how to draw the sub-primitives
- * are delineated by the restart index.
+ * Look up the sub-primitives of an index buffer range in the cache.
+ * \return a copy of the cached sub-primitives, to be freed by the caller,
+ *         or NULL if there are none.
  */
 static struct sub_primitive *
-find_sub_primitives(const void *elements, unsigned element_size,
-                    unsigned start, unsigned end, unsigned restart_index,
-                    unsigned *num_sub_prims)
+vbo_get_restart_cached(struct gl_buffer_object *bufferObj,
+                       const struct restart_cache_key *key,
+                       GLuint *num_sub_prims)
 {
-   const unsigned max_prims = end - start;
-   struct sub_primitive *sub_prims;
-   unsigned i, cur_start, cur_count;
-   GLuint scan_index;
-   unsigned scan_num;
+   struct sub_primitive *sub_prims = NULL;
+   struct hash_entry *result;
 
-   sub_prims =
-      malloc(max_prims * sizeof(struct sub_primitive));
-
-   if (!sub_prims) {
-      *num_sub_prims = 0;
+   if (!bufferObj->RestartCache)
       return NULL;
+   if (!vbo_use_minmax_cache(bufferObj))
+      return NULL;
+
+   mtx_lock(&bufferObj->Mutex);
+
+   if (bufferObj->RestartCacheDirty) {
+      /* Disable the caches for this BO when the splits keep getting
+       * recomputed, as vbo_get_minmax_cached() does for streamed buffers.
+       */
+      unsigned optimism = bufferObj->Size;
+      if (bufferObj->RestartCacheMissIndices > optimism &&
+          bufferObj->RestartCacheHitIndices <
+          bufferObj->RestartCacheMissIndices - optimism) {
+         bufferObj->UsageHistory |= USAGE_DISABLE_MINMAX_CACHE;
+         vbo_delete_restart_cache(bufferObj);
+         goto out_disable;
+      }
+
+      _mesa_hash_table_clear(bufferObj->RestartCache,
+                             vbo_restart_cache_delete_entry);
+      bufferObj->RestartCacheDirty = false;
+      goto out;
    }
 
-   cur_start = start;
-   cur_count = 0;
-   scan_num = 0;
-
-#define IB_INDEX_READ(TYPE, INDEX) (((const GL##TYPE *) elements)[INDEX])
-
-#define SCAN_ELEMENTS(TYPE) \
-   sub_prims[scan_num].min_index = (GL##TYPE) 0xffffffff; \
-   sub_prims[scan_num].max_index = 0; \
-   for (i = start; i < end; i++) { \
-      scan_index = IB_INDEX_READ(TYPE, i); \
-      if (scan_index == restart_index) { \
-         if (cur_count > 0) { \
-            assert(scan_num < max_prims); \
-            sub_prims[scan_num].start = cur_start; \
-            sub_prims[scan_num].count = cur_count; \
-            scan_num++; \
-            sub_prims[scan_num].min_index = (GL##TYPE) 0xffffffff; \
-            sub_prims[scan_num].max_index = 0; \
-         } \
-         cur_start = i + 1; \
-         cur_count = 0; \
-      } \
-      else { \
-         UPDATE_MIN2(sub_prims[scan_num].min_index, scan_index); \
-         UPDATE_MAX2(sub_prims[scan_num].max_index, scan_index); \
-         cur_count++; \
-      } \
-   } \
-   if (cur_count > 0) { \
-      assert(scan_num < max_prims); \
-      sub_prims[scan_num].start = cur_start; \
-      sub_prims[scan_num].count = cur_count; \
-      scan_num++; \
+   result = _mesa_hash_table_search(bufferObj->RestartCache, key);
+   if (result) {
+      const struct restart_cache_entry *entry = result->data;
+
+      /* Copy the list out, another context may invalidate the cache while
+       * we're drawing.
+       */
+      sub_prims = malloc(MAX2(entry->num_sub_prims, 1) *
+                         sizeof(struct sub_primitive));
+      if (sub_prims) {
+         memcpy(sub_prims, entry->sub_prims,
+                entry->num_sub_prims * sizeof(struct sub_primitive));
+         *num_sub_prims = entry->num_sub_prims;
+      }
+   }
+
+out:
+   if (sub_prims) {
+      /* saturates, see vbo_get_minmax_cached() */
+      unsigned new_hit_count = bufferObj->RestartCacheHitIndices + key->count;
+
+      if (new_hit_count >= bufferObj->RestartCacheHitIndices)
+         bufferObj->RestartCacheHitIndices = new_hit_count;
+      else
+         bufferObj->RestartCacheHitIndices = ~(unsigned)0;
+   } else {
+      bufferObj->RestartCacheMissIndices += key->count;
+   }
+
+out_disable:
+   mtx_unlock(&bufferObj->Mutex);
+   return sub_prims;
+}
+
+
+static void
+vbo_restart_cache_store(struct gl_context *ctx,
+                        struct gl_buffer_object *bufferObj,
+                        const struct restart_cache_key *key,
+                        const struct sub_primitive *sub_prims,
+                        GLuint num_sub_prims)
+{
+   struct restart_cache_entry *entry;
+   struct hash_entry *table_entry;
+   uint32_t hash;
+
+   if (!vbo_use_minmax_cache(bufferObj))
+      return;
+
+   mtx_lock(&bufferObj->Mutex);
+
+   if (!bufferObj->RestartCache) {
+      bufferObj->RestartCache =
+         _mesa_hash_table_create(NULL,
+                                 (uint32_t (*)(const void *))vbo_restart_cache_hash,
+                                 (bool (*)(const void *, const void *))vbo_restart_cache_key_equal);
+      if (!bufferObj->RestartCache)
+         goto out;
+   }
+
+   entry = malloc(sizeof(*entry) +
+                  num_sub_prims * sizeof(struct sub_primitive));
+   if (!entry)
+      goto out;
+
+   entry->key = *key;
+   entry->num_sub_prims = num_sub_prims;
+   entry->sub_prims = (struct sub_primitive *) (entry + 1);
+   memcpy(entry->sub_prims, sub_prims,
+          num_sub_prims * sizeof(struct sub_primitive));
+   hash = vbo_restart_cache_hash(&entry->key);
+
+   table_entry = _mesa_hash_table_search_pre_hashed(bufferObj->RestartCache,
+                                                    hash, &entry->key);
+   if (table_entry) {
+      /* Another context sharing the buffer got here first. */
+      _mesa_debug(ctx, "duplicate entry in primitive restart cache\n");
+      free(entry);
+      goto out;
+   }
+
+   table_entry = _mesa_hash_table_insert_pre_hashed(bufferObj->RestartCache,
+                                                    hash, &entry->key, entry);
+   if (!table_entry)
+      free(entry);
+
+out:
+   mtx_unlock(&bufferObj->Mutex);
+}
+
+
+/**
+ * Return the position of the first restart index in [start, end) of the
+ * elements array, or end if there is none.
+ */
+static unsigned
+find_restart_index(const void *elements, unsigned element_size,
+                   unsigned start, unsigned end, unsigned restart_index)
+{
+   unsigned i = start;
+
+   switch (element_size) {
+   case 1: {
+      const GLubyte *ub_elements = (const GLubyte *) elements;
+      if (restart_index > 0xff)
+         return end;
+      while (i < end && ub_elements[i] != restart_index)
+         i++;
+      break;
+   }
+   case 2: {
+      const GLushort *us_elements = (const GLushort *) elements;
+      if (restart_index > 0xffff)
+         return end;
+#if defined(USE_SSE41)
+      if (cpu_has_sse4_1)
+         return _mesa_ushort_array_find(us_elements, restart_index,
+                                        start, end);
+#endif
+      while (i < end && us_elements[i] != restart_index)
+         i++;
+      break;
+   }
+   case 4: {
+      const GLuint *ui_elements = (const GLuint *) elements;
+#if defined(USE_SSE41)
+      if (cpu_has_sse4_1)
+         return _mesa_uint_array_find(ui_elements, restart_index,
+                                      start, end);
+#endif
+      while (i < end && ui_elements[i] != restart_index)
+         i++;
+      break;
+   }
+   default:
+      assert(0 && "bad index_size in find_restart_index()");
+      return end;
+   }
+
+   return i;
+}
+
+
+/**
+ * Compute the min and max of count elements, which contain no restart
+ * index, starting at start.
+ */
+static void
+get_min_max_index(const void *elements, unsigned element_size,
+                  unsigned start, unsigned count,
+                  GLuint *min_index, GLuint *max_index)
+{
+   GLuint min = ~0U, max = 0;
+   unsigned i;
+
+#define MINMAX_ELEMENTS(TYPE) \
+   for (i = start; i < start + count; i++) { \
+      const GLuint index = ((const GL##TYPE *) elements)[i]; \
+      min = MIN2(min, index); \
+      max = MAX2(max, index); \
    }
 
    switch (element_size) {
    case 1:
-      SCAN_ELEMENTS(ubyte);
+      MINMAX_ELEMENTS(ubyte);
       break;
    case 2:
-      SCAN_ELEMENTS(ushort);
+#if defined(USE_SSE41)
+      if (cpu_has_sse4_1) {
+         _mesa_ushort_array_min_max((const GLushort *) elements + start,
+                                    &min, &max, count);
+         break;
+      }
+#endif
+      MINMAX_ELEMENTS(ushort);
       break;
    case 4:
-      SCAN_ELEMENTS(uint);
+#if defined(USE_SSE41)
+      if (cpu_has_sse4_1) {
+         _mesa_uint_array_min_max((const GLuint *) elements + start,
+                                  &min, &max, count);
+         break;
+      }
+#endif
+      MINMAX_ELEMENTS(uint);
       break;
    default:
-      assert(0 && "bad index_size in find_sub_primitives()");
+      assert(0 && "bad index_size in get_min_max_index()");
+   }
+
+#undef MINMAX_ELEMENTS
+
+   *min_index = min;
+   *max_index = max;
+}
+
+
+/**
+ * Scan the elements array to find restart indexes.  Return an array
+ * of struct sub_primitive to indicate how to draw the sub-primitives
+ * are delineated by the restart index.
+ */
+static struct sub_primitive *
+find_sub_primitives(const void *elements, unsigned element_size,
+                    unsigned start, unsigned end, unsigned restart_index,
+                    unsigned *num_sub_prims)
+{
+   /* sub-primitives are separated by at least one restart index */
+   const unsigned max_prims = (end - start + 1) / 2;
+   struct sub_primitive *sub_prims;
+   unsigned i, run_end;
+   unsigned scan_num = 0;
+
+   sub_prims =
+      malloc(MAX2(max_prims, 1) * sizeof(struct sub_primitive));
+
+   if (!sub_prims) {
+      *num_sub_prims = 0;
+      return NULL;
    }
 
-#undef SCAN_ELEMENTS
+   for (i = start; i < end; i = run_end + 1) {
+      run_end = find_restart_index(elements, element_size, i, end,
+                                   restart_index);
+      if (run_end > i) {
+         assert(scan_num < max_prims);
+         sub_prims[scan_num].start = i;
+         sub_prims[scan_num].count = run_end - i;
+         get_min_max_index(elements, element_size, i, run_end - i,
+                           &sub_prims[scan_num].min_index,
+                           &sub_prims[scan_num].max_index);
+         scan_num++;
+      }
+   }
 
    *num_sub_prims = scan_num;
 
@@ -169,14 +421,18 @@ vbo_sw_primitive_restart(struct gl_context *ctx,
    GLuint prim_num;
    struct _mesa_prim new_prim;
    struct _mesa_index_buffer new_ib;
-   struct sub_primitive *sub_prims;
+   struct sub_primitive *sub_prims = NULL;
    struct sub_primitive *sub_prim;
-   GLuint num_sub_prims;
+   GLuint num_sub_prims = 0;
    GLuint sub_prim_num;
    GLuint end_index;
    GLuint sub_end_index;
    GLuint restart_index = _mesa_primitive_restart_index(ctx, ib->type);
-   struct _mesa_prim temp_prim;
+   struct _mesa_prim draw_prims[MAX_SUB_PRIMS_PER_DRAW];
+   GLuint num_draw_prims = 0;
+   GLboolean index_bounds_valid = GL_TRUE;
+   GLuint min_index = ~0U, max_index = 0;
+   struct restart_cache_key key;
    struct vbo_context *vbo = vbo_context(ctx);
    vbo_draw_func draw_prims_func = vbo->draw_prims;
    GLboolean map_ib = ib->obj->Name && !ib->obj->Mappings[MAP_INTERNAL].Pointer;
@@ -217,45 +473,76 @@ vbo_sw_primitive_restart(struct gl_context *ctx,
    }
 
    /* Find the sub-primitives. These are regions in the index buffer which
-    * are split based on the primitive restart index value.
+    * are split based on the primitive restart index value.  For buffer
+    * objects, try the ones found by a previous draw first.
     */
-   if (map_ib) {
-      ctx->Driver.MapBufferRange(ctx, 0, ib->obj->Size, GL_MAP_READ_BIT,
-                                 ib->obj, MAP_INTERNAL);
-   }
+   memset(&key, 0, sizeof(key));
+   key.offset = (GLintptr) ib->ptr;
+   key.count = ib->count;
+   key.type = ib->type;
+   key.restart_index = restart_index;
+
+   if (_mesa_is_bufferobj(ib->obj))
+      sub_prims = vbo_get_restart_cached(ib->obj, &key, &num_sub_prims);
+
+   if (!sub_prims) {
+      if (map_ib) {
+         ctx->Driver.MapBufferRange(ctx, 0, ib->obj->Size, GL_MAP_READ_BIT,
+                                    ib->obj, MAP_INTERNAL);
+      }
 
-   ptr = ADD_POINTERS(ib->obj->Mappings[MAP_INTERNAL].Pointer, ib->ptr);
+      ptr = ADD_POINTERS(ib->obj->Mappings[MAP_INTERNAL].Pointer, ib->ptr);
 
-   sub_prims = find_sub_primitives(ptr, vbo_sizeof_ib_type(ib->type),
-                                   0, ib->count, restart_index,
-                                   &num_sub_prims);
+      sub_prims = find_sub_primitives(ptr, vbo_sizeof_ib_type(ib->type),
+                                      0, ib->count, restart_index,
+                                      &num_sub_prims);
+
+      if (map_ib) {
+         ctx->Driver.UnmapBuffer(ctx, ib->obj, MAP_INTERNAL);
+      }
 
-   if (map_ib) {
-      ctx->Driver.UnmapBuffer(ctx, ib->obj, MAP_INTERNAL);
+      if (sub_prims && _mesa_is_bufferobj(ib->obj)) {
+         vbo_restart_cache_store(ctx, ib->obj, &key, sub_prims,
+                                 num_sub_prims);
+      }
    }
 
    /* Loop over the primitives, and use the located sub-primitives to draw
     * each primitive with a break to implement each primitive restart.
+    * Consecutive sub-primitives are handed to the driver together.
     */
    for (prim_num = 0; prim_num < nr_prims; prim_num++) {
       end_index = prims[prim_num].start + prims[prim_num].count;
-      memcpy(&temp_prim, &prims[prim_num], sizeof (temp_prim));
       /* Loop over the sub-primitives drawing sub-ranges of the primitive. */
       for (sub_prim_num = 0; sub_prim_num < num_sub_prims; sub_prim_num++) {
          sub_prim = &sub_prims[sub_prim_num];
          sub_end_index = sub_prim->start + sub_prim->count;
-         if (prims[prim_num].start <= sub_prim->start) {
-            temp_prim.start = MAX2(prims[prim_num].start, sub_prim->start);
-            temp_prim.count = MIN2(sub_end_index, end_index) - temp_prim.start;
-            if ((temp_prim.start == sub_prim->start) &&
-                (temp_prim.count == sub_prim->count)) {
-               draw_prims_func(ctx, &temp_prim, 1, ib,
-                               GL_TRUE, sub_prim->min_index, sub_prim->max_index,
-                               NULL, 0, NULL);
+         if (prims[prim_num].start <= sub_prim->start &&
+             sub_prim->start < end_index) {
+            struct _mesa_prim *draw_prim = &draw_prims[num_draw_prims++];
+
+            memcpy(draw_prim, &prims[prim_num], sizeof (*draw_prim));
+            draw_prim->start = MAX2(prims[prim_num].start, sub_prim->start);
+            draw_prim->count = MIN2(sub_end_index, end_index) -
+                               draw_prim->start;
+            if ((draw_prim->start == sub_prim->start) &&
+                (draw_prim->count == sub_prim->count)) {
+               min_index = MIN2(min_index, sub_prim->min_index);
+               max_index = MAX2(max_index, sub_prim->max_index);
             } else {
-               draw_prims_func(ctx, &temp_prim, 1, ib,
-                               GL_FALSE, -1, -1,
+               index_bounds_valid = GL_FALSE;
+            }
+
+            if (num_draw_prims == MAX_SUB_PRIMS_PER_DRAW) {
+               draw_prims_func(ctx, draw_prims, num_draw_prims, ib,
+                               index_bounds_valid,
+                               index_bounds_valid ? min_index : -1,
+                               index_bounds_valid ? max_index : -1,
                                NULL, 0, NULL);
+               num_draw_prims = 0;
+               index_bounds_valid = GL_TRUE;
+               min_index = ~0U;
+               max_index = 0;
             }
          }
          if (sub_end_index >= end_index) {
@@ -264,6 +551,13 @@ vbo_sw_primitive_restart(struct gl_context *ctx,
       }
    }
 
+   if (num_draw_prims) {
+      draw_prims_func(ctx, draw_prims, num_draw_prims, ib,
+                      index_bounds_valid,
+                      index_bounds_valid ? min_index : -1,
+                      index_bounds_valid ? max_index : -1,
+                      NULL, 0, NULL);
+   }
+
    free(sub_prims);
 }
-
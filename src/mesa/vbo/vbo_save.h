@@ -82,8 +82,20 @@ struct vbo_save_vertex_list {
    struct _mesa_prim *prim;
    GLuint prim_count;
 
+   /* The same primitives as a few indexed GL_POINTS, GL_LINES and
+    * GL_TRIANGLES draws, with the indices in index_store, or
+    * indexed_prim_count == 0 if that doesn't save any draws.
+    */
+   struct _mesa_prim *indexed_prim;
+   GLuint indexed_prim_count;
+   GLuint index_offset;         /**< in bytes */
+   GLuint index_count;
+   GLboolean indexed_fill_only;  /**< polygons or strips were split */
+   GLboolean indexed_unstippled; /**< line strips were split */
+
    struct vbo_save_vertex_store *vertex_store;
    struct vbo_save_primitive_store *prim_store;
+   struct vbo_save_index_store *index_store;
 };
 
 /* These buffers should be a reasonable size to support upload to
@@ -97,7 +109,8 @@ struct vbo_save_vertex_list {
  * internally even though this probably isn't allowed for client VBOs?
  */
 #define VBO_SAVE_BUFFER_SIZE (8*1024) /* dwords */
-#define VBO_SAVE_PRIM_SIZE   128
+#define VBO_SAVE_PRIM_SIZE   1024
+#define VBO_SAVE_INDEX_SIZE  (32*1024) /* GLushorts */
 #define VBO_SAVE_PRIM_MODE_MASK         0x3f
 #define VBO_SAVE_PRIM_WEAK              0x40
 #define VBO_SAVE_PRIM_NO_CURRENT_UPDATE 0x80
@@ -119,6 +132,14 @@ struct vbo_save_primitive_store {
    GLuint refcount;
 };
 
+/* Indices of the vertex_list::indexed_prim draws.  Allocated on demand.
+ */
+struct vbo_save_index_store {
+   struct gl_buffer_object *bufferobj;
+   GLuint used;                 /**< in indices */
+   GLuint refcount;
+};
+
 
 struct vbo_save_context {
    struct gl_context *ctx;
@@ -145,6 +166,7 @@ struct vbo_save_context {
 
    struct vbo_save_vertex_store *vertex_store;
    struct vbo_save_primitive_store *prim_store;
+   struct vbo_save_index_store *index_store;
 
    fi_type *buffer_ptr;		   /* cursor, points into buffer */
    fi_type vertex[VBO_ATTRIB_MAX*4];	   /* current values */
@@ -189,4 +211,8 @@ void
 vbo_save_unmap_vertex_store(struct gl_context *ctx,
                             struct vbo_save_vertex_store *vertex_store);
 
+void
+vbo_save_release_index_store(struct gl_context *ctx,
+                             struct vbo_save_index_store *index_store);
+
 #endif /* VBO_SAVE_H */
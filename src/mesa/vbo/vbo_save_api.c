@@ -304,6 +304,44 @@ alloc_prim_store(struct gl_context *ctx)
 }
 
 
+static struct vbo_save_index_store *
+alloc_index_store(struct gl_context *ctx)
+{
+   struct vbo_save_index_store *store =
+      CALLOC_STRUCT(vbo_save_index_store);
+
+   if (!store)
+      return NULL;
+
+   store->refcount = 1;
+   store->bufferobj = ctx->Driver.NewBufferObject(ctx, VBO_BUF_ID);
+   if (!store->bufferobj ||
+       !ctx->Driver.BufferData(ctx,
+                               GL_ELEMENT_ARRAY_BUFFER_ARB,
+                               VBO_SAVE_INDEX_SIZE * sizeof(GLushort),
+                               NULL, GL_STATIC_DRAW_ARB,
+                               GL_MAP_WRITE_BIT |
+                               GL_DYNAMIC_STORAGE_BIT,
+                               store->bufferobj)) {
+      vbo_save_release_index_store(ctx, store);
+      return NULL;
+   }
+
+   return store;
+}
+
+
+void
+vbo_save_release_index_store(struct gl_context *ctx,
+                             struct vbo_save_index_store *index_store)
+{
+   if (--index_store->refcount == 0) {
+      _mesa_reference_buffer_object(ctx, &index_store->bufferobj, NULL);
+      free(index_store);
+   }
+}
+
+
 static void
 _save_reset_counters(struct gl_context *ctx)
 {
@@ -406,6 +444,247 @@ convert_line_loop_to_strip(struct vbo_save_context *save,
 }
 
 
+/**
+ * Return the mode of the independent points, lines or triangles that a
+ * primitive is made of, or GL_NONE if it can't be decomposed.
+ */
+static GLenum
+indexed_prim_mode(const struct _mesa_prim *prim)
+{
+   switch (prim->mode) {
+   case GL_POINTS:
+      return GL_POINTS;
+   case GL_LINE_LOOP:
+      /* a loop that isn't closed in this vertex list needs the first
+       * vertex of an earlier one
+       */
+      return prim->begin && prim->end ? GL_LINES : GL_NONE;
+   case GL_LINES:
+   case GL_LINE_STRIP:
+      return GL_LINES;
+   case GL_TRIANGLES:
+   case GL_TRIANGLE_STRIP:
+   case GL_TRIANGLE_FAN:
+   case GL_QUADS:
+   case GL_QUAD_STRIP:
+   case GL_POLYGON:
+      return GL_TRIANGLES;
+   default:
+      return GL_NONE;
+   }
+}
+
+
+/**
+ * Write the indices that draw a primitive as independent points, lines or
+ * triangles.  The triangles keep the winding and, with
+ * GL_LAST_VERTEX_CONVENTION, the provoking vertex of the original ones, in
+ * the same order as the gallium u_indices translation.
+ *
+ * \return number of indices written, at most 3 * prim->count
+ */
+static GLuint
+generate_prim_indices(const struct _mesa_prim *prim, GLushort *out)
+{
+   const GLuint start = prim->start, count = prim->count;
+   GLushort *p = out;
+   GLuint i;
+
+   switch (prim->mode) {
+   case GL_POINTS:
+      for (i = 0; i < count; i++)
+         *p++ = start + i;
+      break;
+   case GL_LINES:
+      for (i = 0; i + 1 < count; i += 2) {
+         *p++ = start + i;
+         *p++ = start + i + 1;
+      }
+      break;
+   case GL_LINE_STRIP:
+   case GL_LINE_LOOP:
+      for (i = 0; i + 1 < count; i++) {
+         *p++ = start + i;
+         *p++ = start + i + 1;
+      }
+      if (prim->mode == GL_LINE_LOOP && count > 1) {
+         *p++ = start + count - 1;
+         *p++ = start;
+      }
+      break;
+   case GL_TRIANGLES:
+      for (i = 0; i + 2 < count; i += 3) {
+         *p++ = start + i;
+         *p++ = start + i + 1;
+         *p++ = start + i + 2;
+      }
+      break;
+   case GL_TRIANGLE_STRIP:
+      for (i = 0; i + 2 < count; i++) {
+         /* swap the first two vertices of every other triangle */
+         *p++ = start + i + (i & 1);
+         *p++ = start + i + 1 - (i & 1);
+         *p++ = start + i + 2;
+      }
+      break;
+   case GL_TRIANGLE_FAN:
+      for (i = 1; i + 1 < count; i++) {
+         *p++ = start;
+         *p++ = start + i;
+         *p++ = start + i + 1;
+      }
+      break;
+   case GL_POLYGON:
+      /* the first vertex of a polygon is its provoking vertex */
+      for (i = 1; i + 1 < count; i++) {
+         *p++ = start + i;
+         *p++ = start + i + 1;
+         *p++ = start;
+      }
+      break;
+   case GL_QUADS:
+      for (i = 0; i + 3 < count; i += 4) {
+         *p++ = start + i;
+         *p++ = start + i + 1;
+         *p++ = start + i + 3;
+         *p++ = start + i + 1;
+         *p++ = start + i + 2;
+         *p++ = start + i + 3;
+      }
+      break;
+   case GL_QUAD_STRIP:
+      for (i = 0; i + 3 < count; i += 2) {
+         *p++ = start + i + 2;
+         *p++ = start + i;
+         *p++ = start + i + 3;
+         *p++ = start + i;
+         *p++ = start + i + 1;
+         *p++ = start + i + 3;
+      }
+      break;
+   default:
+      assert(0);
+   }
+
+   return p - out;
+}
+
+
+/**
+ * Decompose the primitives of a vertex list that merge_prims() couldn't
+ * merge, like many small strips, fans, polygons or line loops, into one
+ * indexed draw per run of primitives that reduce to the same mode.  The
+ * indices are uploaded to the index store once, here.
+ * vbo_save_playback_vertex_list() uses these draws when the state allows.
+ */
+static void
+_save_compile_indexed_prims(struct gl_context *ctx,
+                            struct vbo_save_vertex_list *node)
+{
+   struct vbo_save_context *save = &vbo_context(ctx)->save;
+   struct _mesa_prim *indexed_prim = NULL;
+   GLushort *indices = NULL;
+   GLboolean fill_only = GL_FALSE, unstippled = GL_FALSE;
+   GLuint i, num_runs = 0, index_count = 0;
+   GLenum mode = GL_NONE;
+
+   if (node->prim_count < 2)
+      return;
+
+   for (i = 0; i < node->prim_count; i++) {
+      const GLenum prim_mode = indexed_prim_mode(&node->prim[i]);
+
+      if (prim_mode == GL_NONE)
+         return;
+
+      if (prim_mode != mode) {
+         mode = prim_mode;
+         num_runs++;
+      }
+   }
+
+   if (num_runs == node->prim_count)
+      return;
+
+   indices = malloc(3 * node->count * sizeof(GLushort));
+   indexed_prim = calloc(num_runs, sizeof(*indexed_prim));
+   if (!indices || !indexed_prim)
+      goto done;
+
+   num_runs = 0;
+   mode = GL_NONE;
+   for (i = 0; i < node->prim_count; i++) {
+      const struct _mesa_prim *prim = &node->prim[i];
+      const GLenum prim_mode = indexed_prim_mode(prim);
+      struct _mesa_prim *run;
+      GLuint count;
+
+      if (prim_mode != mode) {
+         run = &indexed_prim[num_runs++];
+         run->mode = prim_mode;
+         run->indexed = 1;
+         run->begin = 1;
+         run->end = 1;
+         run->start = index_count;
+         run->num_instances = 1;
+         mode = prim_mode;
+      }
+      else {
+         run = &indexed_prim[num_runs - 1];
+      }
+
+      /* Polygon mode and edge flags only work the same way for triangles
+       * that were drawn as GL_TRIANGLES, and line stipple restarts for
+       * every independent line.
+       */
+      if (prim_mode == GL_TRIANGLES && prim->mode != GL_TRIANGLES)
+         fill_only = GL_TRUE;
+      if (prim_mode == GL_LINES && prim->mode != GL_LINES)
+         unstippled = GL_TRUE;
+
+      count = generate_prim_indices(prim, indices + index_count);
+      run->count += count;
+      index_count += count;
+   }
+
+   if (index_count == 0)
+      goto done;
+
+   if (save->index_store &&
+       save->index_store->used + index_count > VBO_SAVE_INDEX_SIZE) {
+      vbo_save_release_index_store(ctx, save->index_store);
+      save->index_store = NULL;
+   }
+
+   /* Without an index store, the list is just drawn as it is */
+   if (!save->index_store)
+      save->index_store = alloc_index_store(ctx);
+   if (!save->index_store)
+      goto done;
+
+   ctx->Driver.BufferSubData(ctx,
+                             save->index_store->used * sizeof(GLushort),
+                             index_count * sizeof(GLushort), indices,
+                             save->index_store->bufferobj);
+
+   node->indexed_prim = indexed_prim;
+   node->indexed_prim_count = num_runs;
+   node->index_offset = save->index_store->used * sizeof(GLushort);
+   node->index_count = index_count;
+   node->indexed_fill_only = fill_only;
+   node->indexed_unstippled = unstippled;
+   node->index_store = save->index_store;
+   node->index_store->refcount++;
+
+   save->index_store->used += index_count;
+   indexed_prim = NULL;
+
+done:
+   free(indices);
+   free(indexed_prim);
+}
+
+
 /**
  * Insert the active immediate struct onto the display list currently
  * being built.
@@ -443,6 +722,13 @@ _save_compile_vertex_list(struct gl_context *ctx)
    node->prim_count = save->prim_count;
    node->vertex_store = save->vertex_store;
    node->prim_store = save->prim_store;
+   node->indexed_prim = NULL;
+   node->indexed_prim_count = 0;
+   node->index_offset = 0;
+   node->index_count = 0;
+   node->indexed_fill_only = GL_FALSE;
+   node->indexed_unstippled = GL_FALSE;
+   node->index_store = NULL;
 
    node->vertex_store->refcount++;
    node->prim_store->refcount++;
@@ -494,6 +780,8 @@ _save_compile_vertex_list(struct gl_context *ctx)
 
    merge_prims(node->prim, &node->prim_count);
 
+   _save_compile_indexed_prims(ctx, node);
+
    /* Deal with GL_COMPILE_AND_EXECUTE:
     */
    if (ctx->ExecuteFlag) {
@@ -639,6 +927,30 @@ _save_copy_to_current(struct gl_context *ctx)
 }
 
 
+/**
+ * Copy the current vertex to ctx->ListState at the end of a primitive.
+ * A vertex list starting with a glDrawArrays or glDrawElements primitive
+ * doesn't update the current values when called, see
+ * _save_compile_vertex_list(), so the attributes it sets are unknown
+ * afterwards instead.
+ */
+static void
+_save_copy_to_list_state(struct gl_context *ctx, GLboolean no_current_update)
+{
+   struct vbo_save_context *save = &vbo_context(ctx)->save;
+   GLbitfield64 enabled = save->enabled & (~BITFIELD64_BIT(VBO_ATTRIB_POS));
+
+   _save_copy_to_current(ctx);
+
+   if (no_current_update) {
+      while (enabled) {
+         const int i = u_bit_scan64(&enabled);
+         save->currentsz[i][0] = 0;
+      }
+   }
+}
+
+
 static void
 _save_copy_from_current(struct gl_context *ctx)
 {
@@ -934,6 +1246,8 @@ static void
 dlist_fallback(struct gl_context *ctx)
 {
    struct vbo_save_context *save = &vbo_context(ctx)->save;
+   const GLboolean no_current_update =
+      save->prim_count > 0 && save->prim[0].no_current_update;
 
    if (save->vert_count || save->prim_count) {
       if (save->prim_count > 0) {
@@ -951,7 +1265,7 @@ dlist_fallback(struct gl_context *ctx)
       _save_compile_vertex_list(ctx);
    }
 
-   _save_copy_to_current(ctx);
+   _save_copy_to_list_state(ctx, no_current_update);
    _save_reset_vertex(ctx);
    _save_reset_counters(ctx);
    if (save->out_of_memory) {
@@ -1082,6 +1396,11 @@ _save_End(void)
    save->prim[i].end = 1;
    save->prim[i].count = (save->vert_count - save->prim[i].start);
 
+   /* Keep ctx->ListState up to date outside begin/end, so that dlist.c can
+    * drop attribute changes that don't change anything.
+    */
+   _save_copy_to_list_state(ctx, save->prim[0].no_current_update);
+
    if (i == (GLint) save->prim_max - 1) {
       _save_compile_vertex_list(ctx);
       assert(save->copied.nr == 0);
@@ -1492,16 +1811,19 @@ void
 vbo_save_SaveFlushVertices(struct gl_context *ctx)
 {
    struct vbo_save_context *save = &vbo_context(ctx)->save;
+   GLboolean no_current_update;
 
    /* Noop when we are actually active:
     */
    if (ctx->Driver.CurrentSavePrimitive <= PRIM_MAX)
       return;
 
+   no_current_update = save->prim_count > 0 && save->prim[0].no_current_update;
+
    if (save->vert_count || save->prim_count)
       _save_compile_vertex_list(ctx);
 
-   _save_copy_to_current(ctx);
+   _save_copy_to_list_state(ctx, no_current_update);
    _save_reset_vertex(ctx);
    _save_reset_counters(ctx);
    ctx->Driver.SaveNeedFlush = GL_FALSE;
@@ -1598,6 +1920,14 @@ vbo_destroy_vertex_list(struct gl_context *ctx, void *data)
    if (--node->prim_store->refcount == 0)
       free(node->prim_store);
 
+   if (node->index_store) {
+      vbo_save_release_index_store(ctx, node->index_store);
+      node->index_store = NULL;
+   }
+
+   free(node->indexed_prim);
+   node->indexed_prim = NULL;
+
    free(node->current_data);
    node->current_data = NULL;
 }
@@ -1628,6 +1958,17 @@ vbo_print_vertex_list(struct gl_context *ctx, void *data, FILE *f)
              (prim->begin) ? "BEGIN" : "(wrap)",
              (prim->end) ? "END" : "(wrap)");
    }
+
+   for (i = 0; i < node->indexed_prim_count; i++) {
+      struct _mesa_prim *prim = &node->indexed_prim[i];
+      fprintf(f, "   indexed prim %d: %s %d..%d%s%s\n",
+              i,
+              _mesa_lookup_prim_by_nr(prim->mode),
+              prim->start,
+              prim->start + prim->count,
+              node->indexed_fill_only ? " (fill only)" : "",
+              node->indexed_unstippled ? " (unstippled)" : "");
+   }
 }
 
 
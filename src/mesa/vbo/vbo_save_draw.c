@@ -34,6 +34,7 @@
 #include "main/macros.h"
 #include "main/light.h"
 #include "main/state.h"
+#include "main/transformfeedback.h"
 #include "util/bitscan.h"
 
 #include "vbo_context.h"
@@ -241,6 +242,47 @@ vbo_save_loopback_vertex_list(struct gl_context *ctx,
 }
 
 
+/**
+ * Whether the vertex list can be drawn with its indexed primitives instead
+ * of the original ones without any visible difference.
+ */
+static bool
+can_draw_indexed_prims(const struct gl_context *ctx,
+                       const struct vbo_save_vertex_list *node)
+{
+   if (!node->indexed_prim_count)
+      return false;
+
+   /* Feedback and selection return primitive tokens and vertices in the
+    * order they were specified.
+    */
+   if (ctx->RenderMode != GL_RENDER)
+      return false;
+
+   /* The decomposed primitives only keep the provoking vertex of the last
+    * vertex convention.
+    */
+   if (ctx->Light.ProvokingVertex != GL_LAST_VERTEX_CONVENTION_EXT)
+      return false;
+
+   if (node->indexed_fill_only &&
+       (ctx->Polygon.FrontMode != GL_FILL || ctx->Polygon.BackMode != GL_FILL))
+      return false;
+
+   if (node->indexed_unstippled && ctx->Line.StippleFlag)
+      return false;
+
+   /* A user restart index could match one of ours, and transform feedback
+    * must see the primitives as drawn.
+    */
+   if (ctx->Array._PrimitiveRestart ||
+       _mesa_is_xfb_active_and_unpaused(ctx))
+      return false;
+
+   return true;
+}
+
+
 /**
  * Execute the buffer and save copied verts.
  * This is called from the display list code when executing
@@ -307,7 +349,24 @@ vbo_save_playback_vertex_list(struct gl_context *ctx, void *data)
       if (ctx->NewState)
 	 _mesa_update_state( ctx );
 
-      if (node->count > 0) {
+      if (node->count > 0 && can_draw_indexed_prims(ctx, node)) {
+         struct _mesa_index_buffer ib;
+
+         ib.count = node->index_count;
+         ib.type = GL_UNSIGNED_SHORT;
+         ib.obj = node->index_store->bufferobj;
+         ib.ptr = (const GLubyte *) NULL + node->index_offset;
+
+         vbo_context(ctx)->draw_prims(ctx,
+                                      node->indexed_prim,
+                                      node->indexed_prim_count,
+                                      &ib,
+                                      GL_TRUE,
+                                      0,
+                                      node->count - 1,
+                                      NULL, 0, NULL);
+      }
+      else if (node->count > 0) {
          vbo_context(ctx)->draw_prims(ctx, 
                                       node->prim,
                                       node->prim_count,